@@ -0,0 +1,64 @@
+############################################################################
+##
+## Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+## All rights reserved.
+## Contact: Nokia Corporation (testabilitydriver@nokia.com)
+##
+## This file is part of Testability Driver.
+##
+## If you have questions regarding the use of this file, please contact
+## Nokia at testabilitydriver@nokia.com .
+##
+## This library is free software; you can redistribute it and/or
+## modify it under the terms of the GNU Lesser General Public
+## License version 2.1 as published by the Free Software Foundation
+## and appearing in the file LICENSE.LGPL included in the packaging
+## of this file.
+##
+############################################################################
+
+
+# QTestLib benchmarks of visualizer internals, run for example with
+#   ../bin/tdriver_benchmarks -tickcounter
+include (../visualizer.pri)
+TEMPLATE = app
+TARGET = tdriver_benchmarks
+DEPENDPATH += .. \
+    ../inc
+INCLUDEPATH += .. \
+    ../inc
+CONFIG += qtestlib
+CONFIG += link_prl
+
+# For libutil
+INCLUDEPATH += $$UTILLIBDIR
+LIBS += -l$$UTIL_LIB
+
+# For libtdrivereditor
+INCLUDEPATH += $$EDITORLIBDIR
+LIBS += -l$$EDITOR_LIB
+QT += network
+
+# For libtdriverfeatureditor
+INCLUDEPATH += $$FEATUREDITORLIBDIR
+LIBS += -l$$FEATUREDITOR_LIB
+
+# keyword files are read from source tree, so installed ones are not needed
+DEFINES += TDRIVER_COMPLETIONS_DIR=\\\"$$PWD/../libtdrivereditor/completions\\\"
+
+HEADERS += tdriver_benchmarks.h
+SOURCES += tdriver_benchmarks.cpp
+
+# visualizer classes are not in a library, so measured ones are compiled in
+HEADERS += ../inc/tdriver_uidump_parser.h
+HEADERS += ../inc/tdriver_testobject_store.h
+HEADERS += ../inc/tdriver_screenshot_index.h
+HEADERS += ../inc/tdriver_object_search_index.h
+HEADERS += ../inc/tdriver_object_selector.h
+SOURCES += ../src/tdriver_uidump_parser.cpp
+SOURCES += ../src/tdriver_testobject_store.cpp
+SOURCES += ../src/tdriver_screenshot_index.cpp
+SOURCES += ../src/tdriver_object_search_index.cpp
+SOURCES += ../src/tdriver_object_selector.cpp
+
+QT += xml
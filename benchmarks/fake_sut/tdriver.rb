@@ -0,0 +1,127 @@
+############################################################################
+##
+## Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+## All rights reserved.
+## Contact: Nokia Corporation (testabilitydriver@nokia.com)
+##
+## This file is part of Testability Driver.
+##
+## If you have questions regarding the use of this file, please contact
+## Nokia at testabilitydriver@nokia.com .
+##
+## This library is free software; you can redistribute it and/or
+## modify it under the terms of the GNU Lesser General Public
+## License version 2.1 as published by the Free Software Foundation
+## and appearing in the file LICENSE.LGPL included in the packaging
+## of this file.
+##
+############################################################################
+
+############################################################################
+# Fake tdriver gem for measuring tdriver_interface.rb without a device.
+# Load it ahead of the real gem with: ruby -I benchmarks/fake_sut tdriver_interface.rb
+#
+# Each sut returns a generated UI dump and a small PNG after a delay, which
+# stands for the time a real sut takes to traverse its objects or grab the
+# screen. Delays and dump size are set with environment variables:
+#   FAKE_SUT_UI_DUMP_DELAY  seconds per get_ui_dump, default 0.3
+#   FAKE_SUT_CAPTURE_DELAY  seconds per capture_screen, default 0.2
+#   FAKE_SUT_OBJECTS        objects in UI dump, default 2000
+############################################################################
+
+# tdriver_interface.rb still uses names removed from newer Ruby versions
+Config = RbConfig unless defined?( Config )
+Fixnum = Integer unless defined?( Fixnum )
+Bignum = Integer unless defined?( Bignum )
+
+ENV[ 'TDRIVER_VERSION' ] ||= 'fake'
+
+
+module MobyUtil
+
+  class ParameterHash < Hash
+    def []( key, default = nil )
+      fetch( key, default )
+    end
+  end
+
+  class Parameter
+    @parameters = Hash.new { | hash, sut_id | hash[ sut_id ] = ParameterHash.new }
+
+    def self.[]( sut_id )
+      @parameters[ sut_id.to_sym ]
+    end
+  end
+
+  class FileHelper
+    def self.fix_path( path )
+      path
+    end
+  end
+
+end
+
+
+module TDriver
+
+  class FakeSut
+
+    # smallest valid PNG, a single transparent pixel
+    PNG_DATA = [ '89504e470d0a1a0a0000000d4948445200000001000000010806000000' \
+                 '1f15c4890000000d4944415478da63f8ffff3f0005fe02fea7d6a5d60000' \
+                 '000049454e44ae426082' ].pack( 'H*' )
+
+    attr_reader :id
+
+    def initialize( id )
+      @id = id
+      @ui_dump_delay = ( ENV[ 'FAKE_SUT_UI_DUMP_DELAY' ] || 0.3 ).to_f
+      @capture_delay = ( ENV[ 'FAKE_SUT_CAPTURE_DELAY' ] || 0.2 ).to_f
+      @object_count = ( ENV[ 'FAKE_SUT_OBJECTS' ] || 2000 ).to_i
+      @test_object_factory = Struct.new( :timeout ).new( 20 )
+    end
+
+    def connect( attributes = {} ); end
+
+    def disconnect; end
+
+    def get_ui_dump( attributes = {} )
+      sleep @ui_dump_delay
+      objects = ( 1 .. @object_count ).collect { | index |
+        "<obj type=\"QPushButton\" name=\"button#{ index }\" id=\"#{ 1000 + index }\" env=\"qt\">" \
+        "<attr name=\"text\" type=\"QString\" access=\"readWrite\">Button #{ index }</attr>" \
+        "<attr name=\"x\" type=\"int\" access=\"readOnly\">#{ index % 800 }</attr></obj>"
+      }
+      "<tasMessage version=\"1.3\"><tasInfo id=\"1\" name=\"#{ @id }\" env=\"qt\">#{ objects.join }</tasInfo></tasMessage>"
+    end
+
+    # sut takes :Filename option, application takes format, file name and redraw flag
+    def capture_screen( *arguments )
+      filename = arguments.first.kind_of?( Hash ) ? arguments.first[ :Filename ] : arguments[ 1 ]
+      sleep @capture_delay
+      File.open( filename, 'wb' ) { | file | file << PNG_DATA }
+    end
+
+    def list_apps
+      "<tasMessage version=\"1.3\"><tasInfo id=\"1\" name=\"#{ @id }\" env=\"qt\">" \
+      "<obj type=\"application\" name=\"fakeapp\" id=\"42\" env=\"qt\"/></tasInfo></tasMessage>"
+    end
+
+    def application( attributes = {} )
+      self
+    end
+
+  end
+
+  @suts = Hash.new
+
+  def self.connect_sut( sut_attributes = {} )
+    id = sut_attributes[ :Id ].to_sym
+    @suts[ id ] ||= FakeSut.new( id )
+  end
+
+  def self.disconnect_sut( sut_attributes = {} )
+    @suts.delete( sut_attributes[ :Id ].to_sym )
+  end
+
+end
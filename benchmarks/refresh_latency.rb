@@ -0,0 +1,172 @@
+############################################################################
+##
+## Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+## All rights reserved.
+## Contact: Nokia Corporation (testabilitydriver@nokia.com)
+##
+## This file is part of Testability Driver.
+##
+## If you have questions regarding the use of this file, please contact
+## Nokia at testabilitydriver@nokia.com .
+##
+## This library is free software; you can redistribute it and/or
+## modify it under the terms of the GNU Lesser General Public
+## License version 2.1 as published by the Free Software Foundation
+## and appearing in the file LICENSE.LGPL included in the packaging
+## of this file.
+##
+############################################################################
+
+############################################################################
+# Measures end-to-end refresh latency of tdriver_interface.rb against the
+# fake sut in fake_sut/tdriver.rb. A refresh is a refresh_ui and a
+# refresh_image request of one sut, sent either one after the other reply,
+# like the visualizer did when all requests ran on the main thread, or both
+# at once, so that the screen capture runs while the dump is sent.
+#
+# Usage: ruby refresh_latency.rb [rounds] [inline]
+# Fake sut delays and dump size are set as described in fake_sut/tdriver.rb.
+############################################################################
+
+require 'socket'
+require 'benchmark'
+
+BENCHMARK_DIR = File.expand_path( File.dirname( __FILE__ ) )
+INTERFACE_RB = File.join( BENCHMARK_DIR, '..', 'libtdriverutil', 'tdriver_interface.rb' )
+
+
+# same message format as tdriver_interface.rb and TDriverRbProtocol use
+def make_message( seq_num, name, map )
+  map_data = map.collect { | key, list |
+    list_data = list.collect { | item | [ item.to_s.bytesize, item.to_s ].pack( 'Na*' ) }.join
+    [ key.bytesize, key, list_data.bytesize, list_data ].pack( 'Na*Na*' )
+  }.join
+  [ seq_num, name.bytesize, name, map_data.bytesize, map_data ].pack( 'NNa*Na*' )
+end
+
+
+def read_exactly( socket, length )
+  data = ''.b
+  while data.bytesize < length
+    chunk = socket.read( length - data.bytesize )
+    raise 'Connection closed' if chunk.nil? or chunk.empty?
+    data << chunk
+  end
+  data
+end
+
+
+def read_bytes( socket )
+  length = read_exactly( socket, 4 ).unpack( 'N' )[ 0 ]
+  ( length == 0 or length == 0xFFFFFFFF ) ? '' : read_exactly( socket, length )
+end
+
+
+def parse_map( data )
+  map = {}
+  offset = 0
+  while offset < data.bytesize
+    key_length = data[ offset, 4 ].unpack( 'N' )[ 0 ]
+    key = data[ offset + 4, key_length ]
+    offset += 4 + key_length
+    list_length = data[ offset, 4 ].unpack( 'N' )[ 0 ]
+    list_end = offset + 4 + list_length
+    offset += 4
+    map[ key ] = []
+    while offset < list_end
+      item_length = data[ offset, 4 ].unpack( 'N' )[ 0 ]
+      map[ key ] << ( item_length == 0xFFFFFFFF ? '' : data[ offset + 4, item_length ] )
+      offset += 4 + ( item_length == 0xFFFFFFFF ? 0 : item_length )
+    end
+  end
+  map
+end
+
+
+# returns sequence number, name and map of next message
+def read_message( socket )
+  seq_num = read_exactly( socket, 4 ).unpack( 'N' )[ 0 ]
+  name = read_bytes( socket )
+  return seq_num, name, parse_map( read_bytes( socket ) )
+end
+
+
+class RefreshClient
+
+  def initialize( inline )
+    @inline = inline
+    @seq_num = 0
+    @pipe = IO.popen( [ 'ruby', '-I', File.join( BENCHMARK_DIR, 'fake_sut' ), INTERFACE_RB ], 'r' )
+    hello = @pipe.gets.to_s.split
+    raise "Unexpected hello line: #{ hello.join( ' ' ) }" unless hello[ 0 ] == 'TDriverVisualizerRubyInterface' and hello[ 6 ] != 'error'
+    @socket = TCPSocket.new( '127.0.0.1', hello[ 4 ].to_i )
+    seq_num, name, = read_message( @socket )
+    raise "Unexpected hello message #{ seq_num } #{ name }" unless seq_num == 0 and name == 'hello'
+  end
+
+  def send_request( sut_id, command )
+    @seq_num += 1
+    map = { 'input' => [ sut_id, command ] }
+    map[ 'inline' ] = [] if @inline
+    @socket.write( make_message( @seq_num, 'visualization', map ) )
+    @seq_num
+  end
+
+  # waits for replies of given requests, returns seconds from start to each reply
+  def wait_replies( seq_nums, start )
+    latencies = {}
+    until ( seq_nums - latencies.keys ).empty?
+      seq_num, name, map = read_message( @socket )
+      raise "Request #{ seq_num } failed: #{ map[ 'error' ].inspect }" if map.key?( 'error' )
+      latencies[ seq_num ] = Time.now - start
+    end
+    seq_nums.collect { | seq_num | latencies[ seq_num ] }
+  end
+
+  def sequential_refresh( sut_id )
+    start = Time.now
+    ui, = wait_replies( [ send_request( sut_id, 'refresh_ui' ) ], start )
+    image, = wait_replies( [ send_request( sut_id, 'refresh_image' ) ], start )
+    return ui, image
+  end
+
+  def concurrent_refresh( sut_id )
+    start = Time.now
+    ui_request = send_request( sut_id, 'refresh_ui' )
+    image_request = send_request( sut_id, 'refresh_image' )
+    wait_replies( [ ui_request, image_request ], start )
+  end
+
+  def close
+    @socket.write( make_message( @seq_num + 1, 'visualization', { 'input' => [ 'quit' ] } ) )
+    @socket.close
+    Process.wait( @pipe.pid )
+    @pipe.close
+  end
+
+end
+
+
+def report( label, results )
+  ui = results.collect { | result | result[ 0 ] }
+  refresh = results.collect { | result | result.max }
+  average = lambda { | list | list.inject( 0.0 ) { | sum, value | sum + value } / list.size * 1000 }
+  printf( "%-10s ui dump reply %7.1f ms, refresh done %7.1f ms (best %.1f ms)\n",
+          label, average.call( ui ), average.call( refresh ), refresh.min * 1000 )
+end
+
+
+rounds = ( ARGV[ 0 ] || 10 ).to_i
+inline = ( ARGV[ 1 ] == 'inline' )
+
+client = RefreshClient.new( inline )
+begin
+  # first requests connect the sut and start the workers
+  client.concurrent_refresh( 'sut_qt' )
+
+  puts "#{ rounds } rounds, #{ inline ? 'inline payloads' : 'payloads in files' }"
+  report( 'sequential', ( 1 .. rounds ).collect { client.sequential_refresh( 'sut_qt' ) } )
+  report( 'concurrent', ( 1 .. rounds ).collect { client.concurrent_refresh( 'sut_qt' ) } )
+ensure
+  client.close
+end
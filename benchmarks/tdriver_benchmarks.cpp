@@ -0,0 +1,811 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#include "tdriver_benchmarks.h"
+
+#include "tdriver_uidump_parser.h"
+#include "tdriver_screenshot_index.h"
+#include "tdriver_object_search_index.h"
+#include "tdriver_object_selector.h"
+
+#include <tdriver_highlighter.h>
+#include <tdriver_consoletextedit.h>
+#include <tdriver_featurstepmatcher.h>
+#include <tdriver_rbiprotocol.h>
+
+#include <QtTest>
+#include <QBuffer>
+#include <QFile>
+#include <QTextDocument>
+#include <QTextCharFormat>
+#include <QXmlStreamWriter>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <QtXml/QDomDocument>
+
+
+/*!
+    \class TDriverBenchmarks
+    \brief QTestLib benchmarks for visualizer and editor library internals.
+
+    Inputs are generated, so no large test data is kept in the repository.
+    Data rows go from typical to large sizes, and the largest rows show how
+    things scale on dumps of big applications. Where an earlier implementation
+    was replaced, its core cost is measured beside the new one for comparison.
+ */
+
+
+static const char *const objectTypes[] = { "QWidget", "QPushButton", "QLabel", "QLineEdit", "QLayout",
+                                           "QGraphicsView", "QGraphicsItem", "QDialog", "QTreeView" };
+static const int objectTypeCount = sizeof(objectTypes) / sizeof(objectTypes[0]);
+
+
+static void writeAttr(QXmlStreamWriter &writer, const QString &name, const QString &value)
+{
+    writer.writeStartElement("attr");
+    writer.writeAttribute("name", name);
+    writer.writeAttribute("type", "QString");
+    writer.writeAttribute("access", "readOnly");
+    writer.writeCharacters(value);
+    writer.writeEndElement();
+}
+
+
+// Writes object and its children depth first, like traversers do
+static void writeObject(QXmlStreamWriter &writer, int &next, int count, int depth)
+{
+    const int index = next++;
+
+    writer.writeStartElement("obj");
+    writer.writeAttribute("type", objectTypes[index % objectTypeCount]);
+    // every fourth name is shared, so duplicate name statistics have work to do
+    writer.writeAttribute("name", (index % 4) ? QString("object%1").arg(index) : QString("shared%1").arg(index % 100));
+    writer.writeAttribute("id", QString::number(100000 + index));
+    writer.writeAttribute("env", "qt");
+
+    writeAttr(writer, "objectName", QString("object%1").arg(index));
+    writeAttr(writer, "x", QString::number((index * 37) % 800));
+    writeAttr(writer, "y", QString::number((index * 53) % 480));
+    writeAttr(writer, "width", QString::number(20 + (index * 7) % 200));
+    writeAttr(writer, "height", QString::number(10 + (index * 11) % 100));
+    writeAttr(writer, "visible", (index % 5) ? "true" : "false");
+    writeAttr(writer, "enabled", "true");
+    writeAttr(writer, "text", QString("Item %1").arg(index % 500));
+
+    for (int child = 0; child < 6 && depth < 6 && next < count; ++child) {
+        writeObject(writer, next, count, depth + 1);
+    }
+
+    writer.writeEndElement();
+}
+
+
+// UI dump of 1.3+ format with objectCount objects below the sut
+QByteArray TDriverBenchmarks::generateUiDump(int objectCount)
+{
+    QByteArray xml;
+    xml.reserve(objectCount * 600);
+
+    QXmlStreamWriter writer(&xml);
+    writer.writeStartDocument();
+    writer.writeStartElement("tasMessage");
+    writer.writeAttribute("version", "1.3");
+    writer.writeStartElement("tasInfo");
+    writer.writeAttribute("id", "1");
+    writer.writeAttribute("name", "sut_qt");
+    writer.writeAttribute("env", "qt");
+
+    int next = 0;
+    while (next < objectCount) {
+        writeObject(writer, next, objectCount, 0);
+    }
+
+    writer.writeEndElement();
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    return xml;
+}
+
+
+const QByteArray &TDriverBenchmarks::uiDump(int objectCount)
+{
+    QHash<int, QByteArray>::iterator it = uiDumps.find(objectCount);
+    if (it == uiDumps.end()) {
+        it = uiDumps.insert(objectCount, generateUiDump(objectCount));
+    }
+    return it.value();
+}
+
+
+const TDriverTestObjectStore &TDriverBenchmarks::parsedObjects(int objectCount)
+{
+    QHash<int, TDriverTestObjectStore>::iterator it = parsedStores.find(objectCount);
+    if (it == parsedStores.end()) {
+        QBuffer buffer;
+        buffer.setData(uiDump(objectCount));
+        buffer.open(QIODevice::ReadOnly);
+
+        TDriverUiDumpParser parser;
+        parser.parse(&buffer);
+        it = parsedStores.insert(objectCount, parser.objects());
+    }
+    return it.value();
+}
+
+
+void TDriverBenchmarks::objectCountRows()
+{
+    QTest::addColumn<int>("objects");
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("500k") << 500000;
+}
+
+
+void TDriverBenchmarks::cleanupTestCase()
+{
+    uiDumps.clear();
+    parsedStores.clear();
+}
+
+
+void TDriverBenchmarks::uiDumpParse_data()
+{
+    objectCountRows();
+}
+
+
+void TDriverBenchmarks::uiDumpParse()
+{
+    QFETCH(int, objects);
+    const QByteArray &dump = uiDump(objects);
+    TDriverUiDumpParser parser;
+
+    QBENCHMARK {
+        QBuffer buffer;
+        buffer.setData(dump);
+        buffer.open(QIODevice::ReadOnly);
+        QVERIFY(parser.parse(&buffer));
+    }
+
+    QCOMPARE(parser.objects().count(), objects + 1);
+}
+
+
+void TDriverBenchmarks::uiDumpDomLoad_data()
+{
+    // DOM of 500k objects takes gigabytes, which was the reason to replace it
+    QTest::addColumn<int>("objects");
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+}
+
+
+// Only the DOM load of the earlier loader, it then walked the DOM twice more
+void TDriverBenchmarks::uiDumpDomLoad()
+{
+    QFETCH(int, objects);
+    const QByteArray &dump = uiDump(objects);
+
+    QBENCHMARK {
+        QDomDocument document;
+        QVERIFY(document.setContent(dump));
+    }
+}
+
+
+// Copies subtree in document order, the way parser fills the store
+static void copyObject(const TDriverTestObjectStore &source, int sourceIndex, TDriverTestObjectStore &target, int targetParent)
+{
+    int index = target.beginObject(targetParent, source.treeItemInfo(sourceIndex));
+
+    const int attributeCount = source.attributeCount(sourceIndex);
+    for (int n = 0; n < attributeCount; ++n) {
+        target.addAttribute(index, source.attributeAt(sourceIndex, n));
+    }
+
+    for (int child = source.firstChild(sourceIndex); child >= 0; child = source.nextSibling(child)) {
+        copyObject(source, child, target, index);
+    }
+
+    target.endObject(index);
+}
+
+
+void TDriverBenchmarks::objectStoreBuild_data()
+{
+    objectCountRows();
+}
+
+
+void TDriverBenchmarks::objectStoreBuild()
+{
+    QFETCH(int, objects);
+    const TDriverTestObjectStore &source = parsedObjects(objects);
+    TDriverTestObjectStore store;
+
+    QBENCHMARK {
+        store.clear();
+        copyObject(source, 0, store, -1);
+    }
+
+    QCOMPARE(store.count(), source.count());
+    qDebug() << "objects" << store.count() << "strings" << store.stringCount()
+             << "memory usage" << store.memoryUsage() / 1024 << "KiB";
+}
+
+
+void TDriverBenchmarks::objectStoreLookup_data()
+{
+    objectCountRows();
+}
+
+
+// Same lookups as filling properties table and finding tree items by id
+void TDriverBenchmarks::objectStoreLookup()
+{
+    QFETCH(int, objects);
+    const TDriverTestObjectStore &store = parsedObjects(objects);
+    const int count = store.count();
+    const int textKey = store.attributeKey("text");
+    int found = 0;
+
+    QBENCHMARK {
+        found = 0;
+        for (int index = 0; index < count; ++index) {
+            if (store.indexOfId(store.id(index)) == index) ++found;
+            if (!store.attributeValue(index, "objectName").isEmpty()) ++found;
+            if (store.hasAttribute(index, textKey)) ++found;
+        }
+    }
+
+    // sut has no attributes
+    QCOMPARE(found, 3 * count - 2);
+}
+
+
+// Rects of all objects except sut, index in vector is object index - 1
+QVector<QRect> TDriverBenchmarks::objectRects(const TDriverTestObjectStore &objects)
+{
+    const int xKey = objects.attributeKey("x");
+    const int yKey = objects.attributeKey("y");
+    const int widthKey = objects.attributeKey("width");
+    const int heightKey = objects.attributeKey("height");
+
+    QVector<QRect> results;
+    results.reserve(objects.count());
+
+    for (int index = 1; index < objects.count(); ++index) {
+        results << QRect(objects.attributeValue(index, xKey).toInt(),
+                         objects.attributeValue(index, yKey).toInt(),
+                         objects.attributeValue(index, widthKey).toInt(),
+                         objects.attributeValue(index, heightKey).toInt());
+    }
+    return results;
+}
+
+
+// Mouse positions over the generated 800x480 screen
+QVector<QPoint> TDriverBenchmarks::queryPoints()
+{
+    QVector<QPoint> results;
+    for (int y = 0; y < 480; y += 16) {
+        for (int x = 0; x < 800; x += 25) {
+            results << QPoint(x, y);
+        }
+    }
+    return results;
+}
+
+
+void TDriverBenchmarks::screenshotIndexBuild_data()
+{
+    objectCountRows();
+}
+
+
+void TDriverBenchmarks::screenshotIndexBuild()
+{
+    QFETCH(int, objects);
+    const QVector<QRect> rects = objectRects(parsedObjects(objects));
+    TDriverScreenshotIndex index;
+
+    QBENCHMARK {
+        index.clear();
+        for (int n = 0; n < rects.size(); ++n) {
+            index.addObject(n, rects.at(n), true);
+        }
+        index.build();
+    }
+
+    QCOMPARE(index.count(), rects.size());
+}
+
+
+void TDriverBenchmarks::screenshotIndexQuery_data()
+{
+    objectCountRows();
+}
+
+
+void TDriverBenchmarks::screenshotIndexQuery()
+{
+    QFETCH(int, objects);
+    const QVector<QRect> rects = objectRects(parsedObjects(objects));
+    const QVector<QPoint> points = queryPoints();
+
+    TDriverScreenshotIndex index;
+    for (int n = 0; n < rects.size(); ++n) {
+        index.addObject(n, rects.at(n), true);
+    }
+    index.build();
+
+    int hits = 0;
+    QBENCHMARK {
+        hits = 0;
+        foreach (const QPoint &pos, points) {
+            if (index.smallestAt(pos) >= 0) ++hits;
+        }
+    }
+    QVERIFY(hits > 0);
+}
+
+
+void TDriverBenchmarks::screenshotLinearQuery_data()
+{
+    objectCountRows();
+}
+
+
+// Every query tests every rect, as hit testing did before the index
+void TDriverBenchmarks::screenshotLinearQuery()
+{
+    QFETCH(int, objects);
+    const QVector<QRect> rects = objectRects(parsedObjects(objects));
+    const QVector<QPoint> points = queryPoints();
+
+    int hits = 0;
+    QBENCHMARK {
+        hits = 0;
+        foreach (const QPoint &pos, points) {
+            int smallest = -1;
+            qint64 smallestArea = 0;
+            for (int n = 0; n < rects.size(); ++n) {
+                const QRect &rect = rects.at(n);
+                qint64 area = qint64(rect.width()) * rect.height();
+                if (area > 0 && rect.contains(pos) && (smallest < 0 || area < smallestArea)) {
+                    smallest = n;
+                    smallestArea = area;
+                }
+            }
+            if (smallest >= 0) ++hits;
+        }
+    }
+    QVERIFY(hits > 0);
+}
+
+
+// Default rules and Ruby keyword lists, without the rest of the Ruby rules
+class BenchmarkKeywordHighlighter : public TDriverHighlighter
+{
+public:
+    BenchmarkKeywordHighlighter(bool wordTrie, QTextDocument *parent) : TDriverHighlighter(parent)
+    {
+        QList<const HighlightingRuleBase*> rules;
+        const QString dir(TDRIVER_COMPLETIONS_DIR "/");
+
+        if (wordTrie) {
+            readPlainStrings(dir + "plain_ruby_keywords.txt", keywordFormat, rules);
+            readPlainStrings(dir + "plain_ruby_classes.txt", keywordFormat, rules);
+        }
+        else {
+            addWordRegExps(dir + "plain_ruby_keywords.txt", rules);
+            addWordRegExps(dir + "plain_ruby_classes.txt", rules);
+        }
+
+        ruleListList.append(rules);
+        keywordRuleCount = rules.size();
+    }
+
+    int keywordRuleCount;
+
+private:
+    // rules like readPlainStrings used to add, one \bword\b regex per word
+    void addWordRegExps(const QString &fileName, QList<const HighlightingRuleBase*> &rules)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "Could not open" << fileName;
+            return;
+        }
+
+        while (!file.atEnd()) {
+            QString word = QString::fromUtf8(file.readLine()).trimmed();
+            if (word.isEmpty()) continue;
+            HighlightingRule1 *rule1 = new HighlightingRule1(this);
+            rule1->matchPat = new QRegExp(word.prepend("\\b").append("\\b"));
+            rule1->format = keywordFormat;
+            rules.append(rule1);
+        }
+    }
+};
+
+
+QString TDriverBenchmarks::generateRubyScript(int lineCount)
+{
+    static const char *const lines[] = {
+        "class Calculator%1 < Object",
+        "  def compute_value(argument, options = {})",
+        "    return nil if argument.nil? or not defined?(@value)",
+        "    result = Array.new(argument.size) { |index| index * %1 }",
+        "    puts \"computed #{result.length} values\" unless options[:quiet]",
+        "    while result.empty? == false do result.pop end",
+        "    raise ArgumentError, 'negative' if argument.first < 0",
+        "    Hash[result.zip(argument)].each_pair { |key, value| yield key, value }",
+        "  end",
+        "end" };
+    const int lineTemplates = sizeof(lines) / sizeof(lines[0]);
+
+    QString script;
+    for (int n = 0; n < lineCount; ++n) {
+        script += QString(lines[n % lineTemplates]).replace("%1", QString::number(n / lineTemplates));
+        script += '\n';
+    }
+    return script;
+}
+
+
+void TDriverBenchmarks::highlightKeywords_data()
+{
+    QTest::addColumn<bool>("wordTrie");
+    QTest::addColumn<int>("lines");
+    QTest::newRow("trie 1k") << true << 1000;
+    QTest::newRow("trie 10k") << true << 10000;
+    QTest::newRow("trie 50k") << true << 50000;
+    QTest::newRow("regex 1k") << false << 1000;
+    QTest::newRow("regex 10k") << false << 10000;
+}
+
+
+void TDriverBenchmarks::highlightKeywords()
+{
+    QFETCH(bool, wordTrie);
+    QFETCH(int, lines);
+
+    QTextDocument document(generateRubyScript(lines));
+    BenchmarkKeywordHighlighter highlighter(wordTrie, &document);
+    QVERIFY(highlighter.keywordRuleCount > 0);
+
+    QBENCHMARK {
+        highlighter.rehighlight();
+    }
+}
+
+
+void TDriverBenchmarks::consoleOutputStress_data()
+{
+    // chunks per flush: flush timer fires about once per frame, and a busy
+    // script fills many socket reads in between
+    QTest::addColumn<int>("maximumLines");
+    QTest::addColumn<int>("chunksPerFlush");
+    QTest::newRow("20k lines, flush per chunk") << 20000 << 1;
+    QTest::newRow("20k lines, flush per 64 chunks") << 20000 << 64;
+    QTest::newRow("1k lines, flush per 64 chunks") << 1000 << 64;
+}
+
+
+void TDriverBenchmarks::consoleOutputStress()
+{
+    QFETCH(int, maximumLines);
+    QFETCH(int, chunksPerFlush);
+
+    // 4 KiB chunks of 64 character lines, like socket reads of script output
+    const int totalBytes = 100 * 1024 * 1024;
+    const int chunkBytes = 4096;
+    QString chunk;
+    while (chunk.size() < chunkBytes) {
+        chunk += QString("output line %1 ").arg(chunk.size(), 8, 10, QChar('0')).leftJustified(63, '.') + '\n';
+    }
+
+    TDriverConsoleTextEdit console;
+    console.setMaximumLines(maximumLines);
+
+    QBENCHMARK_ONCE {
+        for (int chunks = 0; chunks < totalBytes / chunkBytes; ++chunks) {
+            console.appendText(chunk, console.outputFormat);
+            if ((chunks + 1) % chunksPerFlush == 0) {
+                console.flushAppendedText();
+            }
+        }
+        console.flushAppendedText();
+    }
+
+    QVERIFY(console.document()->blockCount() <= maximumLines);
+}
+
+
+static const char *const stepWords[] = { "I", "the", "user", "application", "a",
+                                         "my", "all", "device", "screen", "list" };
+static const int stepWordCount = sizeof(stepWords) / sizeof(stepWords[0]);
+
+
+// Step definition lines, every 20th without anchor and literal prefix
+QStringList TDriverBenchmarks::generateStepDefinitions(int definitionCount)
+{
+    static const char *const keywords[] = { "Given", "When", "Then" };
+    QStringList results;
+
+    for (int n = 0; n < definitionCount; ++n) {
+        const QString keyword(keywords[n % 3]);
+        const QString word(stepWords[n % stepWordCount]);
+
+        if (n % 20 == 0) {
+            results << QString("%1 / step %2 is shown$/ do").arg(keyword).arg(n);
+        }
+        else {
+            results << QString("%1 /^%2 step %3 has (\\d+) items? in \"([^\"]*)\"$/ do |count, name|")
+                       .arg(keyword, word).arg(n);
+        }
+    }
+    return results;
+}
+
+
+// Feature file step lines, about every 10th of them has no definition
+QStringList TDriverBenchmarks::generateSteps(int stepCount, int definitionCount)
+{
+    static const char *const keywords[] = { "Given", "When", "Then", "And" };
+    const int range = definitionCount + definitionCount / 10;
+    QStringList results;
+
+    for (int s = 0; s < stepCount; ++s) {
+        const int n = int((qint64(s) * 7919) % range);
+        const QString keyword(keywords[s % 4]);
+        const QString word(stepWords[n % stepWordCount]);
+
+        if (n % 20 == 0) {
+            results << QString("    %1 %2 step %3 is shown").arg(keyword, word).arg(n);
+        }
+        else {
+            results << QString("    %1 %2 step %3 has %4 items in \"view%5\"").arg(keyword, word).arg(n).arg(s % 9).arg(s);
+        }
+    }
+    return results;
+}
+
+
+void TDriverBenchmarks::stepMatch_data()
+{
+    QTest::addColumn<int>("definitions");
+    QTest::addColumn<int>("steps");
+    QTest::newRow("1k x 10k") << 1000 << 10000;
+    QTest::newRow("5k x 10k") << 5000 << 10000;
+    QTest::newRow("5k x 50k") << 5000 << 50000;
+}
+
+
+// Definitions are loaded again for each round, so match cache starts empty
+void TDriverBenchmarks::stepMatch()
+{
+    QFETCH(int, definitions);
+    QFETCH(int, steps);
+
+    const QStringList definitionLines = generateStepDefinitions(definitions);
+    const QStringList stepLines = generateSteps(steps, definitions);
+    TDriverFeaturStepMatcher matcher;
+    int undefined = 0;
+
+    QBENCHMARK {
+        matcher.clear();
+        for (int n = 0; n < definitionLines.size(); ++n) {
+            matcher.addDefinition("features/step_definitions/generated_steps.rb", n + 1, definitionLines.at(n));
+        }
+
+        undefined = 0;
+        foreach (const QString &step, stepLines) {
+            if (matcher.match(step).status == TDriverFeaturStepMatcher::Undefined) ++undefined;
+        }
+    }
+
+    QCOMPARE(matcher.definitionCount(), definitions);
+    QVERIFY(undefined > 0 && undefined < steps);
+}
+
+
+void TDriverBenchmarks::stepMatchAllDefinitions_data()
+{
+    QTest::addColumn<int>("definitions");
+    QTest::addColumn<int>("steps");
+    QTest::newRow("1k x 10k") << 1000 << 10000;
+    QTest::newRow("5k x 10k") << 5000 << 10000;
+}
+
+
+void TDriverBenchmarks::stepMatchAllDefinitions()
+{
+    QFETCH(int, definitions);
+    QFETCH(int, steps);
+
+    const QStringList definitionLines = generateStepDefinitions(definitions);
+    const QStringList stepLines = generateSteps(steps, definitions);
+
+    QList<QRegExp> patterns;
+    foreach (const QString &line, definitionLines) {
+        QString source;
+        QRegExp rx;
+        QVERIFY(TDriverFeaturStepMatcher::parseDefinition(line, source, rx));
+        patterns << rx;
+    }
+
+    int undefined = 0;
+    QBENCHMARK {
+        undefined = 0;
+        foreach (const QString &step, stepLines) {
+            const QString text(TDriverFeaturStepMatcher::stepText(step));
+            int matches = 0;
+            for (int n = 0; n < patterns.size(); ++n) {
+                if (patterns[n].indexIn(text) >= 0) ++matches;
+            }
+            if (matches == 0) ++undefined;
+        }
+    }
+
+    QVERIFY(undefined > 0 && undefined < steps);
+}
+
+
+void TDriverBenchmarks::searchIndexBuild_data()
+{
+    objectCountRows();
+}
+
+
+void TDriverBenchmarks::searchIndexBuild()
+{
+    QFETCH(int, objects);
+    const TDriverTestObjectStore &store = parsedObjects(objects);
+    TDriverObjectSearchIndex searchIndex;
+
+    QBENCHMARK {
+        searchIndex.build(store);
+    }
+
+    QVERIFY(!searchIndex.isEmpty());
+}
+
+
+void TDriverBenchmarks::selectorMatch_data()
+{
+    QTest::addColumn<QString>("selector");
+    QTest::addColumn<int>("objects");
+    QTest::addColumn<bool>("useIndex");
+
+    static const char *const names[] = { "equal", "contains", "descendant", "numeric" };
+    static const char *const selectors[] = { "QPushButton[text='Item 42']",
+                                             "[objectName*='bject123']",
+                                             "QDialog QLabel[text^='Item 1']",
+                                             "QLineEdit[width>150]" };
+    const int selectorCount = sizeof(selectors) / sizeof(selectors[0]);
+
+    for (int n = 0; n < selectorCount; ++n) {
+        foreach (int objects, QList<int>() << 10000 << 100000) {
+            for (int useIndex = 1; useIndex >= 0; --useIndex) {
+                const QString rowName = QString("%1 %2k %3").arg(names[n]).arg(objects / 1000)
+                        .arg(useIndex ? "index" : "scan");
+                QTest::newRow(rowName.toLatin1()) << QString(selectors[n]) << objects << bool(useIndex);
+            }
+        }
+    }
+}
+
+
+void TDriverBenchmarks::selectorMatch()
+{
+    QFETCH(QString, selector);
+    QFETCH(int, objects);
+    QFETCH(bool, useIndex);
+
+    const TDriverTestObjectStore &store = parsedObjects(objects);
+    TDriverObjectSearchIndex searchIndex;
+    if (useIndex) searchIndex.build(store);
+
+    TDriverObjectSelector objectSelector;
+    QVERIFY2(objectSelector.parse(selector), qPrintable(objectSelector.errorString()));
+    const QVector<int> expected = objectSelector.match(store);
+
+    QVector<int> results;
+    QBENCHMARK {
+        results = objectSelector.match(store, useIndex ? &searchIndex : 0);
+    }
+
+    QCOMPARE(results, expected);
+}
+
+
+void TDriverBenchmarks::rbiMessageRoundTrip_data()
+{
+    // one item is an inline UI dump or screenshot, small items are like variable lists
+    QTest::addColumn<int>("megabytes");
+    QTest::addColumn<int>("itemSize");
+    QTest::newRow("1 MB in one item") << 1 << 1024*1024;
+    QTest::newRow("8 MB in one item") << 8 << 8*1024*1024;
+    QTest::newRow("32 MB in one item") << 32 << 32*1024*1024;
+    QTest::newRow("4 MB in 1 KiB items") << 4 << 1024;
+    QTest::newRow("16 MB in 1 KiB items") << 16 << 1024;
+}
+
+
+// Message is sent to protocol from the peer socket, like ruby sends its replies,
+// and protocol sends it back, like it sends requests. Both ends are in this thread.
+void TDriverBenchmarks::rbiMessageRoundTrip()
+{
+    QFETCH(int, megabytes);
+    QFETCH(int, itemSize);
+
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QMutex syncMutex;
+    QWaitCondition msgCond;
+    QWaitCondition helloCond;
+    QTcpSocket connection;
+    TDriverRbiProtocol protocol(&connection, &syncMutex, &msgCond, &helloCond);
+    protocol.setValidThread(QThread::currentThread());
+    connect(&protocol, SIGNAL(messageReceived(quint32,QByteArray,BAListMap)),
+            &QTestEventLoop::instance(), SLOT(exitLoop()));
+
+    connection.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(server.waitForNewConnection(10000));
+    QVERIFY(connection.waitForConnected(10000));
+    QTcpSocket *peer = server.nextPendingConnection();
+    QVERIFY(peer);
+
+    BAListMap message;
+    const int itemCount = megabytes * 1024 * 1024 / itemSize;
+    for (int n = 0; n < itemCount; ++n) {
+        message["ui_data"] << QByteArray(itemSize, 'x');
+    }
+    message["ui_filename"] << QByteArray("/tmp/visualizer_dump_sut_qt_1.xml");
+
+    quint32 seqNum = 0;
+    QBENCHMARK {
+        QByteArray data;
+        TDriverRbiProtocol::makeStringListMapMsg(data, "visualization", message, ++seqNum);
+        peer->write(data);
+        QTestEventLoop::instance().enterLoop(60);
+        QVERIFY(!QTestEventLoop::instance().timeout());
+
+        protocol.sendStringListMapMsg("visualization", message, seqNum);
+        while (peer->bytesAvailable() < data.size()) {
+            QVERIFY(peer->state() == QAbstractSocket::ConnectedState);
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        QCOMPARE(peer->readAll(), data);
+    }
+}
+
+
+QTEST_MAIN(TDriverBenchmarks)
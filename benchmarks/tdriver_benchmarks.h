@@ -0,0 +1,105 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#ifndef TDRIVER_BENCHMARKS_H
+#define TDRIVER_BENCHMARKS_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+#include <QRect>
+#include <QPoint>
+#include <QStringList>
+
+#include "tdriver_testobject_store.h"
+
+
+class TDriverBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanupTestCase();
+
+    // ui dump loading with stream parser, and DOM loading it replaced
+    void uiDumpParse_data();
+    void uiDumpParse();
+    void uiDumpDomLoad_data();
+    void uiDumpDomLoad();
+
+    // test object store filling, and lookups done by object tree and properties table
+    void objectStoreBuild_data();
+    void objectStoreBuild();
+    void objectStoreLookup_data();
+    void objectStoreLookup();
+
+    // screenshot hit testing with grid index, and the linear scan it replaced
+    void screenshotIndexBuild_data();
+    void screenshotIndexBuild();
+    void screenshotIndexQuery_data();
+    void screenshotIndexQuery();
+    void screenshotLinearQuery_data();
+    void screenshotLinearQuery();
+
+    // keyword highlighting with word trie, and with the regex per word it replaced
+    void highlightKeywords_data();
+    void highlightKeywords();
+
+    // 100 MB of script output through console append buffering and scrollback limit
+    void consoleOutputStress_data();
+    void consoleOutputStress();
+
+    // resolving feature file steps after step definitions were loaded, with prefix
+    // keyed matcher, and by trying every definition regex like cucumber does
+    void stepMatch_data();
+    void stepMatch();
+    void stepMatchAllDefinitions_data();
+    void stepMatchAllDefinitions();
+
+    // selector queries of find dialog, with candidates from search index and without
+    void searchIndexBuild_data();
+    void searchIndexBuild();
+    void selectorMatch_data();
+    void selectorMatch();
+
+    // multi-MB messages to and from ruby interface over a local TCP connection
+    void rbiMessageRoundTrip_data();
+    void rbiMessageRoundTrip();
+
+private:
+    // generated dumps are kept, so each size is generated once for all benchmarks
+    const QByteArray &uiDump(int objectCount);
+    static QByteArray generateUiDump(int objectCount);
+    const TDriverTestObjectStore &parsedObjects(int objectCount);
+
+    static QVector<QRect> objectRects(const TDriverTestObjectStore &objects);
+    static QVector<QPoint> queryPoints();
+    static QString generateRubyScript(int lineCount);
+    static QStringList generateStepDefinitions(int definitionCount);
+    static QStringList generateSteps(int stepCount, int definitionCount);
+
+    void objectCountRows();
+
+    QHash<int, QByteArray> uiDumps;
+    QHash<int, TDriverTestObjectStore> parsedStores;
+};
+
+#endif // TDRIVER_BENCHMARKS_H
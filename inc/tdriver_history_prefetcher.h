@@ -0,0 +1,83 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#ifndef TDRIVER_HISTORY_PREFETCHER_H
+#define TDRIVER_HISTORY_PREFETCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QImage>
+#include <QFutureWatcher>
+
+#include "tdriver_uidump_parser.h"
+#include "tdriver_state_history_store.h"
+
+
+// ui dump and screenshot of one state history entry
+struct TDriverHistoryState {
+    TDriverHistoryState() : ok(false) {}
+
+    QByteArray signature;
+    QString uiDumpName;
+    QByteArray uiDumpData;
+    TDriverUiDumpParser uiDump;
+    bool ok; // uiDump was parsed successfully
+    QString errorText;
+    QString imageName;
+    QByteArray imageData;
+    QImage image;
+};
+
+
+class TDriverHistoryPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum { PrefetchCount = 3 };
+
+    explicit TDriverHistoryPrefetcher(const TDriverStateHistoryStore &store, QObject *parent = 0);
+    ~TDriverHistoryPrefetcher();
+
+    // loads first PrefetchCount of entries on worker threads, states of other entries are dropped
+    void prefetch(const QList<TDriverStateHistoryEntry> &entries);
+    // true if state of entry has been loaded
+    bool lookup(const TDriverStateHistoryEntry &entry, TDriverHistoryState &state) const;
+
+    // reads, parses and decodes state of entry, may be called from any thread
+    static TDriverHistoryState loadState(TDriverStateHistoryStore store, TDriverStateHistoryEntry entry);
+
+private slots:
+    void loadFinished();
+
+private:
+    static QByteArray stateSignature(const TDriverStateHistoryEntry &entry);
+
+    TDriverStateHistoryStore store;
+    // keyed by blob hashes, so same content is loaded only once
+    QHash<QByteArray, TDriverHistoryState> states;
+    QHash<QByteArray, QFutureWatcher<TDriverHistoryState> *> loading;
+};
+
+#endif // TDRIVER_HISTORY_PREFETCHER_H
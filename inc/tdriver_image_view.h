@@ -28,17 +28,36 @@
 #include <QtGui/QPaintEvent>
 #include <QtGui/QPainter>
 #include <QtCore/QTimer>
+#include <QtCore/QByteArray>
 #include <QtCore/QDebug>
 //#include <QWaitCondition>
 #include <QPointF>
 
 #include <QRect>
+#include <QRegion>
 #include <QList>
+#include <QPixmap>
+#include <QImage>
+#include <QSize>
+#include <QFutureWatcher>
 
 #include "tdriver_main_types.h"
 
 class MainWindow;
 
+
+// request and result of decoding an image on a worker thread
+struct TDriverDecodedImage {
+    TDriverDecodedImage() : generation(0) {}
+
+    int generation;
+    QString fileName;
+    QByteArray data; // decoded instead of file if not null, fileName then only names it
+    QSize scaledSize; // if valid, image is also scaled to fit this size
+    QImage image;
+    QImage scaled;
+};
+
 class TDriverImageView : public QFrame
 {
     Q_OBJECT
@@ -51,7 +70,17 @@ public:
     // destructor
     ~TDriverImageView();
 
+    // images are decoded on a worker thread, previous image and its name are kept until done
     void refreshImage(const QString &imagePath);
+    // image received in memory, imagePath only names it until it's saved
+    void refreshImage(const QString &imagePath, const QByteArray &imageData);
+    // image opened from file, not a refresh so imageDecoded is not emitted for it
+    void loadImage(const QString &imagePath);
+    // image already decoded, for example prefetched state history
+    void showDecodedImage(const QString &imagePath, const QImage &decodedImage,
+                          const QByteArray &imageData = QByteArray());
+
+    static TDriverDecodedImage decodeImage(TDriverDecodedImage request);
 
     void drawHighlights( RectList geometries, bool multiple );
     void disableDrawHighlight();
@@ -60,6 +89,8 @@ public:
     int imageHeight() { return image->height(); }
     QString tasIdString() { return imageTasId; }
     QString lastImageFileName() const { return imageFileName; }
+    // null if image was loaded from lastImageFileName
+    QByteArray lastImageData() const { return imageData; }
 
     QPoint getPosInImage(const QPoint &pos) {
         return QPoint(float(pos.x()) / zoomFactor, float(pos.y()) / zoomFactor);
@@ -102,6 +133,11 @@ signals:
 
     void statusBarMessage(QString text, int timeout);
 
+    // emitted when image from refreshImage is decoded and shown, not for cancelled decodes
+    void imageDecoded(bool ok);
+    // emitted when image from refreshImage will not be shown, it was cancelled by other image
+    void imageDecodeCancelled();
+
 protected:
     virtual void paintEvent( QPaintEvent *event );
     virtual void mousePressEvent(QMouseEvent *);
@@ -116,14 +152,36 @@ private slots:
     void forwardTapById();
     void forwardInspectById();
     void forwardInsertObjectById();
+    void decodeFinished();
 
 private:
+    void startDecode(const QString &imagePath, const QByteArray &imageData, bool refresh);
+    void cancelDecode();
+    // returns true if dropped decode was from refreshImage
+    bool dropDecode();
+    void setImage(const QString &imagePath, const QImage &newImage, const QByteArray &newData, const QImage &scaled);
+    // common part of refreshImage overloads
+    void imageUpdated();
+    // takes pixmap for current widget size from cache, or scales it
+    void preparePixmap();
+    // widget area covered by highlights or drag rectangle, for partial updates
+    QRegion highlightRegion() const;
+    QRect highlightRect(const QRect &imageRect) const;
+    QRect dragBounds() const;
 
     QTimer * hoverTimer;
     QImage *image;
     QString imageFileName;
+    QByteArray imageData;
     QString imageTasId;
-    QPixmap *pixmap;
+    QPixmap pixmap;
+    // pixmaps of current image at recently used sizes, most recent first
+    QList<QPixmap> pixmapCache;
+    enum { PixmapCacheSize = 4 };
+
+    int decodeGeneration;
+    QFutureWatcher<TDriverDecodedImage> *decodeWatcher;
+    bool decodeIsRefresh;
 
     int highlightEnabledMode; // 0=disabled, 1=single, 2=multiple
 
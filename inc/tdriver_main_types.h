@@ -3,13 +3,13 @@
 
 #include <QString>
 
-class QTreeWidgetItem;
 template <class T> class QList;
 class QRect;
 
 // types meant to be used in other code
 
-typedef void* TestObjectKey;
+// object tree model assigns keys, 0 is not a valid key
+typedef quint32 TestObjectKey;
 
 
 typedef QList<QRect> RectList;
@@ -54,29 +54,14 @@ struct ApplicationInfo {
 //};
 
 
-// internal convenience type, not really intended to be used outside this header
-
-typedef QTreeWidgetItem *TestObjectPtrType;
-
-
-
-// convenience functions meant to hide static casts
-
-static inline TestObjectPtrType testObjectKey2Ptr(TestObjectKey key) {
-    return static_cast<TestObjectPtrType>(key);
-}
-
-static inline TestObjectKey ptr2TestObjectKey(TestObjectPtrType ptr) {
-    return static_cast<TestObjectKey>(ptr);
-}
+// convenience functions for passing keys as strings
 
 static inline QString testObjectKey2Str(TestObjectKey key) {
-    return QString::number((quintptr)(key));
+    return QString::number(key);
 }
 
 static inline TestObjectKey str2TestObjectKey(const QString &str) {
-    return ptr2TestObjectKey(reinterpret_cast<TestObjectPtrType >(
-                                 static_cast<quintptr>(str.toULongLong())));
+    return str.toUInt();
 }
 
 #endif // TDRIVER_MAIN_TYPES_H
@@ -52,8 +52,7 @@
 #include <QtGui/QStatusBar>
 #include <QtGui/QTableWidget>
 #include <QtGui/QTabWidget>
-#include <QtGui/QTreeWidget>
-#include <QtGui/QTreeWidgetItem>
+#include <QtGui/QTreeView>
 #include <QtGui/QWidget>
 
 #include <QtXml/QDomDocument>
@@ -65,6 +64,7 @@ class QErrorMessage;
 class QScrollArea;
 class QToolBar;
 class QPlainTextEdit;
+class QLabel;
 
 #include "tdriver_behaviour.h"
 #include <tdriver_util.h>
@@ -72,6 +72,12 @@ class QPlainTextEdit;
 // visualizer UI classes
 class TDriverRecorder;
 class TDriverImageView;
+class TDriverUiDumpParser;
+class TDriverTestObjectDiff;
+class TDriverReplyParser;
+class TDriverHistoryPrefetcher;
+class TDriverStateHistoryStore;
+struct TDriverParsedReply;
 
 // libeditor classes
 class TDriverTabbedEditor;
@@ -88,6 +94,11 @@ namespace Ui {
 }
 
 #include "tdriver_main_types.h"
+#include "tdriver_testobject_store.h"
+#include "tdriver_screenshot_index.h"
+#include "tdriver_object_search_index.h"
+#include "tdriver_object_selector.h"
+#include "tdriver_object_tree_model.h"
 
 #define DOCK_FEATURES_DEFAULT (QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetFloatable | QDockWidget::DockWidgetClosable)
 
@@ -191,10 +202,8 @@ public:
     bool isPathAction(ContextMenuSelection action) { return (action == copyPathAction || action == appendPathAction || action == insertPathAction); }
 
 public:    // methods to access test object data by object id
-    const QMap<QString, AttributeInfo > &testobjAttributes(TestObjectKey id) { return attributesMap[id]; }
-    //const QStringList &testobjGeometries(AttributeKey id) { return geometriesMap[id]; }
-    //const QTreeWidgetItem *testobjTreeWidget(AttributeKey id) { return objectTreeMap[id]; }
-    const TreeItemInfo &testobjTreeData(TestObjectKey id) { return objectTreeData[id]; }
+    QString testobjAttributeValue(TestObjectKey id, const QString &name) const { return testObjects.attributeValue(testObjectIndex(id), name); }
+    TreeItemInfo testobjTreeData(TestObjectKey id) const { return testObjects.treeItemInfo(testObjectIndex(id)); }
 
 public slots:
     void refreshScreenshotObjectList();
@@ -255,16 +264,22 @@ private:
     QMap<QString, QString> applicationsNamesMap;
     QMap<QAction*, QString> applicationsActionMap;
 
-    QMap<TestObjectKey, QMap<QString, AttributeInfo > > attributesMap;
     QHash<QString, QMap<QString, QHash<QString, QString> > > apiMethodsMap;
     QHash<QString, QStringList > apiSignalsMap;
     QMap<QString, Behaviour> behavioursMap;
 
-    QMap<TestObjectKey, RectList> geometriesMap;
+    // all test objects of current ui dump, in document order
+    TDriverTestObjectStore testObjects;
+
+    // geometry of each object in testObjects, null rect if object has no valid geometry
+    QVector<QRect> objectGeometries;
     QSet<TestObjectKey> screenshotObjects;
+    // spatial index of screenshotObjects geometries, by index in testObjects
+    TDriverScreenshotIndex screenshotIndex;
 
-    QMap<TestObjectKey, TreeItemInfo > objectTreeData;
-    QHash<QString, TestObjectKey> objectIdMap;
+    // object tree model key <-> index in testObjects
+    int testObjectIndex(TestObjectKey key) const { return objectTreeModel->objectIndex(key); }
+    TestObjectKey testObjectKey(int index) const { return objectTreeModel->objectKey(index); }
     //    QHash<QString, QMap<QString, QString> > objectMethods;
     //    QHash<QString, QMap<QString, QString> > objectSignals;
 
@@ -327,12 +342,16 @@ private:
 
     // object tree
 
-    QTreeWidget *objectTree;
+    QTreeView *objectTree;
+    TDriverObjectTreeModel *objectTreeModel;
     QString uiDumpFileName;
+    QByteArray uiDumpData; // ui dump received in memory, written to uiDumpFileName only when saved
 
     void createTreeViewDockWidget();
 
-    //QTreeWidgetItem *currentObjectTreeItem;
+    TestObjectKey currentObjectKey() const;
+    void setCurrentObject( TestObjectKey key );
+
     TestObjectKey collapsedObjectTreeItemPtr;
     TestObjectKey expandedObjectTreeItemPtr;
 
@@ -347,29 +366,34 @@ private:
 
     void clearObjectTreeMappings();
     void updateObjectTree( QString filename );
+    void updateObjectTree( const QString &filename, const TDriverUiDumpParser *parser,
+                           const QByteArray &data = QByteArray() );
 
-    bool parseObjectTreeXml( QString filename, QDomDocument &resultDomTree );
-    void buildScreenshotObjectList(TestObjectKey parentKey=0);
-
-    void buildObjectTree( QTreeWidgetItem *parentItem, QDomElement parentElement, QMap<QString, QStringList> duplicateItems );
-    void buildObjectTree_new_format( QTreeWidgetItem *parentItem, QDomElement parentElement, QMap<QString, QStringList> duplicateItems );
+    void buildScreenshotObjectList(int parentIndex=-1);
+    void buildScreenshotIndex();
 
-    QList<QMap<QString, QString> > collectObjectData( QDomElement element );
-    QList<QMap<QString, QString> > collectObjectData_new_format( QDomElement element );
+    bool buildObjectTree( const TDriverUiDumpParser &parser );
+    bool updateObjectTreeItems( const TDriverUiDumpParser &parser, TestObjectKey &focusKey );
+    void forgetObjectTreeItem( TestObjectKey key );
 
-    QMap<QString, QStringList> findDuplicateObjectNames( QList<QMap<QString, QString> > objects );
+    // duplicate object names of current object tree, see TDriverUiDumpParser::duplicateItems
+    QMap<QString, QStringList> objectTreeDuplicateItems;
 
-    void storeItemToObjectTreeMap( QTreeWidgetItem *item, const TreeItemInfo &data);
-
-    QTreeWidgetItem * createObjectTreeItem( QTreeWidgetItem *parentItem, const TreeItemInfo &data, QMap<QString, QStringList> duplicateItems );
+    void updateCurrentApplication();
+    void reportObjectsWithoutType();
+    void addObjectTreeCompletions();
 
     void objectTreeItemChanged();
 
-    void collectGeometries( QTreeWidgetItem *item, RectList &geometries);
+    QRect calculateObjectGeometry( int index );
+    void collectObjectGeometries();
+    void updateObjectGeometries( const TDriverTestObjectDiff &diff, const QVector<QRect> &previousGeometries );
+
+    void collectGeometries( int index, RectList &geometries );
 
-    bool getParentItemOffset( QTreeWidgetItem *item, int &x, int &y );
+    bool getParentItemOffset( int index, int &x, int &y );
 
-    bool getItemPos( QTreeWidgetItem *item, int &x, int &y) ;
+    bool getItemPos( int index, int &x, int &y );
 
     void objectTreeKeyPressEvent( QKeyEvent * event );
 
@@ -396,7 +420,7 @@ private:
     bool parseXml( QString fileName, QDomDocument &resultDocument );
 
     // ui dump xml
-    QDomDocument xmlDocument;
+    bool parseUiDumpXml( QString fileName, TDriverUiDumpParser &parser );
 
     // behaviours xml
     QDomDocument behaviorDomDocument;
@@ -406,7 +430,7 @@ private:
     void updateDevicesList(const QStringList &newDeviceList);
 
     // visualizer_applications_sut_id.xml
-    void parseApplicationsXml( QString filename );
+    void parseApplicationsXml( const QDomDocument &appDocument );
     void updateApplicationsList();
     void resetApplicationsList();
 
@@ -414,14 +438,11 @@ private:
     void buildBehavioursMap();
     bool sendUpdateBehaviourXml();
 
-    // visualizer_dump_sut_id.xml
-    void parseUiDump( QString filename );
-
     // api fixture
     bool apiFixtureEnabled;
     bool apiFixtureChecked;
     void parseApiMethodsXml( QString filename );
-    QStringList parseSignalsXml( QString filename );
+    QStringList parseSignalsXml( const QDomDocument &apiDocument );
 
     // other methods
     void connectObjectTreeSignals();
@@ -513,6 +534,7 @@ private:
 
     TestObjectKey lastHighlightedObjectKey;
     void drawHighlight( TestObjectKey itemKey, bool multiple );
+    void drawHighlight( const QVector<int> &indexes );
 
 
     bool highlightByKey( TestObjectKey itemKey, bool selectItem, QString insertMethodToEditor = QString() );
@@ -520,7 +542,6 @@ private:
     // insertMethodToEditor.isNull means don't insert,
     // insertMethodToEditor.isEmpty means insert without method name
 
-    bool getSmallestObjectFromMatches( QList<TestObjectKey> *matchingObjects, TestObjectKey &objectPtr );
 
 
 #if DEVICE_BUTTONS_ENABLED
@@ -580,16 +601,31 @@ private:
     QCheckBox *findDialogWrapAround;
     QCheckBox *findDialogAttributes;
     QCheckBox *findDialogSubtreeOnly;
+    QCheckBox *findDialogSelector;
 
     TDriverComboLineEdit *findDialogText;
 
     QDialog *findDialog;
     QPushButton *findDialogFindButton;
     QPushButton *findDialogCloseButton;
-    QTreeWidgetItem *findDialogSubtreeRoot;
+    TestObjectKey findDialogSubtreeRoot;
+    QLabel *findDialogMatchCount;
+    QTimer *findDialogMatchCountTimer;
+
+    // index is built on first search after object tree changes,
+    // and matches are kept until search text or options change
+    TDriverObjectSearchIndex objectSearchIndex;
+    QVector<int> findDialogMatches;
+    QString findDialogMatchText;
+    int findDialogMatchFlags;
 
-    bool containsWords( const TreeItemInfo &itemData, QString text, bool caseSensitive, bool entireWords  );
-    bool attributeContainsWords( TestObjectKey itemPtr, QString text, bool caseSensitive, bool entireWords );
+    // compiled selector queries by text
+    QHash<QString, TDriverObjectSelector> findDialogSelectors;
+
+    const QVector<int> &findDialogMatchList();
+    const TDriverObjectSelector &findDialogSelectorFor(const QString &text);
+    void findDialogHighlightMatches(int root);
+    void invalidateObjectSearch();
 
     QErrorMessage *tdriverMsgBox;
     int tdriverMsgTotal;
@@ -598,6 +634,8 @@ private:
     QString keyLastUiStateDir;
     QString keyLastTDriverDir;
     QString keyHistoryStateDirCount;
+    QString keyHistoryLegacyDirsRemoved;
+    QString keyInlineReplies;
 
     // start app dialog
 
@@ -627,8 +665,8 @@ private slots:
     void tdriverMsgFinished();
     void tdriverMsgAppend(QString message);
 
-    void collapseTreeWidgetItem( QTreeWidgetItem *item );
-    void expandTreeWidgetItem( QTreeWidgetItem *item );
+    void collapseObjectTreeItem( const QModelIndex &index );
+    void expandObjectTreeItem( const QModelIndex &index );
 
     void tabWidgetChanged( int currentTableWidget );
 
@@ -670,18 +708,19 @@ private slots:
 
     void refreshAppearance();
 
-    void objectViewItemClicked( QTreeWidgetItem *item, int column );
-    void objectViewItemAction( QTreeWidgetItem *item, int column, ContextMenuSelection action, QString method = QString() );
-    void objectViewCurrentItemChanged( QTreeWidgetItem *itemCurrent, QTreeWidgetItem *itemPrevious );
+    void objectViewItemClicked( const QModelIndex &index );
+    void objectViewItemAction( TestObjectKey key, ContextMenuSelection action, QString method = QString() );
+    void objectViewCurrentItemChanged( const QModelIndex &current, const QModelIndex &previous );
 
     // menu: file
 
     void getParameterXML();
 
     void loadStateByDialog();
-    void loadStateFromHistoryDir(const QString &dirPath);
-    void loadStateFromDir(const QString &dirPath);
+    void loadStateFromHistory(const QString &entryId);
     void historySaveCurrentState();
+    void removeLegacyStateHistory();
+    void prefetchStateHistory();
     void saveStateAsArchive();
     void clickedImage();
 
@@ -745,8 +784,9 @@ private slots:
     void findNextTreeObject();
 
     void findDialogTextChanged( const QString & text );
-    void findDialogHandleTreeCurrentChange(QTreeWidgetItem*current);
+    void findDialogHandleTreeCurrentChange(const QModelIndex &current);
     void findDialogSubtreeChanged( int value);
+    void findDialogUpdateMatchCount();
     void closeFindDialog();
 
     // start app dialog slots
@@ -759,11 +799,17 @@ private slots:
     void receiveTDriverMessage(quint32 seqNum, QByteArray name, const BAListMap &reply = BAListMap());
     void messageTimeoutSlot();
     void resetMessageSequenceFlags();
+    void receiveParsedReply(const TDriverParsedReply &reply);
+    void imageRefreshDone(bool ok);
+    void imageRefreshCancelled();
 
 private:
 
     QMap<quint32, SentTDriverMsg> sentTDriverMsgs; // maps seqnum of sent message to message type
     QTimer *messageTimeoutTimer;
+    TDriverReplyParser *replyParser; // parses reply files on worker threads
+    TDriverStateHistoryStore *stateHistory;
+    TDriverHistoryPrefetcher *historyPrefetcher; // loads recent state history on worker threads
     bool doRefreshAfterAppList;
     int historySavingCounter; // -1 for done state; bits to reset: 1 for dui dump, 2 for image
     QWidget *richTextContainerWidget;
@@ -775,11 +821,13 @@ private:
     bool eventFilter ( QObject *obj, QEvent *event );
     void closeEvent( QCloseEvent *event );
 
+    void finishAppListRefresh(bool failed);
+    void finishUiDumpRefresh(bool parsed);
+    void cancelUiDumpRefresh();
+    void saveStateHistoryIfReady();
+
     QString treeObjectRubyId(TestObjectKey treeItemPtr, TestObjectKey sutItemPtr);
-    QTreeWidgetItem *findDialogSubtreeNext(QTreeWidgetItem *current, QTreeWidgetItem *root, bool wrap=false);
-    QTreeWidgetItem *findDialogSubtreePrev(QTreeWidgetItem *current, QTreeWidgetItem *root, bool wrap=false);
-    bool compareTreeItem(QTreeWidgetItem *item, const QString &findString, bool matchCase, bool entireWords, bool searchAttributes);
-    void findFromSubTree(QTreeWidgetItem *current, const QString &findString, bool backwards, bool matchCase, bool entireWords, bool searchWrapAround, bool searchAttributes);
+    void findFromSubTree(int current, bool backwards, bool searchWrapAround);
 
 };
 
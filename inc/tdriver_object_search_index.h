@@ -0,0 +1,72 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#ifndef TDRIVER_OBJECT_SEARCH_INDEX_H
+#define TDRIVER_OBJECT_SEARCH_INDEX_H
+
+#include <QString>
+#include <QVector>
+
+class TDriverTestObjectStore;
+
+
+class TDriverObjectSearchIndex
+{
+public:
+    // longer strings are not split to trigrams, they are always compared
+    enum { MaxIndexedLength = 256 };
+
+    TDriverObjectSearchIndex();
+
+    void clear();
+    bool isEmpty() const { return stringCount == 0; }
+
+    // indexes type, name and id, and attribute values of all objects
+    void build(const TDriverTestObjectStore &objects);
+
+    // matching object indexes in document order
+    QVector<int> find(const QString &text, bool matchCase, bool entireWords, bool searchAttributes) const;
+    // objects with any attribute value equal to or containing text, case sensitively, in document order
+    QVector<int> findAttributeValues(const QString &text, bool entireValue) const;
+
+private:
+    static quint64 trigramKey(const QChar *chars);
+    QVector<int> candidateStrings(const QString &foldedText) const;
+    QVector<int> findObjects(const QString &text, Qt::CaseSensitivity caseSensitivity, bool entireWords,
+                             bool searchItems, bool searchAttributes) const;
+
+    const TDriverTestObjectStore *store;
+    int stringCount;
+
+    // objects referring to each pooled string, as ranges of postings lists
+    QVector<int> itemOffsets;
+    QVector<int> itemPostings;
+    QVector<int> attributeOffsets;
+    QVector<int> attributePostings;
+
+    // case folded trigram -> pooled strings containing it
+    QVector<quint64> trigramKeys;
+    QVector<int> trigramOffsets;
+    QVector<int> trigramStrings;
+    QVector<int> longStrings;
+};
+
+#endif // TDRIVER_OBJECT_SEARCH_INDEX_H
@@ -0,0 +1,100 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#ifndef TDRIVER_OBJECT_SELECTOR_H
+#define TDRIVER_OBJECT_SELECTOR_H
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QCoreApplication>
+
+class TDriverTestObjectStore;
+class TDriverObjectSearchIndex;
+
+
+class TDriverObjectSelector
+{
+    Q_DECLARE_TR_FUNCTIONS(TDriverObjectSelector)
+
+public:
+    TDriverObjectSelector();
+
+    // compiles selector text, returns false and sets error on syntax error
+    bool parse(const QString &selectorText);
+    bool isValid() const { return !chains.isEmpty(); }
+    const QString &errorString() const { return error; }
+    int errorColumn() const { return errorPos + 1; }
+
+    // matching object indexes in document order, searchIndex must be built from objects if given
+    QVector<int> match(const TDriverTestObjectStore &objects, const TDriverObjectSearchIndex *searchIndex = 0) const;
+
+private:
+    enum Field { TypeField, NameField, IdField, AttributeField };
+    enum Operator { Exists, Equal, NotEqual, StartsWith, EndsWith, Contains,
+                    Less, LessOrEqual, Greater, GreaterOrEqual };
+    enum Combinator { Descendant, Child };
+
+    struct Predicate {
+        Field field;
+        QString attribute;
+        Operator op;
+        QString value;
+        double number; // value of comparison operators
+    };
+
+    // one compound selector, and its relation to previous step
+    struct Step {
+        Combinator combinator;
+        QList<Predicate> predicates;
+    };
+
+    // predicate resolved against one store, names and values are integers of the store
+    struct BoundPredicate {
+        const Predicate *predicate;
+        int key;
+        int valueString;
+    };
+
+    bool parseSelector(QList<Step> &steps);
+    bool parseCompound(Step &step);
+    bool parseAttribute(Predicate &predicate);
+    bool parseValue(QString &value);
+    QString parseIdentifier();
+    void skipSpaces();
+    bool fail(const QString &message);
+
+    static bool bind(const QList<Predicate> &predicates, const TDriverTestObjectStore &objects,
+                     QVector<BoundPredicate> &bound);
+    static bool test(const QVector<BoundPredicate> &bound, const TDriverTestObjectStore &objects, int index);
+    static bool findCandidates(const QList<Predicate> &predicates, const TDriverObjectSearchIndex &searchIndex,
+                               QVector<int> &candidates);
+
+    // alternatives separated by comma
+    QList<QList<Step> > chains;
+
+    QString text;
+    int pos;
+    QString error;
+    int errorPos;
+};
+
+#endif // TDRIVER_OBJECT_SELECTOR_H
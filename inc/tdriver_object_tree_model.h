@@ -0,0 +1,105 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#ifndef TDRIVER_OBJECT_TREE_MODEL_H
+#define TDRIVER_OBJECT_TREE_MODEL_H
+
+#include <QAbstractItemModel>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+
+#include "tdriver_main_types.h"
+#include "tdriver_testobject_store.h"
+
+class TDriverTestObjectDiff;
+
+
+class TDriverObjectTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Columns { TypeColumn = 0, NameColumn, IdColumn, ColumnCount };
+
+    explicit TDriverObjectTreeModel(QObject *parent = 0);
+
+    // replaces all objects, every object gets a new key
+    void setObjects(const TDriverTestObjectStore &objects, const QMap<QString, QStringList> &duplicateItems);
+    // replaces all objects, objects matched by diff keep their keys and view state,
+    // removed and added objects are reported as row removals and insertions
+    void updateObjects(const TDriverTestObjectStore &objects, const TDriverTestObjectDiff &diff,
+                       const QMap<QString, QStringList> &duplicateItems);
+    void clear();
+
+    // tooltip for objects without type
+    void setMissingTypeToolTip(const QString &toolTip) { missingTypeToolTip = toolTip; }
+    // symbian suts are not warned about objects having same name with different ids
+    void setSymbianSut(bool symbian) { symbianSut = symbian; }
+
+    // keys are stable over updateObjects and never reused, 0 is not a valid key
+    TestObjectKey objectKey(int index) const { return (index >= 0 && index < keys.size()) ? keys.at(index) : 0; }
+    TestObjectKey objectKey(const QModelIndex &index) const { return index.isValid() ? TestObjectKey(index.internalId()) : 0; }
+    int objectIndex(TestObjectKey key) const { return indexes.value(key, -1); }
+    QModelIndex modelIndex(TestObjectKey key, int column = 0) const;
+
+    // type text as shown in type column
+    QString typeText(int index) const;
+
+    // QAbstractItemModel
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &child) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+private:
+    void setKeys(const QVector<TestObjectKey> &newKeys);
+    void materializeChildren(int index) const;
+    QVector<int> childList(int index) const;
+    void setChildList(int index, const QVector<int> &children);
+    int row(int index) const;
+
+    QVariant sutData(int column, int role) const;
+    QVariant objectData(int index, int column, int role) const;
+
+    TDriverTestObjectStore objects;
+    QMap<QString, QStringList> duplicateItems;
+
+    QVector<TestObjectKey> keys;
+    QHash<TestObjectKey, int> indexes;
+    TestObjectKey lastKey;
+
+    // children are listed only for objects whose rows have been requested by the view:
+    // children of object i are childLists[childOffsets[i]] ... childLists[childOffsets[i]+childCounts[i]-1],
+    // childOffsets[i] is -1 when not listed yet, rows[i] is row of object i under its parent or -1
+    mutable QVector<int> childOffsets;
+    mutable QVector<int> childCounts;
+    mutable QVector<int> childLists;
+    mutable QVector<int> rows;
+
+    QString missingTypeToolTip;
+    bool symbianSut;
+};
+
+#endif // TDRIVER_OBJECT_TREE_MODEL_H
@@ -0,0 +1,110 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#ifndef TDRIVER_REPLY_PARSER_H
+#define TDRIVER_REPLY_PARSER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QPair>
+#include <QtXml/QDomDocument>
+
+#include "tdriver_uidump_parser.h"
+
+
+struct TDriverParsedReply;
+
+
+class TDriverReplyParser : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum ReplyType { UiDumpReply = 0, BehavioursReply, ApplicationsReply, SignalsReply, ReplyTypeCount };
+
+    explicit TDriverReplyParser(QObject *parent = 0);
+    ~TDriverReplyParser();
+
+    // Starts parsing fileName on a worker thread. Earlier parse of same type and
+    // context is cancelled, and its result is never reported. context is passed to result as is.
+    // If data is not null, it is parsed instead, and fileName only names it.
+    void parse(ReplyType type, const QString &fileName, const QString &context = QString(),
+               const QByteArray &data = QByteArray());
+    // cancels parses of type with any context, or with given context
+    void cancel(ReplyType type);
+    void cancel(ReplyType type, const QString &context);
+    void cancelAll();
+    bool isParsing(ReplyType type) const;
+
+    // synchronous parsing used by worker threads, errorText is set if false is returned
+    static bool parseUiDumpFile(const QString &fileName, TDriverUiDumpParser &parser, QString &errorText);
+    static bool parseXmlFile(const QString &fileName, QDomDocument &document, QString &errorText);
+    static bool parseUiDumpData(const QByteArray &data, const QString &name, TDriverUiDumpParser &parser, QString &errorText);
+    static bool parseXmlData(const QByteArray &data, const QString &name, QDomDocument &document, QString &errorText);
+
+signals:
+    // emitted in thread of this object for latest parse of each type only
+    void parsed(const TDriverParsedReply &reply);
+
+private slots:
+    void parseFinished();
+
+private:
+    static TDriverParsedReply parseReply(TDriverParsedReply reply, QSharedPointer<QAtomicInt> cancelFlag);
+
+    typedef QPair<int, QString> ParseKey; // type and context
+
+    struct PendingParse {
+        quint32 generation;
+        QSharedPointer<QAtomicInt> cancelFlag;
+        QFutureWatcher<TDriverParsedReply> *watcher;
+    };
+
+    static void cancelParse(const PendingParse &parse);
+
+    quint32 generations[ReplyTypeCount];
+    QHash<ParseKey, PendingParse> pendingParses;
+};
+
+
+// result of parsing, fields used depend on type
+struct TDriverParsedReply {
+    TDriverReplyParser::ReplyType type;
+    quint32 generation;
+    QString fileName;
+    QString context;
+    QByteArray data; // payload received in memory, null if it was read from fileName
+
+    bool ok;
+    QString errorText;
+    int parseTime; // milliseconds
+
+    TDriverUiDumpParser uiDump; // UiDumpReply
+    QDomDocument document; // other types
+
+    TDriverParsedReply() : type(TDriverReplyParser::ReplyTypeCount), generation(0), ok(false), parseTime(0) {}
+};
+
+#endif // TDRIVER_REPLY_PARSER_H
@@ -0,0 +1,77 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#ifndef TDRIVER_SCREENSHOT_INDEX_H
+#define TDRIVER_SCREENSHOT_INDEX_H
+
+#include <QRect>
+#include <QPoint>
+#include <QVector>
+#include <QList>
+
+
+class TDriverScreenshotIndex
+{
+public:
+    TDriverScreenshotIndex();
+
+    void clear();
+
+    // add objects, then call build before queries, id is opaque to this class
+    void addObject(int id, const QRect &rect, bool selectable);
+    void build();
+
+    int count() const { return entries.size(); }
+
+    // id of smallest selectable object with non-zero area containing pos, or -1,
+    // equal size objects are resolved to smallest id
+    int smallestAt(const QPoint &pos) const;
+
+    // ids of all objects containing pos, or intersecting rect, in ascending order
+    QList<int> objectsAt(const QPoint &pos, bool selectableOnly = true) const;
+    QList<int> objectsIntersecting(const QRect &rect, bool selectableOnly = true) const;
+
+private:
+    struct Entry {
+        QRect rect;
+        qint64 area;
+        int id;
+        bool selectable;
+    };
+
+    static bool entryIdLessThan(const Entry &e1, const Entry &e2) { return e1.id < e2.id; }
+
+    int cellColumn(int x) const;
+    int cellRow(int y) const;
+
+    QVector<Entry> entries;
+
+    // uniform grid over bounds of all entries, cell (col, row) lists entry
+    // indexes cellEntries[cellStarts[c]] ... cellEntries[cellStarts[c+1]-1], c = row*columns+col
+    QRect bounds;
+    int cellWidth;
+    int cellHeight;
+    int columns;
+    int rows;
+    QVector<int> cellStarts;
+    QVector<int> cellEntries;
+};
+
+#endif // TDRIVER_SCREENSHOT_INDEX_H
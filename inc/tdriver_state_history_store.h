@@ -0,0 +1,84 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#ifndef TDRIVER_STATE_HISTORY_STORE_H
+#define TDRIVER_STATE_HISTORY_STORE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+
+
+// one saved state, refers to its ui dump and screenshot by content hash
+struct TDriverStateHistoryEntry {
+    QString id; // ids sort from oldest to newest
+    QDateTime created;
+    QString uiDumpName; // original file names, used when state is saved elsewhere
+    QByteArray uiDumpHash;
+    QString imageName;
+    QByteArray imageHash; // empty if state had no screenshot
+};
+
+
+class TDriverStateHistoryStore
+{
+public:
+    enum { DeltaRatio = 2 }; // ui dump delta is used if it is this many times smaller than the full dump
+
+    explicit TDriverStateHistoryStore(const QString &path);
+
+    const QString &path() const { return storePath; }
+
+    // stores a new entry, returns its id or empty string on error
+    QString add(const QString &uiDumpName, const QByteArray &uiDump,
+                const QString &imageName, const QByteArray &image);
+    // newest first
+    QList<TDriverStateHistoryEntry> entries() const;
+    bool entry(const QString &id, TDriverStateHistoryEntry &result) const;
+    // removes all but maxCount newest entries, and blobs no remaining entry refers to
+    void trim(int maxCount);
+
+    // does not modify store, may be called from worker threads
+    bool readBlob(const QByteArray &hash, QByteArray &data) const;
+
+private:
+    enum BlobKind { FullBlob = 'F', RawBlob = 'R', DeltaBlob = 'D' };
+
+    QString blobPath(const QByteArray &hash) const;
+    QString manifestPath(const QString &id) const;
+    bool readBlobHeader(const QByteArray &hash, char &kind, QByteArray &base) const;
+    bool writeBlob(const QByteArray &hash, const QByteArray &data, BlobKind kind,
+                   const QByteArray &baseHash = QByteArray(), const QByteArray &baseData = QByteArray());
+    QByteArray deltaBase(const QByteArray &previousHash);
+
+    static bool writeFile(const QString &filePath, const QByteArray &content);
+    static bool readManifest(const QString &filePath, TDriverStateHistoryEntry &result);
+    static QByteArray makeDelta(const QByteArray &base, const QByteArray &data);
+    static bool applyDelta(const QByteArray &base, const QByteArray &delta, QByteArray &data);
+
+    QString storePath;
+    // ui dump which new deltas are made against
+    QByteArray keyframeHash;
+    QByteArray keyframeData;
+};
+
+#endif // TDRIVER_STATE_HISTORY_STORE_H
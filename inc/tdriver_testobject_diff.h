@@ -0,0 +1,67 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#ifndef TDRIVER_TESTOBJECT_DIFF_H
+#define TDRIVER_TESTOBJECT_DIFF_H
+
+#include <QVector>
+#include <QString>
+
+class TDriverTestObjectStore;
+
+
+class TDriverTestObjectDiff
+{
+public:
+    // Matches objects of current to objects of previous. Objects match when their
+    // env, type, id and name are equal and their parents match, so matching follows
+    // the (env, type, id, name) path from sut. Stores must stay alive while diff is used.
+    TDriverTestObjectDiff(const TDriverTestObjectStore &previous, const TDriverTestObjectStore &current);
+
+    // false if sut differs, and nothing else is matched either
+    bool rootMatched() const { return !previousIndexes.isEmpty() && previousIndexes.first() == 0; }
+
+    // index of matching object in the other store, or -1 for added/removed object
+    int previousIndex(int currentIndex) const { return previousIndexes.value(currentIndex, -1); }
+    int currentIndex(int previousIndex) const { return currentIndexes.value(previousIndex, -1); }
+
+    // true for added objects, and for matched objects with any attribute changed
+    bool isChanged(int currentIndex) const;
+
+    int addedCount() const { return added; }
+    int removedCount() const { return removed; }
+    int changedCount() const { return changed; }
+
+private:
+    void matchChildren(int previousParent, int currentParent);
+    bool isSameObject(int previousIndex, int currentIndex) const;
+
+    const TDriverTestObjectStore &previous;
+    const TDriverTestObjectStore &current;
+
+    QVector<int> previousIndexes;
+    QVector<int> currentIndexes;
+
+    int added;
+    int removed;
+    int changed;
+};
+
+#endif // TDRIVER_TESTOBJECT_DIFF_H
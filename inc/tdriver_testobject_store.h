@@ -0,0 +1,164 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#ifndef TDRIVER_TESTOBJECT_STORE_H
+#define TDRIVER_TESTOBJECT_STORE_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+
+#include "tdriver_main_types.h"
+
+
+class TDriverTestObjectStore
+{
+public:
+    TDriverTestObjectStore();
+
+    void clear();
+
+    // building, objects must be added in document order (parent before children),
+    // and attributes of an object must be added before it is ended
+    int beginObject(int parent, const TreeItemInfo &data);
+    void addAttribute(int index, const AttributeInfo &attribute);
+    void endObject(int index);
+
+    // object queries, invalid index returns empty values
+    int count() const { return objects.size(); }
+    bool isEmpty() const { return objects.isEmpty(); }
+    bool isValid(int index) const { return index >= 0 && index < objects.size(); }
+
+    // objects are stored in document order, so subtree of index is range [index, subtreeEnd(index))
+    int parent(int index) const { return isValid(index) ? objects.at(index).parent : -1; }
+    int subtreeEnd(int index) const { return isValid(index) ? objects.at(index).subtreeEnd : index; }
+    int firstChild(int index) const;
+    int nextSibling(int index) const;
+    int childCount(int index) const;
+
+    const QString &type(int index) const { return objectString(index, &ObjectRecord::type); }
+    const QString &name(int index) const { return objectString(index, &ObjectRecord::name); }
+    const QString &id(int index) const { return objectString(index, &ObjectRecord::id); }
+    const QString &env(int index) const { return objectString(index, &ObjectRecord::env); }
+    TreeItemInfo treeItemInfo(int index) const;
+
+    // index of the last object with given id, or -1
+    int indexOfId(const QString &id) const;
+
+    // attribute queries, attribute names are case insensitive
+    int attributeKey(const QString &name) const;
+    int attributeCount(int index) const { return isValid(index) ? objects.at(index).attributeCount : 0; }
+    AttributeInfo attributeAt(int index, int n) const;
+    const QString &attributeNameAt(int index, int n) const;
+    const QString &attributeValueAt(int index, int n) const;
+
+    bool hasAttribute(int index, int key) const { return findAttribute(index, key) >= 0; }
+    bool hasAttribute(int index, const QString &name) const { return hasAttribute(index, attributeKey(name)); }
+    const QString &attributeValue(int index, int key) const;
+    const QString &attributeValue(int index, const QString &name) const { return attributeValue(index, attributeKey(name)); }
+    AttributeInfo attribute(int index, const QString &name) const;
+
+    // attributes of one object in lowercase name order, for display
+    QMap<QString, AttributeInfo> attributes(int index) const;
+
+    // order independent hash of all attributes of object, comparable between stores
+    uint attributeHash(int index) const { return isValid(index) ? objects.at(index).attributeHash : 0; }
+
+    // pooled strings, each distinct value is stored once, index 0 is the empty string
+    int stringCount() const { return strings.size(); }
+    const QString &stringAt(int stringIndex) const { return poolStringAt(stringIndex); }
+    int typeStringIndex(int index) const { return objectStringIndex(index, &ObjectRecord::type); }
+    int nameStringIndex(int index) const { return objectStringIndex(index, &ObjectRecord::name); }
+    int idStringIndex(int index) const { return objectStringIndex(index, &ObjectRecord::id); }
+    int attributeValueStringIndexAt(int index, int n) const;
+    // -1 if attribute is missing
+    int attributeValueStringIndex(int index, int key) const;
+    // -1 if no object or attribute has this value
+    int stringIndex(const QString &str) const { return stringIndexes.value(str, -1); }
+
+    // approximate heap usage in bytes, for debug output
+    int memoryUsage() const;
+
+private:
+    struct ObjectRecord {
+        int type;
+        int name;
+        int id;
+        int env;
+        int parent;
+        int subtreeEnd;
+        int attributeBegin;
+        int attributeCount;
+        uint attributeHash;
+    };
+
+    struct AttributeRecord {
+        int key;
+        int name;
+        int dataType;
+        int type;
+        int value;
+    };
+
+    static bool attributeKeyLessThan(const AttributeRecord &a1, const AttributeRecord &a2) { return a1.key < a2.key; }
+
+    int poolString(const QString &str);
+    int internAttributeName(const QString &name, int &key);
+    int findAttribute(int index, int key) const;
+
+    const QString &poolStringAt(int stringIndex) const {
+        return (stringIndex >= 0 && stringIndex < strings.size()) ? strings.at(stringIndex) : emptyString;
+    }
+
+    const QString &objectString(int index, int ObjectRecord::*field) const {
+        return isValid(index) ? strings.at(objects.at(index).*field) : emptyString;
+    }
+
+    int objectStringIndex(int index, int ObjectRecord::*field) const {
+        return isValid(index) ? objects.at(index).*field : 0;
+    }
+
+    QVector<ObjectRecord> objects;
+    QVector<AttributeRecord> attributeRecords;
+
+    // string pool for object and attribute values
+    QVector<QString> strings;
+    QVector<uint> stringHashes;
+    QHash<QString, int> stringIndexes;
+
+    // interned attribute names, key is index of lowercase name
+    QVector<QString> attributeNames;
+    QVector<int> attributeNameKeys;
+    QVector<uint> attributeNameHashes;
+    QHash<QString, int> attributeNameIndexes;
+    QVector<QString> attributeKeyNames;
+    QHash<QString, int> attributeKeyIndexes;
+
+    // string pool index of object id -> object index
+    QHash<int, int> idIndexes;
+
+    // attributes of objects not yet ended
+    QHash<int, QVector<AttributeRecord> > pendingAttributes;
+
+    static const QString emptyString;
+};
+
+#endif // TDRIVER_TESTOBJECT_STORE_H
@@ -0,0 +1,85 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#ifndef TDRIVER_UIDUMP_PARSER_H
+#define TDRIVER_UIDUMP_PARSER_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+
+#include "tdriver_main_types.h"
+#include "tdriver_testobject_store.h"
+
+class QIODevice;
+class QXmlStreamReader;
+class QAtomicInt;
+
+
+class TDriverUiDumpParser
+{
+public:
+    TDriverUiDumpParser();
+
+    // reads entire UI dump from device in a single pass, returns false on XML error
+    bool parse(QIODevice *device);
+    void clear();
+
+    // parse stops with an error when flag becomes non-zero, may be set from another thread
+    void setCancelFlag(const QAtomicInt *flag) { cancelFlag = flag; }
+    bool isCancelled() const { return cancelled; }
+
+    const QString &version() const { return dumpVersion; }
+
+    // objects in document order, so parent is always before its children, sut is index 0
+    const TDriverTestObjectStore &objects() const { return parsedObjects; }
+
+    // same format as used by object tree: name -> list of different ids with that name
+    QMap<QString, QStringList> duplicateItems() const;
+
+    const QString &errorString() const { return parseErrorString; }
+    int errorLine() const { return parseErrorLine; }
+    int errorColumn() const { return parseErrorColumn; }
+
+private:
+    void readObjectChildren(QXmlStreamReader &xml, int parentIndex);
+    void readObject(QXmlStreamReader &xml, int parentIndex);
+    void readAttribute(QXmlStreamReader &xml, int objectIndex);
+    void readOldFormatAttribute(QXmlStreamReader &xml, int objectIndex);
+    void addObjectName(const QString &name, const QString &id);
+
+    QString dumpVersion;
+    TDriverTestObjectStore parsedObjects;
+
+    // duplicate name statistics, collected while parsing
+    QHash<QString, QStringList> nameIds;
+    QSet<QString> duplicateNames;
+
+    QString parseErrorString;
+    int parseErrorLine;
+    int parseErrorColumn;
+
+    const QAtomicInt *cancelFlag;
+    bool cancelled;
+};
+
+#endif // TDRIVER_UIDUMP_PARSER_H
@@ -47,7 +47,11 @@ SOURCES += tdriver_tabbededitor.cpp \
     tdriver_editor_common.cpp \
     tdriver_rubyinteract.cpp \
     tdriver_editbar.cpp \
-    tdriver_combolineedit.cpp
+    tdriver_combolineedit.cpp \
+    tdriver_completionindex.cpp \
+    tdriver_linemarkers.cpp \
+    tdriver_rdebugparser.cpp \
+    tdriver_variablemodel.cpp
 HEADERS += tdriver_tabbededitor.h \
     tdriver_runconsole.h \
     tdriver_rubyhighlighter.h \
@@ -59,6 +63,10 @@ HEADERS += tdriver_tabbededitor.h \
     tdriver_rubyinteract.h \
     tdriver_editbar.h \
     tdriver_combolineedit.h \
+    tdriver_completionindex.h \
+    tdriver_linemarkers.h \
+    tdriver_rdebugparser.h \
+    tdriver_variablemodel.h \
     libtdrivereditor_global.h
 
 # install
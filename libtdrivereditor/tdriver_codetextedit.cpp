@@ -19,6 +19,7 @@
 
 
 #include "tdriver_codetextedit.h"
+#include "tdriver_completionindex.h"
 
 #include <QPainter>
 #include <QPlainTextEdit>
@@ -39,6 +40,7 @@
 #include <QModelIndex>
 #include <QFileSystemWatcher>
 #include <QPushButton>
+#include <QStaticText>
 
 #include <tdriver_util.h>
 
@@ -81,6 +83,7 @@ TDriverCodeTextEdit::TDriverCodeTextEdit(QWidget *parent) :
     completer(new QCompleter(this)),
     complPopupShowingInfo(false),
     phraseModel(NULL),
+    completionIndex(NULL),
     stackHighlightStart(-1),
     translationDBconfigured(false),
     watcher(NULL),
@@ -88,12 +91,12 @@ TDriverCodeTextEdit::TDriverCodeTextEdit(QWidget *parent) :
     fcodecUtfBom(false),
     lastFindWrapped(false),
     lastBlock(-1),
-    lastBlockCount(document()->blockCount()),
     isRunning(false),
     isUsingTabulatorsMode(true),
     isRubyMode(false),
     isWrapMode(true),
-    runningLine(0),
+    lineMarkers(document()),
+    sideAreaFirstBlock(-1),
     //completionPopup(new QMenu(tr("Choose translation"), this)),
     completionType(NO_COMPLETION),
     popupFirstInsert(false),
@@ -222,6 +225,13 @@ void TDriverCodeTextEdit::updateSideArea(const QRect &rect, int dy)
 {
     if (dy) {
         sideArea->scroll(0, dy);
+
+        // scrolled before idle highlighting got here
+        if (highlighter && highlighter->isHighlightingLazily()) {
+            QTextBlock first, last;
+            blocksNearViewport(first, last);
+            highlighter->highlightNow(first, last);
+        }
     }
     else {
         sideArea->update(0, rect.y(), sideArea->width(), rect.height());
@@ -994,26 +1004,40 @@ void TDriverCodeTextEdit::tryInteractiveCompletion(QKeyEvent *)
         lastBaseText.clear();
     }
     else if (lastBaseText == newBaseText) {
-        popupCompleterInfo(tr("Searching completions for:\n") + lastBaseText);
-        emit requestInteractiveCompletion(MEC::replaceUnicodeSeparators(lastBaseText).toLocal8Bit());
+        // local completions are shown until reply from Ruby replaces them
+        const QByteArray statement(MEC::replaceUnicodeSeparators(lastBaseText).toLocal8Bit());
+        if (!popupLocalCompletion(statement)) {
+            popupCompleterInfo(tr("Searching completions for:\n") + lastBaseText);
+        }
+        emit requestInteractiveCompletion(statement);
     }
     else {
-        popupCompleterInfo(tr("CTRL+I to complete:") + newBaseText);
         lastBaseText = newBaseText;
+        // Ruby evaluates the statement, so it is only asked after CTRL+I is pressed again
+        if (!popupLocalCompletion(MEC::replaceUnicodeSeparators(lastBaseText).toLocal8Bit())) {
+            popupCompleterInfo(tr("CTRL+I to complete:") + newBaseText);
+        }
     }
 
 }
 
 
-void TDriverCodeTextEdit::popupInteractiveCompletion(QObject *client, QByteArray statement, QStringList completions)
+// Shows completions from local index for statement, returns false if there were none
+bool TDriverCodeTextEdit::popupLocalCompletion(const QByteArray &statement)
 {
-    Q_UNUSED(statement);
-    if (client != this) return; // not for us
+    if (!completionIndex) return false;
 
-    //qDebug() << FCFL << "completionType" << completionType;
+    const QStringList completions(completionIndex->completions(statement, complCur.selectedText()));
+    if (completions.isEmpty()) return false;
 
-    if (!completer->popup()->isVisible() || completionType != BASIC_COMPLETION || complCur.isNull()) return; // obsolete signal received
+    popupBasicCompleter(createCompletionModel(completions));
+    return true;
+}
 
+
+QStandardItemModel *TDriverCodeTextEdit::createCompletionModel(const QStringList &completions)
+{
+    // completer deletes the model it owns when it gets a new one
     QStandardItemModel *model = new QStandardItemModel(completer);
 
     for(int ii = 0; ii<completions.size(); ++ii) {
@@ -1026,6 +1050,23 @@ void TDriverCodeTextEdit::popupInteractiveCompletion(QObject *client, QByteArray
         model->appendRow(stdItem);
     }
 
+    return model;
+}
+
+
+void TDriverCodeTextEdit::popupInteractiveCompletion(QObject *client, QByteArray statement, QStringList completions)
+{
+    if (client != this) return; // not for us
+
+    //qDebug() << FCFL << "completionType" << completionType;
+
+    if (!completer->popup()->isVisible() || completionType != BASIC_COMPLETION || complCur.isNull()) return; // obsolete signal received
+
+    // base text may have changed while local completions were shown
+    if (statement != MEC::replaceUnicodeSeparators(lastBaseText).toLocal8Bit()) return;
+
+    QStandardItemModel *model = createCompletionModel(completions);
+
     if (model->rowCount() > 0)
         popupBasicCompleter(model);
     else
@@ -1044,6 +1085,9 @@ void TDriverCodeTextEdit::errorInteractiveCompletion(QObject *client, QByteArray
     //qDebug() << FCFL << "base" << lastBaseText << "vs statement" << statement;
     if (lastBaseText != stmStr) return;
 
+    // keep showing local completions, if any
+    if (!complPopupShowingInfo && completer->popup()->isVisible()) return;
+
     qDebug() << FCFL << "canceling completion";
     cancelCompletion();
 }
@@ -1226,10 +1270,32 @@ void TDriverCodeTextEdit::madeCurrent()
     //qDebug() << FCFL << fileName();
     // if this has focus or is visible, start using highlighter
     if (highlighter) {
-        highlighter->setDocument(document());
+        // setting same document again would clear all formats
+        if (highlighter->document() != document()) highlighter->setDocument(document());
         //qDebug() << FCFL << "doing rehighlight";
-        highlighter->rehighlight();
+        QTextBlock first, last;
+        blocksNearViewport(first, last);
+        highlighter->rehighlightLazily(first, last);
+    }
+}
+
+
+// finds blocks shown in viewport, extended by a page above and below
+void TDriverCodeTextEdit::blocksNearViewport(QTextBlock &first, QTextBlock &last)
+{
+    first = last = firstVisibleBlock();
+    if (!first.isValid()) return;
+
+    int count = 1;
+    int bot = (int)blockBoundingGeometry(last).translated(contentOffset()).bottom();
+    while (bot < viewport()->height() && last.next().isValid()) {
+        last = last.next();
+        bot += (int)blockBoundingRect(last).height();
+        ++count;
     }
+
+    for (int ii = 0; ii < count && first.previous().isValid(); ++ii) first = first.previous();
+    for (int ii = 0; ii < count && last.next().isValid(); ++ii) last = last.next();
 }
 
 
@@ -1431,6 +1497,21 @@ void TDriverCodeTextEdit::setHighlighter(TDriverHighlighter *h)
 }
 
 
+void TDriverCodeTextEdit::replaceAllText(const QString &text)
+{
+    const QList<int> markerLines = lineMarkers.lines();
+
+    QTextCursor tc = textCursor();
+    tc.beginEditBlock();
+    tc.select(QTextCursor::Document);
+    tc.insertText(text);
+    tc.endEditBlock();
+
+    lineMarkers.reanchor(markerLines);
+    updateHighlights();
+}
+
+
 void TDriverCodeTextEdit::setFileName(QString fn, bool onlySetModes)
 {
     if (fn.isEmpty()) {
@@ -1460,8 +1541,9 @@ void TDriverCodeTextEdit::setFileName(QString fn, bool onlySetModes)
 
 void TDriverCodeTextEdit::focusInEvent(QFocusEvent *event)
 {
-    if (highlighter) {
+    if (highlighter && highlighter->document() != document()) {
         highlighter->setDocument(document());
+        doSyntaxHighlight();
     }
     QPlainTextEdit::focusInEvent(event);
 }
@@ -1501,9 +1583,9 @@ void TDriverCodeTextEdit::updateHighlights()
 void TDriverCodeTextEdit::doSyntaxHighlight()
 {
     if (highlighter) {
-        highlighter->rehighlight();
-        // TODO: if completion selection becomes sluggish, do highlight only to visible blocks,
-        // see sideAreaPaintEvent for example
+        QTextBlock first, last;
+        blocksNearViewport(first, last);
+        highlighter->rehighlightLazily(first, last);
         needSyntaxRehighlight = false;
     }
 }
@@ -1634,36 +1716,35 @@ void TDriverCodeTextEdit::highlightCompletionCursors(QList<QTextEdit::ExtraSelec
 
 void TDriverCodeTextEdit::highlightRunningLine(QList<QTextEdit::ExtraSelection> &extraSelections)
 {
-    if (runningLine <= 0 || runningLine > document()->blockCount()) return;
+    const int ind = lineMarkers.findFirst(TDriverLineMarkers::RunningLineMarker);
+    if (ind < 0) return;
 
     QTextEdit::ExtraSelection selection;
     selection.format.setBackground(runningLineColor);
     selection.format.setProperty(QTextFormat::FullWidthSelection, true);
-    selection.cursor = QTextCursor(document());
-    selection.cursor.movePosition(QTextCursor::NextBlock, QTextCursor::MoveAnchor, runningLine-1);
+    selection.cursor = QTextCursor(lineMarkers.block(ind));
     extraSelections.append(selection);
 }
 
 
 void TDriverCodeTextEdit::highlightBreakpointLines(QList<QTextEdit::ExtraSelection> &extraSelections)
 {
-    if (bpList.size() <= 0) return;
+    if (lineMarkers.count() <= 0) return;
 
     QTextEdit::ExtraSelection selection;
     selection.format.setBackground(breakpointLineColor);
     selection.format.setProperty(QTextFormat::FullWidthSelection, true);
-    selection.cursor = QTextCursor(document());
 
     int lineNum = 0;
-    for(int ind=0; ind < bpList.size(); ++ind) {
-        if (lineNum == bpList[ind].line) continue; // don't add duplicate entries
-        if (bpList[ind].num <= 0) continue; // don't highlight lines that aren't reported by rdebug
-        lineNum = bpList[ind].line;
-        if (lineNum <= 0 || lineNum >= document()->blockCount()) continue; // invalid line number
-
-        //qDebug() << FFL "highlighting line" << lineNum;
-        selection.cursor.movePosition(QTextCursor::Start);
-        selection.cursor.movePosition(QTextCursor::NextBlock, QTextCursor::MoveAnchor, lineNum-1);
+    for(int ind=0; ind < lineMarkers.count(); ++ind) {
+        if (lineMarkers.type(ind) != TDriverLineMarkers::BreakpointMarker) continue;
+        if (lineMarkers.breakpoint(ind).num <= 0) continue; // don't highlight lines that aren't reported by rdebug
+        const QTextBlock block = lineMarkers.block(ind);
+        if (lineNum == block.blockNumber()+1) continue; // don't add duplicate entries
+        lineNum = block.blockNumber()+1;
+        if (lineNum >= document()->blockCount()) continue; // invalid line number
+
+        selection.cursor = QTextCursor(block);
         extraSelections.append(selection);
     }
 }
@@ -1796,68 +1877,42 @@ void TDriverCodeTextEdit::reindentSelectionStart(QTextCursor tc, int indLevel, i
 }
 
 
-// helper function for sideAreaPaintEvent
-bool TDriverCodeTextEdit::forwardSearch(int targetLine, int &ind)
-{
-    forever {
-        if (ind >= bpList.size()) return false; // nothing more to be found in nums
-        int lineNum = bpList[ind].line;
-        if (targetLine < lineNum) return false; // target not in nums
-        if (targetLine == lineNum) return true; //target found
-        ++ind;
-    }
-}
-
-
-bool TDriverCodeTextEdit::binarySearch(int targetLine, int &ind)
-{
-    int start = 0;
-    int end = bpList.size();
-    int indLine = -1;
-    ind = 0;
-
-    while (start < end) {
-        ind = (start+end)/2;
-        indLine = bpList[ind].line;
-        if (targetLine == indLine) return true; // found!
-
-        if (targetLine < indLine) end = ind;
-        else start = ind+1;
-    }
-
-    // not found, make sure ind is the index where target would be inserted
-    if (ind < bpList.size() && indLine < targetLine) ++ind;
-
-    return false;
-}
-
-
 void TDriverCodeTextEdit::clearBreakpoints()
 {
-    for(int ind=0; ind < bpList.size(); ++ind) {
-        qDebug() << FFL << "removing: " << MEC::dumpBreakpoint(&bpList[ind]);
-        if (bpList[ind].num > 0) {
-            //qDebug() << FFL << "emit removedBreakpoint for list index" << ind;
-            emit removedBreakpoint(bpList[ind].num);
+    for(int ind=0; ind < lineMarkers.count(); ++ind) {
+        if (lineMarkers.type(ind) != TDriverLineMarkers::BreakpointMarker) continue;
+        const MEC::Breakpoint bp = lineMarkers.breakpoint(ind);
+        qDebug() << FFL << "removing: " << MEC::dumpBreakpoint(&bp);
+        if (bp.num > 0) {
+            emit removedBreakpoint(bp.num);
         }
     }
 
-    bpList.clear();
+    lineMarkers.removeAll(TDriverLineMarkers::BreakpointMarker);
     updateHighlights();
 }
 
 
 void TDriverCodeTextEdit::rdebugBreakpointReset()
 {
-    int setCapacity = bpList.size();
+    int setCapacity = rdebugBpSet.size();
 
-    for(int ind=0; ind < bpList.size(); ++ind) {
-        bpList[ind].num = 0;
-        const int thisLine = bpList[ind].line;
-        // remove duplicates
-        while (ind+1 < bpList.size() && bpList[ind+1].line == thisLine) {
-            bpList.removeAt(ind+1);
+    int lastLine = 0;
+    int ind = 0;
+    while (ind < lineMarkers.count()) {
+        if (lineMarkers.type(ind) != TDriverLineMarkers::BreakpointMarker) {
+            ++ind;
+            continue;
+        }
+        const int thisLine = lineMarkers.line(ind);
+        if (thisLine == lastLine) {
+            // remove duplicates
+            lineMarkers.removeAt(ind);
+            continue;
         }
+        lineMarkers.setBreakpointNum(ind, 0);
+        lastLine = thisLine;
+        ++ind;
     }
 
     rdebugBpSet.clear();
@@ -1880,26 +1935,28 @@ void TDriverCodeTextEdit::rdebugBreakpoint(MEC::Breakpoint bp)
         return;
     }
 
-    int ind;
-    if (binarySearch(bp.line, ind)) {
-        // seek index of first breakpoint in line
-        while (ind > 0 && bpList[ind-1].line == bp.line) --ind;
-
-        if (bpList[ind].num == 0) {
+    int ind = lineMarkers.find(bp.line, TDriverLineMarkers::BreakpointMarker);
+    if (ind >= 0) {
+        if (lineMarkers.breakpoint(ind).num == 0) {
             qDebug() << FFL << "setting rdebug breakpoint num";
-            bpList[ind].num = bp.num;
-            // assert that this is only breakpoint for line
-            Q_ASSERT(ind+1 == bpList.size() || bpList[ind+1].line > bp.line);
+            lineMarkers.setBreakpointNum(ind, bp.num);
         }
         else {
-            // seek exact match or insertion point
-            while (ind < bpList.size() && bpList[ind].num < bp.num) ++ind;
+            // seek exact match among breakpoints of the line
+            bool found = false;
+            for (; ind < lineMarkers.count() && lineMarkers.line(ind) == bp.line; ++ind) {
+                if (lineMarkers.type(ind) == TDriverLineMarkers::BreakpointMarker
+                        && lineMarkers.breakpoint(ind).num == bp.num) {
+                    found = true;
+                    break;
+                }
+            }
 
             // if non-existing breakpoint, insert as new
-            if (bpList[ind].num != bp.num) {
+            if (!found) {
                 // TODO: handle enabled status of new breakpoint
                 qDebug() << FFL << "adding new breakpoint";
-                bpList.insert(ind, bp);
+                lineMarkers.insert(bp.line, TDriverLineMarkers::BreakpointMarker, bp);
                 rdebugBpSet.insert(bp.num);
             }
             else {
@@ -1912,22 +1969,24 @@ void TDriverCodeTextEdit::rdebugBreakpoint(MEC::Breakpoint bp)
     updateHighlights();
 }
 
+
+void TDriverCodeTextEdit::removeBreakpointMarker(int ind)
+{
+    const MEC::Breakpoint bp = lineMarkers.breakpoint(ind);
+    qDebug() << FFL << "removing: " << MEC::dumpBreakpoint(&bp);
+    if (bp.num > 0) {
+        emit removedBreakpoint(bp.num);
+        rdebugBpSet.remove(bp.num);
+    }
+    lineMarkers.removeAt(ind);
+}
+
+
 void TDriverCodeTextEdit::removeBreakpointLine(int lineNum)
 {
     int ind;
-    if (binarySearch(lineNum, ind)) {
-        // seek index of first breakpoint in line
-        while (ind > 0 && bpList[ind-1].line == lineNum) --ind;
-
-        do {
-            qDebug() << FFL << "removing: " << MEC::dumpBreakpoint(&bpList[ind]);
-            if (bpList[ind].num > 0) {
-                //qDebug() << FFL << "emit removedBreakpoint for list index" << ind;
-                emit removedBreakpoint(bpList[ind].num);
-                rdebugBpSet.remove(bpList[ind].num);
-            }
-            bpList.removeAt(ind);
-        } while (ind < bpList.size() && bpList[ind].line == lineNum);
+    while ((ind = lineMarkers.find(lineNum, TDriverLineMarkers::BreakpointMarker)) >= 0) {
+        removeBreakpointMarker(ind);
     }
 
     updateHighlights();
@@ -1943,12 +2002,14 @@ void TDriverCodeTextEdit::rdebugDelBreakpoint(int rdebugInd)
 
     int ind=0;
     int count = 0;
-    while (ind < bpList.size()) {
-        if (bpList[ind].num == rdebugInd) {
+    while (ind < lineMarkers.count()) {
+        if (lineMarkers.type(ind) == TDriverLineMarkers::BreakpointMarker
+                && lineMarkers.breakpoint(ind).num == rdebugInd) {
             ++count;
-            qDebug() << FFL << "removing: " << MEC::dumpBreakpoint(&bpList[ind]);
+            const MEC::Breakpoint bp = lineMarkers.breakpoint(ind);
+            qDebug() << FFL << "removing: " << MEC::dumpBreakpoint(&bp);
             rdebugBpSet.remove(rdebugInd);
-            bpList.removeAt(ind);
+            lineMarkers.removeAt(ind);
         }
         else ++ind;
     }
@@ -1962,8 +2023,7 @@ void TDriverCodeTextEdit::rdebugDelBreakpoint(int rdebugInd)
 
 void TDriverCodeTextEdit::uiToggleBreakpointLine(int lineNum)
 {
-    int ind;
-    if (binarySearch(lineNum, ind)) {
+    if (lineMarkers.find(lineNum, TDriverLineMarkers::BreakpointMarker) >= 0) {
         // found
 #if 0
         if (isRunning) {
@@ -1975,14 +2035,11 @@ void TDriverCodeTextEdit::uiToggleBreakpointLine(int lineNum)
         removeBreakpointLine(lineNum);
     }
     else {
-        if (lineNum == document()->blockCount()) return; // last line not allowed
-        qDebug() << FFL << "Inserting new breakpoint line" << lineNum << "(at ind" << ind << "/ size" << bpList.size() << ")";
+        if (lineNum < 1 || lineNum >= document()->blockCount()) return; // last line not allowed
+        qDebug() << FFL << "Inserting new breakpoint line" << lineNum;
         MEC::Breakpoint bp(0, true, fileName(), lineNum);
-        bpList.insert(ind, bp);
+        lineMarkers.insert(lineNum, TDriverLineMarkers::BreakpointMarker, bp);
         emit addedBreakpoint(bp);
-
-        Q_ASSERT(ind == 0 || bpList[ind-1].line < lineNum);
-        Q_ASSERT(ind+1 == bpList.size() || bpList[ind+1].line > lineNum);
     }
 
     updateHighlights();
@@ -1992,8 +2049,10 @@ void TDriverCodeTextEdit::uiToggleBreakpointLine(int lineNum)
 void TDriverCodeTextEdit::dataSyncRequest()
 {
     rdebugBreakpointReset();
-    for(int ind=0; ind < bpList.size(); ++ind) {
-        emit addedBreakpoint(bpList[ind]);
+    for(int ind=0; ind < lineMarkers.count(); ++ind) {
+        if (lineMarkers.type(ind) == TDriverLineMarkers::BreakpointMarker) {
+            emit addedBreakpoint(lineMarkers.breakpoint(ind));
+        }
     }
 }
 
@@ -2016,14 +2075,37 @@ void TDriverCodeTextEdit::setRunningLine(int lineNum)
 
     gotoLine(lineNum);
 
+    const int ind = lineMarkers.findFirst(TDriverLineMarkers::RunningLineMarker);
+    const int runningLine = (ind >= 0) ? lineMarkers.line(ind) : 0;
     if (lineNum == runningLine) return; // no change, avoid updates below
 
-    runningLine = (lineNum > 0 && lineNum <= document()->blockCount()) ? lineNum : 0;
+    lineMarkers.removeAll(TDriverLineMarkers::RunningLineMarker);
+    if (lineNum > 0 && lineNum <= document()->blockCount()) {
+        lineMarkers.insert(lineNum, TDriverLineMarkers::RunningLineMarker);
+    }
     updateHighlights();
     // TODO: change cursor position to running line? or just scroll document to running line without changing cursor position?
 }
 
 
+const QStaticText &TDriverCodeTextEdit::lineNumberText(int lineNum)
+{
+    // texts are laid out once and then reused, until font changes or cache gets too big
+    if (lineNumberFont != font() || lineNumberTexts.size() > 5000) {
+        lineNumberTexts.clear();
+        lineNumberFont = font();
+    }
+
+    QHash<int, QStaticText>::iterator it = lineNumberTexts.find(lineNum);
+    if (it == lineNumberTexts.end()) {
+        it = lineNumberTexts.insert(lineNum, QStaticText(QString::number(lineNum)));
+        it->setTextFormat(Qt::PlainText);
+        it->prepare(QTransform(), lineNumberFont);
+    }
+    return *it;
+}
+
+
 void TDriverCodeTextEdit::sideAreaPaintEvent(QPaintEvent *event)
 {
     QPainter painter(sideArea);
@@ -2035,37 +2117,53 @@ void TDriverCodeTextEdit::sideAreaPaintEvent(QPaintEvent *event)
     int blockNum = block.blockNumber();
     int top = (int)blockBoundingGeometry(block).translated(contentOffset()).top();
     int bot = top + (int) blockBoundingRect(block).height();
+    const int height = fontMetrics().height();
+
+    // tops of all visible blocks are collected for hit testing, even if only part is painted
+    sideAreaFirstBlock = blockNum;
+    sideAreaBlockTops.clear();
 
-    int bpInd = 0;
-    while (block.isValid() && top <= event->rect().bottom()) {
+    int markerInd = lineMarkers.lowerBound(blockNum+1);
+    while (block.isValid() && top <= sideArea->height()) {
+        sideAreaBlockTops.append(top);
 
-        if (block.isVisible() && bot >= event->rect().top()) {
+        if (block.isVisible() && bot >= event->rect().top() && top <= event->rect().bottom()) {
             // line number
-            QString num = QString::number(blockNum + 1);
+            const QStaticText &num = lineNumberText(blockNum + 1);
             painter.setPen(Qt::darkGray);
             painter.setBrush(Qt::NoBrush);
-            painter.drawText(0, top, sideArea->width(),
-                             fontMetrics().height(), Qt::AlignRight, num);
+            painter.drawStaticText(QPointF(sideArea->width() - num.size().width(), top), num);
+
+            // markers of the line
+            int bpInd = -1;
+            bool isRunningLine = false;
+            for (; markerInd < lineMarkers.count(); ++markerInd) {
+                const int markerLine = lineMarkers.line(markerInd);
+                if (markerLine > blockNum+1) break;
+                if (markerLine < blockNum+1) continue;
+                if (lineMarkers.type(markerInd) == TDriverLineMarkers::RunningLineMarker) isRunningLine = true;
+                else if (lineMarkers.type(markerInd) == TDriverLineMarkers::BreakpointMarker && bpInd < 0) bpInd = markerInd;
+            }
 
             // breakpoint marker
-            if (forwardSearch(blockNum+1, bpInd)) {
+            if (bpInd >= 0) {
                 static QBrush breakPointBrushes[2] = {
                     QBrush(Qt::red, Qt::Dense6Pattern), // disabled
                     QBrush(Qt::red, Qt::SolidPattern) }; // enabled
 
-                painter.setBrush(breakPointBrushes[bpList[bpInd].enabled]);
+                painter.setBrush(breakPointBrushes[lineMarkers.breakpoint(bpInd).enabled]);
                 painter.setPen(Qt::darkRed);
-                painter.drawEllipse(0, top, fontMetrics().height(), fontMetrics().height()-1);
+                painter.drawEllipse(0, top, height, height-1);
             }
 
             // runningLine marker
-            if (blockNum+1 == runningLine) {
+            if (isRunningLine) {
                 static QBrush runningLineMarkerBrush(Qt::green, Qt::SolidPattern);
                 painter.setPen(Qt::darkGreen);
                 painter.setBrush(runningLineMarkerBrush);
                 static int halfSpanDegrees = 45;
-                painter.drawPie(fontMetrics().height()/3, top-1,
-                                fontMetrics().height()+4, fontMetrics().height()-1+2,
+                painter.drawPie(height/3, top-1,
+                                height+4, height-1+2,
                                 16*(180-halfSpanDegrees), 16*(2*halfSpanDegrees));
             }
         }
@@ -2075,32 +2173,23 @@ void TDriverCodeTextEdit::sideAreaPaintEvent(QPaintEvent *event)
         bot = top + (int) blockBoundingRect(block).height();
         ++blockNum;
     }
+    sideAreaBlockTops.append(top); // bottom of last block
 }
 
 
 void TDriverCodeTextEdit::sideAreaMouseReleaseEvent(QMouseEvent *event)
 {
-    //qDebug() << FFL << "COORDS" << event->pos();
-    QTextBlock block = firstVisibleBlock();
-    int y = event->y();
-    int top = 0;
-    int bot = 0;
-
-    while (block.isValid() && block.isVisible()) {
-        //qDebug() << FFL << block.blockNumber();
-        top = (int)blockBoundingGeometry(block).translated(contentOffset()).top();
-        bot = top + (int) blockBoundingRect(block).height();
-
-        if (y >= top && y < bot) break;
-        block = block.next();
-    }
-
-    if (!(block.isValid() && block.isVisible())) {
-        //qDebug() << FFL << "No match: out of blocks";
+    if (sideAreaFirstBlock != firstVisibleBlock().blockNumber() || sideAreaBlockTops.size() < 2) {
+        // viewport changed after last paint, click is for content not yet shown
         return;
     }
 
-    int lineNum = block.blockNumber()+1;
+    const int y = event->y();
+    if (y < sideAreaBlockTops.first() || y >= sideAreaBlockTops.last()) return;
+
+    const int ind = qUpperBound(sideAreaBlockTops.constBegin(), sideAreaBlockTops.constEnd(), y)
+            - sideAreaBlockTops.constBegin() - 1;
+    const int lineNum = sideAreaFirstBlock + ind + 1;
     //qDebug() << FFL << "MATCH" << lineNum;
     uiToggleBreakpointLine(lineNum);
 }
@@ -2108,18 +2197,8 @@ void TDriverCodeTextEdit::sideAreaMouseReleaseEvent(QMouseEvent *event)
 
 void TDriverCodeTextEdit::documentBlockCountChange(int newCount)
 {
-    int adjust = newCount - lastBlockCount;
-    lastBlockCount = newCount;
-
-    int lineNum = textCursor().block().blockNumber()+1;
-    //qDebug() << FFL << "got linenum" << lineNum << "adjust" << adjust;
-
-    /* adjust breakpoints */
-    for (int ind=bpList.size()-1 ; ind >= 0 && bpList[ind].line >= lineNum; --ind) {
-        qDebug() << FFL << "adjusting breakpoint line number" << bpList[ind].line << "by" << adjust;
-        bpList[ind].line += adjust;
-    }
-
+    Q_UNUSED(newCount);
+    // line markers move with their blocks, only line number width may need changing
     updateSideAreaWidth();
 }
 
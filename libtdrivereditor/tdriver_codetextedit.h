@@ -24,6 +24,7 @@
 #include "libtdrivereditor_global.h"
 #include "tdriver_editor_common.h"
 #include "tdriver_highlighter.h"
+#include "tdriver_linemarkers.h"
 
 #include <QPlainTextEdit>
 
@@ -34,6 +35,10 @@
 #include <QStringList>
 #include <QTextDocument>
 #include <QPair>
+#include <QHash>
+#include <QVector>
+#include <QStaticText>
+#include <QFont>
 
 class QAbstractItemModel;
 class QModelIndex;
@@ -45,6 +50,7 @@ class QTextCodec;
 class SideArea;
 //class QMenu;
 class TDriverCompletionMenu;
+class TDriverCompletionIndex;
 
 class LIBTDRIVEREDITORSHARED_EXPORT TDriverCodeTextEdit : public QPlainTextEdit
 {
@@ -73,9 +79,12 @@ public:
     void sideAreaMouseReleaseEvent(QMouseEvent *event);
 
     void setHighlighter(TDriverHighlighter *);
+    void setCompletionIndex(TDriverCompletionIndex *index) { completionIndex = index; }
 
     const QString &fileName() const { return fname; }
     void setFileName(QString name, bool onlySetModes=false); // emits modesChanged()
+    // replaces text as one undoable edit, markers keep their line numbers
+    void replaceAllText(const QString &text);
 
     QTextCodec *fileCodec() { return fcodec; }
     void setFileCodec(QTextCodec *codec) { fcodec = codec; }
@@ -168,6 +177,7 @@ private:
     QCompleter *completer;
     bool complPopupShowingInfo;
     QStandardItemModel *phraseModel;
+    TDriverCompletionIndex *completionIndex; // shared, not owned
     int baseStart; // position before complCur.selectionStart, indicating the base text for which completions are searched
     QString lastBaseText;
     QTextCursor complCur;
@@ -192,7 +202,6 @@ private:
     bool lastFindWrapped;
 
     int lastBlock; // used for avoiding unnecessary calls to updateHighlights
-    int lastBlockCount;
     bool isRunning;
 
     bool isUsingTabulatorsMode;
@@ -200,9 +209,15 @@ private:
     bool isWrapMode;
 
     // Note: valid line numbers are 1 .. document.blockCount
-    int runningLine;
+    TDriverLineMarkers lineMarkers; // breakpoints and running line
     QSet<int> rdebugBpSet;
-    QList <struct MEC::Breakpoint> bpList;
+
+    // side area caches, line number texts and block tops of last painted viewport for hit testing
+    QHash<int, QStaticText> lineNumberTexts;
+    QFont lineNumberFont;
+    QVector<int> sideAreaBlockTops;
+    int sideAreaFirstBlock;
+
     QColor cursorLineColor;
     QColor pairMatchColor;
     QColor pairNoMatchBgColor;
@@ -248,11 +263,14 @@ private slots:
     void completerActivated(const QModelIndex &);
 
 private:
+    void blocksNearViewport(QTextBlock &first, QTextBlock &last);
+    QStandardItemModel *createCompletionModel(const QStringList &completions);
+    bool popupLocalCompletion(const QByteArray &statement);
     bool doTabHandling(QKeyEvent *);
     void indentSelection(QTextCursor tc, bool increaseIndentation);
     void reindentSelectionStart(QTextCursor tc, int indLevel, int indChars);
-    bool forwardSearch(int targetLine, int &ind);
-    bool binarySearch(int targetLine, int &ind);
+    const QStaticText &lineNumberText(int lineNum);
+    void removeBreakpointMarker(int ind);
     void insertAtComplCursor(QString text) {
         ignoreCursorPosChanges = true;
         complCur.insertText(text);
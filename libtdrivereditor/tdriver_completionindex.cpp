@@ -0,0 +1,176 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#include "tdriver_completionindex.h"
+
+#include "tdriver_editor_common.h"
+
+#include <tdriver_debug_macros.h>
+
+#include <QDir>
+#include <QRegExp>
+#include <QtAlgorithms>
+
+
+/*!
+    \class TDriverCompletionIndex
+    \brief Local completion candidates, so completion popup needs no round-trip to Ruby.
+
+    Words come from completion definition files, behaviours, object tree and
+    earlier Ruby replies, and are kept in a sorted list searched by prefix.
+    Object tree words are replaced on every refresh, others are kept.
+    Ruby replies are also cached as such by statement, so that a statement
+    which was completed before gets its exact completions immediately.
+    Cached replies are only a first guess, Ruby is still asked when the user
+    requests completion again, and the newer reply replaces the cached one.
+ */
+
+
+TDriverCompletionIndex::TDriverCompletionIndex(QObject *parent) :
+    QObject(parent),
+    wordsSorted(true)
+{
+}
+
+
+void TDriverCompletionIndex::addWords(const QStringList &newWords)
+{
+    foreach (const QString &word, newWords) {
+        if (word.isEmpty() || addedWords.contains(word)) continue;
+        addedWords.insert(word);
+        if (wordSet.contains(word)) continue;
+        wordSet.insert(word);
+        words.append(word);
+        wordsSorted = false;
+    }
+}
+
+
+void TDriverCompletionIndex::replaceWords(const QString &source, const QStringList &newWords)
+{
+    sourceWords.insert(source, newWords);
+
+    // rebuilt from scratch, words of old source can't be told apart in words
+    wordSet = addedWords;
+    foreach (const QStringList &list, sourceWords) {
+        foreach (const QString &word, list) {
+            if (!word.isEmpty()) wordSet.insert(word);
+        }
+    }
+    words = wordSet.toList();
+    wordsSorted = false;
+}
+
+
+// Adds identifiers found in text, note: ruby-specific like splitToComplCursors
+void TDriverCompletionIndex::addText(const QString &text)
+{
+    static const QRegExp wordEx("[@A-Z_a-z][0-9A-Z_a-z]*[!?]?");
+    QStringList found;
+
+    for (int pos = wordEx.indexIn(text); pos >= 0; pos = wordEx.indexIn(text, pos + wordEx.matchedLength())) {
+        // short words are faster to type than to pick from a list
+        if (wordEx.matchedLength() >= 3) found << wordEx.cap(0);
+    }
+
+    addWords(found);
+}
+
+
+// Adds words of all completion definition files (*.txt) in given directory
+void TDriverCompletionIndex::addDefinitionFiles(const QString &dirName)
+{
+    QDir dir(dirName);
+
+    foreach (const QString &fileName, dir.entryList(QStringList("*.txt"), QDir::Files | QDir::Readable)) {
+        QStringList contents;
+
+        if (MEC::getDefinitionFile(dir.filePath(fileName), contents) == MEC::InvalidDefinitionFile) {
+            qDebug() << FCFL << "invalid definition file" << dir.filePath(fileName);
+            continue;
+        }
+
+        foreach (const QString &entry, contents) addText(entry);
+    }
+
+    qDebug() << FCFL << "words after" << dirName << addedWords.size();
+}
+
+
+// Returns cached completions of statement if Ruby has replied to it before,
+// else known words starting with prefix
+QStringList TDriverCompletionIndex::completions(const QByteArray &statement, const QString &prefix) const
+{
+    if (replies.contains(statement)) {
+        return replies.value(statement);
+    }
+
+    sortWords();
+
+    QStringList result;
+    QStringList::const_iterator it = qLowerBound(words.constBegin(), words.constEnd(), prefix);
+
+    for (; it != words.constEnd() && it->startsWith(prefix) && result.size() < MaxCompletions; ++it) {
+        result << *it;
+    }
+
+    return result;
+}
+
+
+void TDriverCompletionIndex::addReply(QObject *client, QByteArray statement, QStringList completions)
+{
+    Q_UNUSED(client);
+
+    QStringList trimmed;
+    foreach (const QString &completion, completions) {
+        const QString text(completion.trimmed());
+        if (!text.isEmpty()) trimmed << text;
+    }
+
+    if (replies.contains(statement)) {
+        replyOrder.removeOne(statement);
+    }
+    else if (replyOrder.size() >= MaxReplies) {
+        replies.remove(replyOrder.takeFirst());
+    }
+
+    replies.insert(statement, trimmed);
+    replyOrder.append(statement);
+
+    addWords(trimmed);
+}
+
+
+void TDriverCompletionIndex::clearReplies()
+{
+    replies.clear();
+    replyOrder.clear();
+}
+
+
+void TDriverCompletionIndex::sortWords() const
+{
+    if (!wordsSorted) {
+        qSort(words);
+        wordsSorted = true;
+    }
+}
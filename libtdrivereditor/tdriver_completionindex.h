@@ -0,0 +1,69 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#ifndef TDRIVER_COMPLETIONINDEX_H
+#define TDRIVER_COMPLETIONINDEX_H
+
+#include "libtdrivereditor_global.h"
+
+#include <QObject>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+
+
+class LIBTDRIVEREDITORSHARED_EXPORT TDriverCompletionIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TDriverCompletionIndex(QObject *parent = 0);
+
+    void addWords(const QStringList &words);
+    // words of source replace its earlier words, for example object tree of latest refresh
+    void replaceWords(const QString &source, const QStringList &words);
+    void addText(const QString &text);
+    void addDefinitionFiles(const QString &dirName);
+
+    QStringList completions(const QByteArray &statement, const QString &prefix) const;
+
+    enum { MaxReplies = 100, MaxCompletions = 1000 };
+
+public slots:
+    void addReply(QObject *client, QByteArray statement, QStringList completions);
+    void clearReplies();
+
+private:
+    void sortWords() const;
+
+    // words is sorted lazily on first lookup after new words were appended
+    mutable QStringList words;
+    mutable bool wordsSorted;
+    QSet<QString> wordSet; // same as words
+    QSet<QString> addedWords; // kept until index is destroyed
+    QHash<QString, QStringList> sourceWords;
+
+    QHash<QByteArray, QStringList> replies;
+    QList<QByteArray> replyOrder; // oldest first
+};
+
+#endif // TDRIVER_COMPLETIONINDEX_H
@@ -28,6 +28,9 @@
 #include <QByteArray>
 #include <QToolBar>
 #include <QTextCharFormat>
+#include <QTimer>
+#include <QScrollBar>
+#include <QSettings>
 
 #include <tdriver_debug_macros.h>
 
@@ -43,10 +46,19 @@ TDriverConsoleTextEdit::TDriverConsoleTextEdit(QWidget *parent) :
 #endif
         quiet(false),
         appendCur(new QTextCursor(document())),
-        appendCurSource(this)
+        appendCurSource(this),
+        pendingLines(0),
+        flushTimer(new QTimer(this))
 {
     //setWordWrapMode(QTextOption::NoWrap);
 
+    // output is inserted at most once per frame
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(20);
+    connect(flushTimer, SIGNAL(timeout()), SLOT(flushAppendedText()));
+
+    setMaximumLines(QSettings().value("editor/console_max_lines", 20000).toInt());
+
     // note: command line is not displayed by default, it's responsibility of derived class to display it
     configureCommandLine(new TDriverComboLineEdit(this));
     cmdLine->setObjectName("console command line");
@@ -129,6 +141,8 @@ bool TDriverConsoleTextEdit::sendAndAppendChars(QString text,  const QTextCharFo
     MEC::replaceUnicodeSeparators(text);
 
     if (!quiet) {
+        // echo goes after output received so far
+        appendCurSource->flushAppendedText();
         moveCursor(QTextCursor::End);
         centerCursor();
         if (localEcho) {
@@ -191,13 +205,68 @@ void TDriverConsoleTextEdit::appendLine(const QString &text, const QTextCharForm
 
 void TDriverConsoleTextEdit::appendText(const QString &text, const QTextCharFormat &format)
 {
-    if (quiet) return;
+    if (quiet || text.isEmpty()) return;
+
+    if (appendCurSource != this) {
+        // shared append cursor, text is kept in order by its owner
+        appendCurSource->appendText(text, format);
+        return;
+    }
+
+    if (!pendingText.isEmpty() && pendingText.last().format == format) {
+        pendingText.last().text.append(text);
+    }
+    else {
+        PendingText pending;
+        pending.text = text;
+        pending.format = format;
+        pendingText.append(pending);
+    }
+    pendingLines += text.count('\n');
+
+    if (!flushTimer->isActive()) flushTimer->start();
+}
+
+
+void TDriverConsoleTextEdit::flushAppendedText()
+{
+    flushTimer->stop();
+    if (pendingText.isEmpty()) return;
+
+    // text that would be trimmed right away is not inserted at all
+    const int maxLines = maximumBlockCount();
+    if (maxLines > 0 && pendingLines > maxLines) {
+        int skipLines = pendingLines - maxLines;
+        while (pendingText.size() > 1 && pendingText.first().text.count('\n') <= skipLines) {
+            skipLines -= pendingText.takeFirst().text.count('\n');
+        }
+        QString &first = pendingText.first().text;
+        int pos = 0;
+        for (; skipLines > 0; --skipLines) {
+            const int next = first.indexOf('\n', pos);
+            if (next < 0) break;
+            pos = next + 1;
+        }
+        first.remove(0, pos);
+    }
+
+    const QScrollBar *scrollBar = verticalScrollBar();
+    const bool atBottom = (scrollBar->value() >= scrollBar->maximum());
+
+    appendCur->beginEditBlock();
+    foreach (const PendingText &pending, pendingText) {
+        appendCur->setCharFormat(pending.format);
+        appendCur->insertText(pending.text);
+    }
+    appendCur->endEditBlock();
+
+    pendingText.clear();
+    pendingLines = 0;
 
-    appendCur->setCharFormat(format);
-    appendCur->insertText(text);
-    centerAppendCursor();
+    if (atBottom) centerAppendCursor();
 }
 
+
 void TDriverConsoleTextEdit::centerAppendCursor()
 {
     //QTextCursor tmp = appendCurSource->textCursor();
@@ -207,6 +276,22 @@ void TDriverConsoleTextEdit::centerAppendCursor()
 }
 
 
+void TDriverConsoleTextEdit::setMaximumLines(int lines)
+{
+    // QPlainTextEdit removes blocks from the start of document
+    setMaximumBlockCount(qMax(lines, 0));
+}
+
+
+void TDriverConsoleTextEdit::clearConsole()
+{
+    pendingText.clear();
+    pendingLines = 0;
+    flushTimer->stop();
+    QPlainTextEdit::clear();
+}
+
+
 void TDriverConsoleTextEdit::insertFromMimeData ( const QMimeData * source )
 {
     sendAndAppendChars(source->text(), commandFormat);
@@ -25,8 +25,10 @@
 
 #include <QPlainTextEdit>
 #include <QTextCharFormat>
+#include <QList>
 
 class QIODevice;
+class QTimer;
 class QTextCursor;
 class QColor;
 class QToolBar;
@@ -58,10 +60,18 @@ public slots:
 
     void copyAppendCursor(TDriverConsoleTextEdit *source);
 
+    // appended text is buffered and inserted once per frame,
+    // view follows it only if it was scrolled to the bottom
     void appendLine(const QString &text, const QTextCharFormat &format);
     void appendText(const QString &text, const QTextCharFormat &format);
+    void flushAppendedText();
     void centerAppendCursor();
 
+    // scrollback limit in lines, oldest lines are removed, 0 means unlimited
+    void setMaximumLines(int lines);
+    // QPlainTextEdit::clear is not virtual, so this has its own name
+    void clearConsole();
+
 protected:
     virtual void insertFromMimeData ( const QMimeData * source );
     TDriverComboLineEdit *cmdLine;
@@ -72,6 +82,14 @@ private:
     bool quiet;
     QTextCursor *appendCur;
     TDriverConsoleTextEdit *appendCurSource;
+
+    struct PendingText {
+        QString text;
+        QTextCharFormat format;
+    };
+    QList<PendingText> pendingText; // consecutive texts with same format are joined
+    int pendingLines;
+    QTimer *flushTimer;
 };
 
 #endif // TDRIVER_CONSOLETEXTEDIT_H
@@ -22,6 +22,7 @@
 #include "tdriver_runconsole.h"
 #include "tdriver_debugconsole.h"
 #include "tdriver_combolineedit.h"
+#include "tdriver_variablemodel.h"
 
 #include <QVBoxLayout>
 #include <QAction>
@@ -29,12 +30,13 @@
 #include <QTcpSocket>
 #include <QStringList>
 #include <QMap>
-#include <QRegExp>
 
 #include <QLineEdit>
 #include <QHBoxLayout>
 #include <QPushButton>
 #include <QComboBox>
+#include <QSplitter>
+#include <QTreeView>
 
 #include "tdriver_editor_common.h"
 #include <tdriver_debug_macros.h>
@@ -63,10 +65,10 @@ TDriverDebugConsole::TDriverDebugConsole(QWidget *parent) :
         interruptWaiting(false),
         interruptSent(false),
         rdebugDelim(rdebugDelimCstr),
-
-        remoteParseKey(),
-        remoteParsedLast(NULL),
-        remoteParsedNew(new QMap<QString, QStringList>)
+        splitter(new QSplitter(Qt::Horizontal)),
+        variableModel(new TDriverVariableModel(this)),
+        variableView(new QTreeView),
+        inspectRequest(0)
 {
     remoteConsole->outputFormat.setForeground(QBrush(Qt::darkBlue));
     remoteConsole->commandFormat.setForeground(QBrush(Qt::blue));
@@ -80,8 +82,7 @@ TDriverDebugConsole::TDriverDebugConsole(QWidget *parent) :
     cmdTargetCB->setObjectName("debugconsole cmd target");
     sendCmdButton->setObjectName("debugconsole cmd send");
 
-    remotePromptPrefix = rdebugDelim + "prompt";
-    controlPromptPrefix = remotePromptPrefix;
+    controlPromptPrefix = rdebugDelim + "prompt";
 
     createActions();
 
@@ -95,7 +96,17 @@ TDriverDebugConsole::TDriverDebugConsole(QWidget *parent) :
     toolbar->setToolButtonStyle(Qt::ToolButtonTextBesideIcon);
     layout->addWidget(toolbar);
 
-    layout->addWidget(remoteConsole);
+    variableView->setObjectName("debugconsole variables");
+    variableView->setModel(variableModel);
+    variableView->setUniformRowHeights(true);
+    variableView->setAlternatingRowColors(true);
+    connect(variableView, SIGNAL(activated(QModelIndex)), variableModel, SLOT(fetchNextPage(QModelIndex)));
+    connect(variableModel, SIGNAL(childrenRequested(int,QString)), this, SLOT(requestVariableChildren(int,QString)));
+
+    splitter->setObjectName("debugconsole splitter");
+    splitter->addWidget(remoteConsole);
+    splitter->addWidget(variableView);
+    layout->addWidget(splitter);
     remoteConsole->setLocalEcho(true);
 
 #if DEBUG_RDEBUG_CONTROL
@@ -139,8 +150,8 @@ TDriverDebugConsole::TDriverDebugConsole(QWidget *parent) :
 
 void TDriverDebugConsole::clear()
 {
-    remoteConsole->clear();
-    controlConsole->clear();
+    remoteConsole->clearConsole();
+    controlConsole->clearConsole();
 }
 
 
@@ -163,6 +174,8 @@ void TDriverDebugConsole::connectTo(QString host, quint16 dport, quint16 cport,
     resetConnections();
 
     procConsoleOwner = procConsoleOwner_;
+    remoteParser.reset();
+    remoteStop = TDriverRdebugStop();
 
     //qDebug() << FCFL << host << dport << cport;
     remoteConsole->appendLine(
@@ -204,6 +217,11 @@ void TDriverDebugConsole::setRunning(bool state)
     remoteCmdQueue.clear();
     controlCmdQueue.clear();
 
+    inspectQueue.clear();
+    inspectRequest = 0;
+    inspectReply.clear();
+    variableModel->clear();
+
     dataSynced =
             syncingBeforeContinue =
             controlHasPrompt =
@@ -223,7 +241,7 @@ void TDriverDebugConsole::createActions()
     clearAct = new QAction(QIcon(":/images/clear.png"), tr("&Clear"), this);
     clearAct->setObjectName("debugconsole clear");
     clearAct->setToolTip(tr("Clear contents of buffer"));
-    connect(clearAct, SIGNAL(triggered()), remoteConsole, SLOT(clear()));
+    connect(clearAct, SIGNAL(triggered()), remoteConsole, SLOT(clearConsole()));
 
     quitAct = new QAction(QIcon(":/images/quit.png"), tr("&Quit"), this);
     quitAct->setObjectName("debugconsole quit");
@@ -423,94 +441,25 @@ void TDriverDebugConsole::doStepOver(void)
 }
 
 
-static inline void remoteParsedDone(QMap<QString, QStringList> *&target, QMap<QString, QStringList> *&tmp)
-{
-    if (target) delete target;
-    target = tmp;
-    tmp = new QMap<QString, QStringList>;
-    //qDebug() << "got parselist" << *target;
-}
-
-static inline void dumpToConsole(TDriverConsoleTextEdit *console, QMap<QString, QStringList> *map)
-{
-    foreach(QString key, map->keys()) {
-        qDebug() << FFL << "-----------------" << key;
-        if (map->value(key).isEmpty())
-            console->appendLine(rdebugDelimCstr + key + ": <no values>", console->notifyFormat);
-        else
-            console->appendLine(rdebugDelimCstr + key + ": '" + map->value(key).join("', '") + "'", console->notifyFormat);
-    }
-}
-
-static QList<struct MEC::Breakpoint> parseBreakpoints(QStringList list)
-{
-    static const QRegExp rx("^(\\d+) +([yn]) +at +(.+):(\\d+)$");
-    //obsolete parsing from control: "^Breakpoint (\\d+) file (.+), line (\\d+)$");
-
-    QList<struct MEC::Breakpoint> result;
-    if (list.isEmpty()) return result;
-
-    QString firstline(list.takeFirst());
-    if (list.isEmpty() || firstline != QObject::tr("Num Enb What", "rdebug header for breakpoint list printout")) {
-        if (firstline != QObject::tr("No breakpoints.", "rdebug printout for no breakpoints")) {
-            qWarning() << FFL << "UNEXPECTED OUTPUT FROM rdebug, PLEASE REPORT A TICKET";
-            qDebug() << "breakpoint list:" << list;
-        }
-        return result;
-    }
-
-    foreach (QString line, list) {
-        if (rx.indexIn(line) == -1 || rx.capturedTexts().size() != 1+4) {
-            qWarning() << FFL << "Invalid breakpoint line ignored:" << line;
-            qDebug() << FFL << "captures:" << rx.capturedTexts()
-                    << "pattern:" << rx.pattern();
-            continue;
-        }
-
-        bool ok1, ok4;
-        struct MEC::Breakpoint bp(
-                rx.cap(1).toInt(&ok1),
-                (rx.cap(2) == "y"),
-                rx.cap(3),
-                rx.cap(4).toInt(&ok4) );
-        if (ok1 && ok4)
-            result.append(bp);
-        else
-            qDebug() << FFL << "invalid parse result" << ok1 << ok4 << "for line" << line;
-    }
-
-    qDebug() << FFL << MEC::dumpBreakpointList(result, "\n  ", "\n  ");
-    return result;
-}
-
 static inline bool checkForPrompt(const QString &str, const QString &prefix)
 {
     //return str.startsWith(prefix);
     return (str == prefix);
 }
 
-void TDriverDebugConsole::handleRemoteText(QString text)
+void TDriverDebugConsole::handleRemoteData(const QByteArray &data)
 {
     remoteHasPrompt = false;
 
-    remoteBuffer.append(text);
-    QStringList spl = remoteBuffer.split('\n', QString::KeepEmptyParts);
-    Q_ASSERT(!spl.isEmpty());
-    remoteBuffer = spl.takeLast(); // either partial line or empty string
+    remoteParser.append(data);
 
-    qDebug() << FCFL << "REMOTE\n" << spl.join("\n") << "\n^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^";
-    foreach(QString str, spl) {
-
-        // handle "PROMPT ..pre-prompt" line so it won't be displayed as application output
-        if (str == "PROMPT "+rdebugDelim+"pre-prompt") {
-            str = rdebugDelim+"pre-prompt";
-        }
+    TDriverRdebugParser::LineType type;
+    QByteArray line;
+    while (remoteParser.readLine(type, line)) {
 
-        qDebug() << FCFL << str << remoteParseKey;
-
-        if (checkForPrompt(str, remotePromptPrefix)) {
+        if (type == TDriverRdebugParser::PromptLine) {
             // got prompt, we're back in control
-            if (!remoteHasPrompt) qDebug() << FCFL << "REMOTE GOT PROMPT by" << str;
+            qDebug() << FCFL << "REMOTE GOT PROMPT";
             remoteHasPrompt = true;
 
             if (!dataSynced) {
@@ -523,51 +472,49 @@ void TDriverDebugConsole::handleRemoteText(QString text)
             // TODO: if there are threads, maybe setStdStreamsHidden shouldn't be done?
             if (procConsoleOwner) procConsoleOwner->setStdStreamsHidden(true);
 
-            qDebug() << FCFL << "GOT PARSELIST remoteParsed2" << *remoteParsedNew;
-            remoteParsedDone(remoteParsedLast, remoteParsedNew);
-            remoteParseKey.clear();
-            //dumpToConsole(remoteConsole, remoteParsed2);
+            const TDriverRdebugStop stop(remoteParser.takeStop());
+
+            if (inspectRequest) {
+                // reply to variable inspector, program is still at the same stop
+                QStringList errors;
+                foreach(const QByteArray &errorLine, stop.errors) errors << QString::fromLocal8Bit(errorLine);
+                variableModel->childrenReceived(inspectRequest, inspectReply, errors.join("\n"));
+                inspectRequest = 0;
+                inspectReply.clear();
+            }
+            else {
+                remoteStop = stop;
 
-            //foreach(const QString &line, remoteParsedLast->value("breakpoints"))
-                //remoteConsole->appendLine("BREAKPOINT "+line, remoteConsole->outputFormat);
-            foreach(const QString &line, remoteParsedLast->value("stack"))
-                remoteConsole->appendLine("STACK"+line, remoteConsole->outputFormat);
-            foreach(const QString &line, remoteParsedLast->value("variables"))
-                remoteConsole->appendLine(line, remoteConsole->outputFormat);
-            foreach(const QString &line, remoteParsedLast->value("error-begin"))
-                remoteConsole->appendLine("ERROR: "+line, remoteConsole->outputFormat);
+                foreach(const TDriverRdebugFrame &frame, remoteStop.stack)
+                    remoteConsole->appendLine("STACK"+frame.displayText(), remoteConsole->outputFormat);
+                foreach(const QByteArray &errorLine, remoteStop.errors)
+                    remoteConsole->appendLine("ERROR: "+QString::fromLocal8Bit(errorLine), remoteConsole->outputFormat);
 
-            emit breakpoints(parseBreakpoints(remoteParsedLast->value("breakpoints")));
-            emitRunningPosition(*remoteParsedLast, false);
+                // values of previous stop are not valid anymore
+                inspectQueue.clear();
+                variableModel->setVariables(remoteStop.variables);
+
+                emit breakpoints(remoteStop.breakpoints);
+                emitRunningPosition(remoteStop, false);
+            }
 
             interruptSent = false;
             if (quitWaiting) doQuit();
 
             sendRemoteCmd(); // handle remoteCmdQueue
-            //            if (remoteHasPrompt) {
-            //                remoteConsole->appendText("> ", remoteConsole->commandFormat);
-            //            }
+            sendInspectCmd();
         }
-        else if (str.startsWith(rdebugDelim)) {
-            // got  new key for parsed information items
-            qDebug() << FCFL << remoteParseKey << "chaged to" << str.mid(rdebugDelim.length()).trimmed();
-            remoteParseKey = str.mid(rdebugDelim.length()).trimmed();
-            // make sure a map key exists even if there won't be any data associated with it
-            if (!remoteParseKey.isEmpty()) (*remoteParsedNew)[remoteParseKey];
-
+        else if (type == TDriverRdebugParser::SectionLine) {
             // "starting" means script is running and rdebug remote will not be responsive
-            if (remoteParseKey == "starting") {
-                remoteParsedNew->clear();
+            if (remoteParser.section() == "starting") {
                 if (procConsoleOwner) procConsoleOwner->setStdStreamsHidden(false);
             }
         }
-        else if (!remoteParseKey.isEmpty()) {
-            // got new information item for current key
-            (*remoteParsedNew)[remoteParseKey].append(str.trimmed());
-        }
-        else {
-            remoteConsole->appendLine(str, remoteConsole->outputFormat);
+        else if (type == TDriverRdebugParser::OutputLine) {
+            if (inspectRequest) inspectReply.append(line).append('\n');
+            else remoteConsole->appendLine(QString::fromLocal8Bit(line), remoteConsole->outputFormat);
         }
+        // DataLine is already recorded by parser
     }
     updateActionStates();
 }
@@ -630,7 +577,7 @@ void TDriverDebugConsole::readRemoteText()
 {
     QByteArray rawData = remoteConn->readAll();
     //qDebug() << FCFL << "RAW REMOTE" << rawData << "=" << rawData.toHex();
-    handleRemoteText(QString::fromLocal8Bit(rawData));
+    handleRemoteData(rawData);
 }
 
 
@@ -647,47 +594,16 @@ void TDriverDebugConsole::readControlText()
 }
 
 
-void TDriverDebugConsole::emitRunningPosition(QMap<QString, QStringList> &remoteParsed, bool starting)
+void TDriverDebugConsole::emitRunningPosition(const TDriverRdebugStop &stop, bool starting)
 {
-    static const QString currentLineStart("--> #0 ");
-    static const QString parseStart("at line ");
-
-    QStringList stack(remoteParsed.value("stack"));
-
-    //QString function; // emited value // TODO: implement reporting function, add to signal arguments
-    QString entry;
-
-    if (stack.isEmpty()) return;
-    QString line0(stack.takeFirst());
-    if (!line0.startsWith(currentLineStart)) return;
-    if (!stack.isEmpty()) {
-        QString line1 = stack.takeFirst();
-        if (line1.startsWith(parseStart)) {
-            // 2-line format get function from line0 and at_line from line1
-            //function = line0.mid(currentLineStart.length());
-            entry = line1.mid(parseStart.length());
-        }
-    }
-    if (entry.isEmpty()) {
-        // 1-line format, function will stay empty
-        int ind = line0.indexOf(parseStart, currentLineStart.length());
-        if (ind == -1) return;
-        entry = line0.mid(ind + parseStart.length());
-    }
-
-    // try to find colon preceding line number
-    int colonInd = entry.lastIndexOf(':');
-    if (colonInd < 0) return;
+    // TODO: implement reporting function, add to signal arguments
+    if (stop.stack.isEmpty()) return;
+    const TDriverRdebugFrame &frame = stop.stack.first();
+    if (!frame.current || frame.level != 0 || frame.file.isEmpty()) return;
 
-    // try to parse line number
-    bool ok = false;
-    int lineNum = entry.mid(colonInd+1).toInt(&ok); // emited vaule
-    if (!ok)  return;
-
-    QString fileName = entry.left(colonInd); // emitted value
-    if (fileName.isEmpty()) return;
+    int lineNum = frame.lineNum; // emitted value
+    QString fileName = MEC::fileWithPath(QString::fromLocal8Bit(frame.file)); // emitted value
 
-    fileName = MEC::fileWithPath(fileName);
     if (starting) {
         qDebug() << FCFL << "emitting runStarting(" << fileName << lineNum <<")";
         emit runStarting(fileName, lineNum);
@@ -699,6 +615,26 @@ void TDriverDebugConsole::emitRunningPosition(QMap<QString, QStringList> &remote
 }
 
 
+void TDriverDebugConsole::requestVariableChildren(int requestId, QString command)
+{
+    inspectQueue.append(qMakePair(requestId, command));
+    sendInspectCmd();
+}
+
+
+void TDriverDebugConsole::sendInspectCmd()
+{
+    // user commands go first, inspector commands are not shown in console
+    if (!remoteHasPrompt || !remoteCmdQueue.isEmpty() || inspectQueue.isEmpty()) return;
+
+    const QPair<int, QString> request = inspectQueue.takeFirst();
+    inspectRequest = request.first;
+    remoteConn->write((request.second + "\n").toLocal8Bit());
+    remoteHasPrompt = false;
+    updateActionStates();
+}
+
+
 void TDriverDebugConsole::addBreakpoint(struct MEC::Breakpoint bp)
 {
     if (!isRunning) {
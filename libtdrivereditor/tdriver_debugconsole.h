@@ -24,6 +24,7 @@
 #include "libtdrivereditor_global.h"
 
 #include "tdriver_editor_common.h"
+#include "tdriver_rdebugparser.h"
 #include <QWidget>
 
 class QVBoxLayout;
@@ -35,8 +36,13 @@ class QTcpSocket;
 class QToolBar;
 class TDriverConsoleTextEdit;
 class TDriverRunConsole;
+class TDriverVariableModel;
+class QTreeView;
+class QSplitter;
 
 #include <QStringList>
+#include <QList>
+#include <QPair>
 
 class LIBTDRIVEREDITORSHARED_EXPORT TDriverDebugConsole : public QWidget
 {
@@ -44,6 +50,8 @@ class LIBTDRIVEREDITORSHARED_EXPORT TDriverDebugConsole : public QWidget
 public:
     explicit TDriverDebugConsole(QWidget *parent = 0);
     QTcpSocket &connection() { return *remoteConn; }
+    // records parsed from rdebug output at latest prompt
+    const TDriverRdebugStop &lastStop() const { return remoteStop; }
 
 
 signals:
@@ -63,7 +71,7 @@ public slots:
     void resetProcConsoleOwner();
     void setRunning(bool);
 
-    void handleRemoteText(QString text);
+    void handleRemoteData(const QByteArray &data);
     void handleControlText(QString text);
     void readRemoteText();
     void readControlText();
@@ -111,13 +119,17 @@ private:
     bool interruptSent;
 
     QString rdebugDelim;
-    QString remoteParseKey;
 
-    QMap<QString, QStringList> *remoteParsedLast;
-    QMap<QString, QStringList> *remoteParsedNew;
+    TDriverRdebugParser remoteParser;
+    TDriverRdebugStop remoteStop;
 
-    QString remotePromptPrefix;
-    QString remoteBuffer;
+    // variable inspector, its commands are sent only when remote has nothing else queued
+    QSplitter *splitter;
+    TDriverVariableModel *variableModel;
+    QTreeView *variableView;
+    QList<QPair<int, QString> > inspectQueue;
+    int inspectRequest; // id of request whose reply is being received, or 0
+    QByteArray inspectReply;
 
     QString controlPromptPrefix;
     QString controlBuffer;
@@ -138,7 +150,9 @@ private slots:
     // empty but non-null cmd will send just newline, so null is needed
     bool sendRemoteCmd(QString cmd=QString(), bool allowQueuing=false);
     bool sendControlCmd(QString cmd=QString(), bool allowQueuing=false);
-    void emitRunningPosition(QMap<QString, QStringList> &remoteParsed, bool starting);
+    void emitRunningPosition(const TDriverRdebugStop &stop, bool starting);
+    void requestVariableChildren(int requestId, QString command);
+    void sendInspectCmd();
 };
 
 #endif // TDRIVER_DEBUGCONSOLE_H
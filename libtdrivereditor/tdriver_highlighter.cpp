@@ -26,6 +26,10 @@
 #include <QFont>
 #include <QStringList>
 #include <QFile>
+#include <QTimer>
+#include <QTime>
+#include <QTextDocument>
+#include <QCoreApplication>
 
 #include "tdriver_editor_common.h"
 
@@ -38,8 +42,11 @@ TDriverHighlighter::TDriverHighlighter(QTextDocument *parent) :
         keywordFormat(new QTextCharFormat),
         singleQuotationFormat(new QTextCharFormat),
         doubleQuotationFormat(new QTextCharFormat),
-        ruleListList()
+        ruleListList(),
+        idleTimer(new QTimer(this))
 {
+    idleTimer->setInterval(0);
+    connect(idleTimer, SIGNAL(timeout()), SLOT(highlightIdleSlice()));
 
     // setup formats
     // this is used to detect if a given char is formatted with defaultFormat or not
@@ -60,9 +67,7 @@ TDriverHighlighter::TDriverHighlighter(QTextDocument *parent) :
 
         rule2 = new HighlightingRule2(this);
         rule2->matchPat = new QRegExp("\"");
-        // endPat matches " at the beginning, or preceded by even number of backslashes
-        // requires endCaretMode QRegExp::CaretAtOffset
-        rule2->endPat = new QRegExp("(^\\\"|[^\\\\](\\\\\\\\)*\\\")");
+        rule2->endChar = '"';
         rule2->format = doubleQuotationFormat;
         //qDebug() << FFL << rule2->matchPat->pattern();
         rules.append(rule2);
@@ -70,9 +75,7 @@ TDriverHighlighter::TDriverHighlighter(QTextDocument *parent) :
 
         rule2 = new HighlightingRule2(this);
         rule2->matchPat = new QRegExp("'");
-        // endPat matches ' at the beginning, or preceded by even number of backslashes
-        // requires endCaretMode QRegExp::CaretAtOffset
-        rule2->endPat = new QRegExp("(^\\'|[^\\\\](\\\\\\\\)*\\')");
+        rule2->endChar = '\'';
         rule2->format = singleQuotationFormat;
         //qDebug() << FFL << rule2->matchPat->pattern();
         rules.append(rule2);
@@ -96,18 +99,94 @@ int TDriverHighlighter::readPlainStrings(
         return -1;
     }
 
+    // words of all files given the same rule list are matched by one rule
+    HighlightingRuleWords *wordsRule = (!rules.isEmpty() && rules.last()->type() == 3)
+            ? static_cast<HighlightingRuleWords *>(const_cast<HighlightingRuleBase *>(rules.last()))
+            : NULL;
+    if (!wordsRule) {
+        wordsRule = new HighlightingRuleWords(this);
+        rules.append(wordsRule);
+    }
+
     int count = 0;
     foreach (QString word, keywords) {
-        HighlightingRule1 *rule1 = new HighlightingRule1(this);
-        rule1->matchPat = new QRegExp(word.trimmed().prepend("\\b").append("\\b"));
-        rule1->format = format;
-        rules.append(rule1);
+        word = word.trimmed();
+        if (word.isEmpty()) continue;
+        wordsRule->addWord(word, format);
         ++count;
     }
     return count;
 }
 
 
+void TDriverHighlighter::rehighlightLazily(const QTextBlock &first, const QTextBlock &last)
+{
+    if (!document()) return;
+
+    // setDocument queues a full rehighlight as a queued call, idle slices replace it
+    QCoreApplication::removePostedEvents(this, QEvent::MetaCall);
+
+    if (first.document() == document()) {
+        for (QTextBlock block = first; block.isValid() && block.blockNumber() <= last.blockNumber(); block = block.next()) {
+            rehighlightBlock(block);
+        }
+    }
+
+    idleCursor = QTextCursor(document());
+    idleTimer->start();
+}
+
+
+void TDriverHighlighter::highlightNow(const QTextBlock &first, const QTextBlock &last)
+{
+    if (!isHighlightingLazily() || first.document() != document()) return;
+
+    const int idlePosition = idleCursor.position();
+    for (QTextBlock block = first; block.isValid() && block.blockNumber() <= last.blockNumber(); block = block.next()) {
+        if (block.position() >= idlePosition) rehighlightBlock(block);
+    }
+}
+
+
+bool TDriverHighlighter::isHighlightingLazily() const
+{
+    return idleTimer->isActive() && document() && idleCursor.document() == document();
+}
+
+
+void TDriverHighlighter::highlightIdleSlice()
+{
+    // one slice takes a fraction of a frame, so editing and scrolling stay smooth
+    static const int sliceMs = 8;
+
+    if (!isHighlightingLazily()) {
+        // document was changed or removed
+        idleTimer->stop();
+        idleCursor = QTextCursor();
+        return;
+    }
+
+    QTime sliceTime;
+    sliceTime.start();
+
+    // rehighlightBlock continues to next blocks as long as block state changes
+    QTextBlock block = idleCursor.block();
+    while (block.isValid() && sliceTime.elapsed() < sliceMs) {
+        rehighlightBlock(block);
+        block = block.next();
+    }
+
+    if (block.isValid()) {
+        // cursor keeps its place if document is edited between slices
+        idleCursor.setPosition(block.position());
+    }
+    else {
+        idleTimer->stop();
+        idleCursor = QTextCursor();
+    }
+}
+
+
 void TDriverHighlighter::highlightBlock(const QString &text)
 {
     int startIndex = 0;
@@ -141,14 +220,13 @@ void TDriverHighlighter::highlightBlock(const QString &text)
             int index = startIndex;
 
             forever {
-                index = rule->matchPat->indexIn(text, index, rule->matchCaretMode);
+                // this length value applies if rule coveres all of text to be highlighted
+                int length = 0;
+                index = rule->match(text, index, length);
 
                 // break if no match
                 if (index == -1) break; // continue inner foreach to next rule
 
-                // this length value applies if rule coveres all of text to be highlighted
-                int length = rule->matchPat->matchedLength();
-
                 //qDebug() << FFL << index << length;
 
                 // skip this match if position already formatted
@@ -194,6 +272,14 @@ TDriverHighlighter::HighlightingRuleBase::HighlightingRuleBase(TDriverHighlighte
     castowner->stateRulePtrs.append(this);
 }
 
+int TDriverHighlighter::HighlightingRuleBase::match(const QString &text, int from, int &length) const
+{
+    int index = matchPat->indexIn(text, from, matchCaretMode);
+    length = matchPat->matchedLength();
+    return index;
+}
+
+
 void TDriverHighlighter::HighlightingRuleBase::postMatch (
         const QString &,
         int &startInd,
@@ -210,15 +296,41 @@ void TDriverHighlighter::HighlightingRuleBase::postMatch (
 TDriverHighlighter::HighlightingRule2::HighlightingRule2(TDriverHighlighter *owner_)  :
         HighlightingRuleBase(owner_),
         endPat(NULL),
-        endCaretMode(QRegExp::CaretAtOffset)
+        endCaretMode(QRegExp::CaretAtOffset),
+        endChar(0)
+{
+}
+
+
+int TDriverHighlighter::HighlightingRule2::findEnd(const QString &text, int from, int &length) const
 {
+    if (endChar.isNull()) {
+        int index = endPat->indexIn(text, from, endCaretMode);
+        length = endPat->matchedLength();
+        return index;
+    }
+
+    // scanned in one pass, backslash escapes next character
+    const int textLength = text.length();
+    const QChar *data = text.constData();
+    for (int index = from; index < textLength; ++index) {
+        if (data[index] == QLatin1Char('\\')) {
+            ++index;
+        }
+        else if (data[index] == endChar) {
+            length = 1;
+            return index;
+        }
+    }
+    return -1;
 }
 
 
 int TDriverHighlighter::HighlightingRule2::handlePreviousState(const QString &text) const
 {
     TDriverHighlighter *castowner = const_cast<TDriverHighlighter *>(owner);
-    int startIndex = endPat->indexIn(text, 0, endCaretMode);
+    int endLength = 0;
+    int startIndex = findEnd(text, 0, endLength);
 
     if (startIndex == -1) {
         castowner->setFormat(0, text.length(), *format);
@@ -226,7 +338,7 @@ int TDriverHighlighter::HighlightingRule2::handlePreviousState(const QString &te
          //qDebug() << FFL << "full line formatted, block state continuation" << castowner->previousBlockState();
     }
     else {
-        startIndex += endPat->matchedLength();
+        startIndex += endLength;
         castowner->setFormat(0, startIndex, *format);
         //qDebug() << FFL << "formated until pos" << startIndex;
     }
@@ -241,7 +353,8 @@ void TDriverHighlighter::HighlightingRule2::postMatch (
         int &formatLen ) const
 {
     TDriverHighlighter *castowner = const_cast<TDriverHighlighter *>(owner);
-    int endIndex = endPat->indexIn(text, startInd+formatLen, endCaretMode);
+    int endLength = 0;
+    int endIndex = findEnd(text, startInd+formatLen, endLength);
     //qDebug() << FFL << text << " " << startInd << " " << formatLen << " " << endIndex;
 
     if (endIndex == -1) {
@@ -253,7 +366,7 @@ void TDriverHighlighter::HighlightingRule2::postMatch (
     }
     else {
         // set formatLen to cover start and end patters (including text between)
-        formatLen = endIndex - startInd + endPat->matchedLength();
+        formatLen = endIndex - startInd + endLength;
 
         // RESET remaining block before setting new rule format
         // Higher priority rules format has been already applied but not closed if current block state is not -1.
@@ -270,3 +383,82 @@ void TDriverHighlighter::HighlightingRule2::postMatch (
 
     castowner->setFormat(startInd, formatLen, *format);
 }
+
+
+//
+// member functions of HighlightingRuleWords
+
+TDriverHighlighter::HighlightingRuleWords::HighlightingRuleWords(TDriverHighlighter *owner_)  :
+        HighlightingRuleBase(owner_),
+        matchedFormat(NULL)
+{
+    wordFormats.append(NULL); // root
+}
+
+
+void TDriverHighlighter::HighlightingRuleWords::addWord(const QString &word, const QTextCharFormat *wordFormat)
+{
+    int node = 0;
+    foreach (QChar ch, word) {
+        const quint64 key = transitionKey(node, ch);
+        int next = transitions.value(key, 0);
+        if (next == 0) {
+            next = wordFormats.size();
+            wordFormats.append(NULL);
+            transitions.insert(key, next);
+        }
+        node = next;
+    }
+    wordFormats[node] = wordFormat;
+}
+
+
+static inline bool isWordChar(QChar ch)
+{
+    // same as \w of QRegExp
+    return ch.isLetterOrNumber() || ch.isMark() || ch == QLatin1Char('_');
+}
+
+
+int TDriverHighlighter::HighlightingRuleWords::match(const QString &text, int from, int &length) const
+{
+    const int textLength = text.length();
+    const QChar *data = text.constData();
+
+    for (int index = from; index < textLength; ++index) {
+        // words start only at word boundary
+        if (index > 0 && isWordChar(data[index-1])) continue;
+
+        int node = 0;
+        int matchLength = 0;
+        for (int pos = index; pos < textLength; ++pos) {
+            node = transitions.value(transitionKey(node, data[pos]), 0);
+            if (node == 0) break;
+
+            // word ending with word character must also end at word boundary
+            if (wordFormats.at(node)
+                    && (!isWordChar(data[pos]) || pos+1 == textLength || !isWordChar(data[pos+1]))) {
+                matchLength = pos + 1 - index;
+                matchedFormat = wordFormats.at(node);
+            }
+        }
+
+        if (matchLength > 0) {
+            length = matchLength;
+            return index;
+        }
+    }
+
+    length = 0;
+    return -1;
+}
+
+
+void TDriverHighlighter::HighlightingRuleWords::postMatch (
+        const QString &,
+        int &startInd,
+        int &formatLen ) const
+{
+    TDriverHighlighter *castowner = const_cast<TDriverHighlighter *>(owner);
+    castowner->setFormat(startInd, formatLen, *matchedFormat);
+}
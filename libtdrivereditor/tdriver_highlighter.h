@@ -24,11 +24,17 @@
 #include "libtdrivereditor_global.h"
 
 #include <QSyntaxHighlighter>
+#include <QTextBlock>
+#include <QTextCursor>
 
 class QString;
 class QTextCharFormat;
+class QTimer;
 
 #include <QList>
+#include <QHash>
+#include <QVector>
+#include <QChar>
 
 class LIBTDRIVEREDITORSHARED_EXPORT TDriverHighlighter : public QSyntaxHighlighter
 {
@@ -55,11 +61,14 @@ protected:
             qWarning("TDriverHighlighter::HighlightingRuleBase::handlePreviousState called!");
             return 0;
         }
+        // match: finds next match at or after from, returns its index and sets length, or returns -1
+        virtual int match(const QString &text, int from, int &length) const;
         // postMatch: called when rule matched
         // returns new currentBlockState >= -1, or -2 for no change in state
         virtual void postMatch(const QString &text, int &startInd, int &formatLen) const;
 
         HighlightingRuleBase(TDriverHighlighter *owner);
+        virtual ~HighlightingRuleBase() {}
     };
 
 
@@ -80,24 +89,62 @@ protected:
         virtual int type() const { return 2; };
         QRegExp *endPat;
         QRegExp::CaretMode endCaretMode;
+        // if set, rule ends at first endChar not escaped with backslash, and endPat is not used
+        QChar endChar;
         // handlePreviousState: overloaded
         virtual int handlePreviousState(const QString &text) const;
         // postMatch: overloaded
         virtual void postMatch(const QString &text, int &startInd, int &formatLen) const;
         HighlightingRule2(TDriverHighlighter *owner);
+    private:
+        int findEnd(const QString &text, int from, int &length) const;
+    };
+
+
+    // Class for word list entries, all words are matched in one pass over text
+    class HighlightingRuleWords: public HighlightingRuleBase
+    {
+    public:
+        virtual int type() const { return 3; };
+        // later added word replaces format of same word
+        void addWord(const QString &word, const QTextCharFormat *wordFormat);
+        // match: overloaded, finds longest word starting at word boundary and ending at one
+        virtual int match(const QString &text, int from, int &length) const;
+        // postMatch: overloaded, uses format of matched word
+        virtual void postMatch(const QString &text, int &startInd, int &formatLen) const;
+        HighlightingRuleWords(TDriverHighlighter *owner);
+    private:
+        // words form a trie, node 0 is root, and transitions are keyed by node and character
+        static quint64 transitionKey(int node, QChar ch) { return (quint64(node) << 16) | ch.unicode(); }
+        QHash<quint64, int> transitions;
+        QVector<const QTextCharFormat *> wordFormats; // format of word ending at node, or NULL
+        mutable const QTextCharFormat *matchedFormat;
     };
 
 
 public:
     explicit TDriverHighlighter(QTextDocument *parent=NULL);
 
-    // returns -1 for file error, -2 for parse error, >=0 for number of rules added
+    // words are added to a single word list rule at end of rules,
+    // returns -1 for file error, -2 for parse error, >=0 for number of words added
     int readPlainStrings(const QString &file, const QTextCharFormat *format,
                             QList<const HighlightingRuleBase*> &rules);
 
+    // Formats blocks first ... last of document right away, and rest of document in short
+    // slices when event loop is idle. Blocks use states stored by earlier highlighting,
+    // and following blocks are formatted again by slices if their states turn out wrong.
+    void rehighlightLazily(const QTextBlock &first, const QTextBlock &last);
+    // formats blocks first ... last now, if idle slices haven't formatted them yet
+    void highlightNow(const QTextBlock &first, const QTextBlock &last);
+    bool isHighlightingLazily() const;
+
 protected:
     virtual void highlightBlock(const QString &);
 
+private slots:
+    void highlightIdleSlice();
+
+protected:
     // standard Formats, optionally modified in derived classes
     QTextCharFormat *defaultFormat; // has special meaning
     QTextCharFormat *keywordFormat;
@@ -109,6 +156,10 @@ protected:
 
     QList<HighlightingRuleBase*> stateRulePtrs;
     QList< QList<const HighlightingRuleBase*> > ruleListList;
+
+private:
+    QTimer *idleTimer;
+    QTextCursor idleCursor; // start of next block to be formatted by idle slices
 };
 
 #endif // TDRIVER_HIGHLIGHTER_H
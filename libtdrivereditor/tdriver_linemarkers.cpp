@@ -0,0 +1,162 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#include "tdriver_linemarkers.h"
+
+#include <QTextDocument>
+
+
+/*!
+    \class TDriverLineMarkers
+    \brief Line markers of a code editor, such as breakpoints and running line.
+
+    Each marker is anchored with a text cursor to the start of its block, so
+    document edits move markers with their lines without any bookkeeping, and
+    markers keep the order of their positions. Lines are looked up by binary
+    search over anchor positions, so finding markers of a line costs O(log n).
+    A marker of a removed line moves to the line where the removal started.
+ */
+
+
+TDriverLineMarkers::TDriverLineMarkers(QTextDocument *document) :
+    doc(document)
+{
+}
+
+
+MEC::Breakpoint TDriverLineMarkers::breakpoint(int index) const
+{
+    MEC::Breakpoint bp = markers.at(index).bp;
+    bp.line = line(index);
+    return bp;
+}
+
+
+int TDriverLineMarkers::lowerBoundPos(int pos) const
+{
+    int start = 0;
+    int end = markers.size();
+
+    while (start < end) {
+        const int mid = (start+end)/2;
+        if (markers.at(mid).anchor.position() < pos) start = mid+1;
+        else end = mid;
+    }
+    return start;
+}
+
+
+int TDriverLineMarkers::lowerBound(int line) const
+{
+    if (line < 1) return 0;
+    if (line > doc->blockCount()) return markers.size();
+    return lowerBoundPos(doc->findBlockByNumber(line-1).position());
+}
+
+
+int TDriverLineMarkers::find(int line, int types) const
+{
+    if (line < 1 || line > doc->blockCount()) return -1;
+
+    const QTextBlock block = doc->findBlockByNumber(line-1);
+    const int endPos = block.position() + block.length();
+
+    for (int ind = lowerBoundPos(block.position()); ind < markers.size(); ++ind) {
+        if (markers.at(ind).anchor.position() >= endPos) break;
+        if (markers.at(ind).type & types) return ind;
+    }
+    return -1;
+}
+
+
+int TDriverLineMarkers::findFirst(int types) const
+{
+    for (int ind = 0; ind < markers.size(); ++ind) {
+        if (markers.at(ind).type & types) return ind;
+    }
+    return -1;
+}
+
+
+int TDriverLineMarkers::typesAt(int line) const
+{
+    if (line < 1 || line > doc->blockCount()) return 0;
+
+    const QTextBlock block = doc->findBlockByNumber(line-1);
+    const int endPos = block.position() + block.length();
+    int types = 0;
+
+    for (int ind = lowerBoundPos(block.position()); ind < markers.size(); ++ind) {
+        if (markers.at(ind).anchor.position() >= endPos) break;
+        types |= markers.at(ind).type;
+    }
+    return types;
+}
+
+
+int TDriverLineMarkers::insert(int line, MarkerType type, const MEC::Breakpoint &bp)
+{
+    Q_ASSERT(line >= 1 && line <= doc->blockCount());
+
+    const QTextBlock block = doc->findBlockByNumber(line-1);
+    const int endPos = block.position() + block.length();
+
+    // after existing markers of same line
+    int ind = lowerBoundPos(block.position());
+    while (ind < markers.size() && markers.at(ind).anchor.position() < endPos) ++ind;
+
+    Marker marker;
+    marker.anchor = QTextCursor(block);
+    marker.type = type;
+    marker.bp = bp;
+    markers.insert(ind, marker);
+    return ind;
+}
+
+
+void TDriverLineMarkers::removeAll(int types)
+{
+    int ind = 0;
+    while (ind < markers.size()) {
+        if (markers.at(ind).type & types) markers.removeAt(ind);
+        else ++ind;
+    }
+}
+
+
+QList<int> TDriverLineMarkers::lines() const
+{
+    QList<int> result;
+    for (int ind = 0; ind < markers.size(); ++ind) result << line(ind);
+    return result;
+}
+
+
+void TDriverLineMarkers::reanchor(const QList<int> &lines)
+{
+    Q_ASSERT(lines.size() == markers.size());
+
+    // lines are in marker order, so clamping them keeps markers ordered
+    for (int ind = 0; ind < markers.size() && ind < lines.size(); ++ind) {
+        const int line = qBound(1, lines.at(ind), doc->blockCount());
+        markers[ind].anchor = QTextCursor(doc->findBlockByNumber(line-1));
+    }
+}
@@ -0,0 +1,85 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#ifndef TDRIVER_LINEMARKERS_H
+#define TDRIVER_LINEMARKERS_H
+
+#include "libtdrivereditor_global.h"
+#include "tdriver_editor_common.h"
+
+#include <QList>
+#include <QTextCursor>
+#include <QTextBlock>
+
+class QTextDocument;
+
+
+class LIBTDRIVEREDITORSHARED_EXPORT TDriverLineMarkers
+{
+public:
+    enum MarkerType {
+        BreakpointMarker = 0x01,
+        RunningLineMarker = 0x02,
+        ErrorMarker = 0x04,
+        CoverageMarker = 0x08,
+        AnyMarker = 0xff
+    };
+
+    explicit TDriverLineMarkers(QTextDocument *document);
+
+    // Note: valid line numbers are 1 .. document.blockCount, indexes are 0 .. count-1 in line order
+    int count() const { return markers.size(); }
+    MarkerType type(int index) const { return markers.at(index).type; }
+    QTextBlock block(int index) const { return markers.at(index).anchor.block(); }
+    int line(int index) const { return markers.at(index).anchor.blockNumber() + 1; }
+
+    // breakpoint data of BreakpointMarker, line field is updated from current marker position
+    MEC::Breakpoint breakpoint(int index) const;
+    void setBreakpointNum(int index, int num) { markers[index].bp.num = num; }
+
+    int lowerBound(int line) const; // index of first marker at or after line
+    int find(int line, int types = AnyMarker) const; // index of first matching marker at line, or -1
+    int findFirst(int types) const; // index of first matching marker in document, or -1
+    int typesAt(int line) const;
+
+    int insert(int line, MarkerType type, const MEC::Breakpoint &bp = MEC::Breakpoint());
+    void removeAt(int index) { markers.removeAt(index); }
+    void removeAll(int types);
+
+    // replacing whole text would move all anchors to one position, so lines
+    // are saved before it and markers are anchored to them again after it
+    QList<int> lines() const;
+    void reanchor(const QList<int> &lines); // lines past end of document go to last line
+
+private:
+    struct Marker {
+        QTextCursor anchor; // at start of marked block, moves with edits made before it
+        MarkerType type;
+        MEC::Breakpoint bp;
+    };
+
+    int lowerBoundPos(int pos) const;
+
+    QTextDocument *doc;
+    QList<Marker> markers; // ordered by anchor position, edits never change the order
+};
+
+#endif // TDRIVER_LINEMARKERS_H
@@ -0,0 +1,254 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#include "tdriver_rdebugparser.h"
+
+#include <tdriver_debug_macros.h>
+
+
+/*!
+    \class TDriverRdebugParser
+    \brief Incremental parser for output of rdebug remote connection.
+
+    Received bytes are appended to a buffer which is scanned only from the end
+    of the previous complete line, so partial lines cost nothing until they are
+    finished. Lines of annotated sections (stack, variables, breakpoints,
+    error-begin) are parsed into records as they arrive, and records of a stop
+    are handed out when prompt is received. Raw bytes are kept in records and
+    decoded to text only when displayed.
+ */
+
+
+static const char rdebugDelim[] = "\x1a\x1a";
+static const int rdebugDelimLen = 2;
+
+
+TDriverRdebugParser::TDriverRdebugParser() :
+    scanPos(0),
+    newlinePos(0),
+    sectionLineCount(0)
+{
+}
+
+
+void TDriverRdebugParser::reset()
+{
+    buffer.clear();
+    scanPos = 0;
+    newlinePos = 0;
+    currentSection.clear();
+    sectionLineCount = 0;
+    stop = TDriverRdebugStop();
+    finishedStop = TDriverRdebugStop();
+}
+
+
+void TDriverRdebugParser::append(const QByteArray &data)
+{
+    if (scanPos > 0 && scanPos == buffer.size()) {
+        // everything consumed, start over without moving bytes
+        buffer.clear();
+        scanPos = 0;
+        newlinePos = 0;
+    }
+    buffer.append(data);
+}
+
+
+TDriverRdebugStop TDriverRdebugParser::takeStop()
+{
+    TDriverRdebugStop result(finishedStop);
+    finishedStop = TDriverRdebugStop();
+    return result;
+}
+
+
+bool TDriverRdebugParser::readLine(LineType &type, QByteArray &line)
+{
+    // partial line is not searched again for every appended chunk
+    const int end = buffer.indexOf('\n', qMax(scanPos, newlinePos));
+    if (end < 0) {
+        // keep only the partial line
+        if (scanPos > 0) {
+            buffer.remove(0, scanPos);
+            scanPos = 0;
+        }
+        newlinePos = buffer.size();
+        return false;
+    }
+
+    int len = end - scanPos;
+    if (len > 0 && buffer.at(end-1) == '\r') --len;
+    line = buffer.mid(scanPos, len);
+    scanPos = end + 1;
+
+    static const QByteArray promptLine(QByteArray(rdebugDelim) + "prompt");
+    static const QByteArray prePromptLine(QByteArray("PROMPT ") + rdebugDelim + "pre-prompt");
+
+    // handle "PROMPT ..pre-prompt" line so it won't be displayed as application output
+    if (line == prePromptLine) {
+        line.remove(0, 7);
+    }
+
+    if (line.startsWith(rdebugDelim)) {
+        if (line == promptLine) {
+            type = PromptLine;
+            finishedStop = stop;
+            stop = TDriverRdebugStop();
+            currentSection.clear();
+        }
+        else {
+            type = SectionLine;
+            currentSection = line.mid(rdebugDelimLen).trimmed();
+            sectionLineCount = 0;
+
+            if (currentSection == "breakpoints") {
+                stop.breakpoints.clear();
+            }
+            // "starting" means script is running and rdebug remote will not be responsive
+            else if (currentSection == "starting") {
+                stop = TDriverRdebugStop();
+            }
+        }
+    }
+    else if (!currentSection.isEmpty()) {
+        type = DataLine;
+        addDataLine(line);
+    }
+    else {
+        type = OutputLine;
+    }
+
+    return true;
+}
+
+
+void TDriverRdebugParser::addDataLine(const QByteArray &rawLine)
+{
+    const QByteArray line = rawLine.trimmed();
+    ++sectionLineCount;
+
+    if (currentSection == "stack") {
+        static const QByteArray atLine("at line ");
+
+        if (line.startsWith(atLine) && !stop.stack.isEmpty() && stop.stack.last().file.isEmpty()) {
+            // 2-line format, location of previous frame
+            TDriverRdebugFrame &frame = stop.stack.last();
+            const QByteArray entry = line.mid(atLine.size());
+            const int colonInd = entry.lastIndexOf(':');
+            bool ok = false;
+            if (colonInd > 0) frame.lineNum = entry.mid(colonInd+1).toInt(&ok);
+            if (ok) frame.file = entry.left(colonInd);
+            frame.text.append(' ').append(line);
+            return;
+        }
+
+        TDriverRdebugFrame frame;
+        frame.text = line;
+        frame.current = line.startsWith("-->");
+
+        const int hashInd = line.indexOf('#');
+        if (hashInd >= 0) {
+            int numEnd = hashInd + 1;
+            while (numEnd < line.size() && line.at(numEnd) >= '0' && line.at(numEnd) <= '9') ++numEnd;
+            bool ok = false;
+            frame.level = line.mid(hashInd+1, numEnd-hashInd-1).toInt(&ok);
+            if (!ok) frame.level = -1;
+
+            // 1-line format
+            const int atInd = line.indexOf(atLine, numEnd);
+            if (atInd >= 0) {
+                const QByteArray entry = line.mid(atInd + atLine.size());
+                const int colonInd = entry.lastIndexOf(':');
+                if (colonInd > 0) frame.lineNum = entry.mid(colonInd+1).toInt(&ok);
+                if (colonInd > 0 && ok) frame.file = entry.left(colonInd);
+            }
+        }
+        stop.stack.append(frame);
+    }
+
+    else if (currentSection == "variables") {
+        TDriverRdebugVariable var;
+        const int arrowInd = line.indexOf(" => ");
+        if (arrowInd < 0) {
+            var.name = line;
+        }
+        else {
+            var.name = line.left(arrowInd);
+            var.value = line.mid(arrowInd + 4);
+        }
+        stop.variables.append(var);
+    }
+
+    else if (currentSection == "breakpoints") {
+        if (sectionLineCount == 1) {
+            // header line
+            if (line != "Num Enb What" && line != "No breakpoints.") {
+                qWarning() << FFL << "UNEXPECTED OUTPUT FROM rdebug, PLEASE REPORT A TICKET";
+                qDebug() << FFL << "breakpoint list header:" << line;
+            }
+            return;
+        }
+        struct MEC::Breakpoint bp;
+        if (parseBreakpoint(line, bp)) stop.breakpoints.append(bp);
+        else qWarning() << FFL << "Invalid breakpoint line ignored:" << line;
+    }
+
+    else if (currentSection == "error-begin") {
+        stop.errors.append(line);
+    }
+}
+
+
+// parses breakpoint line "<num> <y|n> at <file>:<line>"
+bool TDriverRdebugParser::parseBreakpoint(const QByteArray &line, struct MEC::Breakpoint &bp)
+{
+    const int size = line.size();
+    int pos = 0;
+
+    while (pos < size && line.at(pos) >= '0' && line.at(pos) <= '9') ++pos;
+    if (pos == 0) return false;
+    bool ok = false;
+    const int num = line.left(pos).toInt(&ok);
+    if (!ok) return false;
+
+    if (pos >= size || line.at(pos) != ' ') return false;
+    while (pos < size && line.at(pos) == ' ') ++pos;
+
+    if (pos >= size || (line.at(pos) != 'y' && line.at(pos) != 'n')) return false;
+    const bool enabled = (line.at(pos) == 'y');
+    ++pos;
+
+    if (pos >= size || line.at(pos) != ' ') return false;
+    while (pos < size && line.at(pos) == ' ') ++pos;
+
+    if (line.mid(pos, 3) != "at ") return false;
+    pos += 3;
+    while (pos < size && line.at(pos) == ' ') ++pos;
+
+    const int colonInd = line.lastIndexOf(':');
+    if (colonInd <= pos) return false;
+    const int lineNum = line.mid(colonInd+1).toInt(&ok);
+    if (!ok) return false;
+
+    bp = MEC::Breakpoint(num, enabled, QString::fromLocal8Bit(line.mid(pos, colonInd-pos)), lineNum);
+    return true;
+}
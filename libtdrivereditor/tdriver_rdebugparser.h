@@ -0,0 +1,92 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#ifndef TDRIVER_RDEBUGPARSER_H
+#define TDRIVER_RDEBUGPARSER_H
+
+#include "libtdrivereditor_global.h"
+#include "tdriver_editor_common.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+
+// one line of rdebug "stack" section, raw text is decoded only when displayed
+struct TDriverRdebugFrame {
+    TDriverRdebugFrame() : level(-1), current(false), lineNum(0) {}
+    QString displayText() const { return QString::fromLocal8Bit(text); }
+
+    int level;
+    bool current; // frame marked with "-->"
+    QByteArray text;
+    QByteArray file; // from "at line file:num", empty if location was not given
+    int lineNum;
+};
+
+// one line of rdebug "variables" section, name => value
+struct TDriverRdebugVariable {
+    QByteArray name;
+    QByteArray value;
+};
+
+// records of sections received between two rdebug prompts
+struct TDriverRdebugStop {
+    QList<TDriverRdebugFrame> stack;
+    QList<TDriverRdebugVariable> variables;
+    QList<struct MEC::Breakpoint> breakpoints;
+    QList<QByteArray> errors;
+};
+
+
+class LIBTDRIVEREDITORSHARED_EXPORT TDriverRdebugParser
+{
+public:
+    enum LineType { OutputLine, SectionLine, DataLine, PromptLine };
+
+    TDriverRdebugParser();
+
+    void reset();
+    void append(const QByteArray &data);
+
+    // returns false when there are no complete lines left,
+    // after PromptLine records of finished stop are available with takeStop
+    bool readLine(LineType &type, QByteArray &line);
+
+    const QByteArray &section() const { return currentSection; }
+    TDriverRdebugStop takeStop();
+
+    static bool parseBreakpoint(const QByteArray &line, struct MEC::Breakpoint &bp);
+
+private:
+    void addDataLine(const QByteArray &line);
+
+    QByteArray buffer;
+    int scanPos; // start of first unread line in buffer
+    int newlinePos; // buffer before this has no newline after scanPos
+
+    QByteArray currentSection;
+    int sectionLineCount;
+    TDriverRdebugStop stop;
+    TDriverRdebugStop finishedStop;
+};
+
+#endif // TDRIVER_RDEBUGPARSER_H
@@ -72,8 +72,8 @@ TDriverRubyHighlighter::TDriverRubyHighlighter(QTextDocument *parent) :
     ruleListList.prepend(rules);
     rules.clear();
 
-    // ruby %-expressions, partial and inefficient implementation,
-    // TODO: matchPat should be something like %([qQwW])(.) and change endPat dynamically
+    // ruby %-expressions, partial implementation,
+    // TODO: matchPat should be something like %([qQwW])(.) and change endChar dynamically
     // TODO: probably need to create a new rule for this
     {
         HighlightingRule2 *rule2;
@@ -81,37 +81,37 @@ TDriverRubyHighlighter::TDriverRubyHighlighter(QTextDocument *parent) :
         rule2 = new HighlightingRule2(this);
         rule2->format = singleQuotationFormat;
         rule2->matchPat = new QRegExp("%q\\[");
-        rule2->endPat = new QRegExp("(^'|[^\\\\](\\\\\\\\)*\\])");
+        rule2->endChar = ']';
         rules.append(rule2);
 
         rule2 = new HighlightingRule2(this);
         rule2->format = singleQuotationFormat;
         rule2->matchPat = new QRegExp("%q\\{");
-        rule2->endPat = new QRegExp("(^'|[^\\\\](\\\\\\\\)*\\})");
+        rule2->endChar = '}';
         rules.append(rule2);
 
         rule2 = new HighlightingRule2(this);
         rule2->format = singleQuotationFormat;
         rule2->matchPat = new QRegExp("%q\\(");
-        rule2->endPat = new QRegExp("(^'|[^\\\\](\\\\\\\\)*\\)");
+        rule2->endChar = ')';
         rules.append(rule2);
 
         rule2 = new HighlightingRule2(this);
         rule2->format = doubleQuotationFormat;
         rule2->matchPat = new QRegExp("%Q\\[");
-        rule2->endPat = new QRegExp("(^'|[^\\\\](\\\\\\\\)*\\])");
+        rule2->endChar = ']';
         rules.append(rule2);
 
         rule2 = new HighlightingRule2(this);
         rule2->format = doubleQuotationFormat;
         rule2->matchPat = new QRegExp("%Q\\{");
-        rule2->endPat = new QRegExp("(^'|[^\\\\](\\\\\\\\)*\\})");
+        rule2->endChar = '}';
         rules.append(rule2);
 
         rule2 = new HighlightingRule2(this);
         rule2->format = doubleQuotationFormat;
         rule2->matchPat = new QRegExp("%Q\\(");
-        rule2->endPat = new QRegExp("(^'|[^\\\\](\\\\\\\\)*\\)");
+        rule2->endChar = ')';
         rules.append(rule2);
     }
     // append to list that comes from parent class
@@ -41,7 +41,6 @@ TDriverRubyInteract::TDriverRubyInteract(QWidget *parent) :
   , restartAct(NULL)
   , stdoutFormat(new QTextCharFormat)
   , stderrFormat(new QTextCharFormat)
-  , prevSeqNum(0)
 {
     stdoutFormat->setForeground(QBrush(Qt::darkGray));
     stdoutFormat->setFontFixedPitch(true);
@@ -61,26 +60,26 @@ TDriverRubyInteract::TDriverRubyInteract(QWidget *parent) :
 
     connect(TDriverRubyInterface::globalInstance(), SIGNAL(rubyOutput(int, quint32,QByteArray)),
             this, SLOT(rbiText(int, quint32,QByteArray)));
-
-    connect(TDriverRubyInterface::globalInstance(), SIGNAL(messageReceived(quint32,QByteArray,BAListMap)),
-            this, SLOT(rbiMessage(quint32,QByteArray,BAListMap)));
-
-    // used for progressing in query queue after receiving a reply
-    connect(this, SIGNAL(requestNextQuery()), this, SLOT(sendNextQuery()), Qt::QueuedConnection);
 }
 
 
 void TDriverRubyInteract::resetQueryQueue()
 {
-    while ( !queryQueue.empty() ) {
-        QueryQueueItem query = queryQueue.takeFirst();
+    // clients may send new queries when they get the error
+    const QMap<quint32, PendingQuery> queries(pendingQueries);
+    pendingQueries.clear();
+
+    QMap<quint32, PendingQuery>::const_iterator iter;
+    for (iter = queries.constBegin(); iter != queries.constEnd(); ++iter) {
+        const PendingQuery &query = iter.value();
+        TDriverRubyInterface::globalInstance()->cancelCmd(iter.key());
 
         switch (query.type) {
-        case QueryQueueItem::COMPLETION:
+        case PendingQuery::COMPLETION:
             qDebug() << FCFL << "completionError for statement:" << query.statement;
             emit completionError(query.client, query.statement, QStringList());
             break;
-        case QueryQueueItem::EVALUATION:
+        case PendingQuery::EVALUATION:
             qDebug() << FCFL << "evaluationnError for statement:" << query.statement;
             emit evaluationError(query.client, query.statement, QStringList());
             break;
@@ -112,7 +111,8 @@ void TDriverRubyInteract::resetScript()
     qDebug() << FCFL;
 
     resetQueryQueue();
-    prevSeqNum = 0;
+    finishedSeqNums.clear();
+    emit scriptReset();
 
     BAListMap msg;
     bool ok = TDriverRubyInterface::globalInstance()->executeCmd("interact reset", msg, 5000, "reset");
@@ -177,126 +177,97 @@ void  TDriverRubyInteract::procStarted(void)
 void TDriverRubyInteract::rubyIsOnline()
 {
     qDebug() << FCFL;
+    // restarted process has a new evaluation instance
+    emit scriptReset();
 }
 
 
-bool TDriverRubyInteract::sendNextQuery()
+bool TDriverRubyInteract::sendQuery(PendingQuery::QueryType type, const QByteArray &command, const QByteArray &statement)
 {
-    QString goOnlineError;
+    // completions are abandoned if script is stuck, evaluation may take as long as it takes
+    static const unsigned long completionTimeout = 10000;
 
-    if (queryQueue.isEmpty()) {
-        return true;
-    }
+    PendingQuery query;
+    query.type = type;
+    query.client = sender();
+    query.statement = statement.trimmed();
 
-    else if (!(goOnlineError = TDriverRubyInterface::globalInstance()->goOnline()).isNull()) {
+    BAListMap msg;
+    msg["command"] << command << query.statement;
+    quint32 seqNum = TDriverRubyInterface::globalInstance()->sendCmdAsync(
+                TDriverUtil::interactionId, msg, this, "queryReply",
+                (type == PendingQuery::COMPLETION) ? completionTimeout : 0);
+
+    if (seqNum == 0) {
+        qDebug() << FCFL << ">>>> sendCmdAsync returned failure for" << command << query.statement;
+        if (type == PendingQuery::COMPLETION) emit completionError(query.client, query.statement, QStringList());
+        else emit evaluationError(query.client, query.statement, QStringList());
         return false;
     }
 
-    else {
-        struct QueryQueueItem &query = queryQueue.first();
-
-        if (query.rbiSeqNum == 0) {
-            BAListMap msg;
-            msg["command"] << query.command << query.statement;
-            query.rbiSeqNum = TDriverRubyInterface::globalInstance()->sendCmd(TDriverUtil::interactionId, msg);
-            if (query.rbiSeqNum == 0) {
-                qDebug() <<FCFL << ">>>> sendCmd returned failure, command remains in queryQueue, size" << queryQueue.size();
-                return false;
-            }
-            else {
-                qDebug() <<FCFL << ">>>> sendCmd returned seqnum" << query.rbiSeqNum;
-                return true;
-            }
-        }
-        else {
-            qDebug() << FCFL << "Unable to send command at the moment, with queryQueue size"<< queryQueue.size();
-            return false;
-        }
-    }
+    qDebug() << FCFL << ">>>> sendCmdAsync returned seqnum" << seqNum << ", pending" << pendingQueries.size()+1;
+    pendingQueries.insert(seqNum, query);
+    return true;
 }
 
 
 bool TDriverRubyInteract::queryCompletions(QByteArray statement)
 {
-    struct QueryQueueItem query;
-    query.type = QueryQueueItem::COMPLETION,
-    query.client = sender(),
-    query.rbiSeqNum = 0;
-    query.command = "line_completion",
-    query.statement = statement.trimmed();
-
-    queryQueue.append(query);
-    return sendNextQuery();
+    return sendQuery(PendingQuery::COMPLETION, "line_completion", statement);
 }
 
 
 bool TDriverRubyInteract::evalStatement(QByteArray statement)
 {
-    struct QueryQueueItem query;
-    query.type = QueryQueueItem::EVALUATION,
-    query.client = sender(),
-    query.rbiSeqNum = 0;
-    query.command = "line_execution",
-    query.statement = statement.trimmed();
-
-    queryQueue.append(query);
-    return sendNextQuery();
+    return sendQuery(PendingQuery::EVALUATION, "line_execution", statement);
 }
 
 
-void TDriverRubyInteract::rbiMessage(quint32 seqNum, QByteArray name, BAListMap message)
+void TDriverRubyInteract::queryReply(quint32 seqNum, BAListMap message)
 {
-    //qDebug() << FCFL << "ENTRY for" << seqNum << name;
-    if (queryQueue.isEmpty()) return; // no pending queries
+    //qDebug() << FCFL << "ENTRY for" << seqNum;
+    if (!pendingQueries.contains(seqNum)) return; // query was reset meanwhile
 
-    struct QueryQueueItem &query = queryQueue.first();
+    const PendingQuery query = pendingQueries.take(seqNum);
 
-    if (seqNum < query.rbiSeqNum) return; // ignore
+    finishedSeqNums.append(seqNum);
+    while (finishedSeqNums.size() > 8) finishedSeqNums.removeFirst();
 
-    // after this point, received message affects queryQueue even if it's not for us
+    // only interface itself replies with error, on timeout or when script closed
+    const bool failed = message.contains("error");
+    if (failed) qDebug() << FCFL << "seqNum" << seqNum << message.value("error");
 
-    if (seqNum == query.rbiSeqNum && name == TDriverUtil::interactionId) {
-        // it's for us!
-
-        switch (query.type) {
+    switch (query.type) {
 
-        case QueryQueueItem::COMPLETION:
-            {
-                QStringList completionLines;
-                foreach (QByteArray key, message["result_keys"]) {
-                    foreach(QByteArray line, message[key]) {
-                        completionLines << QString::fromLocal8Bit(line.constData(), line.size());
-                    }
+    case PendingQuery::COMPLETION:
+        if (failed) {
+            emit completionError(query.client, query.statement, QStringList());
+        }
+        else {
+            QStringList completionLines;
+            foreach (QByteArray key, message["result_keys"]) {
+                foreach(QByteArray line, message[key]) {
+                    completionLines << QString::fromLocal8Bit(line.constData(), line.size());
                 }
-                //qDebug() << FCFL << completionLines;
-                emit completionResult(query.client, query.statement, completionLines);
             }
-            break;
-
-        case QueryQueueItem::EVALUATION:
-            //qDebug() << FCFL << "EVALUATION RESULT" << message;
-            //emit evaluationResult(query.client, query.statement, resultLines); // sent by rbiStdoutText/rbiStderrText
-            emit evaluationResult(query.client, query.statement, QStringList()); // sent by rbiStdoutText/rbiStderrText
-            break;
-
+            //qDebug() << FCFL << completionLines;
+            emit completionResult(query.client, query.statement, completionLines);
         }
+        break;
+
+    case PendingQuery::EVALUATION:
+        //qDebug() << FCFL << "EVALUATION RESULT" << message;
+        if (failed) emit evaluationError(query.client, query.statement, QStringList());
+        else emit evaluationResult(query.client, query.statement, QStringList()); // output is shown by rbiText
+        break;
     }
-    else {
-        //qDebug() << FCFL << "name" << name << "with received seqNum" << seqNum << "vs. removed queue seqNum" << query.rbiSeqNum;
-        // NOTE: assert below assumes overlapping queries won't be send, so all except first item in queue have seqNum 0
-        Q_ASSERT(queryQueue.length() < 2 || queryQueue.at(1).rbiSeqNum == 0);
-    }
-    prevSeqNum = query.rbiSeqNum;
-    queryQueue.removeFirst();
-    if (!queryQueue.isEmpty()) emit requestNextQuery();
 }
 
 
 bool TDriverRubyInteract::checkOutputSeqNum(quint32 seqNum)
 {
     if (seqNum == 0) return false;
-    else if (seqNum == prevSeqNum) return true;
-    else return ( !queryQueue.isEmpty() && seqNum == queryQueue.first().rbiSeqNum);
+    else return pendingQueries.contains(seqNum) || finishedSeqNums.contains(seqNum);
 }
 
 
@@ -25,6 +25,7 @@
 
 #include <QWidget>
 #include <QList>
+#include <QMap>
 
 #include "tdriver_runconsole.h"
 
@@ -47,20 +48,20 @@ signals:
     void evaluationResult(QObject *client, QByteArray statement, QStringList result);
     void evaluationError(QObject *client, QByteArray statement, QStringList result);
 
-    void requestNextQuery();
+    // replies received before this came from an earlier evaluation instance
+    void scriptReset();
 
 public slots:
     void resetQueryQueue();
     void resetScript();
     void rubyIsOnline();
-    bool sendNextQuery();
     bool queryCompletions(QByteArray statement);
     bool evalStatement(QByteArray statement);
 
 protected slots:
     virtual void procStarted(void); // interited from RunConsole
 
-    void rbiMessage(quint32 seqNum, QByteArray name, BAListMap message);
+    void queryReply(quint32 seqNum, BAListMap message);
     void rbiText(int fnum, quint32 seqNum, QByteArray text);
 
 protected:
@@ -69,18 +70,18 @@ protected:
     QAction *resetAct;
     QAction *restartAct;
 
-    struct QueryQueueItem {
+    struct PendingQuery {
         enum QueryType { COMPLETION, EVALUATION };
         QueryType type;
         QObject *client;
-        quint32 rbiSeqNum;
-        QByteArray command;
         QByteArray statement;
     };
 
-    QList<struct QueryQueueItem> queryQueue;
+    // queries are sent right away, and all of them may be pending at once
+    QMap<quint32, PendingQuery> pendingQueries;
 
 private:
+    bool sendQuery(PendingQuery::QueryType type, const QByteArray &command, const QByteArray &statement);
     bool checkOutputSeqNum(quint32 seqNum);
 
 private:
@@ -88,7 +89,7 @@ private:
     QTextCharFormat *stdoutFormat;
     QTextCharFormat *stderrFormat;
 
-    quint32 prevSeqNum; // used for accepting STDOUT/STDERR text coming after message text
+    QList<quint32> finishedSeqNums; // used for accepting STDOUT/STDERR text coming after reply message
 };
 
 #endif // TDRIVER_RUBYINTERACT_H
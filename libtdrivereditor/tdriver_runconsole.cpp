@@ -115,7 +115,7 @@ void TDriverRunConsole::createActions()
     clearAct->setObjectName("clear");
     clearAct->setToolTip(tr("Clear contents of buffer"));
     addAction(clearAct);
-    connect(clearAct, SIGNAL(triggered()), console, SLOT(clear()));
+    connect(clearAct, SIGNAL(triggered()), console, SLOT(clearConsole()));
     //clearAct->setEnabled(false);
 
     terminateAct = new QAction(QIcon(":/images/terminate.png"), tr("&Terminate process"), this);
@@ -155,7 +155,7 @@ void TDriverRunConsole::createActions()
 
 void TDriverRunConsole::clear()
 {
-    console->clear();
+    console->clearConsole();
 }
 
 
@@ -18,6 +18,8 @@
 ****************************************************************************/
 
 
+#include <cstring>
+
 #include "tdriver_tabbededitor.h"
 
 #include "tdriver_rubyhighlighter.h"
@@ -28,6 +30,7 @@
 #include "tdriver_editor_common.h"
 #include "tdriver_editbar.h"
 #include "tdriver_combolineedit.h"
+#include "tdriver_completionindex.h"
 
 
 #include <tdriver_executedialog.h>
@@ -57,6 +60,11 @@
 #include <QStackedWidget>
 #include <QShortcut>
 #include <QLineEdit>
+#include <QProgressDialog>
+#include <QTextDecoder>
+#include <QTextEncoder>
+#include <QTextBlock>
+#include <QScopedPointer>
 
 static inline QString strippedName(const QString &fullFileName) {
     return QFileInfo(fullFileName).fileName();
@@ -78,6 +86,7 @@ TDriverTabbedEditor::TDriverTabbedEditor(QWidget *shortcutParent, QWidget *paren
     editBarP(new TDriverEditBar(this)),
     rubyHighlighter(new TDriverRubyHighlighter()),
     plainHighlighter(new TDriverHighlighter()),
+    completionIndex(new TDriverCompletionIndex(this)),
     needRunPreparations(false),
     runConsoleContainer(NULL),
     runConsole(NULL),
@@ -98,6 +107,8 @@ TDriverTabbedEditor::TDriverTabbedEditor(QWidget *shortcutParent, QWidget *paren
         stack->setPalette(pal);
     }
 
+    completionIndex->addDefinitionFiles(TDriverUtil::tdriverHelperFilePath("completions"));
+
     setAcceptDrops(true);
     createActions();
     connect(this, SIGNAL(currentChanged(int)), SLOT(currentChangeAction(int)));
@@ -686,6 +697,7 @@ void TDriverTabbedEditor::newFile(QString fileName)
 
     TDriverCodeTextEdit *newEdit = new TDriverCodeTextEdit(this);
     newEdit->setTranslationDatabase(tdriverParamMap, sutParamMap);
+    newEdit->setCompletionIndex(completionIndex);
     setEditorFontAndTabWidth(newEdit, editorFont);
     newEdit->setFileName(fileName);
     //setEditorDefaultEncoding(newEdit);
@@ -861,6 +873,11 @@ void TDriverTabbedEditor::connectConsoles(TDriverRunConsole *rConsole, QWidget *
     connect(irConsole, SIGNAL(evaluationResult(QObject*,QByteArray,QStringList)),
             editBarP, SLOT(routeAutoRefreshInteractive())); // the slot will emit a signal only if is autorefresh enabled
 
+    // replies to all editors are cached for local completion
+    connect(irConsole, SIGNAL(completionResult(QObject*,QByteArray,QStringList)),
+            completionIndex, SLOT(addReply(QObject*,QByteArray,QStringList)));
+    connect(irConsole, SIGNAL(scriptReset()), completionIndex, SLOT(clearReplies()));
+
     runConsoleContainer->setVisible(runConsoleVisible);
     debugConsoleContainer->setVisible(debugConsoleVisible);
     irConsoleContainer->setVisible(irConsoleVisible);
@@ -927,24 +944,129 @@ void TDriverTabbedEditor::showIrConsole()
 }
 
 
+// Decodes file in chunks, reading it through a memory mapping when possible,
+// so the decoded text is the only full copy of file contents kept in memory.
+// Each chunk is also encoded back and compared to file, to tell if saving will
+// produce identical file. Files without UTF BOM are tried as UTF-8, then with locale codec.
+// Returns false if user cancelled loading.
+bool TDriverTabbedEditor::readFileText(QFile &file, QString &text, QTextCodec *&codec,
+                                       bool &haveBom, bool &encodingTestedOk)
+{
+    static const int chunkSize = 1024*1024;
+    static const qint64 progressSize = 8*chunkSize;
+
+    const qint64 fileSize = file.size();
+    QByteArray readData;
+    const char *data = (fileSize > 0) ? reinterpret_cast<const char *>(file.map(0, fileSize)) : NULL;
+    qint64 dataSize = fileSize;
+    if (!data) {
+        // empty or not mappable
+        readData = file.readAll();
+        data = readData.constData();
+        dataSize = readData.size();
+    }
+
+    QList<QTextCodec *> codecs;
+    codec = QTextCodec::codecForUtfText(QByteArray::fromRawData(data, qMin(dataSize, qint64(16))), NULL);
+    haveBom = (codec != NULL);
+    if (haveBom) {
+        codecs << codec;
+    }
+    else {
+        codecs << QTextCodec::codecForName("UTF-8") << QTextCodec::codecForLocale();
+    }
+
+    QScopedPointer<QProgressDialog> progress;
+    const int chunkCount = int((dataSize + chunkSize - 1) / chunkSize);
+    if (dataSize > progressSize) {
+        progress.reset(new QProgressDialog(tr("Loading file '%1'...").arg(file.fileName()),
+                                           tr("Cancel"), 0, chunkCount, this));
+        progress->setWindowModality(Qt::WindowModal);
+        progress->setMinimumDuration(500);
+    }
+
+    encodingTestedOk = false;
+
+    foreach (QTextCodec *tryCodec, codecs) {
+        codec = tryCodec;
+        QScopedPointer<QTextDecoder> decoder(codec->makeDecoder());
+        QScopedPointer<QTextEncoder> encoder(codec->makeEncoder(QTextCodec::IgnoreHeader));
+
+        // decoder drops BOM, so comparison starts after it
+        qint64 verified = haveBom ? encoder->fromUnicode(QString(QChar(QChar::ByteOrderMark))).size() : 0;
+        encodingTestedOk = true;
+
+        // decoded text never has more characters than file has bytes
+        text.clear();
+        if (dataSize < (1 << 28)) text.reserve(int(dataSize));
+
+        for (int chunk = 0; chunk < chunkCount; ++chunk) {
+            const qint64 pos = qint64(chunk) * chunkSize;
+            const QString decoded(decoder->toUnicode(data + pos, int(qMin(qint64(chunkSize), dataSize - pos))));
+
+            if (encodingTestedOk) {
+                // decoder may keep end of a multibyte character to next chunk,
+                // so encoded chunks are compared at their own position
+                const QByteArray encoded(encoder->fromUnicode(decoded));
+                encodingTestedOk = (verified + encoded.size() <= dataSize
+                                    && memcmp(data + verified, encoded.constData(), encoded.size()) == 0);
+                verified += encoded.size();
+
+                // without BOM there is another codec to try
+                if (!encodingTestedOk && codec != codecs.last()) break;
+            }
+            text.append(decoded);
+
+            if (progress) {
+                progress->setValue(chunk + 1);
+                if (progress->wasCanceled()) return false;
+            }
+        }
+
+        encodingTestedOk = encodingTestedOk && verified == dataSize;
+        if (encodingTestedOk) break;
+        if (codec != codecs.last()) {
+            qDebug() << FCFL << "Encoding back to" << codec->name() << "produced different result, trying next codec";
+        }
+    }
+
+#ifdef Q_OS_WIN
+    // same as reading in QIODevice::Text mode
+    text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+#endif
+    return true;
+}
+
+
 bool TDriverTabbedEditor::loadFile(QString fileName, bool fromTemplate, TDriverCodeTextEdit *replaceIn)
 {
     qDebug() << FFL << fileName;
     bool ret = false;
     QFile file(fileName);
 
+    QString stringData;
+    QTextCodec *codec = NULL;
+    bool haveBom = false;
+    bool encodingTestedOk = false;
+
     if (fileName.isEmpty()) {
         // ignore request to open empty file
     }
 
-    else if (!file.open(QFile::ReadOnly | QFile::Text)) {
+    else if (!file.open(QFile::ReadOnly)) {
         QMessageBox::warning(this, tr("TDriver Editor"),
                              tr("Can't read file '%1':\n%2.")
                              .arg(fileName)
                              .arg(file.errorString()));
     }
 
+    else if (!readFileText(file, stringData, codec, haveBom, encodingTestedOk)) {
+        qDebug() << FCFL << "loading cancelled";
+    }
+
     else {
+        file.close();
+
         TDriverCodeTextEdit *editor = NULL;
         QApplication::setOverrideCursor(Qt::WaitCursor);
         if (!replaceIn) {
@@ -963,47 +1085,15 @@ bool TDriverTabbedEditor::loadFile(QString fileName, bool fromTemplate, TDriverC
             editor = replaceIn;
         }
 
-        QString stringData;
-        QByteArray byteData(file.readAll());
-        bool haveBom = false;
-        bool encodingTestedOk;
-        QTextCodec *codec = QTextCodec::codecForUtfText(byteData, NULL);
-        if (codec == NULL) {
-            qDebug() << FCFL << "Unicode codec autodetection failed, trying UTF-8";
-            codec = QTextCodec::codecForName("UTF-8");
-            stringData = codec->toUnicode(byteData);
-            encodingTestedOk = (codec->fromUnicode(stringData) == byteData);
-            if (!encodingTestedOk) {
-                qDebug() << FCFL << "Encoding back to UTF-8 produced different result, trying codecForLocale";
-                codec = QTextCodec::codecForLocale();
-                stringData = codec->toUnicode(byteData);
-                encodingTestedOk = (codec->fromUnicode(stringData) == byteData);
-            }
-        }
-        else {
-            stringData = codec->toUnicode(byteData);
-            haveBom = true;
-            QByteArray testBuf;
-            {
-                QTextStream testStream(&testBuf);
-                testStream.setCodec(codec);
-                testStream.setGenerateByteOrderMark(haveBom);
-                testStream << stringData;
-            }
-            encodingTestedOk = (testBuf == byteData);
-        }
         editor->setFileCodec(codec);
         editor->setFileCodecUtfBom(haveBom);
         if (replaceIn) {
-            QTextCursor tc = editor->textCursor();
-            tc.beginEditBlock();
-            tc.select(QTextCursor::Document);
-            tc.insertText(stringData);
-            tc.endEditBlock();
+            editor->replaceAllText(stringData);
         }
         else {
             editor->setPlainText(stringData);
         }
+        stringData.clear(); // document has its own copy
         editor->document()->setModified(false);
         QString oldFileName = editor->fileName();
         editor->setFileName(fileName, fromTemplate);
@@ -1074,7 +1164,15 @@ bool TDriverTabbedEditor::saveFile(QString fileName, int index, bool resetEncodi
             QTextStream outStream(&file);
             if (editor->fileCodec()) outStream.setCodec(editor->fileCodec());
             outStream.setGenerateByteOrderMark(editor->fileCodecUtfBom());
-            outStream << editor->toPlainText();
+
+            // written block by block, converted like QTextDocument::toPlainText,
+            // so whole document is never copied to one string
+            QString line;
+            for (QTextBlock block = editor->document()->begin(); block.isValid(); block = block.next()) {
+                if (block != editor->document()->begin()) outStream << '\n';
+                line = block.text();
+                outStream << MEC::replaceUnicodeSeparators(line.replace(QChar::Nbsp, QChar(' ')));
+            }
         }
         file.close();
     }
@@ -1360,6 +1458,18 @@ void TDriverTabbedEditor::setSutParamMap(const QMap<QString, QString> &map)
 }
 
 
+void TDriverTabbedEditor::addCompletionWords(const QStringList &words)
+{
+    completionIndex->addWords(words);
+}
+
+
+void TDriverTabbedEditor::replaceCompletionWords(const QString &source, const QStringList &words)
+{
+    completionIndex->replaceWords(source, words);
+}
+
+
 QString TDriverTabbedEditor::sutVariable() const
 {
 #if EDITBAR_HAS_SUT_FIELD
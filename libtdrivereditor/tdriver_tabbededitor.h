@@ -37,12 +37,15 @@ class QMenuBar;
 class QSettings;
 class QCloseEvent;
 class QUrl;
+class QFile;
+class QTextCodec;
 
 class TDriverEditBar;
 class TDriverRunConsole;
 class TDriverDebugConsole;
 class TDriverRubyInteract;
 class TDriverCodeTextEdit;
+class TDriverCompletionIndex;
 class TDriverExecuteDialog;
 
 #include <QList>
@@ -61,6 +64,8 @@ public:
 
     void setTDriverParamMap(const QMap<QString, QString> &map);
     void setSutParamMap(const QMap<QString, QString> &map);
+    void addCompletionWords(const QStringList &words);
+    void replaceCompletionWords(const QString &source, const QStringList &words);
     TDriverEditBar *searchBar() { return editBarP; }
 
     const QList<QAction *> &fileActions() const { return fileActs; }
@@ -176,6 +181,7 @@ private slots:
 private:
     QList<TDriverCodeTextEdit*> setupLineJump(const QString &file, int lineNum);
     void updateEditorParams();
+    bool readFileText(QFile &file, QString &text, QTextCodec *&codec, bool &haveBom, bool &encodingTestedOk);
 
 private:
     QMap<QString, QString> tdriverParamMap;
@@ -189,6 +195,7 @@ private:
 
     TDriverRubyHighlighter *rubyHighlighter;
     TDriverHighlighter *plainHighlighter;
+    TDriverCompletionIndex *completionIndex;
     void createActions();
 
     bool needRunPreparations;
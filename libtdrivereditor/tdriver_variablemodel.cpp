@@ -0,0 +1,416 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#include "tdriver_variablemodel.h"
+
+#include <QBrush>
+#include <QColor>
+
+#include <cctype>
+
+#include <tdriver_debug_macros.h>
+
+
+/*!
+    \class TDriverVariableModel
+    \brief Item model of debugger variables, children are fetched on demand.
+
+    Top level rows are the variables reported by rdebug at a stop. Children of
+    a value are requested with an rdebug command only when the view expands
+    it, a page at a time, and a "more" row fetches the next page. The command
+    returns short descriptions of the children instead of their full inspect
+    strings, so the size of a value does not affect stepping. Fetched children
+    are kept until the next stop.
+ */
+
+
+// %1 expression, %2 first, %3 count, %4 max value length;
+// names are prefixed because block variables may assign to locals of debugged frame
+static const char childrenCommandTemplate[] =
+        "p (lambda { |_tdo, _tdf, _tdn| "
+        "if _tdo.is_a?(Hash) then _tdt = _tdo.size; "
+        "_tdc = _tdo.keys[_tdf, _tdn].to_a.map { |_tdk| [\"[#{_tdk.inspect}]\", _tdk.inspect, _tdo[_tdk]] } "
+        "elsif _tdo.is_a?(Array) then _tdt = _tdo.size; "
+        "_tdc = (_tdf...[_tdf + _tdn, _tdt].min).map { |_tdi| [\"[#{_tdi}]\", _tdi.to_s, _tdo[_tdi]] } "
+        "else _tdi = _tdo.instance_variables; _tdt = _tdi.size; "
+        "_tdc = _tdi[_tdf, _tdn].to_a.map { |_tdk| [\".instance_variable_get(:#{_tdk})\", _tdk.to_s, _tdo.instance_variable_get(_tdk)] } end; "
+        "([_tdt.to_s] + _tdc.map { |_tda, _tdk, _tdv| "
+        "_tds = case _tdv when Array, Hash then \"#{_tdv.class} (#{_tdv.size})\" "
+        "when String, Numeric, Symbol, NilClass, TrueClass, FalseClass then _tdv.inspect "
+        "else \"#<#{_tdv.class}>\" end; "
+        "_tde = (_tdv.is_a?(Array) || _tdv.is_a?(Hash)) ? !_tdv.empty? "
+        ": !(String === _tdv || Numeric === _tdv || Symbol === _tdv || _tdv.instance_variables.empty?); "
+        "[_tda, _tdk, _tdv.class, _tde ? 1 : 0, _tds[0, %4]].map { |_tdx| _tdx.to_s.tr(\"\\t\\n\", \"  \") }.join(\"\\t\") "
+        "}).join(\"\\n\") }).call(%1, %2, %3)";
+
+
+// value as printed by rdebug looks like something with children
+static bool looksExpandable(const QByteArray &value)
+{
+    return value.startsWith("#<")
+            || (value.startsWith('[') && value != "[]")
+            || (value.startsWith('{') && value != "{}");
+}
+
+
+static QString cutText(const QByteArray &text, int maxLength)
+{
+    if (text.size() <= maxLength) return QString::fromLocal8Bit(text);
+    return QString::fromLocal8Bit(text.constData(), maxLength) + "...";
+}
+
+
+// undoes escaping of String#inspect, returns false if text is not a quoted string
+static bool unescapeRubyString(const QByteArray &quoted, QByteArray &result)
+{
+    const int size = quoted.size();
+    if (size < 2 || quoted.at(0) != '"' || quoted.at(size-1) != '"') return false;
+
+    result.clear();
+    result.reserve(size);
+
+    for (int pos = 1; pos < size-1; ++pos) {
+        char ch = quoted.at(pos);
+        if (ch != '\\') {
+            result.append(ch);
+            continue;
+        }
+        if (++pos >= size-1) return false;
+        ch = quoted.at(pos);
+        switch (ch) {
+        case 'n': result.append('\n'); break;
+        case 't': result.append('\t'); break;
+        case 'r': result.append('\r'); break;
+        case 'e': result.append('\x1b'); break;
+        case 'a': result.append('\a'); break;
+        case 'b': result.append('\b'); break;
+        case 'f': result.append('\f'); break;
+        case 'v': result.append('\v'); break;
+        case 's': result.append(' '); break;
+        case 'x': {
+            int len = 0;
+            while (len < 2 && pos+1+len < size-1 && isxdigit(uchar(quoted.at(pos+1+len)))) ++len;
+            if (len == 0) return false;
+            result.append(char(quoted.mid(pos+1, len).toInt(NULL, 16)));
+            pos += len;
+            break;
+        }
+        default:
+            if (ch >= '0' && ch <= '7') {
+                int len = 1;
+                while (len < 3 && pos+len < size-1 && quoted.at(pos+len) >= '0' && quoted.at(pos+len) <= '7') ++len;
+                result.append(char(quoted.mid(pos, len).toInt(NULL, 8)));
+                pos += len-1;
+            }
+            else {
+                // \\ \" \# and anything else stand for the character itself
+                result.append(ch);
+            }
+        }
+    }
+    return true;
+}
+
+
+TDriverVariableModel::TDriverVariableModel(QObject *parent) :
+    QAbstractItemModel(parent),
+    nodes(1),
+    lastRequestId(0)
+{
+}
+
+
+void TDriverVariableModel::setVariables(const QList<TDriverRdebugVariable> &variables)
+{
+    beginResetModel();
+
+    // request ids are never reused, so replies for previous stop are ignored
+    requests.clear();
+    nodes.resize(1);
+    nodes[0] = Node();
+    nodes.reserve(1 + variables.size());
+
+    foreach (const TDriverRdebugVariable &var, variables) {
+        Node node;
+        node.parent = 0;
+        node.row = nodes[0].children.size();
+        node.name = var.name;
+        node.expression = var.name;
+        node.value = var.value;
+        node.expandable = looksExpandable(var.value);
+        nodes[0].children.append(nodes.size());
+        nodes.append(node);
+    }
+
+    endResetModel();
+}
+
+
+void TDriverVariableModel::clear()
+{
+    setVariables(QList<TDriverRdebugVariable>());
+}
+
+
+QString TDriverVariableModel::childrenCommand(const QByteArray &expression, int first, int count)
+{
+    return QString(childrenCommandTemplate)
+            .arg(QString::fromLocal8Bit(expression))
+            .arg(first)
+            .arg(count)
+            .arg(int(MaxValueLength));
+}
+
+
+bool TDriverVariableModel::parseChildrenReply(const QByteArray &reply, int &total, QList<QList<QByteArray> > &rows)
+{
+    QByteArray text;
+    if (!unescapeRubyString(reply.trimmed(), text)) return false;
+
+    const QList<QByteArray> lines = text.split('\n');
+    bool ok = false;
+    total = lines.first().toInt(&ok);
+    if (!ok) return false;
+
+    rows.clear();
+    for (int ind = 1; ind < lines.size(); ++ind) {
+        const QList<QByteArray> fields = lines.at(ind).split('\t');
+        if (fields.size() != 5) return false;
+        rows.append(fields);
+    }
+    return true;
+}
+
+
+void TDriverVariableModel::requestChildren(int node)
+{
+    Node &n = nodes[node];
+    if (n.requestId) return;
+
+    n.requestId = ++lastRequestId;
+    requests.insert(n.requestId, node);
+    emit childrenRequested(n.requestId, childrenCommand(n.expression, fetchedCount(node), PageSize));
+
+    if (!n.children.isEmpty() && nodes.at(n.children.last()).isMoreRow) {
+        const QModelIndex moreIndex = nodeIndex(n.children.last());
+        emit dataChanged(moreIndex, moreIndex.sibling(moreIndex.row(), ColumnCount-1));
+    }
+}
+
+
+int TDriverVariableModel::fetchedCount(int node) const
+{
+    const QVector<int> &children = nodes.at(node).children;
+    return (!children.isEmpty() && nodes.at(children.last()).isMoreRow) ? children.size()-1 : children.size();
+}
+
+
+void TDriverVariableModel::childrenReceived(int requestId, QByteArray reply, QString errorText)
+{
+    if (!requests.contains(requestId)) {
+        qDebug() << FCFL << "dropping stale reply" << requestId;
+        return;
+    }
+    const int node = requests.take(requestId);
+    nodes[node].requestId = 0;
+
+    int total = 0;
+    QList<QList<QByteArray> > rows;
+    if (!errorText.isEmpty() || !parseChildrenReply(reply, total, rows)) {
+        qDebug() << FCFL << "failed to get children of" << nodes.at(node).expression << errorText;
+        nodes[node].errorText = errorText.isEmpty() ? tr("Invalid reply from debugger") : errorText;
+        // total is left as it was, so the same page can be fetched again by expanding or activating "more"
+        const QModelIndex index = nodeIndex(node);
+        emit dataChanged(index, index.sibling(index.row(), ColumnCount-1));
+        const QVector<int> &children = nodes.at(node).children;
+        if (!children.isEmpty() && nodes.at(children.last()).isMoreRow) {
+            const QModelIndex moreIndex = nodeIndex(children.last());
+            emit dataChanged(moreIndex, moreIndex.sibling(moreIndex.row(), ColumnCount-1));
+        }
+        return;
+    }
+
+    nodes[node].total = total;
+    nodes[node].errorText.clear();
+    const QModelIndex parentIndex = nodeIndex(node);
+
+    // remove "more" row, it is added back below if there are still more children
+    if (!nodes.at(node).children.isEmpty() && nodes.at(nodes.at(node).children.last()).isMoreRow) {
+        const int row = nodes.at(node).children.size()-1;
+        beginRemoveRows(parentIndex, row, row);
+        // detached node stays unused until next stop, so indexes of other nodes don't change
+        nodes[node].children.removeLast();
+        endRemoveRows();
+    }
+
+    const int fetched = nodes.at(node).children.size() + rows.size();
+    const bool haveMore = (fetched < total);
+    const int added = rows.size() + (haveMore ? 1 : 0);
+    if (added == 0) return;
+
+    const int firstRow = nodes.at(node).children.size();
+    beginInsertRows(parentIndex, firstRow, firstRow + added - 1);
+
+    foreach (const QList<QByteArray> &fields, rows) {
+        Node child;
+        child.parent = node;
+        child.row = nodes.at(node).children.size();
+        child.expression = nodes.at(node).expression + fields.at(0);
+        child.name = fields.at(1);
+        child.type = fields.at(2);
+        child.expandable = (fields.at(3) == "1");
+        child.value = fields.at(4);
+        nodes[node].children.append(nodes.size());
+        nodes.append(child);
+    }
+
+    if (haveMore) {
+        Node more;
+        more.parent = node;
+        more.row = nodes.at(node).children.size();
+        more.isMoreRow = true;
+        more.total = total - fetched;
+        nodes[node].children.append(nodes.size());
+        nodes.append(more);
+    }
+
+    endInsertRows();
+}
+
+
+void TDriverVariableModel::fetchNextPage(const QModelIndex &index)
+{
+    if (!index.isValid()) return;
+    const Node &n = nodes.at(index.internalId());
+    if (n.isMoreRow) requestChildren(n.parent);
+}
+
+
+QModelIndex TDriverVariableModel::nodeIndex(int node, int column) const
+{
+    if (node <= 0) return QModelIndex();
+    return createIndex(nodes.at(node).row, column, node);
+}
+
+
+QModelIndex TDriverVariableModel::index(int row, int column, const QModelIndex &parent) const
+{
+    const int parentNode = parent.isValid() ? int(parent.internalId()) : 0;
+    if (row < 0 || column < 0 || column >= ColumnCount || row >= nodes.at(parentNode).children.size()) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, nodes.at(parentNode).children.at(row));
+}
+
+
+QModelIndex TDriverVariableModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) return QModelIndex();
+    return nodeIndex(nodes.at(child.internalId()).parent);
+}
+
+
+int TDriverVariableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) return 0;
+    const int node = parent.isValid() ? int(parent.internalId()) : 0;
+    return nodes.at(node).children.size();
+}
+
+
+int TDriverVariableModel::columnCount(const QModelIndex &) const
+{
+    return ColumnCount;
+}
+
+
+bool TDriverVariableModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) return false;
+    const int node = parent.isValid() ? int(parent.internalId()) : 0;
+    const Node &n = nodes.at(node);
+    return !n.children.isEmpty() || (n.expandable && n.total < 0);
+}
+
+
+bool TDriverVariableModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) return false;
+    const Node &n = nodes.at(parent.internalId());
+    return n.expandable && n.total < 0 && n.requestId == 0;
+}
+
+
+void TDriverVariableModel::fetchMore(const QModelIndex &parent)
+{
+    if (canFetchMore(parent)) requestChildren(parent.internalId());
+}
+
+
+QVariant TDriverVariableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+    const Node &n = nodes.at(index.internalId());
+
+    if (n.isMoreRow) {
+        if (role == Qt::DisplayRole && index.column() == NameColumn) {
+            return (nodes.at(n.parent).requestId)
+                    ? tr("fetching...")
+                    : tr("... %1 more").arg(n.total);
+        }
+        if (role == Qt::ToolTipRole) return tr("Activate to fetch next %1 items").arg(int(PageSize));
+        if (role == Qt::ForegroundRole) return QBrush(Qt::darkGray);
+        return QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case NameColumn: return QString::fromLocal8Bit(n.name);
+        case ValueColumn: return cutText(n.value, MaxValueLength);
+        case TypeColumn: return QString::fromLocal8Bit(n.type);
+        }
+        break;
+
+    case Qt::ToolTipRole:
+        if (!n.errorText.isEmpty()) return n.errorText;
+        if (index.column() == ValueColumn) return cutText(n.value, MaxToolTipLength);
+        return QString::fromLocal8Bit(n.expression);
+
+    case Qt::ForegroundRole:
+        if (!n.errorText.isEmpty()) return QBrush(Qt::red);
+        break;
+    }
+    return QVariant();
+}
+
+
+QVariant TDriverVariableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+
+    switch (section) {
+    case NameColumn: return tr("Name");
+    case ValueColumn: return tr("Value");
+    case TypeColumn: return tr("Class");
+    }
+    return QVariant();
+}
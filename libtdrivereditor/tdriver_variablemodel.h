@@ -0,0 +1,102 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#ifndef TDRIVER_VARIABLEMODEL_H
+#define TDRIVER_VARIABLEMODEL_H
+
+#include "libtdrivereditor_global.h"
+#include "tdriver_rdebugparser.h"
+
+#include <QAbstractItemModel>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+
+class LIBTDRIVEREDITORSHARED_EXPORT TDriverVariableModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Columns { NameColumn = 0, ValueColumn, TypeColumn, ColumnCount };
+    enum { PageSize = 100, MaxValueLength = 200, MaxToolTipLength = 2000 };
+
+    explicit TDriverVariableModel(QObject *parent = 0);
+
+    // starts a new stop, children fetched for previous stop are dropped
+    void setVariables(const QList<TDriverRdebugVariable> &variables);
+    void clear();
+
+    // rdebug command listing children first .. first+count-1 of value of ruby expression
+    static QString childrenCommand(const QByteArray &expression, int first, int count);
+    // reply is output of childrenCommand, rows get fields accessor, name, class, expandable, value
+    static bool parseChildrenReply(const QByteArray &reply, int &total, QList<QList<QByteArray> > &rows);
+
+    // QAbstractItemModel
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &child) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
+
+signals:
+    void childrenRequested(int requestId, QString command);
+
+public slots:
+    void childrenReceived(int requestId, QByteArray reply, QString errorText);
+    // fetches next page, if index is the "more" row of a paged collection
+    void fetchNextPage(const QModelIndex &index);
+
+private:
+    struct Node {
+        Node() : parent(-1), row(0), expandable(false), isMoreRow(false), total(-1), requestId(0) {}
+
+        int parent;
+        int row;
+        bool expandable;
+        bool isMoreRow; // last row of partially fetched collection
+        int total; // child count reported by ruby, -1 until first page is received
+        int requestId; // nonzero while children are being fetched
+        QByteArray name;
+        QByteArray expression; // ruby expression evaluating to the value
+        QByteArray value;
+        QByteArray type;
+        QString errorText;
+        QVector<int> children;
+    };
+
+    void requestChildren(int node);
+    int fetchedCount(int node) const;
+    QModelIndex nodeIndex(int node, int column = 0) const;
+
+    // node 0 is the invisible root, other nodes have their index as internal id
+    QVector<Node> nodes;
+    QHash<int, int> requests; // request id -> node
+    int lastRequestId;
+};
+
+#endif // TDRIVER_VARIABLEMODEL_H
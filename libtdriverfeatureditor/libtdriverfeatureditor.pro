@@ -27,7 +27,9 @@ SOURCES += tdriver_featureditor.cpp \
     tdriver_standardfeaturmodel.cpp \
     tdriver_featurscenariostepview.cpp \
     tdriver_featurstepfileview.cpp \
-    tdriver_featurstepdefview.cpp
+    tdriver_featurstepdefview.cpp \
+    tdriver_featurindexer.cpp \
+    tdriver_featurstepmatcher.cpp
 
 HEADERS += tdriver_featureditor.h\
         libtdriverfeatureditor_global.h \
@@ -37,7 +39,9 @@ HEADERS += tdriver_featureditor.h\
     tdriver_standardfeaturmodel.h \
     tdriver_featurscenariostepview.h \
     tdriver_featurstepfileview.h \
-    tdriver_featurstepdefview.h
+    tdriver_featurstepdefview.h \
+    tdriver_featurindexer.h \
+    tdriver_featurstepmatcher.h
 
 
 
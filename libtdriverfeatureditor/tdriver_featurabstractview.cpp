@@ -36,6 +36,9 @@ TDriverFeaturAbstractView::TDriverFeaturAbstractView(const QString &title, QWidg
   , __pathLine(-1)
   , __pendingScan(false)
   , __scanType(NoScan)
+  , __indexer(NULL)
+  , __indexScanId(0)
+  , __stepMatcher(NULL)
   //, refreshAct(new QAction(tr("Refresh")), this)
 {
 
@@ -127,6 +130,24 @@ bool TDriverFeaturAbstractView::clearModel(int rows)
 }
 
 
+void TDriverFeaturAbstractView::setIndexer(TDriverFeaturIndexer *indexer)
+{
+    if (__indexer) {
+        if (__indexScanId) __indexer->stopScan(__indexScanId);
+        __indexer->disconnect(this);
+    }
+
+    __indexer = indexer;
+    __indexScanId = 0;
+
+    if (__indexer) {
+        connect(__indexer, SIGNAL(scanStarted(int)), SLOT(indexScanStarted(int)));
+        connect(__indexer, SIGNAL(scanBatch(int,QList<TDriverFeaturIndexEntry>)),
+                SLOT(indexScanBatch(int,QList<TDriverFeaturIndexEntry>)));
+    }
+}
+
+
 QItemSelectionModel * TDriverFeaturAbstractView::selectionModel()
 {
     return __listView->selectionModel();
@@ -184,6 +205,10 @@ void TDriverFeaturAbstractView::resetPathFromBox()
 
 void TDriverFeaturAbstractView::clearView()
 {
+    if (__indexer && __indexScanId) {
+        __indexer->stopScan(__indexScanId);
+        __indexScanId = 0;
+    }
     clearModel();
     setLocationBox(QString());
 }
@@ -253,6 +278,74 @@ void TDriverFeaturAbstractView::doFileDialog()
 }
 
 
+void TDriverFeaturAbstractView::indexScanStarted(int scanId)
+{
+    // also called when indexer rescans because of file changes
+    if (scanId == __indexScanId) {
+        clearModel();
+    }
+}
+
+
+// Tooltip of a file is its path, followed by lines read from it
+static QString indexToolTip(const TDriverFeaturIndexEntry &entry)
+{
+    static const int maxLines = 40;
+    QString toolTip(entry.path);
+
+    for (int ii = 0; ii < entry.lines.size() && ii < maxLines; ++ii) {
+        toolTip += QString("\n%1: %2").arg(QString::number(entry.lines.at(ii).lineNum), entry.lines.at(ii).text);
+    }
+
+    if (entry.lines.size() > maxLines) {
+        toolTip += "\n...";
+    }
+
+    return toolTip;
+}
+
+
+void TDriverFeaturAbstractView::indexScanBatch(int scanId, QList<TDriverFeaturIndexEntry> entries)
+{
+    if (scanId != __indexScanId) return;
+
+    int row = model()->rowCount();
+
+    if (!model()->insertRows(row, entries.size())) {
+        qWarning() << "Failed to insert" << entries.size() << "rows to model at" << FCFL;
+        return;
+    }
+
+    foreach (const TDriverFeaturIndexEntry &entry, entries) {
+        QModelIndex index = model()->index(row, 0);
+
+        if (!model()->setData(index,
+                              QFileInfo(entry.path).baseName())) {
+            qWarning() << "Failed to set default role for model row" << row;
+        }
+
+        if (!model()->setData(index,
+                              entry.path,
+                              ActualPathRole)) {
+            qWarning() << "Failed to set ActualPathRole for model row" << row;
+        }
+
+        if (!model()->setData(index,
+                              indexToolTip(entry),
+                              Qt::ToolTipRole)) {
+            qWarning() << "Failed to set ToolTipRole for model row" << row;
+        }
+
+        if (entry.readError) {
+            view()->setItemDelegateForRow(row, _styleDelegate);
+            model()->setData(index, QBrush(Qt::red), Qt::ForegroundRole);
+        }
+
+        ++row;
+    }
+}
+
+
 void TDriverFeaturAbstractView::setLocationBox(const QString &text)
 {
     __locationBox->insertItem(0, text);
@@ -285,11 +378,25 @@ int TDriverFeaturAbstractView::doDirScan()
     qDebug() << FCFL << path << __scanPattern;
     Q_ASSERT(__listView->model());
 
+    if (__indexer && __indexScanId) {
+        __indexer->stopScan(__indexScanId);
+        __indexScanId = 0;
+    }
+
     if (!pathInfo().isDir()) {
         qDebug() << FCFL << "called when path not dir:" << path;
         return -1;
     }
 
+    if (__indexer) {
+        // files are listed and read on worker threads, and added by indexScanBatch
+        if (!clearModel()) {
+            qWarning() << "Failed to initialize empty model at" << FCFL;
+            return -2;
+        }
+        __indexScanId = __indexer->startScan(path, __scanPattern, __indexPattern);
+        return 0;
+    }
 
     QDirIterator dirIt(path,
                        QStringList() << __scanPattern,
@@ -352,6 +459,43 @@ int TDriverFeaturAbstractView::doFileScan()
         return -1;
     }
 
+    if (__indexer) {
+        // file is read only if index does not have it already
+        TDriverFeaturIndexEntry entry;
+        if (!__indexer->lookup(path, __scanPattern, entry)) {
+            qWarning() << "Failed to read" << path << "at" << FCFL;
+            return -2;
+        }
+
+        if (!clearModel(entry.lines.size())) {
+            qWarning() << "Failed to initialize model at" << FCFL;
+            return -2;
+        }
+
+        for (int row = 0; row < entry.lines.size(); ++row) {
+            const TDriverFeaturIndexLine &line = entry.lines.at(row);
+            QModelIndex index = model()->index(row, 0);
+
+            if (!model()->setData(index,
+                                  line.capture)) {
+                qWarning() << "Failed to set default role for model row" << row;
+            }
+
+            if (!model()->setData(index,
+                                  QString("%1:%2").arg(path, QString::number(line.lineNum)),
+                                  ActualPathRole)) {
+                qWarning() << "Failed to set ActualPathRole for model row" << row;
+            }
+
+            if (!model()->setData(index,
+                                  QString("%1: %2").arg(QString::number(line.lineNum), line.text),
+                                  Qt::ToolTipRole)) {
+                qWarning() << "Failed to set ToolTipRole for model row" << row;
+            }
+        }
+        return model()->rowCount();
+    }
+
     QFile file(path);
     if (!file.open(QFile::ReadOnly)) {
         qWarning() << "Failed to open" << path << "with error" << file.errorString() << "at" << FCFL;
@@ -366,14 +510,11 @@ int TDriverFeaturAbstractView::doFileScan()
 
     qDebug() << FCFL << rx.isValid() << rx.pattern();
 
-    qDebug() << FCFL << "________START FILE READ LOOP________";
-
     while ((line = file.readLine()).size() > 0) {
         file.unsetError();
         ++lineNum;
         QString lineStr(QString::fromUtf8(line.trimmed()));
         int pos = rx.indexIn(lineStr);
-        qDebug() << lineNum << '(' << pos << rx.captureCount() << ')' << ':' << line.trimmed();
         if (pos >= 0 && rx.captureCount() >= 1) {
 
             if (!model()->insertRow(modelRow)) {
@@ -404,8 +545,6 @@ int TDriverFeaturAbstractView::doFileScan()
         }
     }
 
-    qDebug() << FCFL << "________ END FILE READ LOOP ________";
-
     if (file.error() != QFile::NoError) {
         qDebug() << FCFL << "reading ended with readLine error" << file.errorString();
     }
@@ -450,14 +589,10 @@ int TDriverFeaturAbstractView::doFileSectionScan()
 
     qDebug() << FCFL << rx.isValid() << rx.pattern();
 
-    qDebug() << FCFL << "________START FILE READ LOOP________";
-
     while (!sectionOver && (line = file.readLine()).size() > 0) {
         file.unsetError();
         ++lineNum;
 
-        qDebug() << lineNum << line.trimmed();
-
         // skip lines until first line to capture
         if (lineNum < pathLineNum) continue;
 
@@ -467,7 +602,6 @@ int TDriverFeaturAbstractView::doFileSectionScan()
             // exclude first line from regexp check
 
             int pos = rx.indexIn(lineStr);
-            qDebug() << "...regexp result:" << pos << rx.captureCount();
             if (pos >= 0) {
                 sectionOver = true; // last line in section
 
@@ -482,7 +616,6 @@ int TDriverFeaturAbstractView::doFileSectionScan()
             return -2;
         }
 
-        qDebug() << "...adding line";
         QModelIndex index = model()->index(modelRow, 0);
 
         if (!model()->setData(index,
@@ -498,8 +631,6 @@ int TDriverFeaturAbstractView::doFileSectionScan()
         ++modelRow;
     }
 
-    qDebug() << FCFL << "________ END FILE READ LOOP ________";
-
     if (file.error() != QFile::NoError) {
         qDebug() << FCFL << "reading ended with readLine error" << file.errorString();
     }
@@ -21,6 +21,7 @@
 #define TDRIVERFEATURABSTRACTVIEW_H
 
 #include "libtdriverfeatureditor_global.h"
+#include "tdriver_featurindexer.h"
 
 #include <QWidget>
 
@@ -36,6 +37,8 @@ class QAbstractItemView;
 class QListView;
 class QPushButton;
 
+class TDriverFeaturStepMatcher;
+
 //class QAction;
 
 class LIBTDRIVERFEATUREDITORSHARED_EXPORT TDriverFeaturAbstractView : public QWidget
@@ -55,7 +58,7 @@ class LIBTDRIVERFEATUREDITORSHARED_EXPORT TDriverFeaturAbstractView : public QWi
 public:
     enum ScanType { NoScan, DirScan, FileScan, FileSectionScan };
     //Q_DECLARE_METATYPE(ScanType);
-    enum DataRoles { ActualPathRole=Qt::UserRole+1, FileContentRole };
+    enum DataRoles { ActualPathRole=Qt::UserRole+1, FileContentRole, StepDefinitionRole };
 
     explicit TDriverFeaturAbstractView(const QString &title, QWidget *parent = 0);
     ~TDriverFeaturAbstractView();
@@ -85,6 +88,19 @@ public:
     ScanType scanType() {return __scanType; }
     void setScanType(ScanType value) { __scanType = value; }
 
+    // with indexer, DirScan and FileScan are done by it, see TDriverFeaturIndexer
+    void setIndexer(TDriverFeaturIndexer *indexer);
+    TDriverFeaturIndexer *indexer() { return __indexer; }
+    int indexScanId() { return __indexScanId; }
+
+    // with DirScan, lines matching index pattern are read from found files for tooltips
+    QString indexPattern() { return __indexPattern; }
+    void setIndexPattern(const QString &pattern) { __indexPattern = pattern; }
+
+    // step file view adds definitions to matcher, scenario step view matches steps with it
+    virtual void setStepMatcher(TDriverFeaturStepMatcher *matcher) { __stepMatcher = matcher; }
+    TDriverFeaturStepMatcher *stepMatcher() { return __stepMatcher; }
+
     void enableFileButton();
 
     QItemSelectionModel *selectionModel();
@@ -105,6 +121,8 @@ public slots:
 
 protected slots:
     virtual void doFileDialog();
+    virtual void indexScanStarted(int scanId);
+    virtual void indexScanBatch(int scanId, QList<TDriverFeaturIndexEntry> entries);
 
 protected:
     void setLocationBox(const QString &text);
@@ -134,6 +152,12 @@ private:
 
     ScanType __scanType;
 
+    TDriverFeaturIndexer *__indexer;
+    int __indexScanId;
+    QString __indexPattern;
+
+    TDriverFeaturStepMatcher *__stepMatcher;
+
 };
 
 #endif // TDRIVERFEATURABSTRACTVIEW_H
@@ -24,6 +24,8 @@
 #include "tdriver_featurscenariostepview.h"
 #include "tdriver_featurstepdefview.h"
 #include "tdriver_featurstepfileview.h"
+#include "tdriver_featurindexer.h"
+#include "tdriver_featurstepmatcher.h"
 
 #include <tdriver_debug_macros.h>
 
@@ -37,9 +39,24 @@ TDriverFeaturEditor::TDriverFeaturEditor(QWidget *parent) :
   , scenarioStepList(new TDriverFeaturScenarioStepView)
   , stepDefinitionList(new TDriverFeaturStepDefView)
   , stepFileList(new TDriverFeaturStepFileView)
+  , indexer(new TDriverFeaturIndexer(this))
+  , stepMatcher(new TDriverFeaturStepMatcher(this))
 {
     setLayout(new QVBoxLayout());
 
+    // directory scans also read the lines that file scans of the next view need,
+    // so selecting a feature or step file is served from the index
+    featureList->setIndexer(indexer);
+    featureList->setIndexPattern(scenarioList->scanPattern());
+    scenarioList->setIndexer(indexer);
+    stepFileList->setIndexer(indexer);
+    stepFileList->setIndexPattern(stepDefinitionList->scanPattern());
+    stepDefinitionList->setIndexer(indexer);
+
+    // step files found by step file list are matched against steps of selected scenario
+    stepFileList->setStepMatcher(stepMatcher);
+    scenarioStepList->setStepMatcher(stepMatcher);
+
     QSplitter *splitter = new QSplitter(Qt::Horizontal);
     layout()->addWidget(splitter);
 
@@ -65,6 +82,8 @@ TDriverFeaturEditor::TDriverFeaturEditor(QWidget *parent) :
 
     connect(scenarioStepList->view(), SIGNAL(doubleClicked(QModelIndex)),
             SLOT(editFromIndex(QModelIndex)));
+    connect(scenarioStepList->selectionModel(), SIGNAL(currentChanged(QModelIndex,QModelIndex)),
+            SLOT(showStepDefinition(QModelIndex)));
 
     connect(stepDefinitionList->view(), SIGNAL(doubleClicked(QModelIndex)),
             SLOT(editFromIndex(QModelIndex)));
@@ -83,6 +102,7 @@ TDriverFeaturEditor::TDriverFeaturEditor(QWidget *parent) :
     connect(this, SIGNAL(fileChangeRelay(QString)), scenarioStepList, SLOT(aFileChanged(QString)));
     //connect(this, SIGNAL(fileChangeRelay(QString)), featureList, SLOT(aFileChanged(QString)));
     connect(this, SIGNAL(fileChangeRelay(QString)), stepFileList, SLOT(aFileChanged(QString)));
+    connect(this, SIGNAL(fileChangeRelay(QString)), indexer, SLOT(fileChanged(QString)));
 }
 
 
@@ -100,3 +120,26 @@ void TDriverFeaturEditor::editFromIndex(const QModelIndex &index)
         qDebug() << FCFL << "could not emit fileEditRequest";
     }
 }
+
+
+// Shows step definition of selected step in step definition list
+void TDriverFeaturEditor::showStepDefinition(const QModelIndex &index)
+{
+    const QAbstractItemModel *model = index.model();
+    if (!index.isValid() || !model) return;
+
+    const QString definitionPath = model->data(index, TDriverFeaturAbstractView::StepDefinitionRole).toString();
+    if (definitionPath.isEmpty()) return;
+
+    // path has line number, list shows all definitions of the file
+    stepDefinitionList->resetPath(definitionPath);
+
+    QAbstractItemModel *definitionModel = stepDefinitionList->model();
+    const QModelIndexList matches = definitionModel->match(definitionModel->index(0, 0),
+                                                           TDriverFeaturAbstractView::ActualPathRole,
+                                                           definitionPath, 1, Qt::MatchExactly);
+    if (!matches.isEmpty()) {
+        stepDefinitionList->selectionModel()->setCurrentIndex(matches.first(), QItemSelectionModel::ClearAndSelect);
+        stepDefinitionList->view()->scrollTo(matches.first());
+    }
+}
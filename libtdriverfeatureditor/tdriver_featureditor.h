@@ -25,6 +25,8 @@
 #include "libtdriverfeatureditor_global.h"
 
 class TDriverFeaturAbstractView;
+class TDriverFeaturIndexer;
+class TDriverFeaturStepMatcher;
 
 class QModelIndex;
 
@@ -41,6 +43,7 @@ signals:
 
 private slots:
     void editFromIndex(const QModelIndex &);
+    void showStepDefinition(const QModelIndex &);
 
 
 private:
@@ -50,6 +53,9 @@ private:
 
     TDriverFeaturAbstractView *stepDefinitionList;
     TDriverFeaturAbstractView *stepFileList;
+
+    TDriverFeaturIndexer *indexer;
+    TDriverFeaturStepMatcher *stepMatcher;
 };
 
 #endif // TDRIVER_FEATUREDITOR_H
@@ -0,0 +1,488 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include "tdriver_featurindexer.h"
+
+#include <tdriver_debug_macros.h>
+
+#include <QtGui>
+#include <QtConcurrentRun>
+#include <QtConcurrentMap>
+
+
+/*!
+    \class TDriverFeaturIndexer
+    \brief Lists and reads feature and step definition files on worker threads.
+
+    Each scan lists files of a directory tree, and reads lines matching a pattern
+    from them, several files in parallel. Results are reported in batches, so views
+    can fill their models while the scan is still running.
+
+    Read files are kept in an index keyed by canonical path, which is saved to disk.
+    A file is read again only if its modification time or size differs from the index,
+    so a rescan of an unchanged tree only lists it. Scanned directories are watched,
+    and scans are rerun when files in them change.
+ */
+
+
+static const quint32 IndexFileMagic = 0x54464958; // "TFIX"
+static const quint32 IndexFileVersion = 1;
+
+
+QDataStream &operator<<(QDataStream &stream, const TDriverFeaturIndexLine &line)
+{
+    return stream << qint32(line.lineNum) << line.text << line.capture;
+}
+
+
+QDataStream &operator>>(QDataStream &stream, TDriverFeaturIndexLine &line)
+{
+    qint32 lineNum;
+    stream >> lineNum >> line.text >> line.capture;
+    line.lineNum = lineNum;
+    return stream;
+}
+
+
+QDataStream &operator<<(QDataStream &stream, const TDriverFeaturIndexEntry &entry)
+{
+    return stream << entry.path << entry.modified << entry.size << entry.linePattern << entry.readError << entry.lines;
+}
+
+
+QDataStream &operator>>(QDataStream &stream, TDriverFeaturIndexEntry &entry)
+{
+    return stream >> entry.path >> entry.modified >> entry.size >> entry.linePattern >> entry.readError >> entry.lines;
+}
+
+
+TDriverFeaturIndexer::TDriverFeaturIndexer(QObject *parent) :
+    QObject(parent)
+  , nextScanId(1)
+  , cacheDirty(false)
+  , cacheFileName(QDesktopServices::storageLocation(QDesktopServices::DataLocation) + "/feature_index.dat")
+  , fsWatcher(new QFileSystemWatcher(this))
+  , changeTimer(new QTimer(this))
+  , saveTimer(new QTimer(this))
+{
+    qRegisterMetaType<TDriverFeaturIndexEntry>("TDriverFeaturIndexEntry");
+    qRegisterMetaType<QList<TDriverFeaturIndexEntry> >("QList<TDriverFeaturIndexEntry>");
+
+    // editors may save a file in several steps, so changes are collected for a while
+    changeTimer->setSingleShot(true);
+    changeTimer->setInterval(1000);
+    connect(changeTimer, SIGNAL(timeout()), SLOT(restartChangedScans()));
+
+    saveTimer->setSingleShot(true);
+    saveTimer->setInterval(5000);
+    connect(saveTimer, SIGNAL(timeout()), SLOT(save()));
+
+    connect(fsWatcher, SIGNAL(directoryChanged(QString)), SLOT(directoryChanged(QString)));
+    connect(fsWatcher, SIGNAL(fileChanged(QString)), SLOT(fileChanged(QString)));
+
+    load();
+}
+
+
+TDriverFeaturIndexer::~TDriverFeaturIndexer()
+{
+    // workers use the index, so they must be finished before it goes away
+    QMutableHashIterator<int, Scan> it(scans);
+    while (it.hasNext()) {
+        cancelScan(it.next().value());
+    }
+
+    foreach (QFuture<QStringList> future, retiredScans) {
+        future.waitForFinished();
+    }
+
+    save();
+}
+
+
+int TDriverFeaturIndexer::startScan(const QString &root, const QString &namePattern, const QString &linePattern)
+{
+    const int scanId = nextScanId++;
+
+    Scan &scan = scans[scanId];
+    scan.root = QFileInfo(root).canonicalFilePath();
+    scan.namePattern = namePattern;
+    scan.linePattern = linePattern;
+
+    runScan(scanId);
+    return scanId;
+}
+
+
+void TDriverFeaturIndexer::stopScan(int scanId)
+{
+    if (scans.contains(scanId)) {
+        cancelScan(scans[scanId]);
+        scans.remove(scanId);
+    }
+    changedScans.remove(scanId);
+}
+
+
+bool TDriverFeaturIndexer::lookup(const QString &path, const QString &linePattern, TDriverFeaturIndexEntry &entry)
+{
+    const QFileInfo info(path);
+    if (!info.isFile()) return false;
+
+    TDriverFeaturIndexEntry current;
+    current.path = info.canonicalFilePath();
+    current.modified = info.lastModified();
+    current.size = info.size();
+    current.linePattern = linePattern;
+
+    {
+        QMutexLocker locker(&cacheMutex);
+        QHash<QString, TDriverFeaturIndexEntry>::const_iterator cached = cache.constFind(current.path);
+        if (cached != cache.constEnd() && isUpToDate(*cached, current)) {
+            entry = *cached;
+            return true;
+        }
+    }
+
+    entry = readEntry(current);
+
+    {
+        QMutexLocker locker(&cacheMutex);
+        cache.insert(entry.path, entry);
+        cacheDirty = true;
+    }
+    saveTimer->start();
+
+    return !entry.readError;
+}
+
+
+void TDriverFeaturIndexer::fileChanged(const QString &path)
+{
+    const QString canonicalPath(QFileInfo(path).canonicalFilePath());
+
+    QHashIterator<int, Scan> it(scans);
+    while (it.hasNext()) {
+        it.next();
+        if (canonicalPath.startsWith(it.value().root + '/')) {
+            changedScans.insert(it.key());
+        }
+    }
+
+    if (!changedScans.isEmpty()) changeTimer->start();
+}
+
+
+void TDriverFeaturIndexer::directoryChanged(const QString &path)
+{
+    QHashIterator<int, Scan> it(scans);
+    while (it.hasNext()) {
+        it.next();
+        if (path == it.value().root || path.startsWith(it.value().root + '/')) {
+            changedScans.insert(it.key());
+        }
+    }
+
+    if (!changedScans.isEmpty()) changeTimer->start();
+}
+
+
+void TDriverFeaturIndexer::restartChangedScans()
+{
+    foreach (int scanId, changedScans) {
+        if (scans.contains(scanId)) {
+            qDebug() << FCFL << "rescanning" << scanId << scans[scanId].root;
+            runScan(scanId);
+        }
+    }
+    changedScans.clear();
+}
+
+
+void TDriverFeaturIndexer::runScan(int scanId)
+{
+    Scan &scan = scans[scanId];
+    cancelScan(scan);
+
+    ++scan.generation;
+    scan.fileCount = 0;
+    scan.cancelFlag = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    scan.watcher = new QFutureWatcher<QStringList>(this);
+    connect(scan.watcher, SIGNAL(finished()), SLOT(scanDone()));
+
+    emit scanStarted(scanId);
+
+    scan.watcher->setFuture(QtConcurrent::run(&TDriverFeaturIndexer::scanWorker,
+                                              this, scanId, scan.generation, scan, scan.cancelFlag));
+}
+
+
+void TDriverFeaturIndexer::cancelScan(Scan &scan)
+{
+    if (scan.cancelFlag) {
+        scan.cancelFlag->fetchAndStoreOrdered(1);
+        scan.cancelFlag.clear();
+    }
+
+    // forget finished workers, and keep track of running ones until they notice cancellation
+    for (int ii = retiredScans.size()-1; ii >= 0; --ii) {
+        if (retiredScans.at(ii).isFinished()) retiredScans.removeAt(ii);
+    }
+
+    if (scan.watcher) {
+        if (!scan.watcher->isFinished()) retiredScans << scan.watcher->future();
+        scan.watcher->disconnect(this);
+        scan.watcher->deleteLater();
+        scan.watcher = NULL;
+    }
+}
+
+
+void TDriverFeaturIndexer::deliverBatch(int scanId, int generation, QList<TDriverFeaturIndexEntry> entries)
+{
+    if (!scans.contains(scanId) || scans[scanId].generation != generation) return; // stale
+
+    scans[scanId].fileCount += entries.size();
+    emit scanBatch(scanId, entries);
+}
+
+
+void TDriverFeaturIndexer::scanDone()
+{
+    QFutureWatcher<QStringList> *watcher = static_cast<QFutureWatcher<QStringList> *>(sender());
+
+    QMutableHashIterator<int, Scan> it(scans);
+    while (it.hasNext()) {
+        Scan &scan = it.next().value();
+        if (scan.watcher != watcher) continue;
+
+        const QStringList dirs(watcher->result());
+        const QStringList watched(fsWatcher->directories());
+        foreach (const QString &dir, dirs) {
+            if (!watched.contains(dir)) fsWatcher->addPath(dir);
+        }
+
+        qDebug() << FCFL << "scan" << it.key() << scan.root << "files" << scan.fileCount << "dirs" << dirs.size();
+
+        scan.watcher = NULL;
+        scan.cancelFlag.clear();
+        emit scanFinished(it.key(), scan.fileCount);
+        break;
+    }
+
+    watcher->deleteLater();
+    saveTimer->start();
+}
+
+
+// Runs in worker thread, returns directories of the tree for watching
+QStringList TDriverFeaturIndexer::scanWorker(TDriverFeaturIndexer *indexer, int scanId, int generation,
+                                             Scan scan, QSharedPointer<QAtomicInt> cancelFlag)
+{
+    QStringList dirs(scan.root);
+    QList<TDriverFeaturIndexEntry> found;
+    QSet<QString> foundPaths;
+
+    // directories are listed too, name filters do not apply to them with AllDirs
+    QDirIterator dirIt(scan.root,
+                       QStringList() << scan.namePattern,
+                       QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot,
+                       QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+
+    while (dirIt.hasNext() && *cancelFlag == 0) {
+        dirIt.next();
+        const QFileInfo info(dirIt.fileInfo());
+
+        if (info.isDir()) {
+            dirs << info.canonicalFilePath();
+            continue;
+        }
+
+        TDriverFeaturIndexEntry entry;
+        entry.path = info.canonicalFilePath();
+        entry.modified = info.lastModified();
+        entry.size = info.size();
+        entry.linePattern = scan.linePattern;
+        found << entry;
+        foundPaths.insert(entry.path);
+    }
+
+    if (*cancelFlag != 0) return dirs;
+
+    {
+        // forget files which were removed from the tree
+        QMutexLocker locker(&indexer->cacheMutex);
+        QMutableHashIterator<QString, TDriverFeaturIndexEntry> it(indexer->cache);
+        while (it.hasNext()) {
+            const QString &path = it.next().key();
+            if (path.startsWith(scan.root + '/') && !foundPaths.contains(path)
+                    && QDir::match(scan.namePattern, QFileInfo(path).fileName())) {
+                it.remove();
+                indexer->cacheDirty = true;
+            }
+        }
+    }
+
+    // up to date entries come from the index, others are read in parallel, a batch at a time
+    for (int begin = 0; begin < found.size() && *cancelFlag == 0; begin += BatchSize) {
+        QList<TDriverFeaturIndexEntry> batch(found.mid(begin, BatchSize));
+        QList<int> readRows;
+        QList<TDriverFeaturIndexEntry> readList;
+
+        {
+            QMutexLocker locker(&indexer->cacheMutex);
+            for (int row = 0; row < batch.size(); ++row) {
+                QHash<QString, TDriverFeaturIndexEntry>::const_iterator cached = indexer->cache.constFind(batch.at(row).path);
+                if (cached != indexer->cache.constEnd() && isUpToDate(*cached, batch.at(row))) {
+                    batch[row] = *cached;
+                }
+                else {
+                    readRows << row;
+                    readList << batch.at(row);
+                }
+            }
+        }
+
+        if (!readList.isEmpty()) {
+            const QList<TDriverFeaturIndexEntry> readEntries =
+                    QtConcurrent::blockingMapped(readList, &TDriverFeaturIndexer::readEntry);
+
+            QMutexLocker locker(&indexer->cacheMutex);
+            for (int ii = 0; ii < readEntries.size(); ++ii) {
+                batch[readRows.at(ii)] = readEntries.at(ii);
+                indexer->cache.insert(readEntries.at(ii).path, readEntries.at(ii));
+            }
+            indexer->cacheDirty = true;
+        }
+
+        QMetaObject::invokeMethod(indexer, "deliverBatch", Qt::QueuedConnection,
+                                  Q_ARG(int, scanId), Q_ARG(int, generation),
+                                  Q_ARG(QList<TDriverFeaturIndexEntry>, batch));
+    }
+
+    return dirs;
+}
+
+
+// Runs in worker thread
+TDriverFeaturIndexEntry TDriverFeaturIndexer::readEntry(const TDriverFeaturIndexEntry &entry)
+{
+    TDriverFeaturIndexEntry result(entry);
+    result.lines.clear();
+    result.readError = false;
+
+    if (entry.linePattern.isEmpty()) return result;
+
+    QFile file(entry.path);
+    if (!file.open(QFile::ReadOnly)) {
+        result.readError = true;
+        return result;
+    }
+
+    QRegExp rx(entry.linePattern);
+    QByteArray line;
+    int lineNum = 0;
+
+    while ((line = file.readLine()).size() > 0) {
+        ++lineNum;
+        const QString lineStr(QString::fromUtf8(line.trimmed()));
+
+        if (rx.indexIn(lineStr) >= 0 && rx.captureCount() >= 1) {
+            TDriverFeaturIndexLine indexLine;
+            indexLine.lineNum = lineNum;
+            indexLine.text = lineStr;
+            indexLine.capture = rx.cap(1);
+            result.lines << indexLine;
+        }
+    }
+
+    return result;
+}
+
+
+bool TDriverFeaturIndexer::isUpToDate(const TDriverFeaturIndexEntry &cached, const TDriverFeaturIndexEntry &current)
+{
+    return !cached.readError
+            && cached.modified == current.modified
+            && cached.size == current.size
+            && cached.linePattern == current.linePattern;
+}
+
+
+bool TDriverFeaturIndexer::load()
+{
+    QFile file(cacheFileName);
+    if (!file.open(QFile::ReadOnly)) return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+
+    if (magic != IndexFileMagic || version != IndexFileVersion) {
+        qDebug() << FCFL << "ignoring" << cacheFileName << "with magic" << magic << "version" << version;
+        return false;
+    }
+
+    stream.setVersion(QDataStream::Qt_4_6);
+    quint32 count = 0;
+    stream >> count;
+
+    QMutexLocker locker(&cacheMutex);
+    for (quint32 ii = 0; ii < count && stream.status() == QDataStream::Ok; ++ii) {
+        TDriverFeaturIndexEntry entry;
+        stream >> entry;
+        cache.insert(entry.path, entry);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qDebug() << FCFL << "corrupt" << cacheFileName;
+        cache.clear();
+        return false;
+    }
+
+    qDebug() << FCFL << "loaded" << cache.size() << "files from" << cacheFileName;
+    return true;
+}
+
+
+bool TDriverFeaturIndexer::save()
+{
+    QMutexLocker locker(&cacheMutex);
+    if (!cacheDirty) return true;
+
+    QDir().mkpath(QFileInfo(cacheFileName).absolutePath());
+
+    QFile file(cacheFileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "Failed to save" << cacheFileName << "with error" << file.errorString() << "at" << FCFL;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << IndexFileMagic << IndexFileVersion;
+    stream.setVersion(QDataStream::Qt_4_6);
+    stream << quint32(cache.size());
+
+    foreach (const TDriverFeaturIndexEntry &entry, cache) {
+        stream << entry;
+    }
+
+    cacheDirty = false;
+    return stream.status() == QDataStream::Ok;
+}
@@ -0,0 +1,135 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef TDRIVER_FEATURINDEXER_H
+#define TDRIVER_FEATURINDEXER_H
+
+#include "libtdriverfeatureditor_global.h"
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QMetaType>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QFutureWatcher>
+
+class QFileSystemWatcher;
+class QTimer;
+
+
+struct TDriverFeaturIndexLine {
+    int lineNum;
+    QString text; // trimmed line
+    QString capture; // first capture of line pattern
+};
+
+
+struct TDriverFeaturIndexEntry {
+    QString path; // canonical
+    QDateTime modified;
+    qint64 size;
+    QString linePattern; // pattern lines were scanned with, empty if file was not read
+    bool readError;
+    QList<TDriverFeaturIndexLine> lines;
+
+    TDriverFeaturIndexEntry() : size(-1), readError(false) {}
+};
+
+Q_DECLARE_METATYPE(TDriverFeaturIndexEntry)
+Q_DECLARE_METATYPE(QList<TDriverFeaturIndexEntry>)
+
+
+class LIBTDRIVERFEATUREDITORSHARED_EXPORT TDriverFeaturIndexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TDriverFeaturIndexer(QObject *parent = 0);
+    ~TDriverFeaturIndexer();
+
+    // scans files matching namePattern under root on worker threads,
+    // and reads lines matching linePattern from them unless it's empty.
+    // Results are reported with scanStarted, scanBatch and scanFinished signals,
+    // again whenever files under root change, until scan is stopped.
+    int startScan(const QString &root, const QString &namePattern, const QString &linePattern);
+    void stopScan(int scanId);
+
+    // gets entry of a single file, reading it now unless index is up to date
+    bool lookup(const QString &path, const QString &linePattern, TDriverFeaturIndexEntry &entry);
+
+    enum { BatchSize = 200 };
+
+signals:
+    void scanStarted(int scanId);
+    void scanBatch(int scanId, QList<TDriverFeaturIndexEntry> entries);
+    void scanFinished(int scanId, int fileCount);
+
+public slots:
+    void fileChanged(const QString &path);
+    bool save();
+
+private slots:
+    void deliverBatch(int scanId, int generation, QList<TDriverFeaturIndexEntry> entries);
+    void scanDone();
+    void directoryChanged(const QString &path);
+    void restartChangedScans();
+
+private:
+    struct Scan {
+        QString root;
+        QString namePattern;
+        QString linePattern;
+        int generation;
+        int fileCount;
+        QSharedPointer<QAtomicInt> cancelFlag;
+        QFutureWatcher<QStringList> *watcher; // result is list of scanned directories
+        Scan() : generation(0), fileCount(0), watcher(NULL) {}
+    };
+
+    void runScan(int scanId);
+    void cancelScan(Scan &scan);
+    bool load();
+
+    static QStringList scanWorker(TDriverFeaturIndexer *indexer, int scanId, int generation,
+                                  Scan scan, QSharedPointer<QAtomicInt> cancelFlag);
+    static TDriverFeaturIndexEntry readEntry(const TDriverFeaturIndexEntry &entry);
+    static bool isUpToDate(const TDriverFeaturIndexEntry &cached, const TDriverFeaturIndexEntry &current);
+
+    QHash<int, Scan> scans;
+    int nextScanId;
+    QSet<int> changedScans;
+    QList<QFuture<QStringList> > retiredScans; // cancelled workers which may still be running
+
+    QMutex cacheMutex;
+    QHash<QString, TDriverFeaturIndexEntry> cache; // guarded by cacheMutex
+    bool cacheDirty; // guarded by cacheMutex
+    QString cacheFileName;
+
+    QFileSystemWatcher *fsWatcher;
+    QTimer *changeTimer;
+    QTimer *saveTimer;
+};
+
+#endif // TDRIVER_FEATURINDEXER_H
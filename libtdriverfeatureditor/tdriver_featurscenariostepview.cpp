@@ -18,6 +18,7 @@
 ****************************************************************************/
 
 #include "tdriver_featurscenariostepview.h"
+#include "tdriver_featurstepmatcher.h"
 
 #include <tdriver_debug_macros.h>
 
@@ -31,3 +32,81 @@ TDriverFeaturScenarioStepView::TDriverFeaturScenarioStepView(QWidget *parent) :
     setScanPattern("^\\s*Scenario:");
 }
 
+
+void TDriverFeaturScenarioStepView::setStepMatcher(TDriverFeaturStepMatcher *matcher)
+{
+    if (stepMatcher()) stepMatcher()->disconnect(this);
+
+    TDriverFeaturAbstractView::setStepMatcher(matcher);
+
+    if (matcher) {
+        connect(matcher, SIGNAL(definitionsChanged()), SLOT(resolveSteps()));
+    }
+}
+
+
+int TDriverFeaturScenarioStepView::reScan()
+{
+    int ret = TDriverFeaturAbstractView::reScan();
+    resolveSteps();
+    return ret;
+}
+
+
+// Marks each step with its definition, undefined and ambiguous steps are colored
+void TDriverFeaturScenarioStepView::resolveSteps()
+{
+    const TDriverFeaturStepMatcher *matcher = stepMatcher();
+    if (!matcher) return;
+
+    QTime t;
+    t.start();
+
+    const int rows = model()->rowCount();
+
+    for (int row = 0; row < rows; ++row) {
+        QModelIndex index(model()->index(row, 0));
+        const TDriverFeaturStepMatcher::Match match = matcher->match(model()->data(index).toString());
+
+        QString definitionPath;
+        QString toolTip;
+        QVariant foreground;
+
+        switch (match.status) {
+
+        case TDriverFeaturStepMatcher::NotStep:
+            break;
+
+        case TDriverFeaturStepMatcher::Undefined:
+            toolTip = tr("Undefined step");
+            foreground = QBrush(Qt::red);
+            break;
+
+        case TDriverFeaturStepMatcher::Matched:
+        case TDriverFeaturStepMatcher::Ambiguous: {
+            const TDriverFeaturStepDefinition &first = matcher->definition(match.definitions.first());
+            definitionPath = QString("%1:%2").arg(first.path, QString::number(first.lineNum));
+
+            toolTip = (match.status == TDriverFeaturStepMatcher::Matched)
+                    ? tr("Defined by:")
+                    : tr("Ambiguous step, defined by:");
+            foreach (int defIndex, match.definitions) {
+                const TDriverFeaturStepDefinition &definition = matcher->definition(defIndex);
+                toolTip += QString("\n%1:%2: %3").arg(definition.path, QString::number(definition.lineNum), definition.source);
+            }
+
+            if (match.status == TDriverFeaturStepMatcher::Ambiguous) {
+                foreground = QBrush(Qt::darkYellow);
+            }
+            break;
+        }
+        }
+
+        if (foreground.isValid()) view()->setItemDelegateForRow(row, _styleDelegate);
+        model()->setData(index, definitionPath, StepDefinitionRole);
+        model()->setData(index, toolTip, Qt::ToolTipRole);
+        model()->setData(index, foreground, Qt::ForegroundRole);
+    }
+
+    qDebug() << FCFL << rows << "steps against" << matcher->definitionCount() << "definitions, time" << float(t.elapsed())/1000.0;
+}
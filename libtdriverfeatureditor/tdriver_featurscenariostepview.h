@@ -28,10 +28,13 @@ class LIBTDRIVERFEATUREDITORSHARED_EXPORT TDriverFeaturScenarioStepView : public
 public:
     explicit TDriverFeaturScenarioStepView(QWidget *parent = 0);
 
+    virtual void setStepMatcher(TDriverFeaturStepMatcher *matcher);
+
 signals:
 
 public slots:
-
+    virtual int reScan();
+    void resolveSteps();
 
 };
 
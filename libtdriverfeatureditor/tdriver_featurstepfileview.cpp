@@ -18,6 +18,7 @@
 ****************************************************************************/
 
 #include "tdriver_featurstepfileview.h"
+#include "tdriver_featurstepmatcher.h"
 
 #include <tdriver_debug_macros.h>
 
@@ -54,37 +55,24 @@ void TDriverFeaturStepFileView::resetPath(const QString &path)
     TDriverFeaturAbstractView::resetPath(info.canonicalFilePath());
 }
 
+
 int TDriverFeaturStepFileView::doDirScan()
 {
-    // update file list,
-    // then make sure display is updated,
-    // and schedule file content scan to be called from event loop
+    // step definitions of previous directory are dropped, found files add theirs
+    if (stepMatcher()) stepMatcher()->clear();
+    return TDriverFeaturAbstractView::doDirScan();
+}
 
-    int ret = TDriverFeaturAbstractView::doDirScan();
-    update();
-    QMetaObject::invokeMethod(this, "readFoundFiles", Qt::QueuedConnection);
 
-    return ret;
+void TDriverFeaturStepFileView::indexScanStarted(int scanId)
+{
+    if (stepMatcher() && scanId == indexScanId()) stepMatcher()->clear();
+    TDriverFeaturAbstractView::indexScanStarted(scanId);
 }
 
-void TDriverFeaturStepFileView::readFoundFiles()
+
+void TDriverFeaturStepFileView::indexScanBatch(int scanId, QList<TDriverFeaturIndexEntry> entries)
 {
-    int rows = model()->rowCount();
-
-    for (int row=0; row < rows; ++row) {
-        QModelIndex index(model()->index(row, 0));
-        QString path = model()->data(index, ActualPathRole).toString();
-        QFile file(path);
-        if (file.open(QFile::ReadOnly)) {
-            //qDebug() << FCFL << path << "OPEN";
-            model()->setData(index, file.readAll(), Qt::ToolTipRole/*FileContentRole*/);
-            file.close();
-            //model()->setData(index, QBrush(Qt::green), Qt::ForegroundRole);
-        }
-        else {
-            qDebug() << FCFL << path << "ERROR" << file.errorString();
-            view()->setItemDelegateForRow(row, _styleDelegate);
-            model()->setData(index, QBrush(Qt::red), Qt::ForegroundRole);
-        }
-    }
+    TDriverFeaturAbstractView::indexScanBatch(scanId, entries);
+    if (stepMatcher() && scanId == indexScanId()) stepMatcher()->addDefinitions(entries);
 }
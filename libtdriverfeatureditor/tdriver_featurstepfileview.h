@@ -34,9 +34,12 @@ signals:
 public slots:
     void resetPath(const QString &path);
 
+protected slots:
+    virtual void indexScanStarted(int scanId);
+    virtual void indexScanBatch(int scanId, QList<TDriverFeaturIndexEntry> entries);
+
 protected:
     virtual int doDirScan();
-    Q_INVOKABLE virtual void readFoundFiles();
 
 private:
     bool __overridePath;
@@ -0,0 +1,325 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include "tdriver_featurstepmatcher.h"
+
+#include <tdriver_debug_macros.h>
+
+#include <QTimer>
+#include <QStringList>
+
+
+/*!
+    \class TDriverFeaturStepMatcher
+    \brief Resolves Gherkin steps to step definitions without running cucumber.
+
+    Step definitions are parsed from step definition lines of the feature indexer,
+    and their Ruby regular expressions are converted to QRegExp.
+    Most definitions start with literal text, so definitions are grouped by first
+    word of that text, and a step is tried only against definitions of its first word
+    whose whole literal prefix it starts with, and definitions without a usable prefix.
+    Results are cached by step text until definitions change.
+ */
+
+
+// Finds end of delimited literal starting after open char at pos, with nesting for bracket pairs
+static int delimitedEnd(const QString &text, int pos, QChar open, QChar close)
+{
+    int depth = 0;
+
+    for (int ii = pos; ii < text.size(); ++ii) {
+        const QChar ch = text.at(ii);
+        if (ch == '\\') ++ii;
+        else if (ch == close && depth == 0) return ii;
+        else if (ch == close) --depth;
+        else if (ch == open && open != close) ++depth;
+    }
+
+    return -1;
+}
+
+
+// Converts a Ruby regexp to QRegExp syntax, as far as QRegExp supports the features
+static QString convertRubyRegex(const QString &body)
+{
+    QString result;
+    result.reserve(body.size());
+    bool inClass = false;
+    bool afterQuantifier = false;
+
+    for (int ii = 0; ii < body.size(); ++ii) {
+        const QChar ch = body.at(ii);
+
+        if (ch == '\\' && ii+1 < body.size()) {
+            const QChar next = body.at(++ii);
+            if (inClass) { result += ch; result += next; }
+            else if (next == 'A') result += '^';
+            else if (next == 'z' || next == 'Z') result += '$';
+            else if (next == 'h') result += "[0-9a-fA-F]";
+            else if (next == '/') result += '/';
+            else { result += ch; result += next; }
+            afterQuantifier = false;
+            continue;
+        }
+
+        if (inClass) {
+            if (ch == ']') inClass = false;
+            result += ch;
+            continue;
+        }
+
+        if (ch == '[') {
+            inClass = true;
+            result += ch;
+            // ']' right after '[' or '[^' is literal
+            if (ii+1 < body.size() && body.at(ii+1) == '^') result += body.at(++ii);
+            if (ii+1 < body.size() && body.at(ii+1) == ']') result += body.at(++ii);
+        }
+        else if (ch == '?' && afterQuantifier) {
+            // QRegExp has no lazy quantifiers, greedy ones match the same steps
+        }
+        else if (ch == '(' && body.mid(ii+1, 2) == "?<"
+                 && ii+3 < body.size() && body.at(ii+3) != '=' && body.at(ii+3) != '!') {
+            // named group becomes plain capture
+            const int nameEnd = body.indexOf('>', ii);
+            if (nameEnd < 0) return QString();
+            result += ch;
+            ii = nameEnd;
+        }
+        else {
+            result += ch;
+        }
+
+        afterQuantifier = (ch == '*' || ch == '+' || ch == '?' || ch == '}');
+    }
+
+    return result;
+}
+
+
+// Returns literal text every match of pattern starts with, or empty string
+static QString literalPrefix(const QString &pattern)
+{
+    if (!pattern.startsWith('^')) return QString();
+
+    // top level alternation makes any prefix optional
+    int depth = 0;
+    for (int ii = 1; ii < pattern.size(); ++ii) {
+        const QChar ch = pattern.at(ii);
+        if (ch == '\\') ++ii;
+        else if (ch == '(') ++depth;
+        else if (ch == ')') --depth;
+        else if (ch == '|' && depth == 0) return QString();
+    }
+
+    static const QString special("()[]{}.*+?|^$");
+    QString prefix;
+
+    for (int ii = 1; ii < pattern.size(); ++ii) {
+        const QChar ch = pattern.at(ii);
+
+        if (ch == '\\') {
+            // escaped punctuation is literal, escaped letters are character classes
+            if (ii+1 >= pattern.size() || pattern.at(ii+1).isLetterOrNumber()) break;
+            prefix += pattern.at(++ii);
+        }
+        else if (special.contains(ch)) {
+            // last char may be left out by these quantifiers
+            if (ch == '?' || ch == '*' || ch == '{') prefix.chop(1);
+            break;
+        }
+        else {
+            prefix += ch;
+        }
+    }
+
+    return prefix;
+}
+
+
+TDriverFeaturStepMatcher::TDriverFeaturStepMatcher(QObject *parent) :
+    QObject(parent)
+  , changeTimer(new QTimer(this))
+{
+    // definitions arrive in many batches, views are told once
+    changeTimer->setSingleShot(true);
+    changeTimer->setInterval(100);
+    connect(changeTimer, SIGNAL(timeout()), SIGNAL(definitionsChanged()));
+}
+
+
+void TDriverFeaturStepMatcher::clear()
+{
+    definitions.clear();
+    keyedDefinitions.clear();
+    unkeyedDefinitions.clear();
+    matchCache.clear();
+    changeTimer->start();
+}
+
+
+void TDriverFeaturStepMatcher::addDefinitions(const QList<TDriverFeaturIndexEntry> &entries)
+{
+    const int oldCount = definitions.size();
+    int unusable = 0;
+
+    foreach (const TDriverFeaturIndexEntry &entry, entries) {
+        foreach (const TDriverFeaturIndexLine &line, entry.lines) {
+            if (!addDefinition(entry.path, line.lineNum, line.text)) ++unusable;
+        }
+    }
+
+    if (unusable > 0) {
+        qDebug() << FCFL << "no usable step definition on" << unusable << "lines of" << entries.size() << "files";
+    }
+
+    if (definitions.size() != oldCount) {
+        matchCache.clear();
+        changeTimer->start();
+    }
+}
+
+
+bool TDriverFeaturStepMatcher::addDefinition(const QString &path, int lineNum, const QString &line)
+{
+    TDriverFeaturStepDefinition definition;
+
+    if (!parseDefinition(line, definition.source, definition.rx)) return false;
+
+    definition.path = path;
+    definition.lineNum = lineNum;
+    definition.prefix = literalPrefix(definition.rx.pattern());
+
+    const int index = definitions.size();
+    definitions.append(definition);
+
+    // first word is usable only if prefix continues after it
+    const int wordEnd = definition.prefix.indexOf(' ');
+    if (wordEnd > 0) {
+        keyedDefinitions[definition.prefix.left(wordEnd).toLower()].append(index);
+    }
+    else {
+        unkeyedDefinitions.append(index);
+    }
+
+    matchCache.clear();
+    return true;
+}
+
+
+TDriverFeaturStepMatcher::Match TDriverFeaturStepMatcher::match(const QString &stepLine) const
+{
+    const QString text(stepText(stepLine));
+    if (text.isNull()) return Match();
+
+    QHash<QString, Match>::const_iterator cached = matchCache.constFind(text);
+    if (cached != matchCache.constEnd()) return *cached;
+
+    Match result;
+    const QVector<int> &keyed = keyedDefinitions.value(text.section(' ', 0, 0).toLower());
+
+    for (int pass = 0; pass < 2; ++pass) {
+        const QVector<int> &candidates = (pass == 0) ? keyed : unkeyedDefinitions;
+
+        foreach (int index, candidates) {
+            const TDriverFeaturStepDefinition &definition = definitions.at(index);
+
+            if (!definition.prefix.isEmpty()
+                    && !text.startsWith(definition.prefix, definition.rx.caseSensitivity())) continue;
+
+            if (definition.rx.indexIn(text) >= 0) result.definitions.append(index);
+        }
+    }
+
+    qSort(result.definitions);
+
+    switch (result.definitions.size()) {
+    case 0: result.status = Undefined; break;
+    case 1: result.status = Matched; break;
+    default: result.status = Ambiguous; break;
+    }
+
+    matchCache.insert(text, result);
+    return result;
+}
+
+
+// Returns step text without keyword, or null string if line is not a step
+QString TDriverFeaturStepMatcher::stepText(const QString &stepLine)
+{
+    static const QRegExp keywordEx("^\\s*(Given|When|Then|And|But|\\*)\\s+");
+
+    if (keywordEx.indexIn(stepLine) < 0) return QString();
+    return stepLine.mid(keywordEx.matchedLength()).trimmed();
+}
+
+
+// Parses regexp or string of a step definition line, like: Given /^I have (\d+) items$/ do |count|
+bool TDriverFeaturStepMatcher::parseDefinition(const QString &line, QString &source, QRegExp &rx)
+{
+    static const QRegExp keywordEx("^\\s*(Given|When|Then|And|But)\\s*\\(?\\s*");
+
+    if (keywordEx.indexIn(line) < 0) return false;
+    int pos = keywordEx.matchedLength();
+    if (pos >= line.size()) return false;
+
+    QString pattern;
+    Qt::CaseSensitivity cs = Qt::CaseSensitive;
+    QChar open = line.at(pos);
+    int begin = pos+1;
+
+    if (open == '%' && line.mid(pos+1, 1) == "r" && pos+2 < line.size()) {
+        open = line.at(pos+2);
+        begin = pos+3;
+    }
+    else if (open == '"' || open == '\'') {
+        // string step definitions match whole step, $words match anything
+        const int end = delimitedEnd(line, begin, open, open);
+        if (end < 0) return false;
+
+        source = line.mid(pos, end-pos+1);
+        pattern = QRegExp::escape(line.mid(begin, end-begin));
+        pattern.replace(QRegExp("\\\\\\$\\w+"), "(.*)");
+        rx = QRegExp('^' + pattern + '$');
+        return rx.isValid();
+    }
+    else if (open != '/') {
+        return false;
+    }
+
+    static const QString opens("({[<");
+    static const QString closes(")}]>");
+    const int pairIndex = opens.indexOf(open);
+    const QChar close = (pairIndex >= 0) ? closes.at(pairIndex) : open;
+
+    const int end = delimitedEnd(line, begin, open, close);
+    if (end < 0) return false;
+
+    // only case insensitivity flag affects matching of single line steps
+    for (int ii = end+1; ii < line.size() && line.at(ii).isLetter(); ++ii) {
+        if (line.at(ii) == 'i') cs = Qt::CaseInsensitive;
+    }
+
+    source = line.mid(pos, end-pos+1);
+    pattern = convertRubyRegex(line.mid(begin, end-begin));
+    if (pattern.isEmpty()) return false;
+
+    rx = QRegExp(pattern, cs);
+    return rx.isValid();
+}
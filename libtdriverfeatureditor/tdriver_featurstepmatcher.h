@@ -0,0 +1,88 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef TDRIVER_FEATURSTEPMATCHER_H
+#define TDRIVER_FEATURSTEPMATCHER_H
+
+#include "libtdriverfeatureditor_global.h"
+#include "tdriver_featurindexer.h"
+
+#include <QObject>
+#include <QString>
+#include <QRegExp>
+#include <QVector>
+#include <QHash>
+
+class QTimer;
+
+
+struct TDriverFeaturStepDefinition {
+    QString path;
+    int lineNum;
+    QString source; // regexp or string as written in step file
+    QRegExp rx;
+    QString prefix; // literal text every matching step starts with
+};
+
+
+class LIBTDRIVERFEATUREDITORSHARED_EXPORT TDriverFeaturStepMatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum MatchStatus { NotStep, Undefined, Matched, Ambiguous };
+
+    struct Match {
+        MatchStatus status;
+        QVector<int> definitions; // indexes of matching definitions
+        Match() : status(NotStep) {}
+    };
+
+    explicit TDriverFeaturStepMatcher(QObject *parent = 0);
+
+    void clear();
+    void addDefinitions(const QList<TDriverFeaturIndexEntry> &entries);
+    bool addDefinition(const QString &path, int lineNum, const QString &line);
+
+    int definitionCount() const { return definitions.size(); }
+    const TDriverFeaturStepDefinition &definition(int index) const { return definitions.at(index); }
+
+    // matches a step line of a feature file, with or without leading keyword
+    Match match(const QString &stepLine) const;
+
+    static QString stepText(const QString &stepLine);
+    static bool parseDefinition(const QString &line, QString &source, QRegExp &rx);
+
+signals:
+    // emitted once after definitions were added or cleared, steps should be matched again
+    void definitionsChanged();
+
+private:
+    QVector<TDriverFeaturStepDefinition> definitions;
+
+    // definitions by lowercase first word of their prefix, others are tried for every step
+    QHash<QString, QVector<int> > keyedDefinitions;
+    QVector<int> unkeyedDefinitions;
+
+    mutable QHash<QString, Match> matchCache;
+
+    QTimer *changeTimer;
+};
+
+#endif // TDRIVER_FEATURSTEPMATCHER_H
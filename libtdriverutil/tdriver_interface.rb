@@ -53,6 +53,7 @@ $lg.debug " ==================================== OPEN"
 
 require 'benchmark'
 require 'socket'
+require 'thread'
 
 
 begin
@@ -126,7 +127,7 @@ def create_output_file(dir, prefix, extension)
   file = nil
 
   begin
-    filename = File.join( @working_directory, prefix+"_#{index}."+extension )
+    filename = File.join( dir, prefix+"_#{index}."+extension )
     file = File.open(filename, "w")
   rescue => ex
     $lg.error "retry after failure to create #{filename}: #{ex.message}"
@@ -235,11 +236,11 @@ def makeMsg(seqnum, name, map)
     itemdata = ""
     value.to_a.each do |item|
       item_s = item.to_s
-      itemdata += [item_s.length, item_s].pack('NA*')
+      itemdata += [item_s.bytesize, item_s].pack('NA*')
     end
-    mapdata += [ key_s.length, key_s].pack('NA*')+[itemdata.length, itemdata].pack('NA*')
+    mapdata += [ key_s.bytesize, key_s].pack('NA*')+[itemdata.bytesize, itemdata].pack('NA*')
   end
-  data = [seqnum, name.length, name].pack('NNA*')+[mapdata.length, mapdata].pack('NA*')
+  data = [seqnum, name.bytesize, name].pack('NNA*')+[mapdata.bytesize, mapdata].pack('NA*')
   return data
 end
 
@@ -573,6 +574,59 @@ class ListenerObject
 
     instance_eval { | | $lg.debug "initial working directory: " + @working_directory }
 
+    # worker queues of visualization commands, keyed by sut id and lane
+    @workers = Hash.new
+    # workers remove themselves from @workers when they exit
+    @workers_mutex = Mutex.new
+    # replies from different workers must not interleave on the connection
+    @write_mutex = Mutex.new
+    # sut connection is shared by workers of a sut
+    @sut_locks = Hash.new
+    @sut_locks_mutex = Mutex.new
+
+  end
+
+  # reply of the command being evaluated, each worker thread has its own
+  def listener_reply
+    Thread.current[ :listener_reply ]
+  end
+
+  def with_sut_lock( sut_id )
+    lock = @sut_locks_mutex.synchronize { @sut_locks[ sut_id.to_s ] ||= Mutex.new }
+    lock.synchronize { yield }
+  end
+
+  # interactive code may use any sut, so every sut known so far is locked,
+  # always in same order so that workers waiting for one of them can't deadlock
+  def with_all_sut_locks( &block )
+    sut_ids = @sut_locks_mutex.synchronize { @sut_locks.keys.sort }
+    sut_ids.reverse.inject( block ) { | inner, sut_id | lambda { with_sut_lock( sut_id ) { inner.call } } }.call
+  end
+
+  # output directory of the command being evaluated, it is given with the request
+  # because set_output_path may change @working_directory while workers are busy
+  def working_directory
+    Thread.current[ :working_directory ] || @working_directory
+  end
+
+  # puts payload in reply as "<key>_data" when client asked for inline payloads,
+  # otherwise writes it to a new file and puts file name in reply as "<key>_filename"
+  def reply_payload( key, data, prefix, extension )
+    if Thread.current[ :inline_payload ]
+      # name of the file the payload would have been written to, client may save it with this name
+      listener_reply[ "#{ key }_filename" ] = [ File.join( working_directory, prefix + "." + extension ) ]
+      listener_reply[ "#{ key }_data" ] = [ data ]
+      $lg.debug calling_method + " #{ data.bytesize/1024.0 } KiB inline"
+    else
+      filename, file = create_output_file(working_directory, prefix, extension )
+      begin
+        file << data
+      ensure
+        file.close
+      end
+      listener_reply[ "#{ key }_filename" ] = [ filename ]
+      $lg.debug calling_method + " wrote #{File.size?(filename).to_i/1024.0} KiB to '#{filename}'"
+    end
   end
 
   def set_working_directory( dir )
@@ -580,7 +634,7 @@ class ListenerObject
   end
 
   def check_version
-    @listener_reply['version'] = [ ENV['TDRIVER_VERSION'] ]
+    listener_reply['version'] = [ ENV['TDRIVER_VERSION'] ]
   end
 
 
@@ -600,28 +654,19 @@ class ListenerObject
       _klass = MobyBase::BehaviourFactory.instance
     end
 
-    filename_xml, file_xml = create_output_file(@working_directory, "visualizer_behaviours_#{ sut_id }", 'xml' )
-    begin
-      behaviour_attributes_hash = { :input_type => ['*', sut.input.to_s ], :sut_type => [ '*', sut.ui_type.upcase ], :version => [ '*', sut.ui_version ] }
-      behaviours_xml = ""
-      object_types.each do | object_type |
-        behaviours_xml <<
-          "<behaviour object_type=\"#{ object_type.to_s }\">\n" <<
-            MobyUtil::XML::parse_string(
-              _klass.to_xml( behaviour_attributes_hash.merge( { :object_type => ( object_type == 'sut' ? [ 'sut' ] : [ '*', object_type ] ) } ) )
-            ).root.xpath('/behaviours/behaviour/object_methods/object_method').to_s <<
-          "\n</behaviour>\n"
-      end
-
-      file_xml << MobyUtil::XML::parse_string( "<behaviours>\n#{ behaviours_xml }\n</behaviours>" ).to_s
-    rescue
-      file_xml.close
-      raise
+    behaviour_attributes_hash = { :input_type => ['*', sut.input.to_s ], :sut_type => [ '*', sut.ui_type.upcase ], :version => [ '*', sut.ui_version ] }
+    behaviours_xml = ""
+    object_types.each do | object_type |
+      behaviours_xml <<
+        "<behaviour object_type=\"#{ object_type.to_s }\">\n" <<
+          MobyUtil::XML::parse_string(
+            _klass.to_xml( behaviour_attributes_hash.merge( { :object_type => ( object_type == 'sut' ? [ 'sut' ] : [ '*', object_type ] ) } ) )
+          ).root.xpath('/behaviours/behaviour/object_methods/object_method').to_s <<
+        "\n</behaviour>\n"
     end
-    file_xml.close
-    $lg.debug this_method + " wrote #{File.size?(filename_xml)/1024.0} KiB to '#{filename_xml}'"
 
-    @listener_reply['behaviour_filename'] = [ filename_xml ]
+    reply_payload( 'behaviour', MobyUtil::XML::parse_string( "<behaviours>\n#{ behaviours_xml }\n</behaviours>" ).to_s,
+                   "visualizer_behaviours_#{ sut_id }", 'xml' )
   end
 
 
@@ -635,7 +680,7 @@ class ListenerObject
   #    file_xml.close
   #  end
   #  $lg.debug this_method + " wrote #{File.size?(filename_xml)/1024.0} KiB to '#{filename_xml}'"
-  #  @listener_reply['fixture_filename'] = [ filename_xml ]
+  #  listener_reply['fixture_filename'] = [ filename_xml ]
   #end
 
 
@@ -650,21 +695,16 @@ class ListenerObject
     end
 
 
-    filename_xml, file_xml = create_output_file(@working_directory, "visualizer_class_signals_#{ sut_id }", 'xml' )
     begin
-      data = obj.fixture('signal', 'list_signals')      
-      file_xml << data
+      data = obj.fixture('signal', 'list_signals')
     rescue Exception => e
-      file_xml << '<tasMessage version="1.3">
+      data = '<tasMessage version="1.3">
       <tasInfo id="1" name="QtSignals" type="QtSignals">
         <obj env="qt" id="0" name="no signals" type="QtSignal" />
       </tasInfo>
     </tasMessage>'
-    ensure
-      file_xml.close
     end
-    $lg.debug this_method + " wrote #{File.size?(filename_xml)/1024.0} KiB to '#{filename_xml}'"
-    @listener_reply['signal_filename'] = [ filename_xml ]
+    reply_payload( 'signal', data, "visualizer_class_signals_#{ sut_id }", 'xml' )
   end
 
 
@@ -672,43 +712,42 @@ class ListenerObject
     MobyUtil::Parameter[ sut.id ][ :filter_type] = 'none'
     MobyUtil::Parameter[ sut.id ][ :use_find_object] = 'false'
 
-    filename_xml, file_xml = create_output_file(@working_directory, "visualizer_dump_#{ sut_id }", 'xml' )
-    begin
-      data = sut.get_ui_dump( *[ ( { :id => app_id } unless app_id.nil? ) ].compact )
-      file_xml << data
-	rescue Errno::ECONNRESET
-	 #Connection lost retry
-	 sut.disconnect
-	 sut.connect(:Id => sut.id)
-	 data = sut.get_ui_dump( *[ ( { :id => app_id } unless app_id.nil? ) ].compact )
-     file_xml << data
-    ensure
-      file_xml.close
-    end
+    data = with_sut_lock( sut_id ) {
+      begin
+        sut.get_ui_dump( *[ ( { :id => app_id } unless app_id.nil? ) ].compact )
+      rescue Errno::ECONNRESET
+        #Connection lost retry
+        sut.disconnect
+        sut.connect(:Id => sut.id)
+        sut.get_ui_dump( *[ ( { :id => app_id } unless app_id.nil? ) ].compact )
+      end
+    }
 
-    $lg.debug this_method + " wrote #{File.size?(filename_xml)/1024.0} KiB to '#{filename_xml}'"
-    @listener_reply['ui_filename'] = [ filename_xml ]
+    # dump is written or sent while other workers may use the sut
+    reply_payload( 'ui', data, "visualizer_dump_#{ sut_id }", 'xml' )
   end
 
 
   def capture_screen( sut, sut_id, app_id = nil )
-    filename_png, file_png = create_output_file(@working_directory, "visualizer_dump_#{ sut_id }", 'png' )
+    filename_png, file_png = create_output_file(working_directory, "visualizer_dump_#{ sut_id }", 'png' )
     begin
       file_png.close
       source = 'nowhere!'
-      if app_id.nil?
-        sut.capture_screen( :Filename => filename_png, :Redraw => true )
-        source = 'sut'
-      else
-        begin
-          sut.application( :id => app_id ).capture_screen( "PNG", filename_png, true )
-          source = 'app'
-        rescue
-          app_id = nil
+      with_sut_lock( sut_id ) {
+        if app_id.nil?
           sut.capture_screen( :Filename => filename_png, :Redraw => true )
           source = 'sut'
+        else
+          begin
+            sut.application( :id => app_id ).capture_screen( "PNG", filename_png, true )
+            source = 'app'
+          rescue
+            app_id = nil
+            sut.capture_screen( :Filename => filename_png, :Redraw => true )
+            source = 'sut'
+          end
         end
-      end
+      }
       $lg.debug this_method + " got #{File.size?(filename_png)/1024.0} KiB to '#{filename_png}' from #{source}"
 
     rescue => ex
@@ -717,23 +756,26 @@ class ListenerObject
       raise ex unless ex.message == "QtTasserver does not support the given service: screenShot"
       filename_png = ""
     end
-    @listener_reply['image_filename'] = [ filename_png ]
+
+    if Thread.current[ :inline_payload ] and not filename_png.empty?
+      # tdriver can only capture to a file, so pass its content on and remove it
+      data = File.open( filename_png, 'rb' ) { | file | file.read }
+      File.delete( filename_png )
+      reply_payload( 'image', data, "visualizer_dump_#{ sut_id }", 'png' )
+    else
+      listener_reply['image_filename'] = [ filename_png ]
+    end
   end
 
 
   def get_app_list( sut, sut_id )
-    filename_xml, file_xml = create_output_file(@working_directory, "visualizer_applications_#{ sut_id }", 'xml' )
     begin
       output = sut.list_apps
-      file_xml << output
-	rescue Exception => e
-      file_xml << '<tasMessage version="1.3">      
+    rescue Exception => e
+      output = '<tasMessage version="1.3">
     </tasMessage>'
-    ensure
-      file_xml.close
     end
-
-    @listener_reply['applications_filename'] = [ filename_xml ]
+    reply_payload( 'applications', output, "visualizer_applications_#{ sut_id }", 'xml' )
   end
 
 
@@ -744,7 +786,7 @@ class ListenerObject
 
   def get_recorded_script( sut, app_id )
     application = sut.application( :id => app_id )
-    filename_rb, file_rb = create_output_file(@working_directory, 'visualizer_rec_fragment', 'rb')
+    filename_rb, file_rb = create_output_file(working_directory, 'visualizer_rec_fragment', 'rb')
     begin
       script = MobyUtil::Recorder.print_script( sut, application )
       file_rb << script
@@ -752,7 +794,7 @@ class ListenerObject
       file_rb.close
     end
     $lg.debug this_method + " wrote #{File.size?(filename_rb)/1024.0} KiB to '#{filename_rb}'"
-    @listener_reply['record_filename'] = [ filename_rb ]
+    listener_reply['record_filename'] = [ filename_rb ]
   end
 
 
@@ -768,7 +810,7 @@ class ListenerObject
 
   def get_parameter( sut_id, para )
     para_value = MobyUtil::Parameter[ sut_id.to_sym ][ para.to_sym, nil ]
-    @listener_reply['parameter'] = [ para.to_s, para_value.inspect ]
+    listener_reply['parameter'] = [ para.to_s, para_value.inspect ]
   end
 
 
@@ -780,8 +822,8 @@ class ListenerObject
       keys << key.to_s
       values << value.inspect
     end
-    @listener_reply['keys'] = keys
-    @listener_reply['values'] = values
+    listener_reply['keys'] = keys
+    listener_reply['values'] = values
   end
 
 
@@ -789,180 +831,255 @@ class ListenerObject
     old = @working_directory
     set_working_directory( MobyUtil::FileHelper.fix_path( File.expand_path( new_path.to_s ) + "/" ) )
     $lg.debug this_method + " @working_directory changed '#{old}' -> '#{@working_directory}'"
-    @listener_reply['output_path'] = [ @working_directory.to_s ]
+    listener_reply['output_path'] = [ @working_directory.to_s ]
   end
 
-  def main_loop (conn)
-    recorder = nil
-    interact = Code_evaluation_sandbox.new
+  # evaluates a visualization command, returns the reply
+  def evaluate_visualization( input_array, inline = false, dir = @working_directory )
+    Thread.current[ :listener_reply ] = Hash.new
+    Thread.current[ :inline_payload ] = inline
+    Thread.current[ :working_directory ] = dir
 
-    while not conn.closed? do
-      STDOUT.flush
-      STDERR.flush
-      #$lg.debug this_method + " reading message"
-      seqNumIn = nameIn = dataIn = nil
-      benchtime = Benchmark.measure {
-        seqNumIn, nameIn, dataIn = readMessage(conn)
-      }.real
-      $lg.debug this_method + " GOT message after time: #{benchtime}"
-      msgIn = parseArrayHash(dataIn)
-      $lg.debug this_method + " MSG #{seqNumIn} #{nameIn} : #{msgIn.inspect}"
+    if input_array.size >= 2
+      sut_id = input_array.first.to_sym
+      cmd = input_array[1].downcase.to_sym
+      eval_cmd = ""
+      error = false
 
-      #listener.rb was old script, which had STDIN/STDOUT interface
-      if ((nameIn == VISUALIZATION_ID) and
-            msgIn.key?('input') and
-            not (input_array = msgIn['input']).empty?)
-      then
-        @listener_reply = Hash.new
-        # handle commands where input_array length is 1
-        break if ( input_array[0] == "quit" )
+      sut = nil
+      begin
+        # connect to sut, unless command does not require it
+        sut = with_sut_lock( sut_id ) { TDriver.connect_sut( :Id => sut_id ) } unless [ :get_parameter, :get_all_parameters, :set_output_path, :check_version ].include?( cmd )
 
-        if input_array.size >= 2
-          sut_id = input_array.first.to_sym
-          cmd = input_array[1].downcase.to_sym
-          eval_cmd = ""
-          error = false
+        begin
+          if sut then
+            #$lg.debug this_method + " before adjust: #{MobyUtil::Parameter[ sut.id ][:filter_type]} #{MobyUtil::Parameter[ sut.id ][:socket_read_timeout]} #{MobyUtil::Parameter[ sut.id ][:socket_write_timeout]} #{MobyUtil::Parameter[ sut.id ][:default_timeout]}"
+            MobyUtil::Parameter[ sut.id ][ :filter_type] = 'none'
+            #              MobyUtil::Parameter[ sut.id ][ :socket_read_timeout] = '10'
+            #              MobyUtil::Parameter[ sut.id ][ :socket_write_timeout] = '10'
+            #              MobyUtil::Parameter[ sut.id ][ :default_timeout] = '10'
+            #$lg.debug this_method + " after adjust: #{MobyUtil::Parameter[ sut.id ][:filter_type]} #{MobyUtil::Parameter[ sut.id ][:socket_read_timeout]} #{MobyUtil::Parameter[ sut.id ][:socket_write_timeout]} #{MobyUtil::Parameter[ sut.id ][:default_timeout]}"
+          end
+        rescue
+        end
 
-          sut = nil
-          begin
-            # connect to sut, unless command does not require it
-            sut = TDriver.connect_sut( :Id => sut_id ) unless [ :get_parameter, :get_all_parameters, :set_output_path, :check_version ].include?( cmd )
+      rescue => ex
+        $lg.error this_method + " sut connect exception #{ex.class}: #{ex.message}"
+        listener_reply['exception'] = [ ex.class.to_s, ex.message.to_s, ex.backtrace.join('\n') ]
+        listener_reply['error'] = [ "Error: connection to sut (#{sut_id}) failed" ]
+        error = true
+      end
 
-            begin
-              if sut then
-                #$lg.debug this_method + " before adjust: #{MobyUtil::Parameter[ sut.id ][:filter_type]} #{MobyUtil::Parameter[ sut.id ][:socket_read_timeout]} #{MobyUtil::Parameter[ sut.id ][:socket_write_timeout]} #{MobyUtil::Parameter[ sut.id ][:default_timeout]}"
-                MobyUtil::Parameter[ sut.id ][ :filter_type] = 'none'
-                #              MobyUtil::Parameter[ sut.id ][ :socket_read_timeout] = '10'
-                #              MobyUtil::Parameter[ sut.id ][ :socket_write_timeout] = '10'
-                #              MobyUtil::Parameter[ sut.id ][ :default_timeout] = '10'
-                #$lg.debug this_method + " after adjust: #{MobyUtil::Parameter[ sut.id ][:filter_type]} #{MobyUtil::Parameter[ sut.id ][:socket_read_timeout]} #{MobyUtil::Parameter[ sut.id ][:socket_write_timeout]} #{MobyUtil::Parameter[ sut.id ][:default_timeout]}"
-              end
-            rescue
-            end
+      if not error
 
-          rescue => ex
-            $lg.error this_method + " sut connect exception #{ex.class}: #{ex.message}"
-            @listener_reply['exception'] = [ ex.class.to_s, ex.message.to_s, ex.backtrace.join('\n') ]
-            @listener_reply['error'] = [ "Error: connection to sut (#{sut_id}) failed" ]
-            error = true
-          end
+        case cmd
 
-          if not error
+        when :check_version
+          eval_cmd = "check_version"
 
-            case cmd
+        when :set_output_path
+          eval_cmd = "set_output_path( '#{ input_array[2] }' )"
 
-            when :check_version
-              eval_cmd = "check_version"
+        when :get_behaviours
+          eval_cmd = "get_behaviours_xml( sut, '#{ sut_id }', [#{ input_array[2] }] )"
 
-            when :set_output_path
-              eval_cmd = "set_output_path( '#{ input_array[2] }' )"
+        when :refresh_ui
+          eval_cmd = "get_ui_dump( sut, '#{ sut_id.to_s }', #{ input_array.size > 2 ? "'#{ input_array[2] }'" : "nil" } )"
 
-            when :get_behaviours
-              eval_cmd = "get_behaviours_xml( sut, '#{ sut_id }', [#{ input_array[2] }] )"
+        when :refresh_image
+          eval_cmd = "capture_screen( sut, '#{ sut_id.to_s }', #{ input_array.size > 2 ? "'#{ input_array[2] }'" : "nil" } )"
 
-            when :refresh_ui
-              eval_cmd = "get_ui_dump( sut, '#{ sut_id.to_s }', #{ input_array.size > 2 ? "'#{ input_array[2] }'" : "nil" } )"
+        when :list_apps
+          eval_cmd = "get_app_list( sut, '#{ sut_id }' )"
 
-            when :refresh_image
-              eval_cmd = "capture_screen( sut, '#{ sut_id.to_s }', #{ input_array.size > 2 ? "'#{ input_array[2] }'" : "nil" } )"
+        when :disconnect
+          eval_cmd = "TDriver.disconnect_sut( :Id => '#{ sut_id }' )" # this does not work with qt
 
-            when :list_apps
-              eval_cmd = "get_app_list( sut, '#{ sut_id }' )"
+        when :get_parameter
+          eval_cmd = "get_parameter( sut_id , '#{ input_array[2] }' )"
 
-            when :disconnect
-              eval_cmd = "TDriver.disconnect_sut( :Id => '#{ sut_id }' )" # this does not work with qt
+        when :get_all_parameters
+          eval_cmd = "get_all_parameters( sut_id )"
 
-            when :get_parameter
-              eval_cmd = "get_parameter( sut_id , '#{ input_array[2] }' )"
+        when :tap
+          eval_cmd = "sut.application"
+          eval_cmd += "(:id=>'#{input_array[3]}')" if input_array.size > 3
+          eval_cmd += ".#{input_array[2]}.tap"
 
-            when :get_all_parameters
-              eval_cmd = "get_all_parameters( sut_id )"
+        #DISABLE_API_TAB_PENDING_REMOVAL
+        #when :check_fixture
+        #  eval_cmd = "check_api_fixture( sut )"
 
-            when :tap
-              eval_cmd = "sut.application"
-              eval_cmd += "(:id=>'#{input_array[3]}')" if input_array.size > 3
-              eval_cmd += ".#{input_array[2]}.tap"
+        #DISABLE_API_TAB_PENDING_REMOVAL
+        #when :fixture
+        #  eval_cmd = "get_fixture_xml( sut, '#{ sut_id }', '#{ input_array[2] }' )"
 
-            #DISABLE_API_TAB_PENDING_REMOVAL
-            #when :check_fixture
-            #  eval_cmd = "check_api_fixture( sut )"
+        when :press_key
+          eval_cmd = "sut.press_key( #{ input_array[2].to_sym } )"
 
-            #DISABLE_API_TAB_PENDING_REMOVAL
-            #when :fixture
-            #  eval_cmd = "get_fixture_xml( sut, '#{ sut_id }', '#{ input_array[2] }' )"
+        when :list_signals
+          eval_cmd = "get_signal_xml( sut, '#{ sut_id }', '#{ input_array[2] }', '#{ input_array[3] }', '#{ input_array[4] }')"
 
-            when :press_key
-              eval_cmd = "sut.press_key( #{ input_array[2].to_sym } )"
+        when :set_attribute
+          attributeName = input_array[4]
+          # note: with latest version of C++ code, join below is unnecessary, as input_array[5] is the entire value
+          attributeValue = input_array[ 5..input_array.size ].join(' ')
+          attributeType = input_array[3]
+          eval_cmd = "sut.application.#{ input_array[2] }.set_attribute( '#{attributeName}', '#{attributeValue}', '#{attributeType}' )"
 
-            when :list_signals
-              eval_cmd = "get_signal_xml( sut, '#{ sut_id }', '#{ input_array[2] }', '#{ input_array[3] }', '#{ input_array[4] }')"
+        when :start_record
+          eval_cmd = "start_recording(sut, #{ ( input_array.size > 2 ? "'#{ input_array[2] }'" : "nil" ) })"
 
-            when :set_attribute
-              attributeName = input_array[4]
-              # note: with latest version of C++ code, join below is unnecessary, as input_array[5] is the entire value
-              attributeValue = input_array[ 5..input_array.size ].join(' ')
-              attributeType = input_array[3]
-              eval_cmd = "sut.application.#{ input_array[2] }.set_attribute( '#{attributeName}', '#{attributeValue}', '#{attributeType}' )"
+        when :stop_record
+          eval_cmd = "get_recorded_script(sut, #{ ( input_array.size > 2 ? "'#{ input_array[2]}'" : "nil" ) })"
 
-            when :start_record
-              eval_cmd = "start_recording(sut, #{ ( input_array.size > 2 ? "'#{ input_array[2] }'" : "nil" ) })"
+        when :test_record
+          eval_cmd = "test_script(sut, '#{ input_array[2]}' )"
 
-            when :stop_record
-              eval_cmd = "get_recorded_script(sut, #{ ( input_array.size > 2 ? "'#{ input_array[2]}'" : "nil" ) })"
+        when :start_application
+          eval_cmd = "sut.run(:name=>'#{input_array[2]}', :arguments=>'#{input_array[3]}' )"
 
-            when :test_record
-              eval_cmd = "test_script(sut, '#{ input_array[2]}' )"
+        else
+          listener_reply['exception'] = []
+          listener_reply['error'] = [ "Error: no command matched (#{cmd})" ]
+          error = true
 
-            when :start_application
-              eval_cmd = "sut.run(:name=>'#{input_array[2]}', :arguments=>'#{input_array[3]}' )"
+        end #case cmd
 
-            else
-              @listener_reply['exception'] = []
-              @listener_reply['error'] = [ "Error: no command matched (#{cmd})" ]
+        if not error and not eval_cmd.empty?
+          benchtime = Benchmark.measure {
+            begin
+              #MobyUtil::Retryable.while( :times => 10, :timeout => 1, :exception => Exception ) do end
+              $lg.debug this_method + " cmd #{cmd} => eval_cmd '#{eval_cmd}'"
+              if [ :refresh_ui, :refresh_image ].include?( cmd )
+                # these lock the sut only while talking to it
+                eval( eval_cmd )
+              else
+                with_sut_lock( sut_id ) { eval( eval_cmd ) }
+              end
+            rescue => ex
+              listener_reply['exception'] = [ ex.class.to_s, ex.message.to_s, ex.backtrace.join('\n') ]
+              listener_reply['error'] = [ "Error: evaluating command (#{eval_cmd}) failed" ]
+              $lg.error this_method + " eval exception"
               error = true
-
-            end #case cmd
-
-            if not error and not eval_cmd.empty?
-              benchtime = Benchmark.measure {
-                begin
-                  #MobyUtil::Retryable.while( :times => 10, :timeout => 1, :exception => Exception ) do end
-                  $lg.debug this_method + " cmd #{cmd} => eval_cmd '#{eval_cmd}'"
-                  eval( eval_cmd )
-                rescue => ex
-                  @listener_reply['exception'] = [ ex.class.to_s, ex.message.to_s, ex.backtrace.join('\n') ]
-                  @listener_reply['error'] = [ "Error: evaluating command (#{eval_cmd}) failed" ]
-                  $lg.error this_method + " eval exception"
-                  error = true
-                end
-              }.real
-              $lg.debug this_method + " eval time: #{benchtime}"
             end
+          }.real
+          $lg.debug this_method + " eval time: #{benchtime}"
+        end
 
-          else
-          # error== true, because TDriver.connect_sut failed
+      else
+      # error== true, because TDriver.connect_sut failed
 
-          end # if !error
+      end # if !error
 
-        else
-          @listener_reply['exception'] = []
-          @listener_reply['error'] = [ "Error: not enough parameters in command (#{cmd})" ]
-          error = true
+    else
+      listener_reply['exception'] = []
+      listener_reply['error'] = [ "Error: not enough parameters in command (#{cmd})" ]
+      error = true
 
-        end # if array_size >= 2
+    end # if array_size >= 2
 
-        msgOut = @listener_reply
+    listener_reply
+  end
+
+
+  # visualization commands of a sut are evaluated in order by a worker thread,
+  # screen captures have a worker of their own so they run alongside ui dumps
+  def worker_queue( conn, sut_id, cmd )
+    lane = [ sut_id.to_s, ( cmd == :refresh_image ? 'image' : 'main' ) ]
+    @workers_mutex.synchronize { @workers[ lane ] ||= start_worker( conn, lane ) }
+  end
+
+
+  def start_worker( conn, lane )
+    $lg.debug this_method + " #{lane.inspect}"
+    queue = Queue.new
+    Thread.new {
+      begin
+        while ( request = queue.pop )
+          seqNum, name, input_array, inline, dir = request
+          begin
+            msgOut = evaluate_visualization( input_array, inline, dir )
+          rescue => ex
+            # failure of one request must not leave later requests of the lane unanswered
+            $lg.error this_method + " worker #{lane.inspect} request #{seqNum} exception #{ex.class}: #{ex.message}"
+            msgOut = { 'exception' => [ ex.class.to_s, ex.message.to_s, ex.backtrace.join('\n') ],
+                       'error' => [ "Error: evaluating command (#{input_array.join(' ')}) failed" ] }
+          end
+          send_reply( conn, seqNum, name, msgOut )
+        end
+      rescue => ex
+        $lg.error this_method + " worker #{lane.inspect} exception #{ex.class}: #{ex.message}"
+      ensure
+        # next request of this lane starts a new worker
+        @workers_mutex.synchronize { @workers.delete( lane ) if @workers[ lane ].equal?( queue ) }
+      end
+    }
+    queue
+  end
+
+
+  def stop_workers
+    @workers_mutex.synchronize {
+      @workers.each_value { | queue | queue << nil }
+      @workers.clear
+    }
+  end
+
+
+  # replies may be sent in any order, sequence number tells which request they belong to
+  def send_reply( conn, seqNum, name, msgOut )
+    @write_mutex.synchronize { writeRawData(conn, makeMsg(seqNum, name, msgOut)) }
+    msgStr = msgOut.inspect.to_s
+    msgStr = msgStr[0,1020] + " ..." if msgStr.size > 1024
+    $lg.info this_method + " SNT #{seqNum} #{name} : #{msgStr}"
+  end
+
+
+  def main_loop (conn)
+    recorder = nil
+    interact = Code_evaluation_sandbox.new
+
+    while not conn.closed? do
+      STDOUT.flush
+      STDERR.flush
+      #$lg.debug this_method + " reading message"
+      seqNumIn = nameIn = dataIn = nil
+      benchtime = Benchmark.measure {
+        seqNumIn, nameIn, dataIn = readMessage(conn)
+      }.real
+      $lg.debug this_method + " GOT message after time: #{benchtime}"
+      msgIn = parseArrayHash(dataIn)
+      $lg.debug this_method + " MSG #{seqNumIn} #{nameIn} : #{msgIn.inspect}"
+
+      #listener.rb was old script, which had STDIN/STDOUT interface
+      if ((nameIn == VISUALIZATION_ID) and
+            msgIn.key?('input') and
+            not (input_array = msgIn['input']).empty?)
+      then
+        # handle commands where input_array length is 1
+        break if ( input_array[0] == "quit" )
+
+        # output path is changed here, so requests queued after it get the new one
+        if input_array.size >= 2 and input_array[1].downcase.to_sym != :set_output_path
+          # commands run on worker of their sut, which sends the reply when done
+          worker_queue( conn, input_array[0], input_array[1].downcase.to_sym ) << [ seqNumIn, nameIn, input_array, msgIn.key?( 'inline' ), @working_directory ]
+          next
+        end
+
+        msgOut = evaluate_visualization( input_array )
 
       #ruby_interact.rb was old script, which had STDIN/STDOUT interface
       elsif ((nameIn == INTERACTION_ID) and
                 msgIn.key?('command') and
                 not (inputcmd = msgIn['command']).empty?)
       then
+        # workers may be using the suts at the same time
         case inputcmd[0]
           when "line_completion"
-            msgOut = interact.line_completion(inputcmd[1], seqNumIn)
+            msgOut = with_all_sut_locks { interact.line_completion(inputcmd[1], seqNumIn) }
           when "line_execution"
-            msgOut = interact.line_execution(inputcmd[1], seqNumIn)
+            msgOut = with_all_sut_locks { interact.line_execution(inputcmd[1], seqNumIn) }
           else
             msgOut = interact.invalidcmd(inputcmd)
         end
@@ -975,12 +1092,11 @@ class ListenerObject
 
       end # if !input
 
-      writeRawData(conn, makeMsg(seqNumIn, nameIn, msgOut))
-      msgStr = msgOut.inspect.to_s
-      msgStr = msgStr[0,1020] + " ..." if msgStr.size > 1024
-      $lg.info this_method + " SNT #{seqNumIn} #{nameIn} : #{msgStr}"
+      send_reply(conn, seqNumIn, nameIn, msgOut)
     end # while
 
+    stop_workers
+
   end # def listener_main_loop
 
 end
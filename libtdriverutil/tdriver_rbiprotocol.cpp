@@ -22,7 +22,6 @@
 // RBI stands for Ruby Interface
 
 #include <QCoreApplication>
-#include <QDataStream>
 #include <QAbstractSocket>
 #include <QHostAddress>
 
@@ -30,6 +29,8 @@
 #include <QMutexLocker>
 #include <QWaitCondition>
 #include <QThread>
+#include <QTime>
+#include <QtEndian>
 
 #include "tdriver_debug_macros.h"
 
@@ -37,10 +38,18 @@
 #define VALIDATE_THREAD (Q_ASSERT(validThread == NULL || validThread == QThread::currentThread()))
 #define VALIDATE_THREAD_NOT (Q_ASSERT(validThread != QThread::currentThread()))
 
+// longer lengths are taken as a corrupt stream, largest UI dumps are some tens of MB
+static const quint32 MaxNameLength = 1024;
+static const quint32 MaxDataLength = 256*1024*1024;
+
 
 TDriverRbiProtocol::TDriverRbiProtocol(QAbstractSocket *connection, QMutex *cm, QWaitCondition *mwc, QWaitCondition *hwc, QObject *parent) :
     QObject(parent),
     readState(ReadDisconnected),
+    readAmount(0),
+    readFilled(0),
+    dataLeft(0),
+    listLeft(0),
     conn(connection),
     syncMutex(cm),
     msgCond(mwc),
@@ -52,10 +61,6 @@ TDriverRbiProtocol::TDriverRbiProtocol(QAbstractSocket *connection, QMutex *cm,
 {
     helloMsg.clear();
 
-    condSeqNum = 0;
-    condName.clear();
-    condMsg.clear();
-
     connect(conn, SIGNAL(connected()), this, SLOT(connected()));
     connect(conn, SIGNAL(disconnected()), this, SLOT(disconnected()));
     connect(conn, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(connError(QAbstractSocket::SocketError)));
@@ -79,20 +84,85 @@ TDriverRbiProtocol::~TDriverRbiProtocol()
 void TDriverRbiProtocol::startNewMessage()
 {
     readState = ReadSeqNum;
-    readAmount = sizeof(quint32);
+    expectBytes(sizeof(quint32));
+}
+
+
+// Next element of message is read straight to a buffer of its final size,
+// returns false and closes connection if amount is not a sane length
+bool TDriverRbiProtocol::expectBytes(quint32 amount)
+{
+    if (amount > MaxDataLength) {
+        abortConnection("element length", amount);
+        return false;
+    }
+
+    readAmount = amount;
+    readFilled = 0;
+    readBuffer.resize(amount);
+    return true;
+}
+
+
+// Rest of stream can't be parsed after a bad length, so connection is closed
+void TDriverRbiProtocol::abortConnection(const char *what, quint32 length)
+{
+    qWarning() << FFL << "bad" << what << length << "received, closing connection";
+
+    readState = ReadDisconnected;
+    readAmount = 0;
+    readFilled = 0;
+    readBuffer = QByteArray();
+    currentList.clear();
+    currentMessage.clear();
+
+    conn->close();
+    emit gotDisconnection();
 }
 
+
+// Hands over buffer of element just read, next element gets a new one
+QByteArray TDriverRbiProtocol::takeReadBuffer()
+{
+    // empty elements are empty, not null, as they were when copied from message data
+    QByteArray element(readBuffer.isEmpty() ? QByteArray("", 0) : readBuffer);
+    readBuffer = QByteArray();
+    return element;
+}
+
+
+// helpers for message format, see tdriver_interface.rb for description
+static inline quint32 wordAt(const char *pos)
+{
+    return qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(pos));
+}
+
+
+static inline char *putWord(char *pos, quint32 word)
+{
+    qToBigEndian<quint32>(word, reinterpret_cast<uchar *>(pos));
+    return pos + sizeof(quint32);
+}
+
+
+// writes length and bytes like QDataStream, null array has length 0xFFFFFFFF
+static inline char *putBytes(char *pos, const QByteArray &bytes)
+{
+    pos = putWord(pos, bytes.isNull() ? 0xFFFFFFFF : quint32(bytes.size()));
+    memcpy(pos, bytes.constData(), bytes.size());
+    return pos + bytes.size();
+}
+
+
 void TDriverRbiProtocol::connected()
 {
     qDebug() << FCFL << "to" << conn->peerAddress() << conn->peerPort();
     VALIDATE_THREAD;
 
-    condSeqNum = 0;
-    condName.clear();
-    condMsg.clear();
-
-    startNewMessage();
     readBuffer.clear();
+    currentList.clear();
+    currentMessage.clear();
+    startNewMessage();
     writeBuffer.clear();
     haveHello = false;
 }
@@ -129,6 +199,15 @@ void TDriverRbiProtocol::connError(QAbstractSocket::SocketError err)
 void TDriverRbiProtocol::addWriteData(QByteArray data)
 {
     VALIDATE_THREAD;
+    if (writeBuffer.isEmpty()) {
+        // usually all is written at once, and message doesn't need to be copied
+        qint64 written = conn->write(data);
+        if (written < data.size()) {
+            writeBuffer = data.mid(qMax(written, qint64(0)));
+        }
+        return;
+    }
+
     writeBuffer.append(data);
     qint64 written = conn->write(writeBuffer);
     if (written > 0) {
@@ -139,35 +218,42 @@ void TDriverRbiProtocol::addWriteData(QByteArray data)
 
 void TDriverRbiProtocol::makeStringListMapMsg(QByteArray &target, const QByteArray &name, const BAListMap &msg, quint32 seqNum)
 {
-    QDataStream msgStream(&target, QIODevice::Append | QIODevice::WriteOnly);
+    //qDebug() << FFL << seqNum << name << msg.keys();
 
-    msgStream << seqNum;
-    msgStream << name;
-
-    qDebug() << FFL << msg;
-    //qDebug() << FFL << seqNum << name;
+    // sizes are computed first, so message is serialized to a single allocation
+    int mapSize = 0;
+    BAListMap::const_iterator mapIter;
+    for (mapIter = msg.constBegin(); mapIter != msg.constEnd(); ++mapIter) {
+        mapSize += 2*sizeof(quint32) + mapIter.key().size() + listSize(mapIter.value());
+    }
 
-    QByteArray mapBuf;
-    {
-        QDataStream mapStream(&mapBuf, QIODevice::WriteOnly | QIODevice::Append);
+    const int start = target.size();
+    target.resize(start + 3*sizeof(quint32) + name.size() + mapSize);
+    char *pos = target.data() + start;
 
-        BAListMap::const_iterator  mapIter;
-        for (mapIter = msg.constBegin(); mapIter != msg.constEnd(); ++mapIter) {
-            //qDebug() << "KEY"<< mapIter.key();
-            mapStream << mapIter.key();
+    pos = putWord(pos, seqNum);
+    pos = putBytes(pos, name);
+    pos = putWord(pos, mapSize);
 
-            QByteArray listBuf;
-            {
-                QDataStream listStream(&listBuf, QIODevice::WriteOnly | QIODevice::Append);
-                foreach(QByteArray listItem, mapIter.value()) {
-                    //qDebug() << "    VALUE" << listItem;
-                    listStream << listItem;
-                }
-            }
-            mapStream << listBuf;
+    for (mapIter = msg.constBegin(); mapIter != msg.constEnd(); ++mapIter) {
+        pos = putBytes(pos, mapIter.key());
+        pos = putWord(pos, listSize(mapIter.value()));
+        foreach (const QByteArray &listItem, mapIter.value()) {
+            pos = putBytes(pos, listItem);
         }
     }
-    msgStream << mapBuf;
+
+    Q_ASSERT(pos == target.constData() + target.size());
+}
+
+
+int TDriverRbiProtocol::listSize(const BAList &list)
+{
+    int size = 0;
+    foreach (const QByteArray &listItem, list) {
+        size += sizeof(quint32) + listItem.size();
+    }
+    return size;
 }
 
 
@@ -190,41 +276,59 @@ quint32 TDriverRbiProtocol::sendStringListMapMsg(const QByteArray &name, const B
 }
 
 
-BAList TDriverRbiProtocol::parseList(const QByteArray &data)
+// Expects length of next key or list in message data, returns true if message is over
+bool TDriverRbiProtocol::expectMapElement(ReadState state)
 {
-    BAList list;
-    QDataStream listStream(data);
-    forever {
-        QByteArray strData;
-        listStream >> strData;
-        if (listStream.status() != QDataStream::Ok) break;
-        list.append(strData);
+    if (dataLeft == 0) {
+        if (state == ReadListLen) {
+            qWarning() << FFL << "got map item with key" << currentKey << "but without data!";
+        }
+        return true;
+    }
+    if (dataLeft < sizeof(quint32)) {
+        skipMessageData();
+        return false;
     }
-    return list;
+
+    expectBytes(sizeof(quint32));
+    dataLeft -= sizeof(quint32);
+    readState = state;
+    return false;
 }
 
 
-BAListMap TDriverRbiProtocol::parseListMap(const QByteArray &data)
+// Expects length of next item in current list, or stores the list when it is over
+bool TDriverRbiProtocol::expectListItem()
 {
-    BAListMap map;
+    if (listLeft == 0) {
+        currentMessage[currentKey] = currentList;
+        currentList.clear();
+        return expectMapElement(ReadKeyLen);
+    }
+    if (listLeft < sizeof(quint32)) {
+        skipMessageData();
+        return false;
+    }
 
-    QDataStream mapStream(data);
-    forever {
+    expectBytes(sizeof(quint32));
+    listLeft -= sizeof(quint32);
+    readState = ReadItemLen;
+    return false;
+}
 
-        QByteArray keyData;
-        QByteArray listData;
-        mapStream >> keyData;
-        if (mapStream.status() != QDataStream::Ok) break;
 
-        mapStream >> listData;
-        if (mapStream.status() != QDataStream::Ok) {
-            qWarning() << FFL << "got map item with key" << keyData << "but without data!";
-            break;
-        }
-        map[keyData] = parseList(listData);
+// Rest of malformed message data is read and dropped, items read so far are kept
+void TDriverRbiProtocol::skipMessageData()
+{
+    qWarning() << FFL << "malformed message data, skipping" << (dataLeft + listLeft) << "bytes";
+    if (!currentList.isEmpty()) {
+        currentMessage[currentKey] = currentList;
+        currentList.clear();
     }
-
-    return map;
+    if (!expectBytes(dataLeft + listLeft)) return;
+    dataLeft = 0;
+    listLeft = 0;
+    readState = ReadSkip;
 }
 
 
@@ -234,67 +338,113 @@ void TDriverRbiProtocol::readyToRead()
     VALIDATE_THREAD;
 
     do {
-        while (readAmount > readBuffer.size() && conn->isReadable() && conn->bytesAvailable() > 0) {
+        while (readAmount > readFilled && conn->isReadable() && conn->bytesAvailable() > 0) {
             // TODO: have timeout here, in case server works incorrectly.
             // This code assumes that server always writes as many bytes of data as it says
-            readBuffer += conn->read(readAmount - readBuffer.size());
+            const qint64 got = conn->read(readBuffer.data() + readFilled, readAmount - readFilled);
+            if (got <= 0) break;
+            readFilled += got;
         }
 
-        if (readBuffer.size() < readAmount) continue; // readBuffer will be preserved
-        Q_ASSERT(readAmount == readBuffer.size());
+        if (readFilled < readAmount) continue; // readBuffer will be preserved
 
         bool messageOver = false;
 
         switch (readState) {
 
         case ReadSeqNum:
-            {
-                QDataStream parseStream(readBuffer);
-                parseStream >> receivedSN;
-            }
-            readAmount = sizeof(quint32);
+            receivedSN = wordAt(readBuffer.constData());
+            expectBytes(sizeof(quint32));
             readState = ReadNameLen;
             break;
 
-        case ReadNameLen:
-            {
-                QDataStream parseStream(readBuffer);
-                parseStream >> readAmount;
-                //qDebug() << FFL << "got nameLen" << readAmount;
-            }
-            if (readAmount == 0) {
+        case ReadNameLen: {
+            const quint32 len = wordAt(readBuffer.constData());
+            //qDebug() << FFL << "got nameLen" << len;
+            if (len == 0 || len == 0xFFFFFFFF) {
+                expectBytes(0);
                 readState = ReadDisconnected;
             }
-            else {
+            else if (len > MaxNameLength) {
+                abortConnection("message name length", len);
+            }
+            else if (expectBytes(len)) {
                 readState = ReadName;
             }
             break;
+        }
 
         case ReadName:
-            currentName = readBuffer;
+            currentName = takeReadBuffer();
             //qDebug() << FFL << "got name" << currentName;
-            readAmount = sizeof(quint32);
+            expectBytes(sizeof(quint32));
             readState = ReadDataLen;
             break;
 
-        case ReadDataLen:
-            {
-                QDataStream parseStream(readBuffer);
-                parseStream >> readAmount;
-            }
-            if (readAmount == 0) {
+        case ReadDataLen: {
+            const quint32 len = wordAt(readBuffer.constData());
+            currentMessage.clear();
+            if (len == 0 || len == 0xFFFFFFFF) {
                 //qDebug() << FFL << "got dataLen" << 0;
-                currentData.clear();
                 messageOver = true;
             }
+            else if (len > MaxDataLength) {
+                abortConnection("message data length", len);
+            }
             else {
-                readState = ReadData;
-                readBuffer.reserve(readAmount);
+                // map is read element by element, so no part of it is copied afterwards
+                dataLeft = len;
+                messageOver = expectMapElement(ReadKeyLen);
+            }
+            break;
+        }
+
+        case ReadKeyLen:
+        case ReadListLen: {
+            quint32 len = wordAt(readBuffer.constData());
+            if (len == 0xFFFFFFFF) len = 0; // null
+            if (len > dataLeft) {
+                skipMessageData();
+            }
+            else if (readState == ReadKeyLen) {
+                if (expectBytes(len)) {
+                    dataLeft -= len;
+                    readState = ReadKey;
+                }
+            }
+            else {
+                listLeft = len;
+                dataLeft -= len;
+                messageOver = expectListItem();
+            }
+            break;
+        }
+
+        case ReadKey:
+            currentKey = takeReadBuffer();
+            messageOver = expectMapElement(ReadListLen);
+            break;
+
+        case ReadItemLen: {
+            quint32 len = wordAt(readBuffer.constData());
+            if (len == 0xFFFFFFFF) len = 0; // null
+            if (len > listLeft) {
+                skipMessageData();
+            }
+            else if (expectBytes(len)) {
+                listLeft -= len;
+                readState = ReadItem;
             }
             break;
-        case ReadData:
-            currentData = readBuffer;
-            //qDebug() << FFL << "got data bytes" << currentData.size();
+        }
+
+        case ReadItem:
+            currentList.append(takeReadBuffer());
+            messageOver = expectListItem();
+            break;
+
+        case ReadSkip:
+            readBuffer = QByteArray();
             messageOver = true;
             break;
 
@@ -302,35 +452,42 @@ void TDriverRbiProtocol::readyToRead()
             conn->disconnectFromHost();
             break;
         }
-        readBuffer.clear(); // element handled, clear readBuffer
 
         if (messageOver) {
             startNewMessage(); // reset state for reading next message
 
-            QMutexLocker lock(syncMutex);
+            const BAListMap message(currentMessage);
+            currentMessage.clear();
 
-            condSeqNum = receivedSN;
+            QMutexLocker lock(syncMutex);
 
             if (nextSN <= receivedSN) nextSN = receivedSN+1;
-            condName = currentName;
 
-            condMsg = parseListMap(currentData);
-            if (condName == "hello") {
+            if (currentName == "hello") {
                 // handle hello message specially
                 haveHello = true;
-                helloMsg = condMsg;
+                helloMsg = message;
                 qDebug() << FCFL << "Received HELLO";
                 helloCond->wakeAll();
+                lock.unlock();
                 emit helloReceived();
             }
             else {
-                //qDebug() << FCFL << "RECEIVED" << condSeqNum << condName << "=>" << condMsg;
-                msgCond->wakeAll();
-                emit messageReceived(condSeqNum, condName, condMsg);
+                //qDebug() << FCFL << "RECEIVED" << receivedSN << currentName << "=>" << message;
+                QHash<quint32, PendingReply>::iterator pending = pendingReplies.find(receivedSN);
+                if (pending != pendingReplies.end()) {
+                    pending->received = true;
+                    pending->message = message;
+                    msgCond->wakeAll();
+                }
+                lock.unlock();
+                // emitted without lock, so receivers may send new messages right away
+                emit messageReceived(receivedSN, currentName, message);
             }
         }
 
-    } while (conn->bytesAvailable() > 0);
+        // empty elements need no more bytes, so they are handled without waiting for them
+    } while (conn->bytesAvailable() > 0 || (readState != ReadDisconnected && readFilled >= readAmount));
 }
 
 
@@ -360,49 +517,69 @@ bool TDriverRbiProtocol::waitHello(unsigned long timeout)
                 : helloCond->wait(syncMutex, timeout);
 }
 
-bool TDriverRbiProtocol::waitSeqNum(quint32 seqNum, unsigned long timeout)
+void TDriverRbiProtocol::expectReply(quint32 seqNum)
+{
+    Q_ASSERT(seqNum != 0);
+    pendingReplies.insert(seqNum, PendingReply());
+}
+
+
+bool TDriverRbiProtocol::waitReply(quint32 seqNum, unsigned long timeout, BAListMap &reply)
 {
     qDebug() << FCFL << "seqNum" << seqNum;
     VALIDATE_THREAD_NOT;
 
     Q_ASSERT(syncMutex);
     Q_ASSERT(msgCond);
+    Q_ASSERT(pendingReplies.contains(seqNum));
 
     // handler.condMutex must be locked when entering here!
+    // Other replies may arrive meanwhile, timeout applies to whole wait
+    QTime waited;
+    waited.start();
+
     forever {
-        // test timeout
+        const PendingReply &pending = pendingReplies[seqNum];
 
-        if (!msgCond->wait(syncMutex, timeout)) {
-            qDebug() << FCFL << "returning false for seqNum" << seqNum << "wait timeout";
-            return false;
-        }
-        // test for success (seqNum 0 accepts any sequence number)
-        else if (seqNum == 0 || condSeqNum == seqNum) {
-            qDebug() << FCFL << "returning true for condSeqNum" << condSeqNum << "vs seqNum" << seqNum;
+        if (pending.received) {
+            qDebug() << FCFL << "returning true for seqNum" << seqNum << "after" << waited.elapsed() << "ms";
+            reply = pendingReplies.take(seqNum).message;
             return true;
         }
-
-        // test missed seqNum
-        else if (condSeqNum == 0 || condSeqNum > seqNum) {
-            qDebug() << FCFL << "returning false for condSeqNum" << condSeqNum << "vs seqNum" << seqNum;
-            return false;
+        else if (pending.cancelled) {
+            qDebug() << FCFL << "returning false for seqNum" << seqNum << "cancelled";
+            break;
         }
 
-        //else qDebug() << FCFL << "ignoring condSeqNum" << condSeqNum << "vs seqNum" << seqNum;
+        const unsigned long elapsed = waited.elapsed();
+        if (elapsed >= timeout || !msgCond->wait(syncMutex, timeout - elapsed)) {
+            // reply may have arrived just as wait timed out
+            if (pendingReplies.value(seqNum).received) continue;
+            qDebug() << FCFL << "returning false for seqNum" << seqNum << "wait timeout";
+            break;
+        }
     }
+
+    pendingReplies.remove(seqNum);
+    return false;
 }
 
 
-#if 0
-void TDriverRbiProtocol::dumpReceivedMessage(quint32 seqNum, QByteArray name, QByteArray data)
+void TDriverRbiProtocol::cancelReply(quint32 seqNum)
 {
-    qDebug() << FFL << "seqnum" << seqNum << "name" << name << "datalen" << data.length();
+    QHash<quint32, PendingReply>::iterator pending = pendingReplies.find(seqNum);
+    if (pending != pendingReplies.end()) {
+        pending->cancelled = true;
+        msgCond->wakeAll();
+    }
 }
-void TDriverRbiProtocol::bounceReceivedMessage(quint32 seqNum, QByteArray name, QByteArray data)
+
+
+void TDriverRbiProtocol::cancelReplies()
 {
-    qDebug() << FFL << "seqnum" << seqNum << "name" << name << "datalen" << data.length();
-    BAListMap map(parseListMap(data));
-    qDebug() << FFL << "map" << map;
-    sendStringListMapMsg(seqNum+1, name, map);
+    QHash<quint32, PendingReply>::iterator pending;
+    for (pending = pendingReplies.begin(); pending != pendingReplies.end(); ++pending) {
+        pending->cancelled = true;
+    }
+    msgCond->wakeAll();
 }
-#endif
@@ -29,6 +29,7 @@
 #include <QByteArray>
 #include <QList>
 #include <QMap>
+#include <QHash>
 #include <QAbstractSocket>
 
 class QMutex;
@@ -44,7 +45,6 @@ public:
     ~TDriverRbiProtocol();
 
     quint32 nextSeqNum() { return nextSN; }
-    BAListMap waitedMessage() { return condMsg; }
 
     void setValidThread(QThread *id) { validThread = id; }
 
@@ -54,9 +54,14 @@ public:
 
 public:
     bool waitHello(unsigned long timeout);
-    bool waitSeqNum(quint32 seqNum, unsigned long timeout);
-    static BAList parseList(const QByteArray &data);
-    static BAListMap parseListMap(const QByteArray &data);
+    // Replies to registered sequence numbers are kept until taken by waitReply,
+    // so any number of callers can wait for their own replies at the same time.
+    // syncMutex must be locked when calling these.
+    void expectReply(quint32 seqNum);
+    bool waitReply(quint32 seqNum, unsigned long timeout, BAListMap &reply);
+    void cancelReply(quint32 seqNum);
+    void cancelReplies();
+    // appends message to target
     static void makeStringListMapMsg(QByteArray &target, const QByteArray &name, const BAListMap &msg, quint32 seqNum);
 
 signals:
@@ -74,22 +79,35 @@ public slots:
     void connError(QAbstractSocket::SocketError);
 
     quint32 sendStringListMapMsg(const QByteArray &name, const BAListMap &map, quint32 seqNum=0);
-#if 0
-    void dumpReceivedMessage(quint32 seqNum, QByteArray name, QByteArray data);
-    void bounceReceivedMessage(quint32 seqNum, QByteArray name, QByteArray data);
-#endif
 
 private slots:
     void startNewMessage();
     void addWriteData(QByteArray data);
 
 private:
-    enum { ReadDisconnected, ReadSeqNum, ReadNameLen, ReadName, ReadDataLen, ReadData } readState;
+    enum ReadState { ReadDisconnected, ReadSeqNum, ReadNameLen, ReadName, ReadDataLen,
+                     ReadKeyLen, ReadKey, ReadListLen, ReadItemLen, ReadItem, ReadSkip };
+
+    bool expectBytes(quint32 amount);
+    void abortConnection(const char *what, quint32 length);
+    QByteArray takeReadBuffer();
+    bool expectMapElement(ReadState state);
+    bool expectListItem();
+    void skipMessageData();
+    static int listSize(const BAList &list);
+
+    ReadState readState;
     qint32 readAmount;
+    qint32 readFilled; // bytes of readAmount already in readBuffer
     QByteArray readBuffer;
     quint32 receivedSN;
     QByteArray currentName;
-    QByteArray currentData;
+    // message map is built while it is read, each key and item is read to its own buffer
+    quint32 dataLeft; // bytes of message data not yet expected
+    quint32 listLeft; // bytes of current list not yet expected
+    QByteArray currentKey;
+    BAList currentList;
+    BAListMap currentMessage;
 
     QByteArray writeBuffer;
 
@@ -99,9 +117,13 @@ private:
     QMutex *syncMutex;
     QWaitCondition *msgCond;
 
-    quint32 condSeqNum;
-    BAListMap condMsg;
-    QByteArray condName;
+    struct PendingReply {
+        bool received;
+        bool cancelled;
+        BAListMap message;
+        PendingReply() : received(false), cancelled(false) {}
+    };
+    QHash<quint32, PendingReply> pendingReplies; // guarded by syncMutex
 
     quint32 nextSN;
     bool haveHello;
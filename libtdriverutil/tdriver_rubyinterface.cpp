@@ -33,6 +33,7 @@
 #include <QWaitCondition>
 #include <QMutex>
 #include <QMessageBox>
+#include <QTimer>
 
 #include "tdriver_debug_macros.h"
 
@@ -57,6 +58,7 @@ TDriverRubyInterface::TDriverRubyInterface() :
     process(NULL),
     conn(NULL),
     handler(NULL),
+    pendingTimer(new QTimer(this)),
     initState(Closed),
     stderrEvalSeqNum(0),
     stdoutEvalSeqNum(0),
@@ -67,6 +69,9 @@ TDriverRubyInterface::TDriverRubyInterface() :
 
     validThread(NULL)
 {
+    // timer moves to interface thread with this object
+    pendingTimer->setInterval(500);
+    connect(pendingTimer, SIGNAL(timeout()), SLOT(expirePendingCmds()));
 }
 
 
@@ -401,6 +406,9 @@ void TDriverRubyInterface::resetRubyConnection(int counter)
         connect(handler, SIGNAL(messageReceived(quint32,QByteArray,BAListMap)),
                 SIGNAL(messageReceived(quint32,QByteArray,BAListMap)));
 
+        connect(handler, SIGNAL(messageReceived(quint32,QByteArray,BAListMap)),
+                SLOT(dispatchReply(quint32,QByteArray,BAListMap)));
+
         connect(handler, SIGNAL(gotDisconnection()),
                 SLOT(close()));
 
@@ -450,6 +458,7 @@ void TDriverRubyInterface::close()
     else {
         initState = Closing;
 
+        if (handler) handler->cancelReplies();
         msgCond->wakeAll();
         helloCond->wakeAll();
 
@@ -461,6 +470,9 @@ void TDriverRubyInterface::close()
         Q_ASSERT(initState == Closed);
     }
     syncMutex->unlock();
+
+    // replies of pending commands will never come
+    failPendingCmds("Error: TDriver interface script closed", false);
     alreadyClosing = false;
 
 }
@@ -585,14 +597,14 @@ bool TDriverRubyInterface::executeCmd(const QByteArray &name, BAListMap &cmd_rep
             box->show();
             box->repaint();
         }
-        bool success = handler->waitSeqNum(seqNum, timeout);
+        handler->expectReply(seqNum);
+        bool success = handler->waitReply(seqNum, timeout, cmd_reply);
         if (box) {
             box->hide();
             box->repaint();
             delete box;
         }
         if (success) {
-            cmd_reply = handler->waitedMessage();
             // TODO: make final decision about which logic to use here, and change tdriver_interface.rb accordingly:
 #if 1
             if (cmd_reply.contains("error") && cmd_reply.value("error").isEmpty()) cmd_reply["error"] << "Unknown error";
@@ -610,6 +622,107 @@ bool TDriverRubyInterface::executeCmd(const QByteArray &name, BAListMap &cmd_rep
 }
 
 
+quint32 TDriverRubyInterface::sendCmdAsync(const QByteArray &name, const BAListMap &cmd,
+                                           QObject *receiver, const char *member, unsigned long timeout)
+{
+    VALIDATE_THREAD_NOT;
+    Q_ASSERT(receiver && member);
+
+    QString goOnlineError;
+    if (!(goOnlineError = goOnline()).isNull()) {
+        qDebug() << FCFL << "goOnline error" << goOnlineError;
+        return 0;
+    }
+
+    QMutexLocker lock(syncMutex);
+    quint32 seqNum = sendCmdMessage(name, cmd);
+    if (seqNum != 0) {
+        // registered before lock is released, so reply can't arrive before this
+        PendingCmd &pending = pendingCmds[seqNum];
+        pending.receiver = receiver;
+        pending.member = member;
+        pending.timeout = timeout;
+        pending.sent.start();
+        if (timeout > 0) {
+            QMetaObject::invokeMethod(pendingTimer, "start", Qt::QueuedConnection);
+        }
+    }
+    qDebug() << FCFL << "SENT" << seqNum << name << "pending" << pendingCmds.size();
+    return seqNum;
+}
+
+
+void TDriverRubyInterface::cancelCmd(quint32 seqNum)
+{
+    QMutexLocker lock(syncMutex);
+    pendingCmds.remove(seqNum);
+}
+
+
+static void invokeReceiver(QObject *receiver, const QByteArray &member, quint32 seqNum, const BAListMap &reply)
+{
+    if (!receiver) return; // deleted while command was pending
+
+    if (!QMetaObject::invokeMethod(receiver, member.constData(), Qt::QueuedConnection,
+                                   Q_ARG(quint32, seqNum), Q_ARG(BAListMap, reply))) {
+        qWarning() << FFL << "invoking" << member << "failed for seqNum" << seqNum;
+    }
+}
+
+
+void TDriverRubyInterface::dispatchReply(quint32 seqNum, QByteArray name, BAListMap message)
+{
+    VALIDATE_THREAD;
+    Q_UNUSED(name);
+
+    QMutexLocker lock(syncMutex);
+    if (!pendingCmds.contains(seqNum)) return; // not async, or cancelled
+    const PendingCmd pending = pendingCmds.take(seqNum);
+    lock.unlock();
+
+    if (message.contains("error") && message.value("error").isEmpty()) message["error"] << "Unknown error";
+    invokeReceiver(pending.receiver, pending.member, seqNum, message);
+}
+
+
+void TDriverRubyInterface::expirePendingCmds()
+{
+    VALIDATE_THREAD;
+    failPendingCmds("Error: Timeout waiting for TDriver interface script", true);
+}
+
+
+void TDriverRubyInterface::failPendingCmds(const QByteArray &error, bool expiredOnly)
+{
+    QList<QPair<quint32, PendingCmd> > failed;
+    bool haveTimeouts = false;
+
+    syncMutex->lock();
+    QHash<quint32, PendingCmd>::iterator iter = pendingCmds.begin();
+    while (iter != pendingCmds.end()) {
+        const PendingCmd &pending = iter.value();
+        if (!expiredOnly || (pending.timeout > 0 && ulong(pending.sent.elapsed()) >= pending.timeout)) {
+            failed << qMakePair(iter.key(), pending);
+            iter = pendingCmds.erase(iter);
+        }
+        else {
+            if (pending.timeout > 0) haveTimeouts = true;
+            ++iter;
+        }
+    }
+    syncMutex->unlock();
+
+    if (!haveTimeouts) pendingTimer->stop();
+
+    BAListMap reply;
+    reply["error"] << error;
+    for (int ii = 0; ii < failed.size(); ++ii) {
+        qDebug() << FCFL << error << "for seqNum" << failed.at(ii).first;
+        invokeReceiver(failed.at(ii).second.receiver, failed.at(ii).second.member, failed.at(ii).first, reply);
+    }
+}
+
+
 int TDriverRubyInterface::getPort()
 {
     VALIDATE_THREAD_NOT;
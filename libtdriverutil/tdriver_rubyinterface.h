@@ -27,9 +27,13 @@
 #include <QThread>
 #include <QProcess>
 #include <QAbstractSocket>
+#include <QHash>
+#include <QPointer>
+#include <QTime>
 
 class QMutex;
 class QWaitCondition;
+class QTimer;
 
 class LIBTDRIVERUTILSHARED_EXPORT TDriverRubyInterface : public QThread
 {
@@ -51,6 +55,15 @@ public:
     quint32 sendCmd(const QByteArray &name, const BAListMap &cmd);
     bool executeCmd( const QByteArray &name, BAListMap &cmd_reply, unsigned long timeout, const QString &showCommand = QString());
 
+    // Sends cmd without waiting, and later invokes member of receiver as queued call
+    // with (quint32 seqNum, BAListMap reply). On timeout or when interface closes,
+    // reply has only "error" key. Timeout 0 waits forever. Any number of commands
+    // may be pending at once. Returns seqNum, or 0 if command could not be sent.
+    quint32 sendCmdAsync(const QByteArray &name, const BAListMap &cmd,
+                         QObject *receiver, const char *member, unsigned long timeout = 0);
+    // reply of a cancelled command is dropped, receiver is not invoked
+    void cancelCmd(quint32 seqNum);
+
     int getPort();
     int getRbiVersion();
     QString getTDriverVersion();
@@ -84,9 +97,12 @@ private slots:
     void resetProcess();
     void recreateProcess();
     //void messageFromHandler(quint32 seqNum, QByteArray name, BAListMap message);
+    void dispatchReply(quint32 seqNum, QByteArray name, BAListMap message);
+    void expirePendingCmds();
 
 private:
     void readProcessHelper(int fnum, QByteArray &readBuffer, quint32 &seqNum, QByteArray &evalBuffer);
+    void failPendingCmds(const QByteArray &error, bool expiredOnly);
 
 private:
     int rbiPort;
@@ -103,6 +119,15 @@ private:
     QAbstractSocket *conn;
     TDriverRbiProtocol *handler;
 
+    struct PendingCmd {
+        QPointer<QObject> receiver;
+        QByteArray member;
+        unsigned long timeout;
+        QTime sent;
+    };
+    QHash<quint32, PendingCmd> pendingCmds; // guarded by syncMutex
+    QTimer *pendingTimer;
+
     static TDriverRubyInterface *pGlobalInstance;
 
     enum { Closed, Running, Connected, Closing } initState;
@@ -24,48 +24,82 @@
 
 #include <QGridLayout>
 #include <QShortcut>
+#include <QLabel>
+#include <QTimer>
+#include <QtAlgorithms>
 
-bool MainWindow::containsWords( const TreeItemInfo &itemData, QString text, bool caseSensitive, bool entireWords )
+
+static const int maxCachedSelectors = 64;
+
+
+// Objects matching current search text and options in document order
+const QVector<int> &MainWindow::findDialogMatchList()
 {
-    bool result = false;
-    Qt::CaseSensitivity caseSensitivity = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-
-    if ( entireWords ) {
-        result = (
-            itemData.name.compare( text, caseSensitivity ) == 0 ||
-            itemData.type.compare( text, caseSensitivity ) == 0 ||
-            itemData.id.compare( text, caseSensitivity ) == 0 );
+    const QString findString = findDialogText->currentText();
+    const int flags = (findDialogMatchCase->isChecked() ? 1 : 0)
+            | (findDialogEntireWords->isChecked() ? 2 : 0)
+            | (findDialogAttributes->isChecked() ? 4 : 0)
+            | (findDialogSelector->isChecked() ? 8 : 0);
+
+    if (flags != findDialogMatchFlags || findString != findDialogMatchText) {
+        if (objectSearchIndex.isEmpty() && !testObjects.isEmpty()) {
+            objectSearchIndex.build(testObjects);
+        }
+
+        if (flags & 8) {
+            const TDriverObjectSelector &selector = findDialogSelectorFor(findString);
+            findDialogMatches = selector.isValid() ? selector.match(testObjects, &objectSearchIndex) : QVector<int>();
+        }
+        else {
+            findDialogMatches = objectSearchIndex.find(findString, (flags & 1) != 0, (flags & 2) != 0, (flags & 4) != 0);
+        }
+        findDialogMatchText = findString;
+        findDialogMatchFlags = flags;
     }
 
-    else {
-        result = (
-            itemData.name.contains( text, caseSensitivity ) ||
-            itemData.type.contains( text, caseSensitivity ) ||
-            itemData.id.contains( text, caseSensitivity ));
+    return findDialogMatches;
+}
+
+
+// Selectors are compiled once per text, they don't depend on objects
+const TDriverObjectSelector &MainWindow::findDialogSelectorFor(const QString &text)
+{
+    QHash<QString, TDriverObjectSelector>::iterator it = findDialogSelectors.find(text);
+
+    if (it == findDialogSelectors.end()) {
+        // every typed prefix is compiled, so cache is just dropped when full
+        if (findDialogSelectors.size() >= maxCachedSelectors) findDialogSelectors.clear();
+
+        TDriverObjectSelector selector;
+        selector.parse(text);
+        it = findDialogSelectors.insert(text, selector);
     }
 
-    return result;
+    return it.value();
 }
 
-bool MainWindow::attributeContainsWords( TestObjectKey itemPtr, QString text, bool caseSensitive, bool entireWords )
+
+// Highlights selector matches in subtree of root on screenshot
+void MainWindow::findDialogHighlightMatches(int root)
 {
-    bool result = false;
+    if (!findDialogSelector->isChecked()) return;
 
-    Qt::CaseSensitivity caseSensitivity = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-    QMapIterator<QString, AttributeInfo > iterator( attributesMap.value( itemPtr ) );
+    const QVector<int> &matches = findDialogMatchList();
+    QVector<int>::const_iterator first = qLowerBound(matches.constBegin(), matches.constEnd(), root);
+    QVector<int>::const_iterator last = qLowerBound(first, matches.constEnd(), testObjects.subtreeEnd(root));
 
-    while ( iterator.hasNext() && !result ) {
+    drawHighlight(matches.mid(first - matches.constBegin(), last - first));
+}
 
-        iterator.next();
-        QString value = iterator.value().value;
 
-        if ( entireWords ? ( value.compare( text, caseSensitivity ) == 0 ) : ( value.contains( text, caseSensitivity ) ) ) {
-            result = true;
-            break;
-        }
-    }
+// Called when testObjects changes, index refers to it
+void MainWindow::invalidateObjectSearch()
+{
+    objectSearchIndex.clear();
+    findDialogMatches.clear();
+    findDialogMatchFlags = -1;
 
-    return result;
+    if (findDialog && findDialog->isVisible()) findDialogMatchCountTimer->start();
 }
 
 
@@ -74,7 +108,7 @@ void MainWindow::findNextTreeObject()
     // exit if no objects in tree
     QString findString = findDialogText->currentText();
 
-    if ( objectTree->columnCount() < 1 || objectTree->invisibleRootItem()->childCount() < 1 ) {
+    if ( testObjects.isEmpty() ) {
 
         qDebug() << FCFL << "findFromObjectTree: no objects in tree";
         QMessageBox::warning(this,
@@ -83,19 +117,28 @@ void MainWindow::findNextTreeObject()
         return;
     }
 
+    if ( findDialogSelector->isChecked() ) {
+        const TDriverObjectSelector &selector = findDialogSelectorFor( findString );
+
+        if ( !selector.isValid() ) {
+            QMessageBox::warning(this,
+                                 tr("Find"),
+                                 tr("Invalid selector '%1' at column %2:\n\n%3")
+                                 .arg(findString).arg(selector.errorColumn()).arg(selector.errorString()));
+            return;
+        }
+    }
+
     bool backwards = findDialogBackwards->isChecked();
-    bool matchCase = findDialogMatchCase->isChecked();
-    bool entireWords = findDialogEntireWords->isChecked();
     bool searchWrapAround = findDialogWrapAround->isChecked();
-    bool searchAttributes = findDialogAttributes->isChecked();
 
-    QTreeWidgetItem *current = objectTree->currentItem();
+    TestObjectKey currentKey = currentObjectKey();
 
     switch ( findDialogSubtreeOnly->checkState() ) {
 
     case Qt::Unchecked:
         // search entire tree
-        findDialogSubtreeRoot = objectTree->topLevelItem(0);
+        findDialogSubtreeRoot = testObjectKey(0);
         break;
 
     case Qt::PartiallyChecked:
@@ -107,153 +150,113 @@ void MainWindow::findNextTreeObject()
 
     case Qt::Checked:
         findDialogSubtreeOnly->setCheckState(Qt::PartiallyChecked);
-        findDialogSubtreeRoot = current;
+        findDialogSubtreeRoot = currentKey;
         break;
     }
 
-    findFromSubTree(current, findString, backwards, matchCase, entireWords, searchWrapAround, searchAttributes);
+    findFromSubTree(testObjectIndex(currentKey), backwards, searchWrapAround);
 
 }
 
 
-QTreeWidgetItem *MainWindow::findDialogSubtreeNext(QTreeWidgetItem *current, QTreeWidgetItem *root, bool wrap)
+// Test objects and matches are both in document order, so matches in subtree of root
+// are a contiguous range of match list, and next and previous are found by binary search
+void MainWindow::findFromSubTree(int current, bool backwards, bool searchWrapAround)
 {
-    if (!current) return NULL; // invalid current item
-
-    if (current->childCount() > 0) return current->child(0); // first child  is next
-
-    // can't use QTreeWidget::itemBelow because it will not iterate into hidden subtrees
-
-    while( current != root) {
-
-        QTreeWidgetItem *par = current->parent();
-        if (!par) break; // null parent -> probably child of objectTree->invisibleRootItem
-        Q_ASSERT(par); // can't be at root of entire tree if here
-
-        int ind = par->indexOfChild(current);
-        Q_ASSERT(ind >= 0);
-        if (ind+1 < par->childCount()) return par->child(ind+1); // next sibling is next
-
-        current = par; // no next sibling, try next sibling of parent
+    Q_ASSERT(findDialogSubtreeRoot);
+    const int root = testObjectIndex(findDialogSubtreeRoot);
+    const QVector<int> &matches = findDialogMatchList();
+
+    QVector<int>::const_iterator first = qLowerBound(matches.constBegin(), matches.constEnd(), root);
+    QVector<int>::const_iterator last = qLowerBound(first, matches.constEnd(), testObjects.subtreeEnd(root));
+    int found = -1;
+
+    if (first != last) {
+        if (backwards) {
+            QVector<int>::const_iterator it = qLowerBound(first, last, current);
+            if (it != first) found = *(it - 1);
+            else if (searchWrapAround) found = *(last - 1);
+        }
+        else {
+            QVector<int>::const_iterator it = qUpperBound(first, last, current);
+            if (it != last) found = *it;
+            else if (searchWrapAround) found = *first;
+        }
     }
 
-    if (!wrap) return NULL; // entire subtree done, no next
-    else return current; // wrapped to subtree root
-}
-
-
-static inline QTreeWidgetItem *goToBottomChild(QTreeWidgetItem *node)
-{
-    forever {
-        int count = node->childCount();
-        if (count <= 0) return node;
-        node = node->child(count-1);
+    if (found >= 0) {
+        setCurrentObject( testObjectKey( found ) );
+        findDialogHighlightMatches(root);
+    }
+    else {
+        QMessageBox::warning(this,
+                             tr("Find"),
+                             tr("No matches found with '%1'").arg(findDialogText->currentText()) );
     }
 }
 
 
-QTreeWidgetItem *MainWindow::findDialogSubtreePrev(QTreeWidgetItem *current, QTreeWidgetItem *root, bool wrap)
+void MainWindow::findDialogTextChanged( const QString & text )
 {
-    if (!current) return NULL; // invalid current item
-
-    Q_ASSERT(current != objectTree->invisibleRootItem());
-
-    if (current == root || current == objectTree->topLevelItem(0)) {
-        if (!wrap) return NULL; // at subtree root, no next
-        else return goToBottomChild(current); // wrap to end of tree
-        // not reached
-    }
-
-    // can't use QTreeWidget::itemAbove because it will not iterate into hidden subtrees
-
-    QTreeWidgetItem *par = current->parent();
-    Q_ASSERT(par && par != objectTree->invisibleRootItem());
-
-    int ind = par->indexOfChild(current);
-    Q_ASSERT(ind >= 0 && ind < par->childCount());
-    if (ind == 0) return par; // no previous sibling, so parent is previous
-    else return goToBottomChild(par->child(ind-1)); // last descendant of previous sibling is previous
+    findDialogFindButton->setEnabled( !text.isEmpty() );
+    findDialogMatchCountTimer->start();
 }
 
 
-bool MainWindow::compareTreeItem(QTreeWidgetItem *item, const QString &findString, bool matchCase, bool entireWords, bool searchAttributes)
+// Shows number of matches in subtree which next search would use
+void MainWindow::findDialogUpdateMatchCount()
 {
-    if (!item) return false;
-
-    TestObjectKey itemIndex = ptr2TestObjectKey(item);
-    Q_ASSERT(objectTreeData.contains( itemIndex) );
-
-    // check values in itemData
-    if ( containsWords( objectTreeData.value( itemIndex ), findString, matchCase, entireWords ) ) {
-        return true;
+    if (!findDialog->isVisible() || findDialogText->currentText().isEmpty()) {
+        findDialogMatchCount->clear();
+        return;
     }
 
-    // check attribute values if that option is checked
-    if ( searchAttributes ) {
-        if ( attributeContainsWords( itemIndex, findString, matchCase, entireWords ) ) {
-            return true;
-        }
+    int root = 0;
+    if (findDialogSubtreeOnly->checkState() == Qt::PartiallyChecked && findDialogSubtreeRoot) {
+        root = testObjectIndex(findDialogSubtreeRoot);
+    }
+    else if (findDialogSubtreeOnly->checkState() != Qt::Unchecked) {
+        root = testObjectIndex(currentObjectKey());
     }
 
-    return false;
-}
-
-
-void MainWindow::findFromSubTree(QTreeWidgetItem *current, const QString &findString, bool backwards, bool matchCase, bool entireWords, bool searchWrapAround, bool searchAttributes)
-{
-    Q_ASSERT(findDialogSubtreeRoot);
-    QTreeWidgetItem *startItem = current;
-
-    forever {
-
-        current = backwards ?
-                  findDialogSubtreePrev(current, findDialogSubtreeRoot, searchWrapAround) :
-                  findDialogSubtreeNext(current, findDialogSubtreeRoot, searchWrapAround);
-
-        if (compareTreeItem(current, findString, matchCase, entireWords, searchAttributes)) {
-            // found
-            objectTree->setCurrentItem( current );
-            return;
-        }
-
-        if (!current || current == startItem) {
-            QMessageBox::warning(this,
-                                 tr("Find"),
-                                 tr("No matches found with '%1'").arg(findDialogText->currentText()) );
+    if (findDialogSelector->isChecked()) {
+        const TDriverObjectSelector &selector = findDialogSelectorFor(findDialogText->currentText());
+        if (!selector.isValid()) {
+            findDialogMatchCount->setText(tr("Column %1: %2").arg(selector.errorColumn()).arg(selector.errorString()));
             return;
         }
     }
-}
 
+    const QVector<int> &matches = findDialogMatchList();
+    QVector<int>::const_iterator first = qLowerBound(matches.constBegin(), matches.constEnd(), root);
+    QVector<int>::const_iterator last = qLowerBound(first, matches.constEnd(), testObjects.subtreeEnd(root));
 
-void MainWindow::findDialogTextChanged( const QString & text )
-{
-    findDialogFindButton->setEnabled( !text.isEmpty() );
+    findDialogMatchCount->setText(tr("Matches: %1").arg(last - first));
+    findDialogHighlightMatches(root);
 }
 
 
-void MainWindow::findDialogHandleTreeCurrentChange(QTreeWidgetItem*current)
+void MainWindow::findDialogHandleTreeCurrentChange(const QModelIndex &currentIndex)
 {
     if (!findDialogSubtreeOnly) return; // not initialized yet
 
     if (findDialogSubtreeOnly->checkState() == Qt::Unchecked) return; // don't care
 
+    findDialogMatchCountTimer->start();
+
     // subtree searching enabled, check if current is in subtree
     // and set current to NULL if subtree search needs to be disabled
-    if (!findDialogSubtreeRoot) {
-        current = NULL;
-    }
-    else {
-        while(current) {
-            if (current == findDialogSubtreeRoot) break;
-            current = current->parent();
-        }
+    int current = testObjectIndex(objectTreeModel->objectKey(currentIndex));
+    const int root = testObjectIndex(findDialogSubtreeRoot);
+
+    if (root < 0 || current < root || current >= testObjects.subtreeEnd(root)) {
+        current = -1;
     }
 
-    if (!current) {
+    if (current < 0) {
         // current not in selected subtree, switch off subtree-only searching
         findDialogSubtreeOnly->setCheckState(Qt::Unchecked);
-        findDialogSubtreeRoot = NULL;
+        findDialogSubtreeRoot = 0;
     }
 }
 
@@ -261,7 +264,7 @@ void MainWindow::findDialogHandleTreeCurrentChange(QTreeWidgetItem*current)
 void MainWindow::findDialogSubtreeChanged( int state)
 {
     if (state != Qt::PartiallyChecked) {
-        findDialogSubtreeRoot = NULL;
+        findDialogSubtreeRoot = 0;
         // prevent user from switching state to PartiallyChecked
         findDialogSubtreeOnly->setTristate(false);
     }
@@ -270,7 +273,7 @@ void MainWindow::findDialogSubtreeChanged( int state)
 
 void MainWindow::showFindDialog() {
 
-    findDialogSubtreeRoot = NULL;
+    findDialogSubtreeRoot = 0;
     if (findDialogSubtreeOnly->checkState() == Qt::PartiallyChecked)
         findDialogSubtreeOnly->setCheckState(Qt::Checked);
     findDialog->show();
@@ -278,6 +281,7 @@ void MainWindow::showFindDialog() {
     if ( findDialogPos != QPoint( -1, -1 ) ) { findDialog->move( findDialogPos ); }
 
     findDialogText->setFocus();
+    findDialogUpdateMatchCount();
 
 }
 
@@ -292,13 +296,14 @@ void MainWindow::closeFindDialog() {
 
 void MainWindow::createFindDialog() {
 
-    findDialogSubtreeRoot = NULL;
+    findDialogSubtreeRoot = 0;
+    findDialogMatchFlags = -1;
 
     findDialog = new QDialog( this );
     findDialog->setObjectName( "main find" );
     findDialog->setWindowTitle( "Find" );
 
-    findDialog->setFixedSize( 560, 155 );
+    findDialog->setFixedSize( 560, 175 );
 
     // reset find dialog position, stored before closing the dialog and restored when dialog opened
     findDialogPos = QPoint(-1, -1);
@@ -352,6 +357,20 @@ void MainWindow::createFindDialog() {
     findDialogSubtreeOnly->setObjectName("main find subtree");
     findDialogSubtreeOnly->setTristate(false);
 
+    findDialogSelector = new QCheckBox( "Se&lector query" );
+    findDialogSelector->setObjectName("main find selector");
+    findDialogSelector->setToolTip( tr("Find objects with a selector, for example:\n"
+                                       "QDialog[visible=true] > QPushButton[text^='OK']\n"
+                                       "QLabel#title, *[width>=100][height<50]") );
+
+    findDialogMatchCount = new QLabel();
+    findDialogMatchCount->setObjectName("main find matchcount");
+
+    // counting matches while typing waits for a pause, first search may need to build the index
+    findDialogMatchCountTimer = new QTimer( findDialog );
+    findDialogMatchCountTimer->setSingleShot( true );
+    findDialogMatchCountTimer->setInterval( 200 );
+
     // populate widgets
     findDialogText->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
     groupBoxLayout->addWidget( findDialogText, 0, 0, 1, -1 );
@@ -364,6 +383,9 @@ void MainWindow::createFindDialog() {
     groupBoxLayout->addWidget( findDialogWrapAround, 2, 1 );
     groupBoxLayout->addWidget( findDialogSubtreeOnly, 2, 2 );
 
+    groupBoxLayout->addWidget( findDialogSelector, 3, 0 );
+    groupBoxLayout->addWidget( findDialogMatchCount, 3, 1, 1, 2 );
+
     groupBoxLayout->addWidget( findDialogFindButton, 1, 3 );
     groupBoxLayout->addWidget( findDialogCloseButton, 2, 3 );
 
@@ -371,6 +393,18 @@ void MainWindow::createFindDialog() {
 
     connect( findDialogSubtreeOnly, SIGNAL(stateChanged(int)),
              this, SLOT(findDialogSubtreeChanged(int)));
+
+    connect( findDialogMatchCountTimer, SIGNAL(timeout()), this, SLOT(findDialogUpdateMatchCount()));
+    connect( findDialogMatchCase, SIGNAL(stateChanged(int)), findDialogMatchCountTimer, SLOT(start()));
+    connect( findDialogEntireWords, SIGNAL(stateChanged(int)), findDialogMatchCountTimer, SLOT(start()));
+    connect( findDialogAttributes, SIGNAL(stateChanged(int)), findDialogMatchCountTimer, SLOT(start()));
+    connect( findDialogSubtreeOnly, SIGNAL(stateChanged(int)), findDialogMatchCountTimer, SLOT(start()));
+    connect( findDialogSelector, SIGNAL(stateChanged(int)), findDialogMatchCountTimer, SLOT(start()));
+
+    // text matching options don't apply to selectors
+    connect( findDialogSelector, SIGNAL(toggled(bool)), findDialogMatchCase, SLOT(setDisabled(bool)));
+    connect( findDialogSelector, SIGNAL(toggled(bool)), findDialogEntireWords, SLOT(setDisabled(bool)));
+    connect( findDialogSelector, SIGNAL(toggled(bool)), findDialogAttributes, SLOT(setDisabled(bool)));
     connect( findDialogText, SIGNAL( editTextChanged( const QString & ) ),
              this, SLOT( findDialogTextChanged( const QString & ) ) );
     connect( findDialogText, SIGNAL(triggered(QString)), this, SLOT(findNextTreeObject()));
@@ -381,8 +415,8 @@ void MainWindow::createFindDialog() {
     connect( findDialogCloseButton, SIGNAL( clicked() ), this, SLOT( closeFindDialog() ) );
 
     Q_ASSERT(objectTree);
-    connect (objectTree, SIGNAL(currentItemChanged(QTreeWidgetItem*,QTreeWidgetItem*)),
-             this, SLOT(findDialogHandleTreeCurrentChange(QTreeWidgetItem*)));
+    connect (objectTree->selectionModel(), SIGNAL(currentChanged(QModelIndex,QModelIndex)),
+             this, SLOT(findDialogHandleTreeCurrentChange(QModelIndex)));
 }
 
 
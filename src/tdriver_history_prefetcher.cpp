@@ -0,0 +1,140 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#include "tdriver_history_prefetcher.h"
+#include "tdriver_reply_parser.h"
+#include "tdriver_image_view.h"
+
+#include <tdriver_debug_macros.h>
+
+#include <QSet>
+#include <QTime>
+#include <QtConcurrentRun>
+
+
+/*!
+    \class TDriverHistoryPrefetcher
+    \brief Loads most recent state history entries in background.
+
+    Ui dump and screenshot of each entry are read from the store, parsed and
+    decoded on a worker thread, so loading a recent state from history menu
+    needs no file access. Loaded states are identified by hashes of their
+    blobs, so entries with identical content share one loaded state.
+ */
+
+
+TDriverHistoryPrefetcher::TDriverHistoryPrefetcher(const TDriverStateHistoryStore &store, QObject *parent) :
+    QObject(parent),
+    store(store)
+{
+}
+
+
+TDriverHistoryPrefetcher::~TDriverHistoryPrefetcher()
+{
+    // worker threads have their own copies of data, results are just not used
+    foreach (QFutureWatcher<TDriverHistoryState> *watcher, loading) {
+        watcher->disconnect(this);
+    }
+}
+
+
+QByteArray TDriverHistoryPrefetcher::stateSignature(const TDriverStateHistoryEntry &entry)
+{
+    return entry.uiDumpHash + '/' + entry.imageHash;
+}
+
+
+void TDriverHistoryPrefetcher::prefetch(const QList<TDriverStateHistoryEntry> &entries)
+{
+    QSet<QByteArray> wanted;
+
+    for (int ind = 0; ind < entries.size() && ind < PrefetchCount; ++ind) {
+        const QByteArray signature = stateSignature(entries.at(ind));
+
+        wanted.insert(signature);
+        if (states.contains(signature) || loading.contains(signature)) continue;
+
+        QFutureWatcher<TDriverHistoryState> *watcher = new QFutureWatcher<TDriverHistoryState>(this);
+        connect(watcher, SIGNAL(finished()), SLOT(loadFinished()));
+        loading.insert(signature, watcher);
+        watcher->setFuture(QtConcurrent::run(&TDriverHistoryPrefetcher::loadState, store, entries.at(ind)));
+    }
+
+    // older states are dropped, loads already started are let finish
+    foreach (const QByteArray &signature, states.keys()) {
+        if (!wanted.contains(signature)) states.remove(signature);
+    }
+}
+
+
+bool TDriverHistoryPrefetcher::lookup(const TDriverStateHistoryEntry &entry, TDriverHistoryState &state) const
+{
+    const QByteArray signature = stateSignature(entry);
+    if (!states.contains(signature)) return false;
+
+    state = states.value(signature);
+    // names may differ between entries with same content
+    state.uiDumpName = entry.uiDumpName;
+    state.imageName = entry.imageName;
+    return true;
+}
+
+
+void TDriverHistoryPrefetcher::loadFinished()
+{
+    QFutureWatcher<TDriverHistoryState> *watcher = static_cast<QFutureWatcher<TDriverHistoryState> *>(sender());
+    const TDriverHistoryState state = watcher->result();
+    watcher->deleteLater();
+
+    loading.remove(state.signature);
+    states.insert(state.signature, state);
+    qDebug() << FCFL << "prefetched" << state.uiDumpName << "ok" << state.ok;
+}
+
+
+TDriverHistoryState TDriverHistoryPrefetcher::loadState(TDriverStateHistoryStore store, TDriverStateHistoryEntry entry)
+{
+    QTime t;
+    t.start();
+
+    TDriverHistoryState state;
+    state.signature = stateSignature(entry);
+    state.uiDumpName = entry.uiDumpName;
+    state.imageName = entry.imageName;
+
+    if (!store.readBlob(entry.uiDumpHash, state.uiDumpData)) {
+        state.errorText = tr("Ui dump %1 of state history is missing or corrupted").arg(entry.uiDumpName);
+    }
+    else {
+        state.ok = TDriverReplyParser::parseUiDumpData(state.uiDumpData, entry.uiDumpName, state.uiDump, state.errorText);
+    }
+
+    if (!entry.imageHash.isEmpty() && store.readBlob(entry.imageHash, state.imageData)) {
+        TDriverDecodedImage image;
+        image.fileName = entry.imageName;
+        image.data = state.imageData;
+        state.image = TDriverImageView::decodeImage(image).image;
+    }
+
+    qDebug() << FFL << entry.id << "time" << float(t.elapsed())/1000.0;
+    return state;
+}
@@ -25,6 +25,10 @@
 #include <QMenu>
 #include <QPoint>
 #include <QRect>
+#include <QBuffer>
+#include <QImageReader>
+#include <QTime>
+#include <QtConcurrentRun>
 
 #include <tdriver_debug_macros.h>
 
@@ -51,14 +55,16 @@ TDriverImageView::TDriverImageView( MainWindow *tdriverMainWindow, QWidget* pare
     QFrame( parent ),
     hoverTimer(new QTimer(this)),
     image(new QImage),
-    pixmap(NULL),
     highlightEnabledMode(0),
     updatePixmap(true),
     scaleImage(true),
     leftClickAction(SUT_DEFAULT_TAP),
     dragging(false),
     zoomFactor(1),
-    objTreeOwner(tdriverMainWindow)
+    objTreeOwner(tdriverMainWindow),
+    decodeGeneration(0),
+    decodeWatcher(NULL),
+    decodeIsRefresh(false)
 {
     connect( hoverTimer, SIGNAL( timeout() ), this, SLOT( hoverTimeout() ) );
     setMouseTracking( true ); //enable tracking of mouse movement
@@ -69,8 +75,6 @@ TDriverImageView::~TDriverImageView()
 {
     delete image;
     image=NULL;
-    delete pixmap;
-    pixmap=NULL;
 }
 
 
@@ -92,12 +96,15 @@ void TDriverImageView::setLeftClickAction(int action){
 
 void TDriverImageView::clearImage()
 {
+    cancelDecode();
     delete image;
     image = new QImage();
     imageOffset = QPoint();
     imageTasId.clear();
     rects.clear();
     highlightEnabledMode = 0;
+    pixmap = QPixmap();
+    pixmapCache.clear();
 
     if (!scaleImage)
         resize(image->size());
@@ -105,32 +112,98 @@ void TDriverImageView::clearImage()
     update();
 }
 
-void TDriverImageView::paintEvent(QPaintEvent *)
+void TDriverImageView::preparePixmap()
 {
-    //qDebug() << FCFL;
-    QPainter painter( this );
+    QSize target = image->size();
+    if (scaleImage && !image->isNull()) {
+        target.scale(size(), Qt::KeepAspectRatio);
+    }
 
-    if( !pixmap || updatePixmap) {
+    if (pixmap.isNull() || pixmap.size() != target) {
+        int ind = 0;
+        while (ind < pixmapCache.size() && pixmapCache.at(ind).size() != target) ++ind;
 
-        delete pixmap;
+        if (ind < pixmapCache.size()) {
+            pixmap = pixmapCache.takeAt(ind);
+        }
+        else if (image->isNull()) {
+            pixmap = QPixmap();
+        }
+        else if (target == image->size()) {
+            pixmap = QPixmap::fromImage(*image);
+        }
+        else {
+            pixmap = QPixmap::fromImage(image->scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+        }
 
-        if ( scaleImage && !image->isNull() ) {
-            pixmap = new QPixmap( QPixmap::fromImage( image->scaled( size(), Qt::KeepAspectRatio, Qt::SmoothTransformation) ) );
-            zoomFactor = float(pixmap->width()) / float(image->width());
-        } else {
-            pixmap = new QPixmap( QPixmap::fromImage( image->copy(), Qt::AutoColor ) );
-            zoomFactor = 1;
+        if (!pixmap.isNull()) {
+            pixmapCache.prepend(pixmap);
+            while (pixmapCache.size() > PixmapCacheSize) pixmapCache.removeLast();
         }
+    }
+
+    zoomFactor = (image->isNull() || pixmap.isNull()) ? 1 : float(pixmap.width()) / float(image->width());
+    imageOffset = QPoint((width() - pixmap.width()) / 2,
+                         (height() - pixmap.height()) / 2 );
+    updatePixmap = false;
+}
+
 
-        updatePixmap = false;
+QRect TDriverImageView::highlightRect(const QRect &rect) const
+{
+    return QRect(imageOffset.x() + float(rect.x()) * zoomFactor,
+                 imageOffset.y() + float(rect.y()) * zoomFactor,
+                 float(rect.width()) * zoomFactor,
+                 float(rect.height()) * zoomFactor );
+}
+
+
+QRegion TDriverImageView::highlightRegion() const
+{
+    QRegion region;
+
+    // highlightEnabledMode: 0=disabled, 1=single, 2=multiple
+    if (highlightEnabledMode) {
+        int count = rects.size();
+        if (highlightEnabledMode == 1 && count > 1) count = 1;
+
+        for ( int n = 0; n < count; n++ ) {
+            const QRect &rect = rects.at(n);
+            // pen is 2 pixels wide
+            if (!rect.isNull()) region += highlightRect(rect).adjusted(-2, -2, 2, 2);
+        }
+    }
+    return region;
+}
+
+
+QRect TDriverImageView::dragBounds() const
+{
+    if (!dragging || !testDragThreshold(dragStart, dragEnd)) return QRect();
+    return QRect(imageOffset + dragStart, imageOffset + dragEnd).normalized().adjusted(-1, -1, 1, 1);
+}
+
+
+void TDriverImageView::paintEvent(QPaintEvent *event)
+{
+    //qDebug() << FCFL;
+    QPainter painter( this );
+
+    if (updatePixmap) {
+        preparePixmap();
     }
 
-    imageOffset = QPoint((width() - pixmap->width()) / 2,
-                         (height() - pixmap->height()) / 2 );
+    // only the dirty part of cached pixmap is drawn
+    const QRect dirty = event->rect();
+    const QRect target = QRect(imageOffset, pixmap.size()) & dirty;
+    if (!target.isEmpty()) {
+        painter.drawPixmap( target, pixmap, target.translated(-imageOffset) );
+    }
 
-    painter.drawPixmap( imageOffset, *pixmap );
     painter.setOpacity(0.5);
 
+    // highlights and drag rectangle are an overlay over the pixmap,
+    // they update only their own area when changed
     // highlightEnabledMode: 0=disabled, 1=single, 2=multiple
     if (highlightEnabledMode) {
 
@@ -143,10 +216,10 @@ void TDriverImageView::paintEvent(QPaintEvent *)
         for ( int n = 0; n < count; n++ ) {
             const QRect &rect = rects.at(n);
             if (!rect.isNull()) {
-                painter.drawRect(imageOffset.x() + float(rect.x()) * zoomFactor,
-                                 imageOffset.y() + float(rect.y()) * zoomFactor,
-                                 float(rect.width()) * zoomFactor,
-                                 float(rect.height()) * zoomFactor );
+                const QRect widgetRect = highlightRect(rect);
+                if (widgetRect.adjusted(-2, -2, 2, 2).intersects(dirty)) {
+                    painter.drawRect(widgetRect);
+                }
             }
         }
     }
@@ -171,13 +244,13 @@ void TDriverImageView::mousePressEvent(QMouseEvent *event)
 
     if (dragging) {
         // pressing other button while dragging cancels the drag
+        update(dragBounds());
         dragging = false;
-        update();
     }
-    if (event->button() == Qt::LeftButton && pixmap) {
+    if (event->button() == Qt::LeftButton && !pixmap.isNull()) {
         // prepare for possible drag
         dragStart = mousePos - imageOffset;
-        fixPoint(dragStart, pixmap->rect());
+        fixPoint(dragStart, pixmap.rect());
     }
     else {
         QFrame::mousePressEvent(event);
@@ -197,21 +270,22 @@ void TDriverImageView::mouseReleaseEvent(QMouseEvent *event)
 
         mousePos = event->pos();
 
-        if (dragging && pixmap) {
+        if (dragging && !pixmap.isNull()) {
             // drag in progress, finish it and test if result is valid selection
+            const QRect oldBounds = dragBounds();
             dragEnd = mousePos - imageOffset;
-            fixPoint(dragEnd, pixmap->rect());
+            fixPoint(dragEnd, pixmap.rect());
             dragging = testDragThreshold(dragStart, dragEnd);
-            if (!dragging) update();
+            if (!dragging) update(oldBounds);
         }
 
         if (dragging) {
             // valid drag happened
             dragAction();
+            update(dragBounds());
             dragging = false;
-            update();
         }
-        else if (pixmap && pixmap->rect().contains(event->pos() - imageOffset)) {
+        else if (!pixmap.isNull() && pixmap.rect().contains(event->pos() - imageOffset)) {
             // non-dragging click
             switch (leftClickAction) {
 
@@ -245,10 +319,11 @@ void TDriverImageView::mouseReleaseEvent(QMouseEvent *event)
 void TDriverImageView::mouseMoveEvent( QMouseEvent * event )
 {
     mousePos = event->pos();
+    const QRect oldDragBounds = dragBounds();
 
-    if (event->buttons() == Qt::LeftButton && pixmap) {
+    if (event->buttons() == Qt::LeftButton && !pixmap.isNull()) {
         dragEnd = mousePos - imageOffset;
-        fixPoint(dragEnd, pixmap->rect());
+        fixPoint(dragEnd, pixmap.rect());
         if (!dragging && testDragThreshold(dragStart, dragEnd)) {
             hoverTimer->stop();
             dragging = true;
@@ -263,7 +338,7 @@ void TDriverImageView::mouseMoveEvent( QMouseEvent * event )
                               .arg(pos2.x()).arg(pos2.y())
                               .arg(pos2.x()-pos1.x()).arg(pos2.y()-pos1.y()),
                               2000 );
-        repaint();
+        update(oldDragBounds | dragBounds());
     }
     else {
         if (leftClickAction != VISUALIZER_INSPECT && event->buttons() == Qt::NoButton) {
@@ -289,8 +364,7 @@ void TDriverImageView::contextMenuEvent ( QContextMenuEvent *event)
             QMap<QAction*, QString> sortKeys;
 
             foreach(TestObjectKey id, matchingObjects) {
-                const QMap<QString, AttributeInfo > &attrMap = objTreeOwner->testobjAttributes(id);
-                const TreeItemInfo &treeData = objTreeOwner->testobjTreeData(id);
+                const TreeItemInfo treeData = objTreeOwner->testobjTreeData(id);
 
                 // create heading entry to context menu
                 QString tmpText;
@@ -299,13 +373,13 @@ void TDriverImageView::contextMenuEvent ( QContextMenuEvent *event)
 
                 tmpText = treeData.name;
                 if ( tmpText.isEmpty())
-                    tmpText = attrMap.value("objectname").value;
+                    tmpText = objTreeOwner->testobjAttributeValue(id, "objectname");
                 if ( !tmpText.isEmpty()) {
                     idText += QString(" name '%1'").arg(tmpText);
                     sortKey = "1"+tmpText;
                 }
 
-                tmpText = attrMap.value("text").value;
+                tmpText = objTreeOwner->testobjAttributeValue(id, "text");
                 if ( !tmpText.isEmpty()) {
                     idText += QString(" text '%1'").arg(tmpText);
                     if (sortKey.isEmpty())
@@ -320,7 +394,7 @@ void TDriverImageView::contextMenuEvent ( QContextMenuEvent *event)
 
                 QString typeText = treeData.type;
                 if (typeText.isEmpty())
-                    typeText = attrMap.value("objecttype").value;
+                    typeText = objTreeOwner->testobjAttributeValue(id, "objecttype");
                 if (typeText.isEmpty())
                     typeText = "????";
 
@@ -518,12 +592,142 @@ void TDriverImageView::forwardInsertObjectById()
 
 
 void TDriverImageView::refreshImage(const QString &imagePath)
+{
+    startDecode(imagePath, QByteArray(), true);
+}
+
+
+void TDriverImageView::refreshImage(const QString &imagePath, const QByteArray &imageData)
+{
+    startDecode(imagePath, imageData, true);
+}
+
+
+void TDriverImageView::loadImage(const QString &imagePath)
+{
+    startDecode(imagePath, QByteArray(), false);
+}
+
+
+void TDriverImageView::showDecodedImage(const QString &imagePath, const QImage &decodedImage,
+                                        const QByteArray &imageData)
+{
+    cancelDecode();
+    setImage(imagePath, decodedImage, imageData, QImage());
+}
+
+
+void TDriverImageView::startDecode(const QString &imagePath, const QByteArray &imageData, bool refresh)
+{
+    // pending refresh is not reported cancelled if this refresh replaces it
+    if (dropDecode() && !refresh) emit imageDecodeCancelled();
+    decodeIsRefresh = refresh;
+
+    // name and data stay with the shown image until setImage replaces it
+    TDriverDecodedImage request;
+    request.generation = ++decodeGeneration;
+    request.fileName = imagePath;
+    request.data = imageData;
+    if (scaleImage) request.scaledSize = size();
+
+    decodeWatcher = new QFutureWatcher<TDriverDecodedImage>(this);
+    connect(decodeWatcher, SIGNAL(finished()), SLOT(decodeFinished()));
+    decodeWatcher->setFuture(QtConcurrent::run(&TDriverImageView::decodeImage, request));
+}
+
+
+void TDriverImageView::cancelDecode()
+{
+    if (dropDecode()) emit imageDecodeCancelled();
+}
+
+
+bool TDriverImageView::dropDecode()
+{
+    if (!decodeWatcher) return false;
+
+    // result of cancelled decode is not used
+    decodeWatcher->disconnect(this);
+    connect(decodeWatcher, SIGNAL(finished()), decodeWatcher, SLOT(deleteLater()));
+    decodeWatcher = NULL;
+    return decodeIsRefresh;
+}
+
+
+void TDriverImageView::decodeFinished()
+{
+    QFutureWatcher<TDriverDecodedImage> *watcher = static_cast<QFutureWatcher<TDriverDecodedImage> *>(sender());
+    const TDriverDecodedImage result = watcher->result();
+    watcher->deleteLater();
+
+    if (watcher != decodeWatcher || result.generation != decodeGeneration) {
+        qDebug() << FCFL << "dropping stale image" << result.fileName;
+        return;
+    }
+    decodeWatcher = NULL;
+
+    setImage(result.fileName, result.image, result.data, result.scaled);
+    if (decodeIsRefresh) emit imageDecoded(!result.image.isNull());
+}
+
+
+// Runs in worker thread
+TDriverDecodedImage TDriverImageView::decodeImage(TDriverDecodedImage request)
+{
+    QTime t;
+    t.start();
+
+    QBuffer buffer;
+    QImageReader reader;
+    if (!request.data.isNull()) {
+        buffer.setData(request.data);
+        buffer.open(QIODevice::ReadOnly);
+        reader.setDevice(&buffer);
+    }
+    else {
+        reader.setFileName(request.fileName);
+    }
+
+    // full resolution is always needed for object coordinates and saved cuts,
+    // so the view sized copy is scaled here instead of decoding straight to it
+    if (!reader.read(&request.image)) {
+        qDebug() << FFL << request.fileName << "decode failed:" << reader.errorString();
+    }
+    else if (request.scaledSize.isValid()) {
+        QSize target = request.image.size();
+        target.scale(request.scaledSize, Qt::KeepAspectRatio);
+        if (target != request.image.size() && !target.isEmpty()) {
+            request.scaled = request.image.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+    }
+
+    qDebug() << FFL << request.fileName << "decoded, time" << float(t.elapsed())/1000.0;
+    return request;
+}
+
+
+void TDriverImageView::setImage(const QString &imagePath, const QImage &newImage, const QByteArray &newData,
+                                const QImage &scaled)
 {
     delete image;
-    image = new QImage( imagePath );
+    image = new QImage( newImage );
 
     imageFileName = (image->isNull()) ? QString() : imagePath;
+    imageData = (image->isNull()) ? QByteArray() : newData;
+    imageUpdated();
+
+    // view sized copy scaled by worker goes to cache, so painting needs no scaling
+    if (!scaled.isNull()) {
+        pixmapCache.prepend(QPixmap::fromImage(scaled));
+    }
+}
+
+
+void TDriverImageView::imageUpdated()
+{
     imageOffset = QPoint();
+    pixmap = QPixmap();
+    pixmapCache.clear();
 
     if (!scaleImage)
         resize(image->size());
@@ -539,8 +743,11 @@ void TDriverImageView::refreshImage(const QString &imagePath)
 
 void TDriverImageView::disableDrawHighlight()
 {
+    if (!highlightEnabledMode) return;
+
+    const QRegion oldRegion = highlightRegion();
     highlightEnabledMode = 0;
-    update();
+    update(oldRegion);
 }
 
 
@@ -548,9 +755,12 @@ void TDriverImageView::drawHighlights( RectList geometries, bool multiple )
 {
     //qDebug() << "drawHighlight";
 
+    const QRegion oldRegion = highlightRegion();
+
     highlightEnabledMode = (multiple) ? 2 : 1;
 
     rects = geometries;
+    update(oldRegion | highlightRegion());
 }
 
 
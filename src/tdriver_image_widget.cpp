@@ -40,6 +40,8 @@ void MainWindow::connectImageWidgetSignals() {
     connect( imageWidget, SIGNAL( imageTapById(TestObjectKey)), SLOT(imageTapFromId(TestObjectKey)));
 
     connect( imageWidget, SIGNAL(imageTasIdChanged(QString)), SLOT(refreshScreenshotObjectList()));
+    connect( imageWidget, SIGNAL(imageDecoded(bool)), SLOT(imageRefreshDone(bool)));
+    connect( imageWidget, SIGNAL(imageDecodeCancelled()), SLOT(imageRefreshCancelled()));
 }
 
 
@@ -101,7 +103,7 @@ void MainWindow::imageInspectFromId(TestObjectKey id)
 void MainWindow::imageTapFromId(TestObjectKey id)
 {
     if ( highlightByKey( id, false ) && lastHighlightedObjectKey != 0 && currentApplication.haveId()) {
-        TreeItemInfo treeItemData = objectTreeData.value( lastHighlightedObjectKey );
+        TreeItemInfo treeItemData = testObjects.treeItemInfo( testObjectIndex( lastHighlightedObjectKey ) );
         sendTapScreen(QStringList() << "tap"
                       << treeItemData.type + "(:id=>" + TDriverUtil::rubySingleQuote(treeItemData.id) + ")"
                       << currentApplication.id);
@@ -137,7 +139,7 @@ void MainWindow::clickedImage()
     QPoint pos(imageWidget->getMousePosInImage());
 
     if ( highlightAtCoords( pos, false ) && lastHighlightedObjectKey != 0 ) {
-        const TreeItemInfo &treeItemData = objectTreeData.value( lastHighlightedObjectKey );
+        const TreeItemInfo treeItemData = testObjects.treeItemInfo( testObjectIndex( lastHighlightedObjectKey ) );
         sendTapScreen( QStringList() << "tap"
                       << treeItemData.type + "(:id=>" + TDriverUtil::rubySingleQuote(treeItemData.id) + ")"
                       << currentApplication.id);
@@ -161,7 +163,7 @@ void MainWindow::drawHighlight( TestObjectKey itemKey, bool multiple )
         if (screenshotObjects.contains(itemKey)) {
             // collect geometries for item and its childs
             RectList geometries;
-            collectGeometries( testObjectKey2Ptr(itemKey), geometries);
+            collectGeometries( testObjectIndex(itemKey), geometries);
 
             if ( !geometries.isEmpty() ) {
 
@@ -181,66 +183,40 @@ void MainWindow::drawHighlight( TestObjectKey itemKey, bool multiple )
 }
 
 
-// Get list of all visible objects that are under given position
-bool MainWindow::collectMatchingVisibleObjects( QPoint pos, QList<TestObjectKey> &matchingObjects)
+// Highlights several objects without their children
+void MainWindow::drawHighlight( const QVector<int> &indexes )
 {
-    QSet<TestObjectKey>::const_iterator visibleObject;
-
-    matchingObjects.clear();
+    RectList geometries;
 
-    for (visibleObject = screenshotObjects.constBegin();
-         visibleObject != screenshotObjects.constEnd();
-         ++visibleObject ) {
-
-        // add only objects that are in geometriesMap
-        const RectList &geometries = geometriesMap.value( *visibleObject );
-        if ( !geometries.isEmpty() ) {
-
-            // add only objects that contain pos
-            if (geometries.first().contains( pos.x(), pos.y() ) ) {
-
-                // don't add Layouts and LayoutItems, they shouldn't be selectable from the image
-                QString objectType = attributesMap.value(*visibleObject).value("objecttype").value;
-                if (objectType != "Layout" && objectType != "LayoutItem") {
-                    matchingObjects << (TestObjectKey)( *visibleObject );
-                }
-            }
+    foreach ( int index, indexes ) {
+        if ( index >= 0 && index < objectGeometries.size() && !objectGeometries.at( index ).isNull() ) {
+            geometries << objectGeometries.at( index );
         }
     }
 
-    return !matchingObjects.isEmpty();
-}
-
-
-// Get smallest object from list of objects
-bool MainWindow::getSmallestObjectFromMatches( QList<TestObjectKey> *matchingObjects, TestObjectKey & objectPtr ) {
-
-    //qDebug() << "getSmallestObjectFromMatches";
-
-    bool result = false;
-    int smallestObjectSize = -1;
-    TestObjectKey smallestObjectPtr = 0;
-
-    QList<TestObjectKey>::const_iterator matchingObject;
-    for ( matchingObject = matchingObjects->constBegin(); matchingObject != matchingObjects->constEnd(); ++matchingObject ) {
+    // next single object highlight is drawn even if it's same object as before
+    lastHighlightedObjectKey = 0;
 
-        const RectList &geometries = geometriesMap.value( *matchingObject );
+    if ( geometries.isEmpty() ) {
+        imageWidget->disableDrawHighlight();
+    }
+    else {
+        imageWidget->drawHighlights( geometries, true );
+    }
+}
 
-        if ( !geometries.isEmpty() ) {
 
-            // calculate size of object in pixels
-            int matchingObjectArea = geometries.first().height() * geometries.first().width();
+// Get list of all visible objects that are under given position
+bool MainWindow::collectMatchingVisibleObjects( QPoint pos, QList<TestObjectKey> &matchingObjects)
+{
+    matchingObjects.clear();
 
-            if ( ( smallestObjectPtr == 0 || matchingObjectArea < smallestObjectSize ) && matchingObjectArea > 0 ) {
-                smallestObjectPtr = *matchingObject;
-                smallestObjectSize = matchingObjectArea;
-                result = true;
-            }
-        }
+    // Layouts and LayoutItems are not selectable from the image, so they are not included
+    foreach (int objectIndex, screenshotIndex.objectsAt( pos )) {
+        matchingObjects << testObjectKey( objectIndex );
     }
 
-    objectPtr = smallestObjectPtr;
-    return result;
+    return !matchingObjects.isEmpty();
 }
 
 
@@ -255,16 +231,13 @@ bool MainWindow::highlightByKey( TestObjectKey itemKey, bool selectItem, QString
 
     drawHighlight( itemKey, false );
 
-    QTreeWidgetItem *item = testObjectKey2Ptr(itemKey);
-
     // select item from object tree if selectItem is true
     if ( selectItem ) {
-        objectTree->scrollToItem( item );
-        objectTree->setCurrentItem( item );
+        setCurrentObject( itemKey );
     }
 
     if (!insertMethodToEditor.isNull()) {
-        objectViewItemAction(item, 0, insertAction, insertMethodToEditor);
+        objectViewItemAction(itemKey, insertAction, insertMethodToEditor);
     }
 
     return true;
@@ -275,16 +248,10 @@ bool MainWindow::highlightByKey( TestObjectKey itemKey, bool selectItem, QString
 bool MainWindow::highlightAtCoords( QPoint pos, bool selectItem, QString insertMethodToEditor )
 {
     bool result = false;
-    QList<TestObjectKey> matchingObjects;
-
-    if ( collectMatchingVisibleObjects( pos, matchingObjects ) ) {
+    const int smallestIndex = screenshotIndex.smallestAt( pos );
 
-        qSort( matchingObjects.begin(), matchingObjects.end() );
-        TestObjectKey matchingObject = 0;
-
-        if ( getSmallestObjectFromMatches( &matchingObjects, matchingObject ) ) {
-            result = highlightByKey(matchingObject, selectItem, insertMethodToEditor);
-        }
+    if ( smallestIndex >= 0 ) {
+        result = highlightByKey(testObjectKey( smallestIndex ), selectItem, insertMethodToEditor);
     }
 
     return result;
@@ -22,6 +22,9 @@
 #include "tdriver_recorder.h"
 #include "tdriver_image_view.h"
 #include "tdriver_statehistorymenu.h"
+#include "tdriver_reply_parser.h"
+#include "tdriver_state_history_store.h"
+#include "tdriver_history_prefetcher.h"
 
 #include <tdriver_tabbededitor.h>
 #include <tdriver_rubyinterface.h>
@@ -41,7 +44,12 @@ MainWindow::MainWindow() :
     keyLastUiStateDir("files/last_uistate_dir"),
     keyLastTDriverDir("files/last_tdriver_dir"),
     keyHistoryStateDirCount("files/state_history_count"),
+    keyHistoryLegacyDirsRemoved("files/state_history_legacy_removed"),
+    keyInlineReplies("files/inline_replies"),
     messageTimeoutTimer(new QTimer(this)),
+    replyParser(new TDriverReplyParser(this)),
+    stateHistory(NULL),
+    historyPrefetcher(NULL),
     doRefreshAfterAppList(false),
     historySavingCounter(-1),
     richTextContainerWidget(new QWidget),
@@ -50,6 +58,7 @@ MainWindow::MainWindow() :
     resetMessageSequenceFlags();
     messageTimeoutTimer->setSingleShot(true);
     connect(messageTimeoutTimer, SIGNAL(timeout()), SLOT(messageTimeoutSlot()));
+    connect(replyParser, SIGNAL(parsed(TDriverParsedReply)), SLOT(receiveParsedReply(TDriverParsedReply)));
 
     richTextContainer->setupUi(richTextContainerWidget);
 
@@ -82,6 +91,7 @@ MainWindow::~MainWindow()
 {
     delete richTextContainer;
     delete richTextContainerWidget;
+    delete stateHistory;
 }
 
 void MainWindow::tdriverMsgSetTitleText()
@@ -177,10 +187,12 @@ bool MainWindow::setup()
     outputPath = QDir::tempPath();
     if (!outputPath.endsWith('/')) outputPath.append('/');
 
-    // prefix fo state history directories
+    // state history, and prefix of state history directories of earlier versions, which are removed
     stateHistoryFilePathPrefix = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
-    QDir().mkpath(stateHistoryFilePathPrefix);
+    stateHistory = new TDriverStateHistoryStore(stateHistoryFilePathPrefix + "/tdriver_visualizer_history");
+    historyPrefetcher = new TDriverHistoryPrefetcher(*stateHistory, this);
     stateHistoryFilePathPrefix += "/tdriver_visualizer_state_";
+    removeLegacyStateHistory();
 
     TDriverRubyInterface::startGlobalInstance();
 
@@ -228,7 +240,7 @@ bool MainWindow::setup()
         TDriverRubyInterface::globalInstance()->requestClose();
     }
 
-    // default font for QTableWidgetItems and QTreeWidgetItems
+    // default font for QTableWidgetItems and object tree
     defaultFont = new QFont;
     defaultFont->fromString(  settings.value( "font/settings", QString("Sans Serif,8,-1,5,50,0,0,0,0,0") ).toString() );
     emit defaultFontSet(*defaultFont);
@@ -553,7 +565,7 @@ bool MainWindow::eventFilter(QObject * object, QEvent *event) {
 void MainWindow::keyPressEvent ( QKeyEvent * event )
 {
     // qDebug() << "MainWindow::keyPressEvent: " << event->key();
-    if ( QApplication::focusWidget() == objectTree && objectTree->currentItem() != NULL )
+    if ( QApplication::focusWidget() == objectTree && objectTree->currentIndex().isValid() )
         objectTreeKeyPressEvent( event );
     else
         event->ignore();
@@ -646,10 +658,14 @@ void MainWindow::receiveTDriverMessage(quint32 seqNum, QByteArray name, const BA
         return;
     }
 
-    qDebug() << FCFL << "received visualization message:" << seqNum << reply;
+    // keys only, payloads may be megabytes
+    qDebug() << FCFL << "received visualization message:" << seqNum << reply.keys();
 
     SentTDriverMsg sentMsg(sentTDriverMsgs.take(seqNum));
 
+    // replies may arrive in any order, time-out is for the last one
+    if (sentTDriverMsgs.isEmpty()) messageTimeoutTimer->stop();
+
     bool handleError = false;
     bool handleNormally = false;
 
@@ -682,17 +698,14 @@ void MainWindow::receiveTDriverMessage(quint32 seqNum, QByteArray name, const BA
 
     case commandListApps:
         if (handleNormally) {
-            qDebug() << FCFL << "got app list:" << applicationsNamesMap;
             statusbar(tr("Parsing applications list..."));
-            parseApplicationsXml( reply.value("applications_filename").value(0) );
-            statusbar(tr("Applications list updated!"), 2000);
+            // continued in receiveParsedReply
+            replyParser->parse(TDriverReplyParser::ApplicationsReply, reply.value("applications_filename").value(0),
+                               QString(), reply.value("applications_data").value(0));
         }
-        if (doRefreshAfterAppList) {
-            // leave doRefreshAfterAppList to true for the call, in case it's used.
-            if (!handleError) startRefreshSequence();
-            doRefreshAfterAppList = false;
+        else {
+            finishAppListRefresh(handleError);
         }
-        updateWindowTitle();
         break;
 
     case commandDisconnectSUT:
@@ -712,43 +725,31 @@ void MainWindow::receiveTDriverMessage(quint32 seqNum, QByteArray name, const BA
 
     case commandRefreshUI:
         if (handleNormally) {
-            if (historySavingCounter > 0) {
-                historySavingCounter &= ~1;
-            }
-
-            statusbar(tr("UI XML refresh done, updating object tree..."));
-            updateObjectTree( reply.value("ui_filename").value(0) );
-            titleFileText.clear();
-            updateWindowTitle();
-
-            statusbar(tr("UI XML refresh done, updating properties"));
-
-            //note: sendImageRequest() may be already queued
-            //note: propertiesDock should be disabled by code that sent commandRefreshUi
-            if (!sendUpdateBehaviourXml()) {
-                statusbar(tr("Could not send behaviour update!"), 2000);
-                propertiesDock->setDisabled(false);
-            }
+            statusbar(tr("UI XML refresh done, parsing..."));
+            // object tree stays disabled until parsed in receiveParsedReply
+            replyParser->parse(TDriverReplyParser::UiDumpReply, reply.value("ui_filename").value(0),
+                               QString(), reply.value("ui_data").value(0));
         }
         else {
             // re-enable if not normal handling above
             propertiesDock->setDisabled(false);
+            objectTree->setDisabled(false);
         }
-        objectTree->setDisabled(false);
         break;
 
     case commandRefreshImage:
         if (handleNormally) {
-            if (historySavingCounter > 0) {
-                historySavingCounter &= ~2;
-            }
             qApp->alert(this, 800);
 
-            statusbar(tr("Image refresh done, updating..."), 1000);
+            statusbar(tr("Image refresh done, decoding..."));
             imageWidget->disableDrawHighlight();
-            imageWidget->refreshImage( reply.value("image_filename").value(0));
-            imageWidget->repaint();
-            statusbar(tr("Image refresh complete!"), 1000);
+            // continued in imageRefreshDone
+            if (reply.contains("image_data")) {
+                imageWidget->refreshImage( reply.value("image_filename").value(0), reply.value("image_data").value(0));
+            }
+            else {
+                imageWidget->refreshImage( reply.value("image_filename").value(0));
+            }
         }
         // re-enable image dockwidget always
         imageViewDock->setDisabled(false);
@@ -813,13 +814,8 @@ void MainWindow::receiveTDriverMessage(quint32 seqNum, QByteArray name, const BA
     case commandBehavioursXml:
         if (handleNormally) {
             statusbar(tr("Behaviours received"), 2000);
-            if (parseXml( reply.value("behaviour_filename").value(0) , behaviorDomDocument )) {
-                buildBehavioursMap();
-                doPropertiesTableUpdate();
-                // todo: handle properties dock disabling better
-                propertiesDock->setDisabled(false);
-            }
-            else qDebug() << FCFL << "parseXml fail";
+            replyParser->parse(TDriverReplyParser::BehavioursReply, reply.value("behaviour_filename").value(0),
+                               QString(), reply.value("behaviour_data").value(0));
         }
         break;
 
@@ -831,26 +827,11 @@ void MainWindow::receiveTDriverMessage(quint32 seqNum, QByteArray name, const BA
         if (handleNormally) {
 
             QString fileName(reply.value("signal_filename").value(0));
-            if (!fileName.isEmpty()) {
-                const QStringList signalsList = parseSignalsXml( fileName );
-                apiSignalsMap[sentMsg.typeStr] = signalsList;
-
-                foreach(const QString &signalName, signalsList) {
-                    // add signal name
-                    QTableWidgetItem *signalItem = new QTableWidgetItem( signalName );
-                    signalItem->setFlags( Qt::ItemIsSelectable | Qt::ItemIsEnabled );
-                    signalItem->setFont( *defaultFont );
-
-                    // append new line to table
-                    int rowNumber = signalsTable->rowCount();
-                    signalsTable->insertRow( rowNumber );
-                    signalsTable->setItem( rowNumber, 0, signalItem );
-                }
-                // sort signals table
-                signalsTable->sortItems( 0 );
-                signalsTable->resizeColumnToContents (0);
-
-                statusbar(tr("Signal list received."), 2000);
+            if (reply.contains("signal_data")) {
+                replyParser->parse(TDriverReplyParser::SignalsReply, fileName, sentMsg.typeStr, reply.value("signal_data").value(0));
+            }
+            else if (!fileName.isEmpty() && QFile::exists(fileName)) {
+                replyParser->parse(TDriverReplyParser::SignalsReply, fileName, sentMsg.typeStr);
             }
             else statusbar(tr("Didn't get any signals."), 2000);
 
@@ -883,6 +864,159 @@ void MainWindow::receiveTDriverMessage(quint32 seqNum, QByteArray name, const BA
         qDebug() << FCFL << "got message type commandInvalid!";
     }
 
+    saveStateHistoryIfReady();
+}
+
+
+void MainWindow::receiveParsedReply(const TDriverParsedReply &reply)
+{
+    if (!reply.ok && !reply.errorText.isEmpty()) {
+        QMessageBox::critical( this, tr( "XML Error" ), reply.errorText );
+    }
+
+    switch (reply.type) {
+
+    case TDriverReplyParser::UiDumpReply:
+        statusbar(tr("UI XML refresh done, updating object tree..."));
+        updateObjectTree( reply.fileName, reply.ok ? &reply.uiDump : NULL, reply.data );
+        titleFileText.clear();
+        updateWindowTitle();
+
+        statusbar(tr("UI XML refresh done, updating properties"));
+        finishUiDumpRefresh(true);
+        break;
+
+    case TDriverReplyParser::BehavioursReply:
+        if (reply.ok) {
+            behaviorDomDocument = reply.document;
+            buildBehavioursMap();
+            doPropertiesTableUpdate();
+            // todo: handle properties dock disabling better
+            propertiesDock->setDisabled(false);
+        }
+        else qDebug() << FCFL << "parseXml fail";
+        break;
+
+    case TDriverReplyParser::ApplicationsReply:
+        if (!reply.ok) {
+            qDebug() << FCFL << "parseXml fail";
+            statusbar(tr("Could not parse applications list!"), 2000);
+            finishAppListRefresh(true);
+            break;
+        }
+        parseApplicationsXml( reply.document );
+        qDebug() << FCFL << "got app list:" << applicationsNamesMap;
+        statusbar(tr("Applications list updated!"), 2000);
+        finishAppListRefresh(false);
+        break;
+
+    case TDriverReplyParser::SignalsReply: {
+        const QStringList signalsList = parseSignalsXml( reply.document );
+        apiSignalsMap[reply.context] = signalsList;
+
+        // signals of another object type are only cached, they don't belong to selected object
+        if (reply.context != objectTreeModel->typeText(testObjectIndex(currentObjectKey()))) {
+            break;
+        }
+
+        foreach(const QString &signalName, signalsList) {
+            // add signal name
+            QTableWidgetItem *signalItem = new QTableWidgetItem( signalName );
+            signalItem->setFlags( Qt::ItemIsSelectable | Qt::ItemIsEnabled );
+            signalItem->setFont( *defaultFont );
+
+            // append new line to table
+            int rowNumber = signalsTable->rowCount();
+            signalsTable->insertRow( rowNumber );
+            signalsTable->setItem( rowNumber, 0, signalItem );
+        }
+        // sort signals table
+        signalsTable->sortItems( 0 );
+        signalsTable->resizeColumnToContents (0);
+
+        statusbar(tr("Signal list received."), 2000);
+        break;
+    }
+
+    default:
+        qDebug() << FCFL << "unknown parsed reply type" << reply.type;
+    }
+
+    saveStateHistoryIfReady();
+}
+
+
+// Continues image refresh after the image is decoded and shown
+void MainWindow::imageRefreshDone(bool ok)
+{
+    if (historySavingCounter > 0) {
+        historySavingCounter &= ~2;
+    }
+
+    if (ok) statusbar(tr("Image refresh complete!"), 1000);
+    else statusbar(tr("Could not decode image!"), 2000);
+
+    saveStateHistoryIfReady();
+}
+
+
+// Image of refresh sequence was replaced before it was decoded, so it no longer blocks saving
+void MainWindow::imageRefreshCancelled()
+{
+    if (historySavingCounter > 0) {
+        historySavingCounter &= ~2;
+    }
+
+    saveStateHistoryIfReady();
+}
+
+
+// Continues refresh sequence after application list request is done
+void MainWindow::finishAppListRefresh(bool failed)
+{
+    if (doRefreshAfterAppList) {
+        // leave doRefreshAfterAppList to true for the call, in case it's used.
+        if (!failed) startRefreshSequence();
+        doRefreshAfterAppList = false;
+    }
+    updateWindowTitle();
+}
+
+
+// Ends ui dump refresh sequence when its reply was parsed, or when parsing was cancelled
+void MainWindow::finishUiDumpRefresh(bool parsed)
+{
+    if (historySavingCounter > 0) {
+        // cancelled refresh was replaced by other ui dump, which is not saved as new state
+        if (parsed) historySavingCounter &= ~1;
+        else historySavingCounter = -1;
+    }
+
+    //note: sendImageRequest() may be already queued
+    //note: propertiesDock should be disabled by code that sent commandRefreshUi
+    if (!parsed) {
+        propertiesDock->setDisabled(false);
+    }
+    else if (!sendUpdateBehaviourXml()) {
+        statusbar(tr("Could not send behaviour update!"), 2000);
+        propertiesDock->setDisabled(false);
+    }
+    objectTree->setDisabled(false);
+}
+
+
+// Cancels ui dump still being parsed from a refresh, it would replace the one shown next
+void MainWindow::cancelUiDumpRefresh()
+{
+    if (replyParser->isParsing(TDriverReplyParser::UiDumpReply)) {
+        replyParser->cancel(TDriverReplyParser::UiDumpReply);
+        finishUiDumpRefresh(false);
+    }
+}
+
+
+void MainWindow::saveStateHistoryIfReady()
+{
     if (historySavingCounter == 0) {
         historySavingCounter = -1;
         qDebug() << FCFL << "Saving state to state history";
@@ -1009,6 +1143,10 @@ bool MainWindow::sendTDriverCommand( ExecuteCommandType commandType,
 {
     BAListMap msg;
     msg["input"] = TDriverUtil::toBAList(inputList);
+    if (QSettings().value(keyInlineReplies, true).toBool()) {
+        // ask for payloads in reply instead of temporary files
+        msg.insert("inline", BAList());
+    }
 
     quint32 seqNum = TDriverRubyInterface::globalInstance()->sendCmd(TDriverUtil::visualizationId, msg);
 
@@ -1186,9 +1324,10 @@ void MainWindow::createActions()
     stateHistoryAction->setText( "&State history" );
     //stateHistoryAction->setShortcuts(QList<QKeySequence>() << QKeySequence(tr("Ctrl+M, S")) << QKeySequence(tr("Ctrl+M, Ctrl+S")));
     stateHistoryAction->setMenu(
-                new TDriverStateHistoryMenu(stateHistoryFilePathPrefix, this));
+                new TDriverStateHistoryMenu(stateHistory, this));
     connect(stateHistoryAction->menu(), SIGNAL(activated(QString)),
-            SLOT(loadStateFromHistoryDir(QString)));
+            SLOT(loadStateFromHistory(QString)));
+    connect(stateHistoryAction->menu(), SIGNAL(aboutToShow()), SLOT(prefetchStateHistory()));
 
     fontAction = new QAction(tr( "Select default font..." ), this);
     fontAction->setObjectName("main font");
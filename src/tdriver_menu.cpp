@@ -21,6 +21,9 @@
 #include "tdriver_main_window.h"
 #include "tdriver_image_view.h"
 #include "tdriver_recorder.h"
+#include "tdriver_reply_parser.h"
+#include "tdriver_state_history_store.h"
+#include "tdriver_history_prefetcher.h"
 #include "tdriver_debug_macros.h"
 
 #include <QSharedPointer>
@@ -293,55 +296,41 @@ void MainWindow::loadStateByDialog()
 
         // create image filename and send it to imagewidget
         fileName.replace(fileName.lastIndexOf('.'), fileName.size(), imageSuffix);
-        imageWidget->refreshImage( fileName );
+        imageWidget->loadImage( fileName );
 
         updateWindowTitle();
     }
 }
 
 
-void MainWindow::loadStateFromHistoryDir(const QString &dirPath)
+void MainWindow::loadStateFromHistory(const QString &entryId)
 {
-    loadStateFromDir(dirPath);
-    titleFileText = tr("previous state %1").arg(dirPath.mid(dirPath.lastIndexOf('_'), 2));
-    updateWindowTitle();
-
-}
-
-
-void MainWindow::loadStateFromDir(const QString &dirPath)
-{
-    QDir dir(dirPath);
+    TDriverStateHistoryEntry entry;
+    TDriverHistoryState state;
 
-    QString errText;
-
-    if (!dir.exists()) {
-        errText = tr("There is no directory with path %1").arg(dirPath);
+    if (!stateHistory->entry(entryId, entry)) {
+        state.errorText = tr("State %1 is no longer in state history").arg(entryId);
+    }
+    else if (historyPrefetcher->lookup(entry, state)) {
+        qDebug() << FCFL << "using prefetched state" << entryId;
     }
     else {
-        QStringList xmlFiles = dir.entryList(QStringList() << "*.xml", QDir::Files);
-        qDebug() << FCFL << dirPath << "contains:" << xmlFiles;
-        if (xmlFiles.isEmpty()) {
-            errText = tr("Directory %1 contains no .xml files").arg(dirPath);
-        }
-        else if (xmlFiles.size() > 1) {
-            errText = tr("Directory %1 contains multiple .xml files:\n\n  %2")
-                    .arg(dirPath).arg(xmlFiles.join("\n  "));
-        }
-        else {
-            QString filePath = dirPath + "/" + xmlFiles.first();
-            updateObjectTree(filePath);
-
-            filePath.replace(filePath.lastIndexOf('.'), filePath.size(), imageSuffix);
-            imageWidget->refreshImage(filePath);
-
-        }
+        state = TDriverHistoryPrefetcher::loadState(*stateHistory, entry);
     }
-    if (!errText.isEmpty()) {
+
+    if (!state.ok) {
         QMessageBox::warning(this,
-                             tr("Loading State from a directory"),
-                             errText);
+                             tr("Loading State from history"),
+                             state.errorText);
+        return;
     }
+
+    cancelUiDumpRefresh();
+    updateObjectTree(state.uiDumpName, &state.uiDump, state.uiDumpData);
+    imageWidget->showDecodedImage(state.imageName, state.image, state.imageData);
+
+    titleFileText = tr("previous state %1").arg(entry.created.toString("yyyy-MM-dd hh:mm:ss"));
+    updateWindowTitle();
 }
 
 
@@ -381,49 +370,65 @@ static inline QString filledDigitString(unsigned num, int fieldWidth) {
 }
 
 
+static inline QByteArray readFileData(const QString &filePath)
+{
+    QFile file(filePath);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+
 void MainWindow::historySaveCurrentState()
 {
     QSettings settings;
 
-    unsigned dirCount = settings.value(keyHistoryStateDirCount, QVariant(8)).toUInt();
+    unsigned entryCount = settings.value(keyHistoryStateDirCount, QVariant(8)).toUInt();
+
+    if (entryCount == 0) return; // disabled
+    if (entryCount > 99) entryCount = 99; // sanity check
 
-    if (dirCount == 0) return; // disabled
-    if (dirCount > 99) dirCount = 99; // sanity check
+    // contents received in memory are stored as is, others are read from their files
+    QByteArray uiDump = uiDumpData.isNull() ? readFileData(uiDumpFileName) : uiDumpData;
+    QByteArray image = imageWidget->lastImageData();
+    if (image.isNull()) image = readFileData(imageWidget->lastImageFileName());
 
-    unsigned ind;
+    if (uiDump.isEmpty()) {
+        qDebug() << FCFL << "No ui dump to store to state history";
+        return;
+    }
 
-    // remove excess history folders
-    ind = dirCount;
-    forever {
-        if (ind > 99) break; // sanity check
+    if (stateHistory->add(QFileInfo(uiDumpFileName).fileName(), uiDump,
+                          QFileInfo(imageWidget->lastImageFileName()).fileName(), image).isEmpty()) {
+        qDebug() << FCFL << "Failed to store state history to" << stateHistory->path();
+    }
+
+    // rotating is just removing manifests of oldest entries
+    stateHistory->trim(entryCount);
+
+    prefetchStateHistory();
+}
+
+
+// Removes state history directories of earlier versions, once per settings
+void MainWindow::removeLegacyStateHistory()
+{
+    QSettings settings;
+
+    if (settings.value(keyHistoryLegacyDirsRemoved, QVariant(false)).toBool()) return;
+
+    for (unsigned ind = 0; ind <= 99; ++ind) {
         QString filePath = stateHistoryFilePathPrefix + filledDigitString(ind, 2);
         if (!recursiveRemove(filePath)) break; // stop when remove fails
         qDebug() << FCFL << "Removed directory" << filePath;
-        ++ind;
     }
 
-    //QString namePrefix = stateHistoryFilePathPrefix.mid(stateHistoryFilePathPrefix.lastIndexOf('/') + 1);
+    settings.setValue(keyHistoryLegacyDirsRemoved, QVariant(true));
+}
 
-    // shift history folder names
-    for(ind = dirCount; ind > 0; --ind) {
-        QString oldName = stateHistoryFilePathPrefix + filledDigitString(ind-1, 2);
-        QString newName = stateHistoryFilePathPrefix + filledDigitString(ind, 2);
-        QFile file(oldName);
-        if (file.exists() && !file.rename(newName)) {
-            QString err = file.errorString();
-            QString fn = file.fileName();
-            qDebug() << FCFL << "Failed to rotate" << oldName << "->" << newName << ":" << err << "(ignored)";
-        }
-        // else file didn't exist, or rename succeeded
-    }
 
-    QString name =  stateHistoryFilePathPrefix + "00";
-    if (!QDir().mkdir(name)) {
-        qDebug() << FCFL << "Failed to create new directory" << name;
-    }
-    else if (!createStateArchive(name)) {
-        qDebug() << FCFL << "Failed to store state history to dir" << name;
-    }
+// Starts loading most recent history states, so that loading them from history menu is fast
+void MainWindow::prefetchStateHistory()
+{
+    historyPrefetcher->prefetch(stateHistory->entries());
 }
 
 
@@ -510,6 +515,10 @@ void MainWindow::deviceSelected()
 
         if ( strOldDevice != activeDevice) {
 
+            // replies of previous device still being parsed are not needed anymore
+            replyParser->cancelAll();
+            objectTree->setDisabled(false);
+
             // clear applications
             resetMessageSequenceFlags();
             resetApplicationsList();
@@ -525,7 +534,7 @@ void MainWindow::deviceSelected()
             clearObjectTreeMappings();
 
             // empty object tree
-            objectTree->clear();
+            objectTreeModel->clear();
 
             // empty properties table
             clearPropertiesTableContents();
@@ -569,6 +578,10 @@ bool MainWindow::createStateArchive( QString targetPath )
     QStringList sourceFiles;
     sourceFiles << imageWidget->lastImageFileName() << uiDumpFileName;
 
+    // contents of files received in memory, these are written instead of copied
+    QList<QByteArray> sourceData;
+    sourceData << imageWidget->lastImageData() << uiDumpData;
+
     QStringList targetFiles;
 
     QStringList problemList;
@@ -605,7 +618,17 @@ bool MainWindow::createStateArchive( QString targetPath )
     }
 
     for (ii=0; ii < count; ++ii) {
-        if (QFileInfo(targetFiles.at(ii)) != QFileInfo(sourceFiles.at(ii))) {
+        if (!sourceData.at(ii).isNull()) {
+            QFile target(targetFiles.at(ii));
+            bool result = target.open(QIODevice::WriteOnly | QIODevice::Truncate)
+                    && target.write(sourceData.at(ii)) == sourceData.at(ii).size();
+            qDebug() << FCFL << "QFile::write('" << targetFiles.at(ii) << "') ==" << result;
+            if ( !result) {
+                problemList << tr("\n%1 => %2 (%3)")
+                               .arg(sourceFiles.at(ii), targetFiles.at(ii), target.errorString());
+            }
+        }
+        else if (QFileInfo(targetFiles.at(ii)) != QFileInfo(sourceFiles.at(ii))) {
             bool result;
             if ( QFile::exists( targetFiles.at(ii))) {
                 result = QFile::remove( targetFiles.at(ii) );
@@ -0,0 +1,275 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#include "tdriver_object_search_index.h"
+#include "tdriver_testobject_store.h"
+
+#include <tdriver_debug_macros.h>
+
+#include <QPair>
+#include <QTime>
+#include <QtAlgorithms>
+
+#include <algorithm>
+
+
+/*!
+    \class TDriverObjectSearchIndex
+    \brief Finds test objects by type, name, id and attribute values.
+
+    Object store pools strings, so the index is built over distinct strings:
+    each string has a sorted list of objects using it as type, name or id, and
+    another for attribute values. Case folded trigrams of the strings select
+    candidates for a search text, which are then compared exactly, so results
+    are same as comparing every object. Index refers to the store it was built
+    from, and must be cleared or rebuilt when the store changes.
+ */
+
+
+TDriverObjectSearchIndex::TDriverObjectSearchIndex() :
+    store(NULL),
+    stringCount(0)
+{
+}
+
+
+void TDriverObjectSearchIndex::clear()
+{
+    store = NULL;
+    stringCount = 0;
+    itemOffsets.clear();
+    itemPostings.clear();
+    attributeOffsets.clear();
+    attributePostings.clear();
+    trigramKeys.clear();
+    trigramOffsets.clear();
+    trigramStrings.clear();
+    longStrings.clear();
+}
+
+
+quint64 TDriverObjectSearchIndex::trigramKey(const QChar *chars)
+{
+    return (quint64(chars[0].unicode()) << 32) | (quint64(chars[1].unicode()) << 16) | quint64(chars[2].unicode());
+}
+
+
+// Fills postings as ranges per string, objects are visited in document order so each range is sorted
+template <typename StringIndexes>
+static void buildPostings(const TDriverTestObjectStore &objects, int stringCount, StringIndexes stringIndexes,
+                          QVector<int> &offsets, QVector<int> &postings)
+{
+    QVector<int> lastObject(stringCount, -1);
+    offsets.fill(0, stringCount + 1);
+
+    for (int index = 0; index < objects.count(); ++index) {
+        foreach (int str, stringIndexes(objects, index)) {
+            if (lastObject.at(str) == index) continue;
+            lastObject[str] = index;
+            ++offsets[str + 1];
+        }
+    }
+
+    for (int str = 0; str < stringCount; ++str) {
+        offsets[str + 1] += offsets.at(str);
+    }
+
+    QVector<int> fill(offsets);
+    postings.resize(offsets.last());
+    lastObject.fill(-1);
+
+    for (int index = 0; index < objects.count(); ++index) {
+        foreach (int str, stringIndexes(objects, index)) {
+            if (lastObject.at(str) == index) continue;
+            lastObject[str] = index;
+            postings[fill[str]++] = index;
+        }
+    }
+}
+
+
+static QVector<int> itemStringIndexes(const TDriverTestObjectStore &objects, int index)
+{
+    return QVector<int>() << objects.typeStringIndex(index) << objects.nameStringIndex(index) << objects.idStringIndex(index);
+}
+
+
+static QVector<int> attributeStringIndexes(const TDriverTestObjectStore &objects, int index)
+{
+    const int count = objects.attributeCount(index);
+    QVector<int> result(count);
+    for (int n = 0; n < count; ++n) {
+        result[n] = objects.attributeValueStringIndexAt(index, n);
+    }
+    return result;
+}
+
+
+void TDriverObjectSearchIndex::build(const TDriverTestObjectStore &objects)
+{
+    QTime t;
+    t.start();
+
+    clear();
+    store = &objects;
+    stringCount = objects.stringCount();
+
+    buildPostings(objects, stringCount, itemStringIndexes, itemOffsets, itemPostings);
+    buildPostings(objects, stringCount, attributeStringIndexes, attributeOffsets, attributePostings);
+
+    // each distinct trigram of each string once, sorted to ranges per trigram
+    QVector<QPair<quint64, int> > pairs;
+    QVector<quint64> stringTrigrams;
+
+    for (int str = 0; str < stringCount; ++str) {
+        const QString folded = objects.stringAt(str).toCaseFolded();
+
+        if (folded.size() > MaxIndexedLength) {
+            longStrings << str;
+            continue;
+        }
+
+        stringTrigrams.clear();
+        for (int pos = 0; pos + 3 <= folded.size(); ++pos) {
+            stringTrigrams << trigramKey(folded.constData() + pos);
+        }
+        qSort(stringTrigrams);
+
+        for (int ind = 0; ind < stringTrigrams.size(); ++ind) {
+            if (ind == 0 || stringTrigrams.at(ind) != stringTrigrams.at(ind - 1)) {
+                pairs << qMakePair(stringTrigrams.at(ind), str);
+            }
+        }
+    }
+
+    qSort(pairs);
+
+    for (int ind = 0; ind < pairs.size(); ++ind) {
+        if (ind == 0 || pairs.at(ind).first != pairs.at(ind - 1).first) {
+            trigramKeys << pairs.at(ind).first;
+            trigramOffsets << ind;
+        }
+        trigramStrings << pairs.at(ind).second;
+    }
+    trigramOffsets << pairs.size();
+
+    qDebug() << FCFL << "indexed" << objects.count() << "objects," << stringCount << "strings,"
+             << trigramKeys.size() << "trigrams, time" << float(t.elapsed())/1000.0;
+}
+
+
+// Strings which may contain foldedText, in increasing order
+QVector<int> TDriverObjectSearchIndex::candidateStrings(const QString &foldedText) const
+{
+    QVector<int> result;
+
+    if (foldedText.size() < 3) {
+        // too short for trigrams, every string is a candidate
+        result.resize(stringCount);
+        for (int str = 0; str < stringCount; ++str) result[str] = str;
+        return result;
+    }
+
+    // intersection of strings of every trigram of the text
+    for (int pos = 0; pos + 3 <= foldedText.size(); ++pos) {
+        const quint64 key = trigramKey(foldedText.constData() + pos);
+        const QVector<quint64>::const_iterator it = qBinaryFind(trigramKeys.constBegin(), trigramKeys.constEnd(), key);
+
+        if (it == trigramKeys.constEnd()) {
+            result.clear();
+            break;
+        }
+
+        const int ind = it - trigramKeys.constBegin();
+        const int *begin = trigramStrings.constData() + trigramOffsets.at(ind);
+        const int *end = trigramStrings.constData() + trigramOffsets.at(ind + 1);
+
+        if (pos == 0) {
+            for (const int *str = begin; str != end; ++str) result << *str;
+        }
+        else {
+            QVector<int> intersection;
+            foreach (int str, result) {
+                if (qBinaryFind(begin, end, str) != end) intersection << str;
+            }
+            result = intersection;
+        }
+
+        if (result.isEmpty()) break;
+    }
+
+    // long strings are not indexed, they are always candidates
+    result << longStrings;
+    qSort(result);
+    return result;
+}
+
+
+QVector<int> TDriverObjectSearchIndex::find(const QString &text, bool matchCase, bool entireWords, bool searchAttributes) const
+{
+    QTime t;
+    t.start();
+
+    const QVector<int> result(findObjects(text, matchCase ? Qt::CaseSensitive : Qt::CaseInsensitive,
+                                          entireWords, true, searchAttributes));
+
+    qDebug() << FCFL << "found" << result.size() << "objects matching" << text << "time" << float(t.elapsed())/1000.0;
+    return result;
+}
+
+
+QVector<int> TDriverObjectSearchIndex::findAttributeValues(const QString &text, bool entireValue) const
+{
+    return findObjects(text, Qt::CaseSensitive, entireValue, false, true);
+}
+
+
+QVector<int> TDriverObjectSearchIndex::findObjects(const QString &text, Qt::CaseSensitivity caseSensitivity, bool entireWords,
+                                                   bool searchItems, bool searchAttributes) const
+{
+    QVector<int> result;
+    if (!store || text.isEmpty()) return result;
+
+    foreach (int str, candidateStrings(text.toCaseFolded())) {
+        const QString &value = store->stringAt(str);
+
+        if ( entireWords ? ( value.compare( text, caseSensitivity ) != 0 ) : !value.contains( text, caseSensitivity ) ) {
+            continue;
+        }
+
+        if (searchItems) {
+            for (int ind = itemOffsets.at(str); ind < itemOffsets.at(str + 1); ++ind) {
+                result << itemPostings.at(ind);
+            }
+        }
+
+        if (searchAttributes) {
+            for (int ind = attributeOffsets.at(str); ind < attributeOffsets.at(str + 1); ++ind) {
+                result << attributePostings.at(ind);
+            }
+        }
+    }
+
+    // objects matching several strings are listed once
+    qSort(result);
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
@@ -0,0 +1,452 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#include "tdriver_object_selector.h"
+#include "tdriver_testobject_store.h"
+#include "tdriver_object_search_index.h"
+
+#include <tdriver_debug_macros.h>
+
+#include <QTime>
+
+#include <algorithm>
+
+
+/*!
+    \class TDriverObjectSelector
+    \brief Compiled CSS like selector query over test objects.
+
+    Syntax is a comma separated list of selectors. A selector is a list of
+    compound selectors separated by whitespace (descendant) or '>' (child).
+    A compound selector is an object type or '*', followed by any number of
+    "#name" and "[attribute op value]" predicates, for example
+
+        QDialog[visible=true] QPushButton[text^='OK']
+
+    Attribute names "type", "name" and "id" refer to the object itself, other
+    names to its attributes, case insensitively. Operators are = != ^= $= *=
+    for strings, < <= > >= for numbers, and [attribute] tests that attribute
+    exists. A missing attribute matches only !=.
+
+    Matching binds names and values to attribute keys and pooled strings of
+    the store once, so equality tests compare integers. Objects are in document
+    order, so each step is one forward pass over all objects, which finds
+    objects whose parent or ancestor matched previous step. When a search index
+    is given, string predicates of attributes take candidate objects from it,
+    and only those are tested.
+ */
+
+
+TDriverObjectSelector::TDriverObjectSelector() :
+    pos(0),
+    errorPos(-1)
+{
+}
+
+
+bool TDriverObjectSelector::fail(const QString &message)
+{
+    error = message;
+    errorPos = pos;
+    return false;
+}
+
+
+void TDriverObjectSelector::skipSpaces()
+{
+    while (pos < text.size() && text.at(pos).isSpace()) ++pos;
+}
+
+
+bool TDriverObjectSelector::parse(const QString &selectorText)
+{
+    chains.clear();
+    text = selectorText;
+    pos = 0;
+    error.clear();
+    errorPos = -1;
+
+    forever {
+        QList<Step> steps;
+        if (!parseSelector(steps)) break;
+        chains << steps;
+
+        skipSpaces();
+        if (pos >= text.size()) return true;
+
+        if (text.at(pos) != ',') {
+            fail(tr("Expected ',' or end of selector"));
+            break;
+        }
+        ++pos;
+    }
+
+    chains.clear();
+    return false;
+}
+
+
+bool TDriverObjectSelector::parseSelector(QList<Step> &steps)
+{
+    skipSpaces();
+
+    Step step;
+    step.combinator = Descendant;
+    if (!parseCompound(step)) return false;
+    steps << step;
+
+    forever {
+        const int start = pos;
+        skipSpaces();
+        if (pos >= text.size() || text.at(pos) == ',') return true;
+
+        Step next;
+        next.combinator = Descendant;
+
+        if (text.at(pos) == '>') {
+            next.combinator = Child;
+            ++pos;
+            skipSpaces();
+        }
+        else if (pos == start) {
+            return fail(tr("Unexpected character '%1'").arg(text.at(pos)));
+        }
+
+        if (!parseCompound(next)) return false;
+        steps << next;
+    }
+}
+
+
+bool TDriverObjectSelector::parseCompound(Step &step)
+{
+    const int start = pos;
+
+    if (pos < text.size() && text.at(pos) == '*') {
+        ++pos;
+    }
+    else {
+        const QString type = parseIdentifier();
+        if (!type.isEmpty()) {
+            Predicate predicate;
+            predicate.field = TypeField;
+            predicate.op = Equal;
+            predicate.value = type;
+            predicate.number = 0;
+            step.predicates << predicate;
+        }
+    }
+
+    while (pos < text.size()) {
+        if (text.at(pos) == '#') {
+            ++pos;
+            Predicate predicate;
+            predicate.field = NameField;
+            predicate.op = Equal;
+            predicate.number = 0;
+            if (!parseValue(predicate.value)) return false;
+            step.predicates << predicate;
+        }
+        else if (text.at(pos) == '[') {
+            ++pos;
+            Predicate predicate;
+            if (!parseAttribute(predicate)) return false;
+            step.predicates << predicate;
+        }
+        else break;
+    }
+
+    if (pos == start) return fail(tr("Expected object type, '*', '#' or '['"));
+    return true;
+}
+
+
+bool TDriverObjectSelector::parseAttribute(Predicate &predicate)
+{
+    static const struct { const char *text; Operator op; } operators[] = {
+        { "!=", NotEqual }, { "^=", StartsWith }, { "$=", EndsWith }, { "*=", Contains },
+        { "<=", LessOrEqual }, { ">=", GreaterOrEqual }, { "=", Equal }, { "<", Less }, { ">", Greater }
+    };
+
+    skipSpaces();
+    const QString name = parseIdentifier();
+    if (name.isEmpty()) return fail(tr("Expected attribute name"));
+
+    const QString lowerName = name.toLower();
+    predicate.field = (lowerName == "type") ? TypeField
+                    : (lowerName == "name") ? NameField
+                    : (lowerName == "id") ? IdField
+                    : AttributeField;
+    predicate.attribute = name;
+    predicate.op = Exists;
+    predicate.number = 0;
+
+    skipSpaces();
+    if (pos < text.size() && text.at(pos) == ']') {
+        ++pos;
+        return true;
+    }
+
+    bool haveOperator = false;
+    for (unsigned ind = 0; ind < sizeof(operators) / sizeof(operators[0]); ++ind) {
+        const QLatin1String op(operators[ind].text);
+        if (text.midRef(pos, qstrlen(operators[ind].text)) == op) {
+            predicate.op = operators[ind].op;
+            pos += qstrlen(operators[ind].text);
+            haveOperator = true;
+            break;
+        }
+    }
+    if (!haveOperator) return fail(tr("Expected operator or ']'"));
+
+    skipSpaces();
+    const int valuePos = pos;
+    if (!parseValue(predicate.value)) return false;
+
+    if (predicate.op >= Less) {
+        bool ok = false;
+        predicate.number = predicate.value.toDouble(&ok);
+        if (!ok) {
+            pos = valuePos;
+            return fail(tr("Expected a number"));
+        }
+    }
+
+    skipSpaces();
+    if (pos >= text.size() || text.at(pos) != ']') return fail(tr("Expected ']'"));
+    ++pos;
+    return true;
+}
+
+
+// Quoted string with backslash escapes, or identifier
+bool TDriverObjectSelector::parseValue(QString &value)
+{
+    value.clear();
+
+    if (pos < text.size() && (text.at(pos) == '\'' || text.at(pos) == '"')) {
+        const QChar quote = text.at(pos++);
+
+        while (pos < text.size() && text.at(pos) != quote) {
+            if (text.at(pos) == '\\' && pos + 1 < text.size()) ++pos;
+            value += text.at(pos++);
+        }
+
+        if (pos >= text.size()) return fail(tr("Unterminated string"));
+        ++pos;
+        return true;
+    }
+
+    value = parseIdentifier();
+    if (value.isEmpty()) return fail(tr("Expected value"));
+    return true;
+}
+
+
+// Type names may contain namespace separators, values may be numbers
+QString TDriverObjectSelector::parseIdentifier()
+{
+    const int start = pos;
+
+    while (pos < text.size()) {
+        const QChar ch = text.at(pos);
+        if (ch.isLetterOrNumber() || ch == '_' || ch == '-' || ch == '.') {
+            ++pos;
+        }
+        else if (ch == ':' && pos + 1 < text.size() && text.at(pos + 1) == ':') {
+            pos += 2;
+        }
+        else break;
+    }
+
+    return text.mid(start, pos - start);
+}
+
+
+// Returns false if predicates can never match any object of the store
+bool TDriverObjectSelector::bind(const QList<Predicate> &predicates, const TDriverTestObjectStore &objects,
+                                 QVector<BoundPredicate> &bound)
+{
+    bound.clear();
+
+    // bound predicates point to the list, which must not be modified meanwhile
+    for (int ind = 0; ind < predicates.size(); ++ind) {
+        const Predicate &predicate = predicates.at(ind);
+        BoundPredicate item;
+        item.predicate = &predicate;
+        item.key = (predicate.field == AttributeField) ? objects.attributeKey(predicate.attribute) : -1;
+        item.valueString = objects.stringIndex(predicate.value);
+
+        if (predicate.op == Equal && item.valueString < 0) return false;
+        if (predicate.field == AttributeField && item.key < 0 && predicate.op != NotEqual) return false;
+
+        // equality tests of types are cheapest and most selective, so they go first
+        if (predicate.field == TypeField && predicate.op == Equal) bound.prepend(item);
+        else bound << item;
+    }
+
+    return true;
+}
+
+
+bool TDriverObjectSelector::test(const QVector<BoundPredicate> &bound, const TDriverTestObjectStore &objects, int index)
+{
+    foreach (const BoundPredicate &item, bound) {
+        const Predicate &predicate = *item.predicate;
+        int str;
+
+        switch (predicate.field) {
+        case TypeField: str = objects.typeStringIndex(index); break;
+        case NameField: str = objects.nameStringIndex(index); break;
+        case IdField: str = objects.idStringIndex(index); break;
+        default: str = objects.attributeValueStringIndex(index, item.key); break;
+        }
+
+        bool ok;
+        bool isNumber = false;
+        double number = 0;
+
+        if (predicate.op >= Less && str >= 0) {
+            number = objects.stringAt(str).toDouble(&isNumber);
+        }
+
+        switch (predicate.op) {
+        case Exists: ok = str >= 0 && (predicate.field == AttributeField || !objects.stringAt(str).isEmpty()); break;
+        case Equal: ok = str == item.valueString; break;
+        case NotEqual: ok = str < 0 || str != item.valueString; break;
+        case StartsWith: ok = str >= 0 && objects.stringAt(str).startsWith(predicate.value); break;
+        case EndsWith: ok = str >= 0 && objects.stringAt(str).endsWith(predicate.value); break;
+        case Contains: ok = str >= 0 && objects.stringAt(str).contains(predicate.value); break;
+        case Less: ok = isNumber && number < predicate.number; break;
+        case LessOrEqual: ok = isNumber && number <= predicate.number; break;
+        case Greater: ok = isNumber && number > predicate.number; break;
+        case GreaterOrEqual: ok = isNumber && number >= predicate.number; break;
+        default: ok = false; break;
+        }
+
+        if (!ok) return false;
+    }
+
+    return true;
+}
+
+
+// Objects which may match attribute string predicates, from search index, in document order.
+// Returns false if no predicate can use the index, candidates are then all objects.
+bool TDriverObjectSelector::findCandidates(const QList<Predicate> &predicates, const TDriverObjectSearchIndex &searchIndex,
+                                          QVector<int> &candidates)
+{
+    bool found = false;
+
+    foreach (const Predicate &predicate, predicates) {
+        if (predicate.field != AttributeField || predicate.value.isEmpty()) continue;
+        if (predicate.op != Equal && predicate.op != StartsWith && predicate.op != EndsWith && predicate.op != Contains) continue;
+
+        // objects having the value in any attribute, exact attribute is checked by test
+        const QVector<int> objects(searchIndex.findAttributeValues(predicate.value, predicate.op == Equal));
+
+        if (!found) {
+            candidates = objects;
+            found = true;
+        }
+        else {
+            QVector<int> intersection(qMin(candidates.size(), objects.size()));
+            intersection.erase(std::set_intersection(candidates.constBegin(), candidates.constEnd(),
+                                                     objects.constBegin(), objects.constEnd(), intersection.begin()),
+                               intersection.end());
+            candidates = intersection;
+        }
+
+        if (candidates.isEmpty()) break;
+    }
+
+    return found;
+}
+
+
+QVector<int> TDriverObjectSelector::match(const TDriverTestObjectStore &objects, const TDriverObjectSearchIndex *searchIndex) const
+{
+    QTime t;
+    t.start();
+
+    const int count = objects.count();
+    QVector<char> matched(count, 0);
+    QVector<BoundPredicate> bound;
+    QVector<int> candidates;
+
+    foreach (const QList<Step> &steps, chains) {
+        QVector<char> previous;
+        QVector<char> reached; // object or some ancestor matched previous step
+        bool possible = true;
+
+        for (int stepInd = 0; stepInd < steps.size() && possible; ++stepInd) {
+            const Step &step = steps.at(stepInd);
+            possible = bind(step.predicates, objects, bound);
+            if (!possible) break;
+
+            QVector<char> current(count, 0);
+            const bool indexed = searchIndex && findCandidates(step.predicates, *searchIndex, candidates);
+
+            if (indexed && stepInd == 0) {
+                foreach (int index, candidates) current[index] = test(bound, objects, index);
+            }
+            else {
+                QVector<char> candidate;
+                if (indexed) {
+                    candidate.fill(0, count);
+                    foreach (int index, candidates) candidate[index] = 1;
+                }
+
+                for (int index = 0; index < count; ++index) {
+                    if (stepInd > 0) {
+                        // ancestors are propagated for all objects, later steps need them
+                        const int parent = objects.parent(index);
+                        reached[index] = previous.at(index) || (parent >= 0 && reached.at(parent));
+
+                        const bool related = parent >= 0 &&
+                                (step.combinator == Child ? previous.at(parent) : reached.at(parent));
+                        if (!related) continue;
+                    }
+                    if (indexed && !candidate.at(index)) continue;
+                    current[index] = test(bound, objects, index);
+                }
+            }
+
+            previous = current;
+            reached.fill(0, count);
+        }
+
+        if (possible) {
+            for (int index = 0; index < count; ++index) {
+                if (previous.at(index)) matched[index] = 1;
+            }
+        }
+    }
+
+    QVector<int> result;
+    for (int index = 0; index < count; ++index) {
+        if (matched.at(index)) result << index;
+    }
+
+    qDebug() << FCFL << "matched" << result.size() << "of" << count << "objects with" << text
+             << "time" << float(t.elapsed())/1000.0;
+    return result;
+}
@@ -19,37 +19,39 @@
 
 #include "tdriver_main_window.h"
 #include "tdriver_image_view.h"
+#include "tdriver_uidump_parser.h"
+#include "tdriver_testobject_diff.h"
+#include "tdriver_reply_parser.h"
 #include <tdriver_util.h>
+#include <tdriver_tabbededitor.h>
 
 #include <tdriver_debug_macros.h>
 
 #include <QTimer>
 #include <QProgressDialog>
 #include <QErrorMessage>
+#include <QVector>
+#include <QSet>
 
 #include "ui_tdriver_richtextcontainer.h"
 
-bool MainWindow::getItemPos(QTreeWidgetItem *item, int &x, int &y)
+bool MainWindow::getItemPos(int index, int &x, int &y)
 {
-    const TestObjectKey itemKey = ptr2TestObjectKey(item);
-
-    const QMap<QString, AttributeInfo > &attributes = attributesMap[itemKey];
-
     QPoint ret;
 
     bool xOk = false;
     bool yOk = false;
 
     if (TDriverUtil::isSymbianSut(activeDeviceParams.value("type"))
-            && 0 == objectTreeData.value(itemKey).env.compare("qt", Qt::CaseInsensitive)) {
+            && 0 == testObjects.env(index).compare("qt", Qt::CaseInsensitive)) {
         // handle special case for Qt testobject with Symbian SUT
-        ret = QPoint(attributes.value("x_absolute").value.toInt(&xOk),
-                     attributes.value("y_absolute").value.toInt(&yOk));
+        ret = QPoint(testObjects.attributeValue(index, "x_absolute").toInt(&xOk),
+                     testObjects.attributeValue(index, "y_absolute").toInt(&yOk));
     }
     else {
 
-        ret = QPoint(attributes.value("x").value.toInt(&xOk),
-                     attributes.value("y").value.toInt(&yOk));
+        ret = QPoint(testObjects.attributeValue(index, "x").toInt(&xOk),
+                     testObjects.attributeValue(index, "y").toInt(&yOk));
     }
 
     if (xOk && yOk) {
@@ -61,84 +63,98 @@ bool MainWindow::getItemPos(QTreeWidgetItem *item, int &x, int &y)
 }
 
 
-bool MainWindow::getParentItemOffset( QTreeWidgetItem * item, int & x, int & y )
+bool MainWindow::getParentItemOffset( int index, int & x, int & y )
 {
     bool ok = false;
 
-    while ( !ok && item != NULL ) {
+    while ( !ok && index >= 0 ) {
         // retrieve selected items attributes
-        ok = getItemPos(item, x, y);
-        item = item->parent();
+        ok = getItemPos(index, x, y);
+        index = testObjects.parent(index);
     }
 
     return ok;
 }
 
 
+// Returns geometry of test object, or null rectangle if it has no valid geometry
+QRect MainWindow::calculateObjectGeometry( int index )
+{
+    // retrieve x, y, widht height, or ok=false if fail
+    int x, y;
+    int width, height;
+    bool ok = getItemPos(index, x, y);
+    if (ok) width = testObjects.attributeValue(index, "width").toInt(&ok);
+    if (ok) height = testObjects.attributeValue(index, "height").toInt(&ok);
 
+    if ( ok ) {
+        // use values from separate attributes
+        return QRect(x, y, width, height);
+    }
 
-void MainWindow::collectGeometries( QTreeWidgetItem * item, RectList & geometries)
-{
-    //qDebug() << "collectGeometries";
+    // parse values from geometry attribute
+    const QString &geometry = testObjects.attributeValue(index, "geometry");
+    QStringList geometryList = geometry.split(',');
 
-    if ( item != NULL ) {
-        TestObjectKey itemPtr = ptr2TestObjectKey( item );
+    if ( geometryList.size() >= 4) {
+        x = geometryList.at(0).toInt(&ok);
+        if (ok) y = geometryList.at(1).toInt(&ok);
+        if (ok) width = geometryList.at(2).toInt(&ok);
+        if (ok) height = geometryList.at(3).toInt(&ok);
 
-        if ( geometriesMap.contains( itemPtr ) ) {
-            // retrieve geometries list from cache
-            geometries = geometriesMap.value( itemPtr );
+        if (ok) {
+            // retrieve parent location as offset, looping down the tree for correct offset
+            int px=-1, py=-1;
+            ok = getParentItemOffset( index, px, py);
+            if (ok) return QRect(px+x, py+y, width, height);
         }
-        else {
+    }
 
-            geometries.clear();
-            // retrieve child nodes geometries first
-            for ( int childIndex = 0; childIndex < item->childCount(); childIndex++ ) {
-                RectList childGeometries;
-                collectGeometries( item->child( childIndex ), childGeometries);
-                geometries << childGeometries;
-            }
+    return QRect();
+}
 
-            // retrieve selected items attributes
-            const QMap<QString, AttributeInfo > &attributes = attributesMap[itemPtr];
 
-            // retrieve x, y, widht height, or ok=false if fail
-            int x, y;
-            int width, height;
-            bool ok = getItemPos(item, x, y);
-            if (ok) width = attributes.value( "width" ).value.toInt(&ok);
-            if (ok) height = attributes.value( "height" ).value.toInt(&ok);
+// Calculates geometry of every test object once per ui dump
+void MainWindow::collectObjectGeometries()
+{
+    const int count = testObjects.count();
+    objectGeometries.resize(count);
 
-            if ( ok ) {
-                // use values from separate attributes
-                geometries.prepend(QRect(x, y, width, height));
-            }
-            else {
-                // parse values from geometry attribute
-                // ok is false here, but may become true below
-                const QString &geometry = attributes.value( "geometry" ).value;
-                QStringList geometryList = geometry.split(',');
-
-                if ( geometryList.size() >= 4) {
-                    x = geometryList.at(0).toInt(&ok);
-                    if (ok) y = geometryList.at(1).toInt(&ok);
-                    if (ok) width = geometryList.at(2).toInt(&ok);
-                    if (ok) height = geometryList.at(3).toInt(&ok);
-
-                    if (ok) {
-                        // retrieve parent location as offset, looping down the tree for correct offset
-                        int px=-1, py=-1;
-                        ok = getParentItemOffset( item, px, py);
-                        if (ok) geometries.prepend(QRect(px+x, py+y, width, height));
-                    }
-                }
-            }
+    for (int index = 0; index < count; ++index) {
+        objectGeometries[index] = calculateObjectGeometry(index);
+    }
+}
 
-            if (!ok) {
-                // not ok, prepend Null rectangle
-                geometries.prepend(QRect());
-            }
 
-            geometriesMap.insert( itemPtr, geometries);
+// Recalculates geometries only for changed test objects and their descendants,
+// because geometry attribute is relative to ancestor position
+void MainWindow::updateObjectGeometries( const TDriverTestObjectDiff &diff, const QVector<QRect> &previousGeometries )
+{
+    const int count = testObjects.count();
+    objectGeometries.resize(count);
+    QVector<bool> dirty(count);
+
+    for (int index = 0; index < count; ++index) {
+        const int parentIndex = testObjects.parent(index);
+        dirty[index] = diff.isChanged(index) || (parentIndex >= 0 && dirty.at(parentIndex));
+
+        objectGeometries[index] = dirty.at(index)
+                ? calculateObjectGeometry(index)
+                : previousGeometries.value(diff.previousIndex(index));
+    }
+}
+
+
+// Geometries of object and all its descendants, object itself first.
+// Objects without valid geometry have a null rectangle.
+void MainWindow::collectGeometries( int index, RectList & geometries)
+{
+    geometries.clear();
+
+    if ( testObjects.isValid( index ) && index < objectGeometries.size() ) {
+        const int end = testObjects.subtreeEnd( index );
+        for ( int ii = index; ii < end; ++ii ) {
+            geometries << objectGeometries.at( ii );
         }
     }
 }
@@ -152,490 +168,262 @@ void MainWindow::objectTreeItemChanged()
     propertyTabLastTimeUpdated.clear();
     // update current properties table
     doPropertiesTableUpdate();
-    drawHighlight( ptr2TestObjectKey(objectTree->currentItem()), true );
+    drawHighlight( currentObjectKey(), true );
 }
 
 
-QTreeWidgetItem * MainWindow::createObjectTreeItem(QTreeWidgetItem *parentItem,
-                                                   const TreeItemInfo &data,
-                                                   QMap<QString, QStringList> duplicateItems )
+TestObjectKey MainWindow::currentObjectKey() const
 {
-    //qDebug() << "createObjectTreeItem";
-    QTreeWidgetItem *item = new QTreeWidgetItem( parentItem );
+    return objectTreeModel->objectKey( objectTree->currentIndex() );
+}
 
-    // if type or id is empty...
-    QString type = data.type;
-    QString id = data.id;
-    QString name = data.name;
-    QString badTypeTip; // empty means type is ok
 
-    static QErrorMessage *testObjectErrorDialog = NULL;
-    if (!testObjectErrorDialog) {
-        testObjectErrorDialog = new QErrorMessage(this);
-        testObjectErrorDialog->setWindowTitle(tr("Test Object Message"));
-        testObjectErrorDialog->resize(640, 360);
+void MainWindow::setCurrentObject( TestObjectKey key )
+{
+    QModelIndex index = objectTreeModel->modelIndex( key );
+
+    if ( index.isValid() ) {
+        objectTree->setCurrentIndex( index );
+        objectTree->scrollTo( index );
     }
+}
 
 
-    // type column
+// Shows test object message dialog if some test object has no type
+void MainWindow::reportObjectsWithoutType()
+{
+    static QErrorMessage *testObjectErrorDialog = NULL;
 
-    if ( type.isEmpty() ) {
-        badTypeTip = richTextContainer->testObjectMissingType->toolTip();
+    for (int index = 1; index < testObjects.count(); ++index) {
+        if (!testObjects.type(index).isEmpty()) continue;
 
-        if (!testObjectErrorDialog->isVisible()) {
-            testObjectErrorDialog->showMessage(badTypeTip);
+        if (!testObjectErrorDialog) {
+            testObjectErrorDialog = new QErrorMessage(this);
+            testObjectErrorDialog->setWindowTitle(tr("Test Object Message"));
+            testObjectErrorDialog->resize(640, 360);
         }
 
-        type = "<NoName>";
-        item->setBackground( 0, QColor(Qt::red) );
-        item->setForeground( 0, QColor(Qt::white) );
-
-        item->setData( 0, Qt::ToolTipRole, badTypeTip + (data.env.isEmpty()
-                                                         ? QString()
-                                                         : "\n" + tr("Test object environment: ") + data.env));
-    }
-    else {
-        item->setBackground( 0, QBrush() );
-        item->setForeground( 0, QColor(Qt::darkCyan).darker(180) );
-        if (!data.env.isEmpty()) {
-            item->setData( 0, Qt::ToolTipRole, tr("Test object environment: ") + data.env);
+        if (!testObjectErrorDialog->isVisible()) {
+            testObjectErrorDialog->showMessage(richTextContainer->testObjectMissingType->toolTip());
         }
+        break;
     }
-    item->setData( 0, Qt::DisplayRole, type);
-
-
-    // name column
-
-    if ( name.isEmpty() ) {
-
-        name = "<Object name not defined...>";
-
-        //item->setBackground( 1, QColor(Qt::red).lighter( 120 ) );
-        item->setBackground( 1, QColor(Qt::red) );
-        item->setForeground( 1, QColor(Qt::white) );
-
-        item->setData( 1, Qt::ToolTipRole,
-                      badTypeTip.isEmpty() ?
-                          tr(
-                              "\n  Warning!  \n"
-                              "\n"
-                              "  Name for this object is not defined in the applications source code.\n"
-                              "  Identifying objects with other attributes such as \"x\", \"y\", \"width\",\n"
-                              "  \"height\", \"text\" or \"icon\" may lead to failure of the tests.  \n"
-                              "\n"
-                              "  Object names are more likely to remain the same throughout the software life cycle.\n"
-                              "\n"
-                              "  Please contact your manager, development team or responsible person and\n"
-                              "  request for properly named objects in order to make this application more testable.\n")
-                        : badTypeTip );
-    }
-    else {
-
-        if ( duplicateItems.count( name ) != 0 ){
-
-            QStringList items = duplicateItems.value( name );
-            QString toolTipMessage;
-
-            if ( items.size() == 1 ){
+}
 
-                toolTipMessage = tr(
-                            "\n  Warning!\n"
-                            "\n"
-                            "  Multiple objects found with same object name and id.\n"
-                            "\n"
-                            "  Identifying and accessing this test object without full stack of parent object(s)\n"
-                            "  may lead your test scripts to fail. The reason for this issue is how objects are\n"
-                            "  traversed, but usually due to there are no unique object id available.\n"
-                            "\n"
-                            "  Please contact your manager, traverser development team or responsible person\n"
-                            "  and request for unique object names and ids in order to make this application\n"
-                            "  more testable.\n" );
 
-                //name = name + " <Duplicate object name and ID>";
-            }
-            else {
-
-                if (!TDriverUtil::isSymbianSut(activeDeviceParams.value("type"))) {
-                    toolTipMessage = tr(
-                                "\n  Warning!\n"
-                                "\n"
-                                "  Multiple objects found with same object name.\n"
-                                "\n"
-                                "  Objects without unique name may lead your test scripts to fail due to multiple\n"
-                                "  test objects found exception.  Please contact your manager, development team\n"
-                                "  or responsible person and request for uniquely named objects in order to make\n"
-                                "  this application more testable.\n");
+// Gives object types, names and attribute names of object tree to code editor completion
+void MainWindow::addObjectTreeCompletions()
+{
+    if (!tabEditor) return;
 
-                }
-                //name = name + " <Duplicate object name>";
+    QSet<QString> words;
 
-            }
+    for (int index = 0; index < testObjects.count(); ++index) {
+        words.insert(testObjects.type(index));
+        words.insert(testObjects.name(index));
 
-            item->setBackground( 1, QColor(Qt::red) );
-            item->setForeground( 1, QColor(Qt::white) );
-            item->setData( 1, Qt::ToolTipRole, badTypeTip.isEmpty() ? toolTipMessage : badTypeTip );
-        }
-        else {
-            item->setBackground( 1, QBrush() );
-            item->setForeground( 1, QColor(Qt::darkGreen) );
+        for (int n = testObjects.attributeCount(index) - 1; n >= 0; --n) {
+            words.insert(testObjects.attributeNameAt(index, n));
         }
     }
-    item->setData( 1, Qt::DisplayRole, name);
-
-    // id column
-
-    if ( id.isEmpty() ) {
-        id = "<None>";
-    }
-    item->setBackground( 2, QBrush() );
-    item->setForeground( 2, QColor(Qt::darkYellow) );
-    item->setData( 2, Qt::DisplayRole, id);
-
-    // fonts for all
-
-    item->setFont( 0, *defaultFont );
-    item->setFont( 1, *defaultFont );
-    item->setFont( 2, *defaultFont );
-
-    parentItem->addChild( item );
 
-    return item;
-}
-
-
-void MainWindow::storeItemToObjectTreeMap( QTreeWidgetItem *item, const TreeItemInfo &data)
-{
-    TestObjectKey itemPtr = ptr2TestObjectKey( item );
-
-    // store object tree data
-    objectTreeData.insert( itemPtr, data );
-    objectIdMap.insert(data.id, itemPtr);
+    tabEditor->replaceCompletionWords("objecttree", words.toList());
 }
 
 
 void MainWindow::refreshScreenshotObjectList()
 {
     screenshotObjects.clear();
+    screenshotIndex.clear();
 
     if (imageWidget) {
         // collect geometries for item and its childs
         buildScreenshotObjectList();
+        buildScreenshotIndex();
         imageWidget->update();
     }
 }
 
 
+void MainWindow::buildScreenshotIndex()
+{
+    QTime t;
+    t.start();
+
+    const int objectTypeKey = testObjects.attributeKey("objecttype");
+
+    foreach (TestObjectKey key, screenshotObjects) {
+        const int objectIndex = testObjectIndex(key);
+
+        // don't select Layouts and LayoutItems, they shouldn't be selectable from the image
+        const QString &objectType = testObjects.attributeValue(objectIndex, objectTypeKey);
+        const bool selectable = (objectType != "Layout" && objectType != "LayoutItem");
+
+        screenshotIndex.addObject(objectIndex, objectGeometries.value(objectIndex), selectable);
+    }
+
+    screenshotIndex.build();
+    qDebug() << FCFL << "indexed" << screenshotIndex.count() << "objects, time" << float(t.elapsed())/1000.0;
+}
+
+
 /* Recursive function.
-   First call from outside should omit arguments, so default value for parentKey is used.
+   First call from outside should omit arguments, so default value for parentIndex is used.
 */
-void MainWindow::buildScreenshotObjectList(TestObjectKey parentKey)
+void MainWindow::buildScreenshotObjectList(int parentIndex)
 {
-    if (!parentKey) {
+    if (parentIndex < 0) {
         // first call
         QString id = imageWidget->tasIdString();
         if (id.isEmpty()) {
-            // image metadata didn't have id, so find first object included in attributesMap
-            QTreeWidgetItem *item = objectTree->invisibleRootItem();
-            parentKey = ptr2TestObjectKey(item);
-
-            while (item) {
-                if (attributesMap.contains(parentKey)) break; // found!
-                item = item->child(0);
-                parentKey = ptr2TestObjectKey(item);
+            // image metadata didn't have id, so find first object which has attributes
+            parentIndex = testObjects.isEmpty() ? -1 : 0;
+
+            while (parentIndex >= 0) {
+                if (testObjects.attributeCount(parentIndex) > 0) break; // found!
+                parentIndex = testObjects.firstChild(parentIndex);
             }
         }
         else {
             // get parent based on id received in image metadata
-            parentKey = objectIdMap.value(id);
+            parentIndex = testObjects.indexOfId(id);
         }
     }
     // check validity
-    if ( parentKey && attributesMap.contains(parentKey) ) {
-
-        const QMap<QString, AttributeInfo > &attributeContainer = attributesMap[parentKey];
+    if ( parentIndex >= 0 && testObjects.attributeCount(parentIndex) > 0 ) {
 
         int x, y;
-        bool ok = getItemPos(testObjectKey2Ptr(parentKey), x, y);
+        bool ok = getItemPos(parentIndex, x, y);
 
-        ok = (ok && attributeContainer.contains("height") && attributeContainer.contains("width"))
-                || attributeContainer.contains("geometry");
+        ok = (ok && testObjects.hasAttribute(parentIndex, "height") && testObjects.hasAttribute(parentIndex, "width"))
+                || testObjects.hasAttribute(parentIndex, "geometry");
 
-        if (ok && 0 == attributeContainer.value( "visible" ).value.compare("false", Qt::CaseInsensitive))
+        if (ok && 0 == testObjects.attributeValue(parentIndex, "visible").compare("false", Qt::CaseInsensitive))
             ok = false;
 
         // isVisible is only used by AVKON traverser
-        if (ok && 0 == attributeContainer.value( "isvisible" ).value.compare("false", Qt::CaseInsensitive))
+        if (ok && 0 == testObjects.attributeValue(parentIndex, "isvisible").compare("false", Qt::CaseInsensitive))
             ok = false;
 
         /* no need to care if object is obscured, highlight should be drawn anyway to show position
-        if (ok && 0 == attributeContainer.value( "visibleonscreen" ).value.compare("false", Qt::CaseInsensitive))
+        if (ok && 0 == testObjects.attributeValue(parentIndex, "visibleonscreen").compare("false", Qt::CaseInsensitive))
             ok = false;
         */
 
         if (ok) {
-            screenshotObjects << parentKey;
+            screenshotObjects << testObjectKey(parentIndex);
         }
 
         // recurse into all children
-        QTreeWidgetItem *parentItem = testObjectKey2Ptr(parentKey);
-        for (int ii=0; ii < parentItem->childCount(); ++ii) {
-            buildScreenshotObjectList(ptr2TestObjectKey(parentItem->child(ii)));
+        for (int child = testObjects.firstChild(parentIndex); child >= 0; child = testObjects.nextSibling(child)) {
+            buildScreenshotObjectList(child);
         }
     }
 }
 
 
-QList<QMap<QString, QString> > MainWindow::collectObjectData( QDomElement element )
+// Stores id of current application from application objects of sut
+void MainWindow::updateCurrentApplication()
 {
-    QList<QMap<QString, QString> > results;
-    QDomNode node = element.firstChild();
-
-    while ( !node.isNull() ) {
-
-        if ( node.isElement() && node.nodeName() == "objects" ){
-            results << collectObjectData( node.toElement() );
-        }
-
-        if ( node.isElement() && node.nodeName() == "object" ){
-            QDomElement tmpElement( node.toElement() );
-
-            if ( tmpElement.attribute( "name" ) != "" ){
-                QMap<QString, QString> tmpValue;
-                tmpValue.insert( "name", tmpElement.attribute( "name" ) );
-                tmpValue.insert( "id", tmpElement.attribute( "id" ) );
-                results << tmpValue;
-            }
-
-            results << collectObjectData( node.toElement() );
+    for (int child = testObjects.firstChild(0); child >= 0; child = testObjects.nextSibling(child)) {
+        if ( testObjects.type(child).compare("application", Qt::CaseInsensitive )==0 ) {
+            qDebug() << FCFL << "got application id" << testObjects.id(child) << "name" << testObjects.name(child);
+            currentApplication.set(testObjects.id(child), testObjects.name(child));
         }
-
-        node = node.nextSibling();
     }
-
-    return results;
 }
 
-// for agent_qt 1.3 or later (with new xml format)
-QList<QMap<QString, QString> > MainWindow::collectObjectData_new_format( QDomElement element )
-{
-    QList<QMap<QString, QString> > results;
-    QDomNode node = element.firstChild();
-
-    while ( !node.isNull() ) {
-
-        if ( node.isElement() && node.nodeName() == "obj" ){
-            QDomElement tmpElement( node.toElement() );
-
-            if ( tmpElement.attribute( "name" ) != "" ){
-                QMap<QString, QString> tmpValue;
-                tmpValue.insert( "name", tmpElement.attribute( "name" ) );
-                tmpValue.insert( "id", tmpElement.attribute( "id" ) );
-                results << tmpValue;
-            }
-
-            results << collectObjectData_new_format( node.toElement() );
-        }
-
-        node = node.nextSibling();
-    }
-
-    return results;
-}
 
-QMap<QString, QStringList> MainWindow::findDuplicateObjectNames( QList<QMap<QString, QString> > objects )
+// Replaces object tree model contents with parsed ui dump, returns false if dump was empty
+bool MainWindow::buildObjectTree( const TDriverUiDumpParser &parser )
 {
-    QMap<QString, QStringList> results;
-    QMap<QString, QStringList> foundObjects;
-
-    if ( objects.size() > 0 ) {
+    testObjects = parser.objects();
+    invalidateObjectSearch();
 
-        for ( int i = 0; i < objects.size(); i++ ) {
+    if (testObjects.isEmpty()) return false;
 
-            //qDebug() << "--";
-            QMap<QString, QString> object = objects.at( i );
-            QString objectName = object.value( "name" );
-            QString objectId = object.value( "id" );
-            bool duplicate = false;
-            QStringList objectIds;
+    if (testObjects.name(0) != activeDevice) {
+        qDebug() << FCFL << "device/sut name mismatch:" << activeDevice << testObjects.name(0);
+    }
 
-            if ( foundObjects.count( objectName ) != 0 ) {
+    updateCurrentApplication();
 
-                objectIds = foundObjects[ objectName ];
-                //qDebug() << "objectIds: " << objectIds;
+    objectTreeDuplicateItems = parser.duplicateItems();
+    objectTreeModel->setSymbianSut(TDriverUtil::isSymbianSut(activeDeviceParams.value("type")));
+    objectTreeModel->setObjects(testObjects, objectTreeDuplicateItems);
 
-                if ( objectIds.contains( objectId ) == true ){
-                    //qDebug() << "objects name and id are identical, show warning...";
-                    duplicate = true;
-                }
-                else {
-                    duplicate = true;
-                    objectIds << objectId;
-                    foundObjects[ objectName ] = objectIds;
-                }
-
-                results[ objectName ] = objectIds;
-                //qDebug() << objectIds;
-            }
-            else {
-                objectIds << objectId;
-                foundObjects.insert( objectName, objectIds );
-            }
-
-            if ( duplicate == false ) {
-                //qDebug() << " not duplicate... " << object;
-            }
-            else {
-                //qDebug() << " duplicate... " << object;
-            }
-            //qDebug() << object;
-        }
-    }
+    reportObjectsWithoutType();
 
-    return results;
+    return true;
 }
 
 
-
-
-void MainWindow::buildObjectTree_new_format(QTreeWidgetItem *parentItem,
-                                 QDomElement parentElement,
-                                 QMap<QString, QStringList> duplicateItems )
+// Updates object tree model to match parsed ui dump, so that matched objects keep their keys,
+// and current item and expansion state of the view are kept.
+// Returns false if there is no previous tree or sut differs, and tree must be rebuilt.
+// focusKey is cleared if its object was removed.
+bool MainWindow::updateObjectTreeItems( const TDriverUiDumpParser &parser, TestObjectKey &focusKey )
 {
-    //qDebug() << "buildObjectTree_new_format";
-    // create attribute hash for each attribute
-
-    QTreeWidgetItem *childItem = 0;
-
-    QDomNode node = parentElement.firstChild();
-
-    TestObjectKey parentPtr = ptr2TestObjectKey( parentItem );
-
-    while ( !node.isNull() ) {
+    // diff refers to both stores, so keep previous data while testObjects is replaced
+    const TDriverTestObjectStore previous = testObjects;
+    const TDriverTestObjectStore &current = parser.objects();
 
-      if (node.isElement())
-      {
+    if (previous.isEmpty() || current.isEmpty()) return false;
 
-        if ( node.nodeName() == "attr" ) {
+    TDriverTestObjectDiff diff(previous, current);
 
-            QDomElement element(node.toElement());
-            QString name = element.attribute( "name" );
+    if (!diff.rootMatched()) return false;
 
-            AttributeInfo attributeData = {
-                  name,
-                  element.attribute( "type" ),
-                  element.attribute( "access" ),
-                  element.text() };
+    qDebug() << FCFL << "added" << diff.addedCount() << "removed" << diff.removedCount()
+             << "changed" << diff.changedCount() << "objects";
 
-            attributesMap[parentPtr][name.toLower()] = attributeData;
-        }
-
-        if ( node.nodeName() == "obj" ) {
-            QDomElement element(node.toElement());
-
-            TreeItemInfo data = {
-                element.attribute( "type" ),
-                element.attribute( "name" ),
-                element.attribute( "id" ),
-                element.attribute( "env" ) };
+    const QVector<QRect> previousGeometries = objectGeometries;
 
-            // store id of current application ui dump
-            if ( data.type.compare("application", Qt::CaseInsensitive )==0 ) {
-                qDebug() << FCFL << "got application id" << data.id << "name" << data.name;
-                currentApplication.set(data.id, data.name);
-            }
-
-            childItem = createObjectTreeItem( parentItem, data, duplicateItems);
+    // forget keys of objects which are no longer in ui dump
+    for (int index = 0; index < previous.count(); ++index) {
+        if (diff.currentIndex(index) >= 0) continue;
 
-            storeItemToObjectTreeMap( childItem, data );
+        const TestObjectKey key = testObjectKey(index);
+        forgetObjectTreeItem(key);
+        if (key == focusKey) focusKey = 0;
+    }
 
-            // iterate the node recursively if child nodes exists
-            if ( node.hasChildNodes() ) {
-                buildObjectTree_new_format( childItem, element, duplicateItems );
-            }
+    // attributes tab shows attribute values, other tabs depend only on type and id
+    const int focusIndex = diff.currentIndex(testObjectIndex(focusKey));
+    if (focusIndex >= 0 && diff.isChanged(focusIndex)) {
+        propertyTabLastTimeUpdated.remove("attributes");
+    }
 
+    testObjects = current;
+    invalidateObjectSearch();
+    objectTreeDuplicateItems = parser.duplicateItems();
 
-        } // end if node is element and node name is "object"
+    // view would report current item changes while model is being updated
+    objectTree->selectionModel()->blockSignals(true);
+    objectTreeModel->updateObjects(testObjects, diff, objectTreeDuplicateItems);
+    objectTree->selectionModel()->blockSignals(false);
 
-      }
+    updateCurrentApplication();
+    updateObjectGeometries(diff, previousGeometries);
 
-      node = node.nextSibling();
+    if (diff.addedCount() > 0) reportObjectsWithoutType();
 
-    } // end while node not null
+    return true;
 }
 
 
-void MainWindow::buildObjectTree(QTreeWidgetItem *parentItem,
-                                 QDomElement parentElement,
-                                 QMap<QString, QStringList> duplicateItems )
+// Clears all references to object tree key which is about to be removed
+void MainWindow::forgetObjectTreeItem( TestObjectKey key )
 {
-    //qDebug() << "buildObjectTree";
-
-    // create attribute hash for each attribute
-
-    QTreeWidgetItem *childItem = 0;
-
-    QDomNode node = parentElement.firstChild();
-
-    TestObjectKey parentPtr = ptr2TestObjectKey( parentItem );
-
-    while ( !node.isNull() ) {
-
-      if ( node.isElement() )
-      {
-
-        if ( node.nodeName() == "attributes" ) {
-            buildObjectTree( parentItem, node.toElement(), duplicateItems );
-        }
-
-        if ( node.nodeName() == "objects" ) {
-            buildObjectTree( parentItem, node.toElement(), duplicateItems );
-        }
-
-        if ( node.nodeName() == "attribute" ) {
-
-            QDomElement element(node.toElement());
-            QString name = element.attribute( "name" );
-
-            AttributeInfo attributeData = {
-                  name,
-                  element.attribute( "dataType" ),
-                  element.attribute( "type" ),
-                  element.elementsByTagName( "value" ).item( 0 ).toElement().text() };
-
-            attributesMap[parentPtr][name.toLower()] = attributeData;
-        }
-
-        if ( node.nodeName() == "object" ) {
-            QDomElement element(node.toElement());
-
-            TreeItemInfo data = {
-                element.attribute( "type" ),
-                element.attribute( "name" ),
-                element.attribute( "id" ),
-                element.attribute( "env" ) };
-
-            // store id of current application ui dump
-            if ( data.type.compare("application", Qt::CaseInsensitive )==0 ) {
-                qDebug() << FCFL << "got application id" << data.id << "name" << data.name;
-                currentApplication.set(data.id, data.name);
-            }
-
-            childItem = createObjectTreeItem( parentItem, data, duplicateItems);
-            storeItemToObjectTreeMap( childItem, data );
-
-            // iterate the node recursively if child nodes exists
-            if ( node.hasChildNodes() ) {
-                buildObjectTree( childItem, element, duplicateItems );
-            }
+    if (lastHighlightedObjectKey == key) lastHighlightedObjectKey = 0;
+    if (collapsedObjectTreeItemPtr == key) collapsedObjectTreeItemPtr = 0;
+    if (expandedObjectTreeItemPtr == key) expandedObjectTreeItemPtr = 0;
+    if (findDialogSubtreeRoot == key) findDialogSubtreeRoot = 0;
 
-
-        } // end if node is element and node name is "object"
-
-      }
-
-      node = node.nextSibling();
-
-    } // end while node not null
+    QMutableMapIterator<QString, TestObjectKey> iterator(propertyTabLastTimeUpdated);
+    while (iterator.hasNext()) {
+        if (iterator.next().value() == key) iterator.remove();
+    }
 }
 
 
@@ -643,152 +431,107 @@ void MainWindow::clearObjectTreeMappings()
 {
     // empty visible objects list
     screenshotObjects.clear();
+    screenshotIndex.clear();
 
-    // empty attributes of each object tree item
-    attributesMap.clear();
-
-    // empty geometry values of each object tree item
-    geometriesMap.clear();
+    // empty geometry values of each test object
+    objectGeometries.clear();
 
     // empty status of last updated properties table tab
     propertyTabLastTimeUpdated.clear();
 
-    // empty object tree data mappings (eg. type, name & id)
-    objectTreeData.clear();
-    objectIdMap.clear();
+    // empty test object data (eg. type, name, id & attributes)
+    testObjects.clear();
+    invalidateObjectSearch();
+    objectTreeDuplicateItems.clear();
 }
 
 
+// Parses ui dump file in GUI thread and updates object tree from it
 void MainWindow::updateObjectTree( QString filename )
 {
     qDebug() << FCFL << "from file" << filename;
-    QTreeWidgetItem *sutItem  = NULL;
 
-    // store id value of focused node in object tree
-    QString currentFocusId = objectTreeData.value(ptr2TestObjectKey( objectTree->currentItem())).id;
-
-    clearObjectTreeMappings();
-    // empty object tree
-    objectTree->clear();
-    uiDumpFileName.clear();
+    cancelUiDumpRefresh();
 
     // parse ui dump xml
-    if (parseXml( filename, xmlDocument )) {
-
-        uiDumpFileName = filename;
-
-        QDomNode node = xmlDocument.documentElement().firstChild();
-
-        QString version = xmlDocument.documentElement().toElement().attribute("version");
-
-/*
+    TDriverUiDumpParser parser;
+    QTime t;
+    t.start();
 
-        QDomElement root = appDocument.documentElement();
-
-        // retrieve version from tas message
-        QString version = root.toElement().attribute("version");
-
-        nodeInfo = root.firstChild();
-
-*/
-
-        while ( !node.isNull() ) {
-
-            // find tasInfo element from xmlDocument
-            if ( node.isElement() && node.nodeName() == "tasInfo" ) {
-                if (sutItem) {
-                    qWarning("%s:%i: Duplicate tasInfo element, ignoring remaining XML!", __FILE__, __LINE__);
-                    break;
-                }
-                sutItem = new QTreeWidgetItem(0);
-
-                QDomElement element = node.toElement();
-                QString sutId = element.attribute( "id" );
-
-                TreeItemInfo treeItemData = {
-                    QString("sut"),
-                    element.attribute("name"),
-                    element.attribute("id"),
-                    element.attribute("env") };
-
-                if (treeItemData.name != activeDevice) {
-                    qDebug() << FCFL << "device/sut name mismatch:" << activeDevice << treeItemData.name;
-                }
+    const bool parsed = parseUiDumpXml( filename, parser );
+    qDebug() << FCFL << "parse time" << float(t.elapsed())/1000.0;
 
-                // add sut to the top of the object tree
-                sutItem->setData( 0, Qt::DisplayRole, QString("sut") );
-                sutItem->setData( 1, Qt::DisplayRole, treeItemData.name );
-                sutItem->setData( 2, Qt::DisplayRole, sutId );
-
-                sutItem->setForeground( 0, QColor(Qt::darkCyan).darker(180) );
-                sutItem->setForeground( 1, QColor(Qt::darkGreen) );
-                sutItem->setForeground( 2, QColor(Qt::darkYellow) );
-
-                sutItem->setFont( 0, *defaultFont );
-                sutItem->setFont( 1, *defaultFont );
-                sutItem->setFont( 2, *defaultFont );
-
-                objectTree->addTopLevelItem ( sutItem );
-                objectIdMap.insert(sutId, ptr2TestObjectKey(sutItem));
-
-                TestObjectKey itemPtr = ptr2TestObjectKey( sutItem );
-
-                // store object tree data
-                objectTreeData.insert( itemPtr, treeItemData );
+    updateObjectTree( filename, parsed ? &parser : NULL );
+}
 
-                // determine whether to use new xml structure or not... (new == 1.3+)
-                if ( !checkVersion( version, "1.3" ) ) {
 
-                  QList<QMap<QString,QString> > objectNamesList = collectObjectData( element );
-                  QMap<QString, QStringList> duplicateItems = findDuplicateObjectNames( objectNamesList );
+// Updates object tree from already parsed ui dump, or empties it if parser is NULL.
+// data is the ui dump if it was received in memory, filename then only names it.
+void MainWindow::updateObjectTree( const QString &filename, const TDriverUiDumpParser *parser,
+                                   const QByteArray &data )
+{
+    bool haveObjects = false;
 
-                  // build object tree with xml
-                  buildObjectTree( sutItem, element, duplicateItems );
+    // store focused node in object tree, and its id in case it gets replaced
+    TestObjectKey currentFocusKey = currentObjectKey();
+    QString currentFocusId = testObjects.id(testObjectIndex(currentFocusKey));
 
-                } else {
+    uiDumpFileName.clear();
+    uiDumpData.clear();
 
-                  QList<QMap<QString,QString> > objectNamesList = collectObjectData_new_format( element );
-                  QMap<QString, QStringList> duplicateItems = findDuplicateObjectNames( objectNamesList );
+    QTime t;
+    t.start();
 
-                  buildObjectTree_new_format( sutItem, element, duplicateItems );
+    if (parser) {
 
-                }
+        uiDumpFileName = filename;
+        uiDumpData = data;
+        qDebug() << FCFL << "parsed" << parser->objects().count() << "objects, version" << parser->version()
+                 << "size" << parser->objects().memoryUsage() << "bytes";
 
-                break; // while node is not null
-            }
+        if (updateObjectTreeItems( *parser, currentFocusKey )) {
+            haveObjects = true;
+            qDebug() << FCFL << "object tree updated, time" << float(t.elapsed())/1000.0;
+        }
+        else {
+            clearObjectTreeMappings();
+            // empty object tree
+            objectTreeModel->clear();
+            currentFocusKey = 0;
 
-            node = node.nextSibling();
+            haveObjects = buildObjectTree( *parser );
+            collectObjectGeometries();
+            qDebug() << FCFL << "object tree built, time" << float(t.elapsed())/1000.0;
         }
     }
+    else {
+        clearObjectTreeMappings();
+        // empty object tree
+        objectTreeModel->clear();
+    }
 
-    if (sutItem) {
-        RectList dummy;
-        collectGeometries(sutItem, dummy);
+    if (haveObjects) {
         refreshScreenshotObjectList();
-        if (lastHighlightedObjectKey && !screenshotObjects.contains(lastHighlightedObjectKey)) {
-            lastHighlightedObjectKey = 0;
-        }
-
-        bool itemFocusChanged = false;
-
-        // restore focus if object is still visible/available
-        if ( !currentFocusId.isEmpty() ) {
+        addObjectTreeCompletions();
 
-            TestObjectKey currentFocusKey = objectIdMap.value(currentFocusId);
+        // keep focus on same object if it was kept in the tree
+        TestObjectKey focusKey = currentFocusKey;
 
-            if (currentFocusKey) {
-                objectTree->setCurrentItem(testObjectKey2Ptr(currentFocusKey));
-                itemFocusChanged = true;
-            }
+        // else restore focus if object is still visible/available
+        if ( !focusKey && !currentFocusId.isEmpty() ) {
+            focusKey = testObjectKey(testObjects.indexOfId(currentFocusId));
         }
 
         // set focus to SUT item unless previously focused item visible
-        if ( !itemFocusChanged ) {
-            objectTree->setCurrentItem( sutItem );
+        if ( !focusKey ) {
+            focusKey = testObjectKey(0);
         }
 
-        // highlight current object
-        drawHighlight( ptr2TestObjectKey(objectTree->currentItem()), true );
+        setCurrentObject(focusKey);
+
+        // highlight current object, geometries may have changed even if object didn't
+        lastHighlightedObjectKey = 0;
+        drawHighlight( currentObjectKey(), true );
         doPropertiesTableUpdate();
     }
     else {
@@ -801,18 +544,18 @@ void MainWindow::updateObjectTree( QString filename )
 void MainWindow::connectObjectTreeSignals()
 {
     // Item select - command
-    connect( objectTree, SIGNAL(itemPressed(QTreeWidgetItem*,int)),
-            SLOT(objectViewItemClicked(QTreeWidgetItem*,int)));
+    connect( objectTree, SIGNAL(pressed(QModelIndex)),
+            SLOT(objectViewItemClicked(QModelIndex)));
 
-    connect( objectTree, SIGNAL(currentItemChanged(QTreeWidgetItem*,QTreeWidgetItem*)),
-            SLOT(objectViewCurrentItemChanged( QTreeWidgetItem *, QTreeWidgetItem * ) ) );
+    connect( objectTree->selectionModel(), SIGNAL(currentChanged(QModelIndex,QModelIndex)),
+            SLOT(objectViewCurrentItemChanged(QModelIndex,QModelIndex)) );
 
     // Item expand/collapse
-    connect(objectTree, SIGNAL(itemExpanded(QTreeWidgetItem*)),
-            SLOT(expandTreeWidgetItem(QTreeWidgetItem*)) );
+    connect(objectTree, SIGNAL(expanded(QModelIndex)),
+            SLOT(expandObjectTreeItem(QModelIndex)) );
 
-    connect(objectTree, SIGNAL( itemCollapsed(QTreeWidgetItem*) ),
-            SLOT(collapseTreeWidgetItem(QTreeWidgetItem*)) );
+    connect(objectTree, SIGNAL(collapsed(QModelIndex)),
+            SLOT(collapseObjectTreeItem(QModelIndex)) );
 }
 
 
@@ -943,6 +686,8 @@ bool MainWindow::sendUiDumpRequest()
 }
 
 
+// Sends both refresh requests without waiting, tdriver_interface.rb captures the screen
+// while the ui dump is being written, so replies may come in either order.
 void MainWindow::startRefreshSequence()
 {
     if (sendUiDumpRequest()) {
@@ -969,41 +714,41 @@ void MainWindow::refreshAppearance()
 
 void MainWindow::resizeObjectTree() {
 
-    int old_width = objectTree->columnWidth( objectTree->currentColumn() );
+    const int column = qMax(0, objectTree->currentIndex().column());
+    int old_width = objectTree->columnWidth( column );
 
-    objectTree->resizeColumnToContents( objectTree->currentColumn() );
+    objectTree->resizeColumnToContents( column );
 
-    if ( objectTree->columnWidth( objectTree->currentColumn() ) < old_width ) {
+    if ( objectTree->columnWidth( column ) < old_width ) {
         // column width smaller after resize --> restore to previous width
-        objectTree->setColumnWidth( objectTree->currentColumn(), old_width );
+        objectTree->setColumnWidth( column, old_width );
 
     } else {
         // add some padding
-        objectTree->setColumnWidth( objectTree->currentColumn(),
-                                   objectTree->columnWidth( objectTree->currentColumn() ) + 25 );
+        objectTree->setColumnWidth( column, objectTree->columnWidth( column ) + 25 );
     }
 }
 
 
-void MainWindow::objectViewCurrentItemChanged ( QTreeWidgetItem * itemCurrent, QTreeWidgetItem * /*itemPrevious*/ )
+void MainWindow::objectViewCurrentItemChanged ( const QModelIndex &current, const QModelIndex &/*previous*/ )
 {
-    Q_UNUSED( itemCurrent );
+    Q_UNUSED( current );
     // qDebug() << "objectViewCurrentItemChanged";
 
     collapsedObjectTreeItemPtr = 0;
     expandedObjectTreeItemPtr = 0;
+    // image view updates only the changed highlight area by itself
     objectTreeItemChanged();
-    imageWidget->update();
     resizeObjectTree();
 }
 
 
 QString MainWindow::treeObjectRubyId(TestObjectKey treeItemPtr, TestObjectKey sutItemPtr)
 {
-    const TreeItemInfo &treeItemData = objectTreeData.value( treeItemPtr );
-    QString objRubyId = treeItemData.type;
-    QString objName = treeItemData.name;
-    QString objText = attributesMap.value( treeItemPtr ).value("text").value;
+    const int treeItemIndex = testObjectIndex( treeItemPtr );
+    QString objRubyId = testObjects.type( treeItemIndex );
+    QString objName = testObjects.name( treeItemIndex );
+    QString objText = testObjects.attributeValue( treeItemIndex, "text" );
 
     if ( sutItemPtr == treeItemPtr && objRubyId == "sut" ) {
         objRubyId = "TDriver.sut( :Id => "
@@ -1017,7 +762,7 @@ QString MainWindow::treeObjectRubyId(TestObjectKey treeItemPtr, TestObjectKey su
     }
     else if(objText != "" && !objText.isEmpty()) {
         objRubyId.append("( :text => "
-                         + TDriverUtil::rubySingleQuote(attributesMap.value( treeItemPtr ).value("text").value)
+                         + TDriverUtil::rubySingleQuote(objText)
                          + " )");
     }
     else {
@@ -1027,22 +772,21 @@ QString MainWindow::treeObjectRubyId(TestObjectKey treeItemPtr, TestObjectKey su
 }
 
 
-void MainWindow::objectViewItemAction( QTreeWidgetItem * item, int column, ContextMenuSelection action, QString method ) {
-
-    Q_UNUSED( column );
+void MainWindow::objectViewItemAction( TestObjectKey key, ContextMenuSelection action, QString method ) {
 
-    if ( action > cancelAction ) {
+    if ( action > cancelAction && key ) {
 
-        TestObjectKey sutItemPtr = ptr2TestObjectKey(objectTree->topLevelItem(0));
-        const bool fullPath = (ptr2TestObjectKey(item) == sutItemPtr) || isPathAction(action) ;
+        TestObjectKey sutItemPtr = testObjectKey(0);
+        const bool fullPath = (key == sutItemPtr) || isPathAction(action) ;
 
         // TODO: use XPath to determine if object is unique, and eg. insert line in comments if it's not unique
         QString result;
+        int index = testObjectIndex(key);
 
         do {
             result = TDriverUtil::smartJoin(
-                        treeObjectRubyId(ptr2TestObjectKey(item), sutItemPtr), '.', result);
-        } while (fullPath && ptr2TestObjectKey(item) != sutItemPtr && (item = item->parent()));
+                        treeObjectRubyId(testObjectKey(index), sutItemPtr), '.', result);
+        } while (fullPath && (index = testObjects.parent(index)) >= 0);
 
         switch (action) {
 
@@ -1068,70 +812,72 @@ void MainWindow::objectViewItemAction( QTreeWidgetItem * item, int column, Conte
     }
 }
 
-void MainWindow::objectViewItemClicked( QTreeWidgetItem * item, int column) {
+void MainWindow::objectViewItemClicked( const QModelIndex &index ) {
 
     // if right mouse button pressed open "copy/append to clipboard" dialog
     if ( QApplication::mouseButtons() == Qt::RightButton ) {
 
         ContextMenuSelection action = showCopyAppendContextMenu();
 
-        objectViewItemAction(item, column, action);
+        objectViewItemAction(objectTreeModel->objectKey(index), action);
     }
 }
 
-// Store last collapsed objectTreeWidgetItem - Note: value will be set to NULL when focus is changed
-void MainWindow::collapseTreeWidgetItem( QTreeWidgetItem * item ) {
+// Store last collapsed object tree item - Note: value will be set to NULL when focus is changed
+void MainWindow::collapseObjectTreeItem( const QModelIndex &index ) {
 
-    collapsedObjectTreeItemPtr = ptr2TestObjectKey( item );
+    collapsedObjectTreeItemPtr = objectTreeModel->objectKey( index );
     expandedObjectTreeItemPtr = 0;
 
     resizeObjectTree();
 
 }
 
-// Store last expanded objectTreeWidgetItem - Note: value will be set to NULL when focus is changed
-void MainWindow::expandTreeWidgetItem(QTreeWidgetItem * item) {
+// Store last expanded object tree item - Note: value will be set to NULL when focus is changed
+void MainWindow::expandObjectTreeItem( const QModelIndex &index ) {
 
     collapsedObjectTreeItemPtr = 0;
-    expandedObjectTreeItemPtr = ptr2TestObjectKey( item );
+    expandedObjectTreeItemPtr = objectTreeModel->objectKey( index );
 
     resizeObjectTree();
 }
 
 void MainWindow::objectTreeExpandAll() {
 
-    TestObjectKey currentItem = ptr2TestObjectKey( objectTree->currentItem() );
+    TestObjectKey currentItem = currentObjectKey();
 
     // exit if object tree is empty
     if ( currentItem == 0 ) { return; }
 
     objectTree->expandAll();
-    objectTree->scrollToItem( objectTree->currentItem() );
+    objectTree->scrollTo( objectTree->currentIndex() );
 
 }
 
 
 void MainWindow::objectTreeCollapseAll() {
 
-    TestObjectKey currentItem = ptr2TestObjectKey( objectTree->currentItem() );
+    TestObjectKey currentItem = currentObjectKey();
 
     // exit if object tree is empty
     if ( currentItem == 0 ) { return; }
 
     objectTree->collapseAll();
-    objectTree->setCurrentItem( objectTree->topLevelItem( 0 ) );
-    objectTree->scrollToItem( objectTree->currentItem() );
+    setCurrentObject( testObjectKey( 0 ) );
 }
 
 
 void MainWindow::objectTreeKeyPressEvent( QKeyEvent * event )
 {
-    TestObjectKey currentItem = ptr2TestObjectKey( objectTree->currentItem() );
+    TestObjectKey currentItem = currentObjectKey();
 
     // exit if object tree is empty
     if ( currentItem == 0 )
         return;
 
+    const int currentIndex = testObjectIndex( currentItem );
+    const int parentIndex = testObjects.parent( currentIndex );
+
     if ( event->modifiers() == Qt::ControlModifier ) {
 
         if ( event->key() == Qt::Key_Right ) {
@@ -1144,36 +890,35 @@ void MainWindow::objectTreeKeyPressEvent( QKeyEvent * event )
 
     else if ( event->key() == Qt::Key_Right ) {
 
-        if ( objectTree->currentItem()->childCount() > 0 ) {
+        if ( testObjects.firstChild( currentIndex ) >= 0 ) {
 
             // if item is exapanded and childs available, go to first child
             if ( expandedObjectTreeItemPtr != 0 || expandedObjectTreeItemPtr != currentItem ) {
-                objectTree->setCurrentItem( objectTree->currentItem()->child( 0 ) );
+                setCurrentObject( testObjectKey( testObjects.firstChild( currentIndex ) ) );
             }
         }
-        else {
-            int selectItem = objectTree->currentItem()->parent()->childCount() - 1;
+        else if ( parentIndex >= 0 ) {
+            int selectItem = -1;
 
-            for( int iter = objectTree->currentItem()->parent()->indexOfChild( objectTree->currentItem() );
-                iter < objectTree->currentItem()->parent()->childCount();
-                iter++ )
+            for( int iter = currentIndex; iter >= 0; iter = testObjects.nextSibling( iter ) )
             {
+                selectItem = iter;
                 // go to next item that has childs
-                if ( objectTree->currentItem()->parent()->child( iter )->childCount() > 0 ) {
-                    selectItem = iter; break;
+                if ( testObjects.firstChild( iter ) >= 0 ) {
+                    break;
                 }
             }
-            objectTree->setCurrentItem( objectTree->currentItem()->parent()->child( selectItem ) );
+            setCurrentObject( testObjectKey( selectItem ) );
         }
     }
 
     else if (event->key() == Qt::Key_Left) {
 
-        if ( objectTree->currentItem()->parent() != NULL ) {
+        if ( parentIndex >= 0 ) {
 
             // if item did not collapse, just to parent
             if ( collapsedObjectTreeItemPtr != 0 || collapsedObjectTreeItemPtr != currentItem ) {
-                objectTree->setCurrentItem( objectTree->currentItem()->parent() );
+                setCurrentObject( testObjectKey( parentIndex ) );
             }
         }
     }
@@ -0,0 +1,511 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#include "tdriver_object_tree_model.h"
+#include "tdriver_testobject_diff.h"
+
+#include <QBrush>
+#include <QColor>
+#include <QPair>
+#include <QtAlgorithms>
+
+
+/*!
+    \class TDriverObjectTreeModel
+    \brief Item model of object tree, presenting test objects of a TDriverTestObjectStore.
+
+    Display texts, colors and tooltips are computed when view asks for them,
+    and children of an object are listed only when view asks for its rows,
+    so nothing is allocated per test object for collapsed parts of the tree.
+    Internal id of model indexes is the test object key, which stays the same
+    for matched objects when objects are updated from a new UI dump.
+ */
+
+
+TDriverObjectTreeModel::TDriverObjectTreeModel(QObject *parent) :
+    QAbstractItemModel(parent),
+    lastKey(0),
+    symbianSut(false)
+{
+}
+
+
+void TDriverObjectTreeModel::setObjects(const TDriverTestObjectStore &objects,
+                                        const QMap<QString, QStringList> &duplicateItems)
+{
+    beginResetModel();
+
+    this->objects = objects;
+    this->duplicateItems = duplicateItems;
+
+    QVector<TestObjectKey> newKeys(objects.count());
+    for (int index = 0; index < newKeys.size(); ++index) {
+        newKeys[index] = ++lastKey;
+    }
+    setKeys(newKeys);
+
+    endResetModel();
+}
+
+
+// Only children of objects whose rows view has asked for are known to view, so only
+// changes in those child lists are reported. Removals are reported while previous
+// objects are still in place, then objects are replaced with known child lists kept
+// in previous order, sibling order changes are reported as layout change, and
+// finally added objects are reported as insertions.
+void TDriverObjectTreeModel::updateObjects(const TDriverTestObjectStore &objects,
+                                           const TDriverTestObjectDiff &diff,
+                                           const QMap<QString, QStringList> &duplicateItems)
+{
+    if (this->objects.isEmpty() || !diff.rootMatched()) {
+        setObjects(objects, duplicateItems);
+        return;
+    }
+
+    // known objects whose children appear or disappear get their children listed,
+    // so that view updates their expand indicators
+    QVector<int> childrenChanged;
+    for (int index = 0; index < this->objects.count(); ++index) {
+        const int current = diff.currentIndex(index);
+        if (current < 0 || rows.at(index) < 0 || childOffsets.at(index) >= 0) continue;
+        if ((this->objects.firstChild(index) >= 0) != (objects.firstChild(current) >= 0)) {
+            childrenChanged << index;
+        }
+    }
+    foreach (int index, childrenChanged) {
+        materializeChildren(index);
+    }
+
+    for (int index = 0; index < this->objects.count(); ++index) {
+        if (childOffsets.at(index) < 0 || diff.currentIndex(index) < 0) continue;
+
+        QVector<int> children = childList(index);
+        for (int last = children.size() - 1; last >= 0; --last) {
+            if (diff.currentIndex(children.at(last)) >= 0) continue;
+
+            int first = last;
+            while (first > 0 && diff.currentIndex(children.at(first - 1)) < 0) --first;
+
+            beginRemoveRows(createIndex(row(index), 0, keys.at(index)), first, last);
+            for (int n = first; n <= last; ++n) {
+                rows[children.at(n)] = -1;
+            }
+            children.remove(first, last - first + 1);
+            setChildList(index, children);
+            endRemoveRows();
+
+            last = first;
+        }
+    }
+
+    // remaining known children all have a match, as matching follows parents
+    QList<QPair<int, QVector<int> > > knownLists;
+    for (int index = 0; index < this->objects.count(); ++index) {
+        if (childOffsets.at(index) < 0 || diff.currentIndex(index) < 0) continue;
+
+        QVector<int> children = childList(index);
+        for (int n = 0; n < children.size(); ++n) {
+            children[n] = diff.currentIndex(children.at(n));
+        }
+        knownLists << qMakePair(diff.currentIndex(index), children);
+    }
+
+    QVector<TestObjectKey> newKeys(objects.count());
+    for (int index = 0; index < newKeys.size(); ++index) {
+        const int previousIndex = diff.previousIndex(index);
+        newKeys[index] = (previousIndex >= 0) ? keys.at(previousIndex) : ++lastKey;
+    }
+
+    const bool duplicatesChanged = (this->duplicateItems != duplicateItems);
+    this->objects = objects;
+    this->duplicateItems = duplicateItems;
+    setKeys(newKeys);
+
+    bool reordered = false;
+    for (int n = 0; n < knownLists.size(); ++n) {
+        const QVector<int> &children = knownLists.at(n).second;
+        setChildList(knownLists.at(n).first, children);
+        for (int child = 1; child < children.size() && !reordered; ++child) {
+            reordered = (children.at(child - 1) > children.at(child));
+        }
+    }
+
+    if (reordered) {
+        emit layoutAboutToBeChanged();
+
+        for (int n = 0; n < knownLists.size(); ++n) {
+            QVector<int> &children = knownLists[n].second;
+            qSort(children);
+            setChildList(knownLists.at(n).first, children);
+        }
+
+        const QModelIndexList from = persistentIndexList();
+        QModelIndexList to;
+        foreach (const QModelIndex &persistent, from) {
+            const int index = objectIndex(objectKey(persistent));
+            to << ((index < 0) ? QModelIndex() : createIndex(row(index), persistent.column(), keys.at(index)));
+        }
+        changePersistentIndexList(from, to);
+
+        emit layoutChanged();
+    }
+
+    for (int n = 0; n < knownLists.size(); ++n) {
+        const int parentIndex = knownLists.at(n).first;
+        QVector<int> children = childList(parentIndex);
+        int position = 0;
+
+        for (int child = this->objects.firstChild(parentIndex); child >= 0; ) {
+            if (position < children.size() && children.at(position) == child) {
+                ++position;
+                child = this->objects.nextSibling(child);
+                continue;
+            }
+
+            QVector<int> added;
+            while (child >= 0 && !(position < children.size() && children.at(position) == child)) {
+                added << child;
+                child = this->objects.nextSibling(child);
+            }
+
+            beginInsertRows(createIndex(row(parentIndex), 0, keys.at(parentIndex)),
+                            position, position + added.size() - 1);
+            children.insert(position, added.size(), -1);
+            for (int a = 0; a < added.size(); ++a) {
+                children[position + a] = added.at(a);
+            }
+            setChildList(parentIndex, children);
+            endInsertRows();
+
+            position += added.size();
+        }
+    }
+
+    // duplicate names are shown with different colors and tooltips
+    if (duplicatesChanged) {
+        for (int n = 0; n < knownLists.size(); ++n) {
+            const int parentIndex = knownLists.at(n).first;
+            const int count = childCounts.at(parentIndex);
+            if (count == 0) continue;
+
+            const QModelIndex parent = createIndex(row(parentIndex), 0, keys.at(parentIndex));
+            emit dataChanged(index(0, 0, parent), index(count - 1, ColumnCount - 1, parent));
+        }
+    }
+}
+
+
+void TDriverObjectTreeModel::clear()
+{
+    beginResetModel();
+    objects.clear();
+    duplicateItems.clear();
+    setKeys(QVector<TestObjectKey>());
+    endResetModel();
+}
+
+
+QModelIndex TDriverObjectTreeModel::modelIndex(TestObjectKey key, int column) const
+{
+    const int index = objectIndex(key);
+    return (index < 0) ? QModelIndex() : createIndex(row(index), column, key);
+}
+
+
+QString TDriverObjectTreeModel::typeText(int index) const
+{
+    if (index == 0) return QString("sut");
+
+    const QString &type = objects.type(index);
+    return type.isEmpty() ? QString("<NoName>") : type;
+}
+
+
+QModelIndex TDriverObjectTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent)) return QModelIndex();
+
+    if (!parent.isValid()) {
+        // sut is the only top level item
+        return createIndex(row, column, keys.first());
+    }
+
+    // hasIndex already listed children of parent with rowCount
+    const int parentIndex = objectIndex(objectKey(parent));
+    const int child = childLists.at(childOffsets.at(parentIndex) + row);
+    return createIndex(row, column, keys.at(child));
+}
+
+
+QModelIndex TDriverObjectTreeModel::parent(const QModelIndex &child) const
+{
+    const int parentIndex = objects.parent(objectIndex(objectKey(child)));
+
+    if (parentIndex < 0) return QModelIndex();
+    return createIndex(row(parentIndex), 0, keys.at(parentIndex));
+}
+
+
+int TDriverObjectTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) return objects.isEmpty() ? 0 : 1;
+    if (parent.column() > 0) return 0;
+
+    const int index = objectIndex(objectKey(parent));
+    if (index < 0) return 0;
+
+    materializeChildren(index);
+    return childCounts.at(index);
+}
+
+
+int TDriverObjectTreeModel::columnCount(const QModelIndex &/*parent*/) const
+{
+    return ColumnCount;
+}
+
+
+// answered without listing children, so view can draw expand indicators of collapsed items cheaply
+bool TDriverObjectTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) return !objects.isEmpty();
+    if (parent.column() > 0) return false;
+
+    return objects.firstChild(objectIndex(objectKey(parent))) >= 0;
+}
+
+
+QVariant TDriverObjectTreeModel::data(const QModelIndex &index, int role) const
+{
+    const int objectIndex = this->objectIndex(objectKey(index));
+
+    if (objectIndex < 0) return QVariant();
+    if (objectIndex == 0) return sutData(index.column(), role);
+    return objectData(objectIndex, index.column(), role);
+}
+
+
+QVariant TDriverObjectTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+
+    switch (section) {
+    case TypeColumn: return QString(" type ");
+    case NameColumn: return QString(" name ");
+    case IdColumn: return QString(" id ");
+    default: return QVariant();
+    }
+}
+
+
+void TDriverObjectTreeModel::setKeys(const QVector<TestObjectKey> &newKeys)
+{
+    keys = newKeys;
+
+    indexes.clear();
+    indexes.reserve(keys.size());
+    for (int index = 0; index < keys.size(); ++index) {
+        indexes.insert(keys.at(index), index);
+    }
+
+    childOffsets.fill(-1, keys.size());
+    childCounts.fill(0, keys.size());
+    childLists.clear();
+    rows.fill(-1, keys.size());
+    if (!rows.isEmpty()) rows[0] = 0;
+}
+
+
+void TDriverObjectTreeModel::materializeChildren(int index) const
+{
+    if (childOffsets.at(index) >= 0) return;
+
+    const int offset = childLists.size();
+    int count = 0;
+
+    for (int child = objects.firstChild(index); child >= 0; child = objects.nextSibling(child)) {
+        childLists << child;
+        rows[child] = count++;
+    }
+
+    childOffsets[index] = offset;
+    childCounts[index] = count;
+}
+
+
+QVector<int> TDriverObjectTreeModel::childList(int index) const
+{
+    return childLists.mid(childOffsets.at(index), childCounts.at(index));
+}
+
+
+// Children are appended to end of childLists, earlier list of object is left unused
+// until next setKeys
+void TDriverObjectTreeModel::setChildList(int index, const QVector<int> &children)
+{
+    childOffsets[index] = childLists.size();
+    childCounts[index] = children.size();
+    childLists += children;
+
+    for (int n = 0; n < children.size(); ++n) {
+        rows[children.at(n)] = n;
+    }
+}
+
+
+int TDriverObjectTreeModel::row(int index) const
+{
+    if (rows.at(index) < 0) {
+        materializeChildren(objects.parent(index));
+    }
+    return rows.at(index);
+}
+
+
+QVariant TDriverObjectTreeModel::sutData(int column, int role) const
+{
+    if (role == Qt::DisplayRole) {
+        switch (column) {
+        case TypeColumn: return QString("sut");
+        case NameColumn: return objects.name(0);
+        case IdColumn: return objects.id(0);
+        }
+    }
+    else if (role == Qt::ForegroundRole) {
+        switch (column) {
+        case TypeColumn: return QBrush(QColor(Qt::darkCyan).darker(180));
+        case NameColumn: return QBrush(QColor(Qt::darkGreen));
+        case IdColumn: return QBrush(QColor(Qt::darkYellow));
+        }
+    }
+    return QVariant();
+}
+
+
+QVariant TDriverObjectTreeModel::objectData(int index, int column, int role) const
+{
+    const QString &type = objects.type(index);
+    const QString &env = objects.env(index);
+
+    // empty means type is ok
+    const QString badTypeTip = type.isEmpty() ? missingTypeToolTip : QString();
+
+    switch (column) {
+
+    case TypeColumn:
+        if (role == Qt::DisplayRole) {
+            return typeText(index);
+        }
+        else if (role == Qt::ToolTipRole) {
+            if (!type.isEmpty()) {
+                return env.isEmpty() ? QVariant() : QVariant(tr("Test object environment: ") + env);
+            }
+            return badTypeTip + (env.isEmpty() ? QString() : "\n" + tr("Test object environment: ") + env);
+        }
+        else if (role == Qt::BackgroundRole) {
+            return type.isEmpty() ? QVariant(QBrush(QColor(Qt::red))) : QVariant();
+        }
+        else if (role == Qt::ForegroundRole) {
+            return type.isEmpty() ? QBrush(QColor(Qt::white)) : QBrush(QColor(Qt::darkCyan).darker(180));
+        }
+        break;
+
+    case NameColumn: {
+        const QString &name = objects.name(index);
+
+        if (name.isEmpty()) {
+            if (role == Qt::DisplayRole) {
+                return QString("<Object name not defined...>");
+            }
+            else if (role == Qt::ToolTipRole) {
+                return badTypeTip.isEmpty()
+                        ? tr(
+                            "\n  Warning!  \n"
+                            "\n"
+                            "  Name for this object is not defined in the applications source code.\n"
+                            "  Identifying objects with other attributes such as \"x\", \"y\", \"width\",\n"
+                            "  \"height\", \"text\" or \"icon\" may lead to failure of the tests.  \n"
+                            "\n"
+                            "  Object names are more likely to remain the same throughout the software life cycle.\n"
+                            "\n"
+                            "  Please contact your manager, development team or responsible person and\n"
+                            "  request for properly named objects in order to make this application more testable.\n")
+                        : badTypeTip;
+            }
+        }
+        else if (duplicateItems.contains(name)) {
+            if (role == Qt::ToolTipRole) {
+                if (!badTypeTip.isEmpty()) return badTypeTip;
+
+                if (duplicateItems.value(name).size() == 1) {
+                    return tr(
+                                "\n  Warning!\n"
+                                "\n"
+                                "  Multiple objects found with same object name and id.\n"
+                                "\n"
+                                "  Identifying and accessing this test object without full stack of parent object(s)\n"
+                                "  may lead your test scripts to fail. The reason for this issue is how objects are\n"
+                                "  traversed, but usually due to there are no unique object id available.\n"
+                                "\n"
+                                "  Please contact your manager, traverser development team or responsible person\n"
+                                "  and request for unique object names and ids in order to make this application\n"
+                                "  more testable.\n" );
+                }
+                else if (!symbianSut) {
+                    return tr(
+                                "\n  Warning!\n"
+                                "\n"
+                                "  Multiple objects found with same object name.\n"
+                                "\n"
+                                "  Objects without unique name may lead your test scripts to fail due to multiple\n"
+                                "  test objects found exception.  Please contact your manager, development team\n"
+                                "  or responsible person and request for uniquely named objects in order to make\n"
+                                "  this application more testable.\n");
+                }
+                return QString();
+            }
+        }
+        else {
+            // unique name, no tooltip and no background
+            if (role == Qt::DisplayRole) return name;
+            if (role == Qt::ForegroundRole) return QBrush(QColor(Qt::darkGreen));
+            return QVariant();
+        }
+
+        // empty and duplicate names
+        if (role == Qt::DisplayRole) return name;
+        if (role == Qt::BackgroundRole) return QBrush(QColor(Qt::red));
+        if (role == Qt::ForegroundRole) return QBrush(QColor(Qt::white));
+        break;
+    }
+
+    case IdColumn:
+        if (role == Qt::DisplayRole) {
+            const QString &id = objects.id(index);
+            return id.isEmpty() ? QString("<None>") : id;
+        }
+        else if (role == Qt::ForegroundRole) {
+            return QBrush(QColor(Qt::darkYellow));
+        }
+        break;
+    }
+
+    return QVariant();
+}
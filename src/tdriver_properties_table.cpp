@@ -20,6 +20,7 @@
 
 #include "tdriver_main_window.h"
 #include <tdriver_tabbededitor.h>
+#include "tdriver_reply_parser.h"
 
 #include <tdriver_debug_macros.h>
 
@@ -56,9 +57,10 @@ void MainWindow::clearPropertiesTableContents() {
 
 void MainWindow::doPropertiesTableUpdate()
 {
-    if ( objectTree->currentItem() != NULL ) {
-        // retrieve pointer of current item selected in object tree
-        TestObjectKey currentItemPtr = ptr2TestObjectKey(objectTree->currentItem());
+    // retrieve key of current item selected in object tree
+    TestObjectKey currentItemPtr = currentObjectKey();
+
+    if ( currentItemPtr != 0 ) {
 
         // retrieve current table index
         int currentTab = tabWidget->currentIndex();        
@@ -81,16 +83,16 @@ void MainWindow::doPropertiesTableUpdate()
 
 void MainWindow::sendUpdateApiTableContent()
 {
-    TestObjectKey currentItemPtr = ptr2TestObjectKey( objectTree->currentItem() );
+    TestObjectKey currentItemPtr = currentObjectKey();
 
 #if !DISABLE_API_TAB_PENDING_REMOVAL
     // clear methods table contents
     apiTable->clearContents();
     apiTable->setRowCount( 0 );
     // update table only if item selected in object tree
-    if ( objectTree->currentItem() != NULL && apiFixtureEnabled ) {
+    if ( currentItemPtr != 0 && apiFixtureEnabled ) {
 
-        QString objectType = objectTreeData.value( currentItemPtr ).type;
+        QString objectType = testObjects.type( testObjectIndex( currentItemPtr ) );
 
         if ( !objectType.isEmpty() ) {
 
@@ -175,7 +177,7 @@ void MainWindow::updateMethodsTableContent() {
 
     // qDebug() << "updateMethodsTableContent";
 
-    TestObjectKey currentItemPtr = ptr2TestObjectKey( objectTree->currentItem() );
+    TestObjectKey currentItemPtr = currentObjectKey();
 
     Behaviour behaviour;
 
@@ -185,10 +187,10 @@ void MainWindow::updateMethodsTableContent() {
 
 
     // update table only if item selected in object tree
-    if ( objectTree->currentItem() != NULL ) {
+    if ( currentItemPtr != 0 ) {
 
         // retrieve current item object type
-        QString currentItemObjectType = objectTree->currentItem()->data( 0, Qt::DisplayRole ).toString();
+        QString currentItemObjectType = objectTreeModel->typeText( testObjectIndex( currentItemPtr ) );
 
         QStringList objectTypes;
         //objectTypes << "*" << currentItemObjectType;
@@ -249,7 +251,7 @@ bool MainWindow::sendUpdateSignalsTableContent()
 {
     // qDebug() << "updateSignalsTableContent";
 
-    TestObjectKey currentItemPtr = ptr2TestObjectKey( objectTree->currentItem() );
+    TestObjectKey currentItemPtr = currentObjectKey();
 
     // store pointer of current item to table, so signals table won't be updated unless item is changed on object tree
     propertyTabLastTimeUpdated.insert( "signals", currentItemPtr );
@@ -258,13 +260,16 @@ bool MainWindow::sendUpdateSignalsTableContent()
     signalsTable->clearContents();
     signalsTable->setRowCount( 0 );
 
+    // signals of previously selected item may still be being parsed
+    replyParser->cancel( TDriverReplyParser::SignalsReply );
+
     // update table only if item selected in object tree
     if ( currentItemPtr != 0 ) {
 
         // retrieve current item object type
-        QString objectType = objectTree->currentItem()->data( 0, Qt::DisplayRole ).toString();
-        QString objectId   = objectTreeData.value(currentItemPtr).id;
-        QString env = objectTreeData.value(currentItemPtr).env;
+        QString objectType = objectTreeModel->typeText( testObjectIndex( currentItemPtr ) );
+        QString objectId   = testObjects.id(testObjectIndex(currentItemPtr));
+        QString env = testObjects.env(testObjectIndex(currentItemPtr));
 
         // Retrieve the signals from the device
         if (objectType != "sut" && objectType != "QAction") {
@@ -292,19 +297,23 @@ void MainWindow::updateAttributesTableContent()
                this, SLOT(changePropertiesTableValue(QTableWidgetItem*)) );
 
     // retrieve pointer of currently selected objectTree item
-    TestObjectKey currentItemPtr = ptr2TestObjectKey( objectTree->currentItem() );
+    TestObjectKey currentItemPtr = currentObjectKey();
 
     // clear properties table contents
     propertiesTable->clearContents();
     propertiesTable->setRowCount( 0 );
 
-    if ( attributesMap.contains( currentItemPtr ) && objectTree->currentItem() != NULL ) {
+    const int currentItemIndex = testObjectIndex( currentItemPtr );
+
+    if ( testObjects.attributeCount( currentItemIndex ) > 0 ) {
+
+        // retrieve current objects attributes, sorted by name
+        const QMap<QString, AttributeInfo > attributes = testObjects.attributes( currentItemIndex );
 
         // set number of attributes in table
-        propertiesTable->setRowCount( attributesMap.value( currentItemPtr ).size() );
+        propertiesTable->setRowCount( attributes.size() );
 
-        // retrieve current objects attributes (using pointer of QTreeWidgetItem)
-        QMapIterator<QString, AttributeInfo > iterator( attributesMap.value( currentItemPtr ) );
+        QMapIterator<QString, AttributeInfo > iterator( attributes );
 
         int index = 0;
         while ( iterator.hasNext() ) {
@@ -370,8 +379,9 @@ void MainWindow::connectTabWidgetSignals()
 
 void MainWindow::changePropertiesTableValue( QTableWidgetItem *item )
 {
-    TestObjectKey currentItemPtr = ptr2TestObjectKey( objectTree->currentItem() );
-    const TreeItemInfo &treeItemData = objectTreeData.value( currentItemPtr );
+    TestObjectKey currentItemPtr = currentObjectKey();
+    const int currentItemIndex = testObjectIndex( currentItemPtr );
+    const TreeItemInfo treeItemData = testObjects.treeItemInfo( currentItemIndex );
 
     // this feature is not supported in with env != qt
     if (treeItemData.env.toLower() == "qt") {
@@ -387,7 +397,7 @@ void MainWindow::changePropertiesTableValue( QTableWidgetItem *item )
         objRubyId.append(":id=>"+TDriverUtil::rubySingleQuote(treeItemData.id));
         objRubyId.append(')');
 
-        QString targetDataType = attributesMap.value(currentItemPtr).value(attributeName).dataType;
+        QString targetDataType = testObjects.attribute(currentItemIndex, attributeName).dataType;
 
         if (targetDataType.size() == 0) {
             QMessageBox::warning(this,
@@ -430,12 +440,13 @@ void MainWindow::methodItemPressed( QTableWidgetItem * item ) {
             bool fullPath = isPathAction(action);
 
             if (fullPath) {
-                QTreeWidgetItem * treeItem = objectTree->currentItem();
-                TestObjectKey sutItemPtr = ptr2TestObjectKey(objectTree->topLevelItem(0));
-                do {
+                int treeItemIndex = testObjectIndex(currentObjectKey());
+                TestObjectKey sutItemPtr = testObjectKey(0);
+                while (treeItemIndex >= 0) {
                     text = TDriverUtil::smartJoin(
-                                treeObjectRubyId(ptr2TestObjectKey(treeItem), sutItemPtr), '.', text);
-                } while (ptr2TestObjectKey(treeItem) != sutItemPtr && (treeItem = treeItem->parent()));
+                                treeObjectRubyId(testObjectKey(treeItemIndex), sutItemPtr), '.', text);
+                    treeItemIndex = testObjects.parent(treeItemIndex);
+                }
             }
 
             switch (action) {
@@ -473,8 +484,8 @@ void MainWindow::propertiesItemPressed ( QTableWidgetItem * item )
         // only react to click if one of the menu choices was clicked
         if ( action > cancelAction ) {
             bool fullPath = isPathAction(action);
-            QTreeWidgetItem * treeItem = objectTree->currentItem();
-            QString objectType = treeItem->data( 0, Qt::DisplayRole ).toString();
+            int treeItemIndex = testObjectIndex(currentObjectKey());
+            QString objectType = objectTreeModel->typeText( treeItemIndex );
 
             QList<QTableWidgetItem *> selectedItems = item->tableWidget()->selectedItems();
 
@@ -495,10 +506,10 @@ void MainWindow::propertiesItemPressed ( QTableWidgetItem * item )
             objRubyId += ")";
 
             if (fullPath) {
-                TestObjectKey sutItemPtr = ptr2TestObjectKey(objectTree->topLevelItem(0));
-                while (ptr2TestObjectKey(treeItem) != sutItemPtr && (treeItem = treeItem->parent())) {
+                TestObjectKey sutItemPtr = testObjectKey(0);
+                while ((treeItemIndex = testObjects.parent(treeItemIndex)) >= 0) {
                     objRubyId = TDriverUtil::smartJoin(
-                                treeObjectRubyId(ptr2TestObjectKey(treeItem), sutItemPtr), '.', objRubyId);
+                                treeObjectRubyId(testObjectKey(treeItemIndex), sutItemPtr), '.', objRubyId);
                 }
             }
 
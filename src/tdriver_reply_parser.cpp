@@ -0,0 +1,314 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#include "tdriver_reply_parser.h"
+
+#include <tdriver_debug_macros.h>
+
+#include <QFile>
+#include <QBuffer>
+#include <QTime>
+#include <QtConcurrentRun>
+
+
+/*!
+    \class TDriverReplyParser
+    \brief Parses reply files of TDriver interface on worker threads.
+
+    Each reply type has a generation counter. Starting a new parse of a type
+    cancels the previous one with same context, and result of a parse is reported
+    only if no newer parse of same type and context was started meanwhile, so a slow
+    stale parse never overwrites newer data. Parses of different contexts, such as
+    signals of different object types, don't cancel each other. UI dump parsing stops soon after cancellation, DOM parsing runs
+    to the end but its result is dropped.
+    Results are plain values, owned by the receiver once reported.
+    Replies may also carry their payload in memory instead of a file,
+    it is then parsed from the data and kept in the result.
+ */
+
+
+TDriverReplyParser::TDriverReplyParser(QObject *parent) :
+    QObject(parent)
+{
+    for (int type = 0; type < ReplyTypeCount; ++type) {
+        generations[type] = 0;
+    }
+}
+
+
+TDriverReplyParser::~TDriverReplyParser()
+{
+    // worker threads keep their own copies of data, they only need to be told to stop
+    cancelAll();
+}
+
+
+void TDriverReplyParser::parse(ReplyType type, const QString &fileName, const QString &context,
+                               const QByteArray &data)
+{
+    cancel(type, context);
+
+    TDriverParsedReply reply;
+    reply.type = type;
+    reply.generation = ++generations[type];
+    reply.fileName = fileName;
+    reply.context = context;
+    reply.data = data;
+
+    PendingParse &parse = pendingParses[ParseKey(type, context)];
+    parse.generation = reply.generation;
+    parse.cancelFlag = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    parse.watcher = new QFutureWatcher<TDriverParsedReply>(this);
+    connect(parse.watcher, SIGNAL(finished()), SLOT(parseFinished()));
+    parse.watcher->setFuture(QtConcurrent::run(&TDriverReplyParser::parseReply, reply, parse.cancelFlag));
+}
+
+
+void TDriverReplyParser::cancelParse(const PendingParse &parse)
+{
+    parse.cancelFlag->fetchAndStoreOrdered(1);
+
+    // finished() of cancelled watcher is not handled anymore
+    parse.watcher->disconnect();
+    connect(parse.watcher, SIGNAL(finished()), parse.watcher, SLOT(deleteLater()));
+}
+
+
+void TDriverReplyParser::cancel(ReplyType type, const QString &context)
+{
+    QHash<ParseKey, PendingParse>::iterator it = pendingParses.find(ParseKey(type, context));
+    if (it != pendingParses.end()) {
+        cancelParse(it.value());
+        pendingParses.erase(it);
+    }
+}
+
+
+void TDriverReplyParser::cancel(ReplyType type)
+{
+    QHash<ParseKey, PendingParse>::iterator it = pendingParses.begin();
+    while (it != pendingParses.end()) {
+        if (it.key().first == type) {
+            cancelParse(it.value());
+            it = pendingParses.erase(it);
+        }
+        else ++it;
+    }
+}
+
+
+void TDriverReplyParser::cancelAll()
+{
+    foreach (const PendingParse &parse, pendingParses) {
+        cancelParse(parse);
+    }
+    pendingParses.clear();
+}
+
+
+bool TDriverReplyParser::isParsing(ReplyType type) const
+{
+    foreach (const ParseKey &key, pendingParses.keys()) {
+        if (key.first == type) return true;
+    }
+    return false;
+}
+
+
+void TDriverReplyParser::parseFinished()
+{
+    QFutureWatcher<TDriverParsedReply> *watcher = static_cast<QFutureWatcher<TDriverParsedReply> *>(sender());
+    const TDriverParsedReply reply = watcher->result();
+    watcher->deleteLater();
+
+    const ParseKey key(reply.type, reply.context);
+    QHash<ParseKey, PendingParse>::iterator it = pendingParses.find(key);
+
+    if (it == pendingParses.end() || it.value().watcher != watcher || it.value().generation != reply.generation) {
+        qDebug() << FCFL << "dropping stale result of type" << reply.type << "generation" << reply.generation;
+        return;
+    }
+
+    pendingParses.erase(it);
+
+    qDebug() << FCFL << "parsed type" << reply.type << "generation" << reply.generation
+             << "ok" << reply.ok << "time" << float(reply.parseTime)/1000.0;
+
+    emit parsed(reply);
+}
+
+
+// Runs in worker thread
+TDriverParsedReply TDriverReplyParser::parseReply(TDriverParsedReply reply, QSharedPointer<QAtomicInt> cancelFlag)
+{
+    QTime t;
+    t.start();
+
+    if (reply.type == UiDumpReply) {
+        reply.uiDump.setCancelFlag(cancelFlag.data());
+        reply.ok = reply.data.isNull()
+                ? parseUiDumpFile(reply.fileName, reply.uiDump, reply.errorText)
+                : parseUiDumpData(reply.data, reply.fileName, reply.uiDump, reply.errorText);
+        reply.uiDump.setCancelFlag(NULL);
+    }
+    else if (*cancelFlag == 0) {
+        reply.ok = reply.data.isNull()
+                ? parseXmlFile(reply.fileName, reply.document, reply.errorText)
+                : parseXmlData(reply.data, reply.fileName, reply.document, reply.errorText);
+    }
+
+    reply.parseTime = t.elapsed();
+    return reply;
+}
+
+
+bool TDriverReplyParser::parseUiDumpFile(const QString &fileName, TDriverUiDumpParser &parser, QString &errorText)
+{
+    bool result = false;
+
+    // ui dump is read as a stream, no dom document is kept
+    QFile xmlFile( fileName );
+
+    if ( !xmlFile.exists() ) {
+        qDebug() << FCFL << fileName << "not found";
+        errorText = tr( "File not found:\n\n  %1\n" ).arg( fileName );
+
+    } else if ( !xmlFile.open( QIODevice::ReadOnly ) ) {
+        qDebug() << fileName << "open error";
+        errorText = tr( "Cannot open XML file %1" ).arg( fileName );
+
+    } else {
+        result = parser.parse( &xmlFile );
+
+        if ( parser.isCancelled() ) {
+            qDebug() << FCFL << fileName << "cancelled";
+
+        } else if ( !result ) {
+            qDebug() << FCFL << fileName << 'l' << parser.errorLine() << 'c' << parser.errorColumn() << ':' << parser.errorString();
+            errorText = tr( "XML parse error in file %1 line %2 column %3:\n\n%4" )
+                    .arg(fileName)
+                    .arg(parser.errorLine())
+                    .arg(parser.errorColumn())
+                    .arg(parser.errorString());
+
+        } else {
+            qDebug() << FCFL << fileName << "success";
+        }
+
+        xmlFile.close();
+    }
+
+    return result;
+}
+
+
+bool TDriverReplyParser::parseXmlFile(const QString &fileName, QDomDocument &document, QString &errorText)
+{
+    bool result = false;
+
+    // read xml file
+    QFile xmlFile( fileName );
+
+    if ( !xmlFile.exists() ) {
+        qDebug() << FCFL << fileName << "not found";
+        errorText = tr( "File not found:\n\n  %1\n" ).arg( fileName );
+
+    } else if ( !xmlFile.open( QIODevice::ReadOnly ) ) {
+        qDebug() << fileName << "open error";
+        errorText = tr( "Cannot open XML file %1" ).arg( fileName );
+
+    } else {
+        // temporary xml dom document
+        QDomDocument tempDomDocument;
+        QString errorMsg;
+        int errorLine = 0, errorColumn = 0;
+        result = tempDomDocument.setContent(&xmlFile, &errorMsg, &errorLine, &errorColumn );
+
+        if ( !result )  {
+            qDebug() << FCFL << fileName << 'l' << errorLine << 'c' << errorColumn << ':' << errorMsg;
+            errorText = tr( "XML parse error in file %1 line %2 column %3:\n\n%4" )
+                    .arg(fileName)
+                    .arg(errorLine)
+                    .arg(errorColumn)
+                    .arg(errorMsg);
+
+        } else {
+            qDebug() << FCFL << fileName << "success";
+            // return parsed xml dom as result
+            document = tempDomDocument;
+        }
+
+        xmlFile.close();
+    }
+
+    return result;
+}
+
+
+bool TDriverReplyParser::parseUiDumpData(const QByteArray &data, const QString &name, TDriverUiDumpParser &parser, QString &errorText)
+{
+    // buffer reads the shared data, nothing is copied
+    QBuffer buffer;
+    buffer.setData( data );
+    buffer.open( QIODevice::ReadOnly );
+
+    const bool result = parser.parse( &buffer );
+
+    if ( parser.isCancelled() ) {
+        qDebug() << FCFL << name << "cancelled";
+
+    } else if ( !result ) {
+        qDebug() << FCFL << name << 'l' << parser.errorLine() << 'c' << parser.errorColumn() << ':' << parser.errorString();
+        errorText = tr( "XML parse error in data %1 line %2 column %3:\n\n%4" )
+                .arg(name)
+                .arg(parser.errorLine())
+                .arg(parser.errorColumn())
+                .arg(parser.errorString());
+
+    } else {
+        qDebug() << FCFL << name << "success," << data.size() << "bytes";
+    }
+
+    return result;
+}
+
+
+bool TDriverReplyParser::parseXmlData(const QByteArray &data, const QString &name, QDomDocument &document, QString &errorText)
+{
+    QDomDocument tempDomDocument;
+    QString errorMsg;
+    int errorLine = 0, errorColumn = 0;
+    const bool result = tempDomDocument.setContent( data, &errorMsg, &errorLine, &errorColumn );
+
+    if ( !result )  {
+        qDebug() << FCFL << name << 'l' << errorLine << 'c' << errorColumn << ':' << errorMsg;
+        errorText = tr( "XML parse error in data %1 line %2 column %3:\n\n%4" )
+                .arg(name)
+                .arg(errorLine)
+                .arg(errorColumn)
+                .arg(errorMsg);
+
+    } else {
+        qDebug() << FCFL << name << "success," << data.size() << "bytes";
+        document = tempDomDocument;
+    }
+
+    return result;
+}
@@ -0,0 +1,211 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#include "tdriver_screenshot_index.h"
+
+#include <QtAlgorithms>
+
+
+/*!
+    \class TDriverScreenshotIndex
+    \brief Uniform grid spatial index of object geometries on screenshot.
+
+    Built once per refresh from geometries of visible objects. Each object is
+    listed in every grid cell it overlaps, so a point query only examines
+    objects of a single cell instead of all visible objects.
+ */
+
+
+// grid is at most this many cells in each direction
+static const int maxGridSize = 64;
+// but cells are not made smaller than this, in pixels
+static const int minCellSize = 8;
+
+
+TDriverScreenshotIndex::TDriverScreenshotIndex() :
+    cellWidth(1),
+    cellHeight(1),
+    columns(0),
+    rows(0)
+{
+}
+
+
+void TDriverScreenshotIndex::clear()
+{
+    entries.clear();
+    bounds = QRect();
+    cellWidth = cellHeight = 1;
+    columns = rows = 0;
+    cellStarts.clear();
+    cellEntries.clear();
+}
+
+
+void TDriverScreenshotIndex::addObject(int id, const QRect &rect, bool selectable)
+{
+    if (!rect.isValid()) return;
+
+    Entry entry;
+    entry.rect = rect;
+    entry.area = qint64(rect.width()) * qint64(rect.height());
+    entry.id = id;
+    entry.selectable = selectable;
+    entries << entry;
+}
+
+
+void TDriverScreenshotIndex::build()
+{
+    // id order makes query results ordered without sorting
+    qSort(entries.begin(), entries.end(), entryIdLessThan);
+
+    bounds = QRect();
+    foreach (const Entry &entry, entries) {
+        bounds |= entry.rect;
+    }
+
+    if (bounds.isEmpty()) {
+        columns = rows = 0;
+        cellStarts.clear();
+        cellEntries.clear();
+        return;
+    }
+
+    cellWidth = qMax(minCellSize, (bounds.width() + maxGridSize - 1) / maxGridSize);
+    cellHeight = qMax(minCellSize, (bounds.height() + maxGridSize - 1) / maxGridSize);
+    columns = (bounds.width() + cellWidth - 1) / cellWidth;
+    rows = (bounds.height() + cellHeight - 1) / cellHeight;
+
+    // count entries per cell, then fill flat cell entry array
+    cellStarts.fill(0, columns * rows + 1);
+
+    foreach (const Entry &entry, entries) {
+        const int col2 = cellColumn(entry.rect.right());
+        const int row2 = cellRow(entry.rect.bottom());
+        for (int row = cellRow(entry.rect.top()); row <= row2; ++row) {
+            for (int col = cellColumn(entry.rect.left()); col <= col2; ++col) {
+                ++cellStarts[row * columns + col + 1];
+            }
+        }
+    }
+
+    for (int cell = 0; cell < columns * rows; ++cell) {
+        cellStarts[cell + 1] += cellStarts.at(cell);
+    }
+
+    cellEntries.resize(cellStarts.last());
+    QVector<int> cellFill = cellStarts;
+
+    for (int ii = 0; ii < entries.size(); ++ii) {
+        const QRect &rect = entries.at(ii).rect;
+        const int col2 = cellColumn(rect.right());
+        const int row2 = cellRow(rect.bottom());
+        for (int row = cellRow(rect.top()); row <= row2; ++row) {
+            for (int col = cellColumn(rect.left()); col <= col2; ++col) {
+                cellEntries[cellFill[row * columns + col]++] = ii;
+            }
+        }
+    }
+}
+
+
+int TDriverScreenshotIndex::smallestAt(const QPoint &pos) const
+{
+    if (!bounds.contains(pos)) return -1;
+
+    const int cell = cellRow(pos.y()) * columns + cellColumn(pos.x());
+    const Entry *smallest = 0;
+
+    for (int ii = cellStarts.at(cell); ii < cellStarts.at(cell + 1); ++ii) {
+        const Entry &entry = entries.at(cellEntries.at(ii));
+
+        // entries are in id order, so strict comparison keeps smallest id
+        if (entry.selectable && entry.area > 0 && entry.rect.contains(pos)
+                && (!smallest || entry.area < smallest->area)) {
+            smallest = &entry;
+        }
+    }
+
+    return smallest ? smallest->id : -1;
+}
+
+
+QList<int> TDriverScreenshotIndex::objectsAt(const QPoint &pos, bool selectableOnly) const
+{
+    QList<int> results;
+    if (!bounds.contains(pos)) return results;
+
+    const int cell = cellRow(pos.y()) * columns + cellColumn(pos.x());
+
+    for (int ii = cellStarts.at(cell); ii < cellStarts.at(cell + 1); ++ii) {
+        const Entry &entry = entries.at(cellEntries.at(ii));
+        if ((entry.selectable || !selectableOnly) && entry.rect.contains(pos)) {
+            results << entry.id;
+        }
+    }
+
+    return results;
+}
+
+
+QList<int> TDriverScreenshotIndex::objectsIntersecting(const QRect &rect, bool selectableOnly) const
+{
+    QList<int> results;
+    const QRect area = rect & bounds;
+    if (area.isEmpty()) return results;
+
+    const int areaCol = cellColumn(area.left());
+    const int areaRow = cellRow(area.top());
+    const int col2 = cellColumn(area.right());
+    const int row2 = cellRow(area.bottom());
+
+    for (int row = areaRow; row <= row2; ++row) {
+        for (int col = areaCol; col <= col2; ++col) {
+            const int cell = row * columns + col;
+
+            for (int ii = cellStarts.at(cell); ii < cellStarts.at(cell + 1); ++ii) {
+                const Entry &entry = entries.at(cellEntries.at(ii));
+                if ((!entry.selectable && selectableOnly) || !entry.rect.intersects(rect)) continue;
+
+                // entry is listed in several cells, report it only from first cell common with query
+                if (col == qMax(areaCol, cellColumn(entry.rect.left()))
+                        && row == qMax(areaRow, cellRow(entry.rect.top()))) {
+                    results << entry.id;
+                }
+            }
+        }
+    }
+
+    qSort(results);
+    return results;
+}
+
+
+int TDriverScreenshotIndex::cellColumn(int x) const
+{
+    return qBound(0, (x - bounds.left()) / cellWidth, columns - 1);
+}
+
+
+int TDriverScreenshotIndex::cellRow(int y) const
+{
+    return qBound(0, (y - bounds.top()) / cellHeight, rows - 1);
+}
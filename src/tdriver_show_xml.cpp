@@ -23,10 +23,23 @@
 
 #include <QGridLayout>
 #include <QPlainTextEdit>
+#include <QFile>
 
 void MainWindow::showXMLDialog() {
 
-    sourceEdit->setPlainText( xmlDocument.toString() );
+    // ui dump is kept in memory only if it was received that way, otherwise read it again from the file
+    QFile xmlFile( uiDumpFileName );
+
+    if ( !uiDumpData.isNull() ) {
+        sourceEdit->setPlainText( QString::fromUtf8( uiDumpData ) );
+    }
+    else if ( !uiDumpFileName.isEmpty() && xmlFile.open( QIODevice::ReadOnly ) ) {
+        sourceEdit->setPlainText( QString::fromUtf8( xmlFile.readAll() ) );
+        xmlFile.close();
+    }
+    else {
+        sourceEdit->clear();
+    }
 
     xmlView->show();
     xmlView->activateWindow();
@@ -0,0 +1,439 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+
+#include "tdriver_state_history_store.h"
+
+#include <tdriver_debug_macros.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QHash>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+
+/*!
+    \class TDriverStateHistoryStore
+    \brief Stores state history as content addressed blobs and small manifests.
+
+    Ui dumps and screenshots are stored once per content, in files named by SHA-1
+    of the content, so identical states saved by consecutive refreshes take no
+    extra space. Each history entry is a manifest file referring to its blobs.
+    Ui dumps are zlib compressed, and stored as line based deltas against a
+    common keyframe dump when that is much smaller. Screenshots are stored as is,
+    PNG is already compressed.
+
+    Removing an entry only removes its manifest, blobs are removed by trim
+    once no manifest refers to them.
+ */
+
+
+static const QByteArray manifestMagic("TDriverStateHistory 1");
+static const QString manifestSuffix(".manifest");
+static const int hashLength = 40; // hex SHA-1
+
+
+static inline QByteArray contentHash(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+
+TDriverStateHistoryStore::TDriverStateHistoryStore(const QString &path) :
+    storePath(path)
+{
+    QDir().mkpath(storePath + "/blobs");
+    QDir().mkpath(storePath + "/manifests");
+}
+
+
+QString TDriverStateHistoryStore::blobPath(const QByteArray &hash) const
+{
+    return storePath + "/blobs/" + QString::fromLatin1(hash);
+}
+
+
+QString TDriverStateHistoryStore::manifestPath(const QString &id) const
+{
+    return storePath + "/manifests/" + id + manifestSuffix;
+}
+
+
+// writes to a temporary file first, so an interrupted write never leaves a partial blob or manifest
+bool TDriverStateHistoryStore::writeFile(const QString &filePath, const QByteArray &content)
+{
+    const QString tmpPath = filePath + ".tmp";
+    QFile file(tmpPath);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(content) != content.size()) {
+        qDebug() << FFL << "failed to write" << tmpPath << ":" << file.errorString();
+        file.remove();
+        return false;
+    }
+    file.close();
+
+    QFile::remove(filePath);
+    if (!file.rename(filePath)) {
+        qDebug() << FFL << "failed to rename" << tmpPath << ":" << file.errorString();
+        file.remove();
+        return false;
+    }
+    return true;
+}
+
+
+QString TDriverStateHistoryStore::add(const QString &uiDumpName, const QByteArray &uiDump,
+                                      const QString &imageName, const QByteArray &image)
+{
+    TDriverStateHistoryEntry newEntry;
+    newEntry.created = QDateTime::currentDateTime();
+    newEntry.uiDumpName = uiDumpName;
+    newEntry.uiDumpHash = contentHash(uiDump);
+
+    const QList<TDriverStateHistoryEntry> previous = entries();
+    const QByteArray baseHash = deltaBase(previous.isEmpty() ? QByteArray() : previous.first().uiDumpHash);
+
+    if (!writeBlob(newEntry.uiDumpHash, uiDump, FullBlob, baseHash, keyframeData)) return QString();
+
+    if (!image.isEmpty()) {
+        newEntry.imageName = imageName;
+        newEntry.imageHash = contentHash(image);
+        if (!writeBlob(newEntry.imageHash, image, RawBlob)) return QString();
+    }
+
+    // ids are time stamps, a counter keeps them unique and ordered within same millisecond
+    const QString stamp = newEntry.created.toString("yyyyMMdd_hhmmss_zzz_");
+    int counter = 0;
+    do {
+        newEntry.id = stamp + QString("%1").arg(counter++, 2, 10, QChar('0'));
+    } while (QFile::exists(manifestPath(newEntry.id)));
+
+    QByteArray manifest;
+    manifest.append(manifestMagic).append('\n');
+    manifest.append("created ").append(newEntry.created.toString(Qt::ISODate).toLatin1()).append('\n');
+    manifest.append("uidump ").append(newEntry.uiDumpHash).append(' ').append(uiDumpName.toUtf8()).append('\n');
+    if (!newEntry.imageHash.isEmpty()) {
+        manifest.append("image ").append(newEntry.imageHash).append(' ').append(imageName.toUtf8()).append('\n');
+    }
+
+    if (!writeFile(manifestPath(newEntry.id), manifest)) return QString();
+
+    qDebug() << FCFL << "added" << newEntry.id << "ui dump" << newEntry.uiDumpHash << "image" << newEntry.imageHash;
+    return newEntry.id;
+}
+
+
+// Returns keyframe for delta of next ui dump, and makes sure keyframeData holds it.
+// Deltas are always made against a full dump, so reading a dump needs at most two blobs.
+QByteArray TDriverStateHistoryStore::deltaBase(const QByteArray &previousHash)
+{
+    char kind;
+    QByteArray base;
+
+    if (previousHash.isEmpty() || !readBlobHeader(previousHash, kind, base)) return QByteArray();
+    if (kind == FullBlob) base = previousHash;
+    else if (kind != DeltaBlob) return QByteArray();
+
+    if (base != keyframeHash) {
+        keyframeHash.clear();
+        keyframeData.clear();
+        if (!readBlob(base, keyframeData)) return QByteArray();
+        keyframeHash = base;
+    }
+    return keyframeHash;
+}
+
+
+bool TDriverStateHistoryStore::writeBlob(const QByteArray &hash, const QByteArray &data, BlobKind kind,
+                                         const QByteArray &baseHash, const QByteArray &baseData)
+{
+    if (QFile::exists(blobPath(hash))) {
+        qDebug() << FCFL << "blob" << hash << "already stored";
+        return true;
+    }
+
+    QByteArray content;
+
+    if (kind == RawBlob) {
+        content.append(char(RawBlob)).append(data);
+    }
+    else {
+        const QByteArray full = qCompress(data);
+
+        if (!baseHash.isEmpty()) {
+            const QByteArray delta = qCompress(makeDelta(baseData, data));
+            qDebug() << FCFL << "delta" << delta.size() << "full" << full.size() << "bytes";
+            if (delta.size() * DeltaRatio < full.size()) {
+                content.append(char(DeltaBlob)).append(baseHash).append(delta);
+            }
+        }
+
+        if (content.isEmpty()) {
+            content.append(char(FullBlob)).append(full);
+            // next dumps are made deltas against this one
+            keyframeHash = hash;
+            keyframeData = data;
+        }
+    }
+
+    return writeFile(blobPath(hash), content);
+}
+
+
+bool TDriverStateHistoryStore::readBlobHeader(const QByteArray &hash, char &kind, QByteArray &base) const
+{
+    QFile file(blobPath(hash));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    const QByteArray header = file.read(1 + hashLength);
+    if (header.isEmpty()) return false;
+
+    kind = header.at(0);
+    base = (kind == DeltaBlob) ? header.mid(1) : QByteArray();
+    return kind != DeltaBlob || base.size() == hashLength;
+}
+
+
+bool TDriverStateHistoryStore::readBlob(const QByteArray &hash, QByteArray &data) const
+{
+    QFile file(blobPath(hash));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << FCFL << "failed to open blob" << hash << ":" << file.errorString();
+        return false;
+    }
+
+    const QByteArray content = file.readAll();
+    const uchar *payload = reinterpret_cast<const uchar *>(content.constData()) + 1;
+    const char kind = content.isEmpty() ? 0 : content.at(0);
+
+    if (kind == RawBlob) {
+        data = content.mid(1);
+    }
+    else if (kind == FullBlob) {
+        data = qUncompress(payload, content.size() - 1);
+    }
+    else if (kind == DeltaBlob && content.size() > 1 + hashLength) {
+        const QByteArray baseHash = content.mid(1, hashLength);
+        char baseKind;
+        QByteArray baseBase;
+        QByteArray baseData;
+        // keyframes are full blobs, this also stops a corrupted store from recursing
+        if (!readBlobHeader(baseHash, baseKind, baseBase) || baseKind != FullBlob
+                || !readBlob(baseHash, baseData)
+                || !applyDelta(baseData, qUncompress(payload + hashLength, content.size() - 1 - hashLength), data)) {
+            data.clear();
+        }
+    }
+    else {
+        data.clear();
+    }
+
+    if (data.isEmpty() || contentHash(data) != hash) {
+        qDebug() << FCFL << "blob" << hash << "is corrupted, kind" << kind;
+        data.clear();
+        return false;
+    }
+    return true;
+}
+
+
+bool TDriverStateHistoryStore::readManifest(const QString &filePath, TDriverStateHistoryEntry &result)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.readLine().trimmed() != manifestMagic) return false;
+
+    result = TDriverStateHistoryEntry();
+    result.id = QFileInfo(filePath).completeBaseName();
+
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        const int keyEnd = line.indexOf(' ');
+        const QByteArray key = line.left(keyEnd);
+        const QByteArray value = line.mid(keyEnd + 1);
+
+        if (key == "created") {
+            result.created = QDateTime::fromString(QString::fromLatin1(value), Qt::ISODate);
+        }
+        else if (key == "uidump") {
+            result.uiDumpHash = value.left(hashLength);
+            result.uiDumpName = QString::fromUtf8(value.mid(hashLength + 1));
+        }
+        else if (key == "image") {
+            result.imageHash = value.left(hashLength);
+            result.imageName = QString::fromUtf8(value.mid(hashLength + 1));
+        }
+    }
+
+    return result.uiDumpHash.size() == hashLength;
+}
+
+
+QList<TDriverStateHistoryEntry> TDriverStateHistoryStore::entries() const
+{
+    QList<TDriverStateHistoryEntry> result;
+    const QDir dir(storePath + "/manifests");
+
+    foreach (const QString &fileName, dir.entryList(QStringList() << "*" + manifestSuffix,
+                                                    QDir::Files, QDir::Name | QDir::Reversed)) {
+        TDriverStateHistoryEntry item;
+        if (readManifest(dir.filePath(fileName), item)) result << item;
+        else qDebug() << FCFL << "ignoring invalid manifest" << fileName;
+    }
+    return result;
+}
+
+
+bool TDriverStateHistoryStore::entry(const QString &id, TDriverStateHistoryEntry &result) const
+{
+    return readManifest(manifestPath(id), result);
+}
+
+
+void TDriverStateHistoryStore::trim(int maxCount)
+{
+    const QList<TDriverStateHistoryEntry> all = entries();
+    QSet<QByteArray> referenced;
+
+    for (int ind = 0; ind < all.size(); ++ind) {
+        const TDriverStateHistoryEntry &item = all.at(ind);
+
+        if (ind >= maxCount) {
+            QFile::remove(manifestPath(item.id));
+            qDebug() << FCFL << "removed entry" << item.id;
+            continue;
+        }
+
+        char kind;
+        QByteArray base;
+        referenced << item.uiDumpHash;
+        if (readBlobHeader(item.uiDumpHash, kind, base) && kind == DeltaBlob) referenced << base;
+        if (!item.imageHash.isEmpty()) referenced << item.imageHash;
+    }
+
+    // also removes temporary files left over by interrupted writes
+    QDir dir(storePath + "/blobs");
+    foreach (const QString &fileName, dir.entryList(QDir::Files)) {
+        if (!referenced.contains(fileName.toLatin1())) {
+            dir.remove(fileName);
+            qDebug() << FCFL << "removed blob" << fileName;
+        }
+    }
+
+    if (!referenced.contains(keyframeHash)) {
+        keyframeHash.clear();
+        keyframeData.clear();
+    }
+}
+
+
+// Delta is a list of operations which either copy a range of lines from base, or insert a new line.
+// Lines are split at '\n' only, so applying the delta restores data byte by byte.
+enum DeltaOp { DeltaCopyLines = 1, DeltaInsertLine = 2 };
+
+QByteArray TDriverStateHistoryStore::makeDelta(const QByteArray &base, const QByteArray &data)
+{
+    const QList<QByteArray> baseLines = base.split('\n');
+    const QList<QByteArray> lines = data.split('\n');
+
+    // first occurrence of each base line, runs are then extended line by line
+    QHash<QByteArray, int> baseIndex;
+    baseIndex.reserve(baseLines.size());
+    for (int ind = baseLines.size() - 1; ind >= 0; --ind) {
+        baseIndex.insert(baseLines.at(ind), ind);
+    }
+
+    QByteArray delta;
+    QDataStream out(&delta, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << quint32(lines.size());
+
+    int copyStart = 0;
+    int copyCount = 0;
+
+    foreach (const QByteArray &line, lines) {
+        if (copyCount > 0 && copyStart + copyCount < baseLines.size() && baseLines.at(copyStart + copyCount) == line) {
+            ++copyCount;
+            continue;
+        }
+
+        if (copyCount > 0) {
+            out << quint8(DeltaCopyLines) << quint32(copyStart) << quint32(copyCount);
+            copyCount = 0;
+        }
+
+        QHash<QByteArray, int>::const_iterator it = baseIndex.constFind(line);
+        if (it != baseIndex.constEnd()) {
+            copyStart = it.value();
+            copyCount = 1;
+        }
+        else {
+            out << quint8(DeltaInsertLine) << line;
+        }
+    }
+
+    if (copyCount > 0) {
+        out << quint8(DeltaCopyLines) << quint32(copyStart) << quint32(copyCount);
+    }
+
+    return delta;
+}
+
+
+bool TDriverStateHistoryStore::applyDelta(const QByteArray &base, const QByteArray &delta, QByteArray &data)
+{
+    const QList<QByteArray> baseLines = base.split('\n');
+
+    QDataStream in(delta);
+    in.setVersion(QDataStream::Qt_4_6);
+    quint32 lineCount = 0;
+    in >> lineCount;
+
+    QList<QByteArray> lines;
+
+    while (in.status() == QDataStream::Ok && !in.atEnd()) {
+        quint8 op = 0;
+        in >> op;
+
+        if (op == DeltaCopyLines) {
+            quint32 start = 0, count = 0;
+            in >> start >> count;
+            if (start > quint32(baseLines.size()) || count > quint32(baseLines.size()) - start) return false;
+            for (quint32 ind = start; ind < start + count; ++ind) lines << baseLines.at(ind);
+        }
+        else if (op == DeltaInsertLine) {
+            QByteArray line;
+            in >> line;
+            lines << line;
+        }
+        else return false;
+    }
+
+    if (in.status() != QDataStream::Ok || quint32(lines.size()) != lineCount) return false;
+
+    data.clear();
+    for (int ind = 0; ind < lines.size(); ++ind) {
+        if (ind > 0) data.append('\n');
+        data.append(lines.at(ind));
+    }
+    return true;
+}
@@ -0,0 +1,129 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#include "tdriver_testobject_diff.h"
+#include "tdriver_testobject_store.h"
+
+#include <QHash>
+#include <QList>
+
+
+/*!
+    \class TDriverTestObjectDiff
+    \brief Matches test objects of two consecutive UI dumps.
+
+    Children of matched parents are matched in order, expecting mostly
+    unchanged sibling order, and a lookup table is built for a parent only
+    when its children have been reordered, added or removed.
+    Attribute changes are detected by comparing attribute hashes of the stores.
+ */
+
+
+TDriverTestObjectDiff::TDriverTestObjectDiff(const TDriverTestObjectStore &previous,
+                                             const TDriverTestObjectStore &current) :
+    previous(previous),
+    current(current),
+    previousIndexes(current.count(), -1),
+    currentIndexes(previous.count(), -1),
+    added(current.count()),
+    removed(previous.count()),
+    changed(0)
+{
+    if (!previous.isEmpty() && !current.isEmpty() && isSameObject(0, 0)) {
+        previousIndexes[0] = 0;
+        currentIndexes[0] = 0;
+        --added;
+        --removed;
+        matchChildren(0, 0);
+    }
+
+    for (int index = 0; index < current.count(); ++index) {
+        if (previousIndexes.at(index) >= 0 && isChanged(index)) ++changed;
+    }
+}
+
+
+bool TDriverTestObjectDiff::isChanged(int currentIndex) const
+{
+    int index = previousIndex(currentIndex);
+
+    return (index < 0
+            || previous.attributeCount(index) != current.attributeCount(currentIndex)
+            || previous.attributeHash(index) != current.attributeHash(currentIndex));
+}
+
+
+void TDriverTestObjectDiff::matchChildren(int previousParent, int currentParent)
+{
+    // expected match for next child, when sibling order is unchanged
+    int cursor = previous.firstChild(previousParent);
+
+    // built on first mismatch: env/type/id/name -> previous children in document order
+    QHash<QString, QList<int> > lookup;
+    bool lookupBuilt = false;
+
+    for (int child = current.firstChild(currentParent); child >= 0; child = current.nextSibling(child)) {
+
+        int match = -1;
+
+        if (cursor >= 0 && currentIndexes.at(cursor) < 0 && isSameObject(cursor, child)) {
+            match = cursor;
+        }
+        else {
+            if (!lookupBuilt) {
+                for (int ii = previous.firstChild(previousParent); ii >= 0; ii = previous.nextSibling(ii)) {
+                    lookup[previous.env(ii) + '\n' + previous.type(ii) + '\n'
+                           + previous.id(ii) + '\n' + previous.name(ii)] << ii;
+                }
+                lookupBuilt = true;
+            }
+
+            QHash<QString, QList<int> >::iterator it = lookup.find(
+                        current.env(child) + '\n' + current.type(child) + '\n'
+                        + current.id(child) + '\n' + current.name(child));
+
+            if (it != lookup.end()) {
+                // first previous object with same key not matched yet
+                while (!it.value().isEmpty() && match < 0) {
+                    int candidate = it.value().takeFirst();
+                    if (currentIndexes.at(candidate) < 0) match = candidate;
+                }
+            }
+        }
+
+        if (match >= 0) {
+            previousIndexes[child] = match;
+            currentIndexes[match] = child;
+            --added;
+            --removed;
+            cursor = previous.nextSibling(match);
+            matchChildren(match, child);
+        }
+    }
+}
+
+
+bool TDriverTestObjectDiff::isSameObject(int previousIndex, int currentIndex) const
+{
+    return (previous.id(previousIndex) == current.id(currentIndex)
+            && previous.type(previousIndex) == current.type(currentIndex)
+            && previous.name(previousIndex) == current.name(currentIndex)
+            && previous.env(previousIndex) == current.env(currentIndex));
+}
@@ -0,0 +1,350 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#include "tdriver_testobject_store.h"
+
+#include <QtAlgorithms>
+
+
+/*!
+    \class TDriverTestObjectStore
+    \brief Compact storage for all test objects and attributes of one UI dump.
+
+    Objects are addressed by dense integer index in document order, so subtree
+    of an object is a contiguous index range. All strings are pooled, attribute
+    names are interned to integer keys, and attributes of each object are one
+    contiguous range sorted by key, so lookups are a binary search over integers.
+ */
+
+
+const QString TDriverTestObjectStore::emptyString;
+
+
+TDriverTestObjectStore::TDriverTestObjectStore()
+{
+    // index 0 is always the empty string
+    poolString(QString(""));
+}
+
+
+void TDriverTestObjectStore::clear()
+{
+    objects.clear();
+    attributeRecords.clear();
+    strings.clear();
+    stringHashes.clear();
+    stringIndexes.clear();
+    attributeNames.clear();
+    attributeNameKeys.clear();
+    attributeNameHashes.clear();
+    attributeNameIndexes.clear();
+    attributeKeyNames.clear();
+    attributeKeyIndexes.clear();
+    idIndexes.clear();
+    pendingAttributes.clear();
+
+    poolString(QString(""));
+}
+
+
+int TDriverTestObjectStore::beginObject(int parent, const TreeItemInfo &data)
+{
+    ObjectRecord object;
+    object.type = poolString(data.type);
+    object.name = poolString(data.name);
+    object.id = poolString(data.id);
+    object.env = poolString(data.env);
+    object.parent = parent;
+    object.subtreeEnd = objects.size() + 1;
+    object.attributeBegin = 0;
+    object.attributeCount = 0;
+    object.attributeHash = 0;
+
+    int index = objects.size();
+    objects << object;
+
+    // later object with same id replaces earlier
+    idIndexes.insert(object.id, index);
+
+    return index;
+}
+
+
+void TDriverTestObjectStore::addAttribute(int index, const AttributeInfo &attribute)
+{
+    if (!isValid(index)) return;
+
+    AttributeRecord record;
+    record.name = internAttributeName(attribute.name, record.key);
+    record.dataType = poolString(attribute.dataType);
+    record.type = poolString(attribute.type);
+    record.value = poolString(attribute.value);
+
+    QVector<AttributeRecord> &pending = pendingAttributes[index];
+
+    // attribute with same case insensitive name replaces earlier one
+    for (int n = 0; n < pending.size(); ++n) {
+        if (pending.at(n).key == record.key) {
+            pending[n] = record;
+            return;
+        }
+    }
+
+    pending << record;
+}
+
+
+void TDriverTestObjectStore::endObject(int index)
+{
+    if (!isValid(index)) return;
+
+    ObjectRecord &object = objects[index];
+    object.subtreeEnd = objects.size();
+
+    QVector<AttributeRecord> pending = pendingAttributes.take(index);
+    qSort(pending.begin(), pending.end(), attributeKeyLessThan);
+
+    object.attributeBegin = attributeRecords.size();
+    object.attributeCount = pending.size();
+    attributeRecords += pending;
+
+    // key indexes are store specific, so hash is combined from string hashes in any order
+    uint hash = 0;
+    foreach (const AttributeRecord &record, pending) {
+        uint recordHash = attributeNameHashes.at(record.name);
+        recordHash = 31 * recordHash + stringHashes.at(record.dataType);
+        recordHash = 31 * recordHash + stringHashes.at(record.type);
+        recordHash = 31 * recordHash + stringHashes.at(record.value);
+        hash += recordHash ^ (recordHash >> 16);
+    }
+    object.attributeHash = hash;
+}
+
+
+int TDriverTestObjectStore::firstChild(int index) const
+{
+    if (!isValid(index)) return -1;
+    return (index + 1 < objects.at(index).subtreeEnd) ? index + 1 : -1;
+}
+
+
+int TDriverTestObjectStore::nextSibling(int index) const
+{
+    if (!isValid(index)) return -1;
+
+    int next = objects.at(index).subtreeEnd;
+    int parentIndex = objects.at(index).parent;
+
+    if (next < objects.size() && parentIndex >= 0 && next < objects.at(parentIndex).subtreeEnd) {
+        return next;
+    }
+    return -1;
+}
+
+
+int TDriverTestObjectStore::childCount(int index) const
+{
+    int result = 0;
+    for (int child = firstChild(index); child >= 0; child = nextSibling(child)) {
+        ++result;
+    }
+    return result;
+}
+
+
+TreeItemInfo TDriverTestObjectStore::treeItemInfo(int index) const
+{
+    TreeItemInfo result;
+    if (isValid(index)) {
+        const ObjectRecord &object = objects.at(index);
+        result.type = strings.at(object.type);
+        result.name = strings.at(object.name);
+        result.id = strings.at(object.id);
+        result.env = strings.at(object.env);
+    }
+    return result;
+}
+
+
+int TDriverTestObjectStore::indexOfId(const QString &id) const
+{
+    int stringIndex = stringIndexes.value(id, -1);
+    return (stringIndex < 0) ? -1 : idIndexes.value(stringIndex, -1);
+}
+
+
+int TDriverTestObjectStore::attributeKey(const QString &name) const
+{
+    QHash<QString, int>::const_iterator it = attributeNameIndexes.constFind(name);
+
+    if (it != attributeNameIndexes.constEnd()) {
+        // exact name seen in dump, avoid lowercase conversion
+        return attributeNameKeys.at(it.value());
+    }
+    return attributeKeyIndexes.value(name.toLower(), -1);
+}
+
+
+AttributeInfo TDriverTestObjectStore::attributeAt(int index, int n) const
+{
+    AttributeInfo result;
+    if (n >= 0 && n < attributeCount(index)) {
+        const AttributeRecord &record = attributeRecords.at(objects.at(index).attributeBegin + n);
+        result.name = attributeNames.at(record.name);
+        result.dataType = strings.at(record.dataType);
+        result.type = strings.at(record.type);
+        result.value = strings.at(record.value);
+    }
+    return result;
+}
+
+
+const QString &TDriverTestObjectStore::attributeNameAt(int index, int n) const
+{
+    if (n < 0 || n >= attributeCount(index)) return emptyString;
+    return attributeNames.at(attributeRecords.at(objects.at(index).attributeBegin + n).name);
+}
+
+
+const QString &TDriverTestObjectStore::attributeValueAt(int index, int n) const
+{
+    if (n < 0 || n >= attributeCount(index)) return emptyString;
+    return strings.at(attributeRecords.at(objects.at(index).attributeBegin + n).value);
+}
+
+
+int TDriverTestObjectStore::attributeValueStringIndexAt(int index, int n) const
+{
+    if (n < 0 || n >= attributeCount(index)) return 0;
+    return attributeRecords.at(objects.at(index).attributeBegin + n).value;
+}
+
+
+int TDriverTestObjectStore::attributeValueStringIndex(int index, int key) const
+{
+    int pos = findAttribute(index, key);
+    return (pos < 0) ? -1 : attributeRecords.at(pos).value;
+}
+
+
+const QString &TDriverTestObjectStore::attributeValue(int index, int key) const
+{
+    int pos = findAttribute(index, key);
+    return (pos < 0) ? emptyString : strings.at(attributeRecords.at(pos).value);
+}
+
+
+AttributeInfo TDriverTestObjectStore::attribute(int index, const QString &name) const
+{
+    int pos = findAttribute(index, attributeKey(name));
+    return (pos < 0) ? AttributeInfo() : attributeAt(index, pos - objects.at(index).attributeBegin);
+}
+
+
+QMap<QString, AttributeInfo> TDriverTestObjectStore::attributes(int index) const
+{
+    QMap<QString, AttributeInfo> results;
+
+    int count = attributeCount(index);
+    for (int n = 0; n < count; ++n) {
+        const AttributeRecord &record = attributeRecords.at(objects.at(index).attributeBegin + n);
+        results.insert(attributeKeyNames.at(record.key), attributeAt(index, n));
+    }
+
+    return results;
+}
+
+
+int TDriverTestObjectStore::memoryUsage() const
+{
+    int result = objects.capacity() * sizeof(ObjectRecord) + attributeRecords.capacity() * sizeof(AttributeRecord);
+
+    foreach (const QString &str, strings) {
+        // string data is shared with hash key
+        result += str.capacity() * sizeof(QChar) + 2 * (sizeof(QString) + sizeof(int));
+    }
+
+    result += idIndexes.size() * 2 * sizeof(int);
+    return result;
+}
+
+
+int TDriverTestObjectStore::poolString(const QString &str)
+{
+    QHash<QString, int>::const_iterator it = stringIndexes.constFind(str);
+    if (it != stringIndexes.constEnd()) return it.value();
+
+    int stringIndex = strings.size();
+    strings << str;
+    stringHashes << qHash(str);
+    stringIndexes.insert(str, stringIndex);
+    return stringIndex;
+}
+
+
+// returns index to attributeNames, and sets key to index of lowercase name
+int TDriverTestObjectStore::internAttributeName(const QString &name, int &key)
+{
+    QHash<QString, int>::const_iterator it = attributeNameIndexes.constFind(name);
+    if (it != attributeNameIndexes.constEnd()) {
+        key = attributeNameKeys.at(it.value());
+        return it.value();
+    }
+
+    const QString keyName = name.toLower();
+    QHash<QString, int>::const_iterator keyIt = attributeKeyIndexes.constFind(keyName);
+    if (keyIt != attributeKeyIndexes.constEnd()) {
+        key = keyIt.value();
+    }
+    else {
+        key = attributeKeyNames.size();
+        attributeKeyNames << keyName;
+        attributeKeyIndexes.insert(keyName, key);
+    }
+
+    int nameIndex = attributeNames.size();
+    attributeNames << name;
+    attributeNameKeys << key;
+    attributeNameHashes << qHash(name);
+    attributeNameIndexes.insert(name, nameIndex);
+    return nameIndex;
+}
+
+
+// returns index to attributeRecords, or -1
+int TDriverTestObjectStore::findAttribute(int index, int key) const
+{
+    if (key < 0 || !isValid(index)) return -1;
+
+    const ObjectRecord &object = objects.at(index);
+    int low = object.attributeBegin;
+    int high = object.attributeBegin + object.attributeCount - 1;
+
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        int middleKey = attributeRecords.at(middle).key;
+
+        if (middleKey < key) low = middle + 1;
+        else if (middleKey > key) high = middle - 1;
+        else return middle;
+    }
+
+    return -1;
+}
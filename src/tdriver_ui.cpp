@@ -33,6 +33,8 @@
 
 #include "tdriver_debug_macros.h"
 
+#include "ui_tdriver_richtextcontainer.h"
+
 void MainWindow::setupTableWidgetHeader( QString headers, QTableWidget * table)
 {
 
@@ -204,8 +206,13 @@ void MainWindow::changeImageLeftClick(int index) {
 void MainWindow::createTreeViewDockWidget()
 {
 
-    objectTree = new QTreeWidget();
+    objectTreeModel = new TDriverObjectTreeModel(this);
+
+    objectTree = new QTreeView();
     objectTree->setObjectName("tree");
+    // all rows have same height, so view doesn't need to ask size of every row
+    objectTree->setUniformRowHeights( true );
+    objectTree->setModel( objectTreeModel );
 
     //    objectTree->header()->setStretchLastSection(false);
     //    objectTree->header()->setResizeMode( QHeaderView::Stretch );
@@ -213,19 +220,14 @@ void MainWindow::createTreeViewDockWidget()
     objectTree->header()->setStretchLastSection( true );
     objectTree->header()->setResizeMode( QHeaderView::Interactive );
 
-    objectTree->setColumnCount( 3 );
-
-    for ( int i = 0; i < 3; i++ ) {
+    for ( int i = 0; i < TDriverObjectTreeModel::ColumnCount; i++ ) {
 
         objectTree->setColumnWidth( i, 250 );
 
         //objectTree->setColumnWidth( i, QSettings().value( QString( "objecttree/column" + QString::number( i ) ), 350 ).toInt() );
     }
 
-    QStringList labels;
-    labels << " type " << " name " << " id ";
-    objectTree->setHeaderLabels ( labels );
-
+    objectTreeModel->setMissingTypeToolTip( richTextContainer->testObjectMissingType->toolTip() );
 }
 
 // create properties dock widget
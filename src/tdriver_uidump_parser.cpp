@@ -0,0 +1,234 @@
+/***************************************************************************
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (testabilitydriver@nokia.com)
+**
+** This file is part of Testability Driver.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at testabilitydriver@nokia.com .
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+
+#include "tdriver_uidump_parser.h"
+
+#include <QIODevice>
+#include <QXmlStreamReader>
+#include <QXmlStreamAttributes>
+#include <QAtomicInt>
+
+#include <QDebug>
+
+
+/*!
+    \class TDriverUiDumpParser
+    \brief Single pass QXmlStreamReader parser for UI dump XML files.
+
+    Reads both the pre-1.3 format (tasInfo/objects/object/attributes/attribute/value)
+    and the 1.3+ format (tasInfo/obj/attr) without building a DOM tree.
+    Element names of the two formats don't overlap, so format is selected per element.
+    Test objects and their attributes go directly to a TDriverTestObjectStore,
+    and duplicate object name statistics are collected during the same sweep.
+ */
+
+
+TDriverUiDumpParser::TDriverUiDumpParser() :
+    parseErrorLine(0),
+    parseErrorColumn(0),
+    cancelFlag(0),
+    cancelled(false)
+{
+}
+
+
+void TDriverUiDumpParser::clear()
+{
+    dumpVersion.clear();
+    parsedObjects.clear();
+    nameIds.clear();
+    duplicateNames.clear();
+    parseErrorString.clear();
+    parseErrorLine = 0;
+    parseErrorColumn = 0;
+    cancelled = false;
+}
+
+
+bool TDriverUiDumpParser::parse(QIODevice *device)
+{
+    clear();
+
+    QXmlStreamReader xml(device);
+
+    // root element, tasMessage
+    if (xml.readNextStartElement()) {
+
+        dumpVersion = xml.attributes().value(QLatin1String("version")).toString();
+
+        while (xml.readNextStartElement()) {
+
+            if (xml.name() == QLatin1String("tasInfo") && parsedObjects.isEmpty()) {
+                const QXmlStreamAttributes attributes = xml.attributes();
+
+                TreeItemInfo sut;
+                sut.type = QString("sut");
+                sut.name = attributes.value(QLatin1String("name")).toString();
+                sut.id = attributes.value(QLatin1String("id")).toString();
+                sut.env = attributes.value(QLatin1String("env")).toString();
+
+                int index = parsedObjects.beginObject(-1, sut);
+                readObjectChildren(xml, index);
+                parsedObjects.endObject(index);
+            }
+            else {
+                if (xml.name() == QLatin1String("tasInfo")) {
+                    qWarning("%s:%i: Duplicate tasInfo element, ignoring it!", __FILE__, __LINE__);
+                }
+                // still read through to detect malformed XML like full DOM parsing would
+                xml.skipCurrentElement();
+            }
+        }
+    }
+
+    if (xml.hasError()) {
+        parseErrorString = xml.errorString();
+        parseErrorLine = xml.lineNumber();
+        parseErrorColumn = xml.columnNumber();
+        return false;
+    }
+
+    return true;
+}
+
+
+QMap<QString, QStringList> TDriverUiDumpParser::duplicateItems() const
+{
+    QMap<QString, QStringList> results;
+
+    foreach(const QString &name, duplicateNames) {
+        results.insert(name, nameIds.value(name));
+    }
+
+    return results;
+}
+
+
+// Reads child elements until end of current element.
+// Old format wrapper elements "objects" and "attributes" are transparent.
+void TDriverUiDumpParser::readObjectChildren(QXmlStreamReader &xml, int parentIndex)
+{
+    while (xml.readNextStartElement()) {
+
+        const QStringRef name = xml.name();
+
+        if (name == QLatin1String("attr")) {
+            readAttribute(xml, parentIndex);
+        }
+        else if (name == QLatin1String("obj") || name == QLatin1String("object")) {
+            readObject(xml, parentIndex);
+        }
+        else if (name == QLatin1String("attribute")) {
+            readOldFormatAttribute(xml, parentIndex);
+        }
+        else if (name == QLatin1String("attributes") || name == QLatin1String("objects")) {
+            readObjectChildren(xml, parentIndex);
+        }
+        else {
+            xml.skipCurrentElement();
+        }
+    }
+}
+
+
+void TDriverUiDumpParser::readObject(QXmlStreamReader &xml, int parentIndex)
+{
+    if (cancelFlag && *cancelFlag != 0) {
+        // makes all enclosing read loops end
+        cancelled = true;
+        xml.raiseError(QLatin1String("Parsing cancelled"));
+        return;
+    }
+
+    const QXmlStreamAttributes attributes = xml.attributes();
+
+    TreeItemInfo object;
+    object.type = attributes.value(QLatin1String("type")).toString();
+    object.name = attributes.value(QLatin1String("name")).toString();
+    object.id = attributes.value(QLatin1String("id")).toString();
+    object.env = attributes.value(QLatin1String("env")).toString();
+
+    addObjectName(object.name, object.id);
+
+    int index = parsedObjects.beginObject(parentIndex, object);
+    readObjectChildren(xml, index);
+    parsedObjects.endObject(index);
+}
+
+
+// 1.3+ format: <attr name="..." type="..." access="...">value</attr>
+void TDriverUiDumpParser::readAttribute(QXmlStreamReader &xml, int objectIndex)
+{
+    const QXmlStreamAttributes attributes = xml.attributes();
+
+    AttributeInfo attributeData;
+    attributeData.name = attributes.value(QLatin1String("name")).toString();
+    attributeData.dataType = attributes.value(QLatin1String("type")).toString();
+    attributeData.type = attributes.value(QLatin1String("access")).toString();
+    attributeData.value = xml.readElementText(QXmlStreamReader::IncludeChildElements);
+
+    parsedObjects.addAttribute(objectIndex, attributeData);
+}
+
+
+// pre-1.3 format: <attribute name="..." dataType="..." type="..."><value>value</value></attribute>
+void TDriverUiDumpParser::readOldFormatAttribute(QXmlStreamReader &xml, int objectIndex)
+{
+    const QXmlStreamAttributes attributes = xml.attributes();
+
+    AttributeInfo attributeData;
+    attributeData.name = attributes.value(QLatin1String("name")).toString();
+    attributeData.dataType = attributes.value(QLatin1String("dataType")).toString();
+    attributeData.type = attributes.value(QLatin1String("type")).toString();
+
+    bool haveValue = false;
+    while (xml.readNextStartElement()) {
+        if (!haveValue && xml.name() == QLatin1String("value")) {
+            attributeData.value = xml.readElementText(QXmlStreamReader::IncludeChildElements);
+            haveValue = true;
+        }
+        else {
+            xml.skipCurrentElement();
+        }
+    }
+
+    parsedObjects.addAttribute(objectIndex, attributeData);
+}
+
+
+// Same rules as used to be applied to whole DOM tree after parsing:
+// a name seen more than once is a duplicate, and ids seen with that name are listed.
+// Single id in the list means there are multiple objects with same name and id.
+void TDriverUiDumpParser::addObjectName(const QString &name, const QString &id)
+{
+    if (name.isEmpty()) return;
+
+    QHash<QString, QStringList>::iterator it = nameIds.find(name);
+
+    if (it == nameIds.end()) {
+        nameIds.insert(name, QStringList() << id);
+    }
+    else {
+        if (!it.value().contains(id)) {
+            it.value() << id;
+        }
+        duplicateNames.insert(name);
+    }
+}
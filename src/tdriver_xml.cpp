@@ -20,7 +20,10 @@
 
 
 #include "tdriver_main_window.h"
+#include "tdriver_uidump_parser.h"
+#include "tdriver_reply_parser.h"
 #include <tdriver_debug_macros.h>
+#include <tdriver_tabbededitor.h>
 
 #include <QToolBar>
 #include <QMenu>
@@ -30,16 +33,14 @@
 
 bool MainWindow::sendUpdateBehaviourXml()
 {
-    if (objectTree->invisibleRootItem()->childCount() <= 0) return false;
+    if (testObjects.isEmpty()) return false;
 
     QStringList objectTypes;
-    QTreeWidgetItem *root = objectTree->invisibleRootItem();
-    QTreeWidgetItem *node = root;
 
-    while ( (node = findDialogSubtreeNext(node, root)) ) {
-        Q_ASSERT(objectTreeData.contains(ptr2TestObjectKey(node) ));
+    // test objects are stored in same order as object tree is traversed
+    for ( int index = 0; index < testObjects.count(); ++index ) {
 
-        QString objectType = objectTreeData.value(ptr2TestObjectKey(node)).type;
+        const QString &objectType = testObjects.type(index);
 
         if ( !objectTypes.contains( objectType ) && !behavioursMap.contains( objectType ) ) {
             objectTypes << objectType;
@@ -75,6 +76,9 @@ void MainWindow::buildBehavioursMap() {
 
     QDomNodeList nodeList = behaviorDomDocument.documentElement().elementsByTagName( "behaviour" );
 
+    // object types and method names are also given to code editor completion
+    QStringList completionWords;
+
     for ( int behaviourIndex = 0; behaviourIndex < nodeList.size(); behaviourIndex++ ) {
 
         QDomNode node = nodeList.item( behaviourIndex );
@@ -151,11 +155,17 @@ void MainWindow::buildBehavioursMap() {
 
             behavioursMap.insert( targetObject, behaviour );
 
+            completionWords << targetObject << behaviour.getMethodsList();
+
         }
 
 
     }
 
+    if ( tabEditor ) {
+        tabEditor->addCompletionWords( completionWords );
+    }
+
 }
 
 void MainWindow::updateApplicationsList()
@@ -336,13 +346,11 @@ void MainWindow::parseApiMethodsXml( QString filename ) {
     }
 
 }
-QStringList MainWindow::parseSignalsXml( QString filename ) {
+QStringList MainWindow::parseSignalsXml( const QDomDocument &apiDocument ) {
 
     QStringList signalList;
-    QDomDocument apiDocument;
 
-    QFile f(filename);
-    if ( f.exists() && parseXml( filename, apiDocument ) ) {
+    if ( !apiDocument.isNull() ) {
 
         // retrieve version from tas message
 
@@ -407,7 +415,7 @@ QStringList MainWindow::parseSignalsXml( QString filename ) {
     return signalList;
 }
 
-void MainWindow::parseApplicationsXml( QString filename )
+void MainWindow::parseApplicationsXml( const QDomDocument &appDocument )
 {
     QDomNode nodeInfo;
     QDomNode nodeApplications;
@@ -415,13 +423,11 @@ void MainWindow::parseApplicationsXml( QString filename )
     QDomNodeList appObjects;
     QDomNodeList applications;
 
-    QDomDocument appDocument;
-
     resetApplicationsList();
 
     QString version;
 
-    if ( parseXml( filename, appDocument ) ) {
+    if ( !appDocument.isNull() ) {
 
         QDomElement root = appDocument.documentElement();
 
@@ -504,7 +510,7 @@ void MainWindow::parseApplicationsXml( QString filename )
 
         } // if ( !nodeInfo.isNull() ) {
 
-    } //     if ( parseXml( filename, appDocument ) ) {
+    } //     if ( !appDocument.isNull() ) {
 
     updateApplicationsList();
 
@@ -521,61 +527,24 @@ void MainWindow::parseApplicationsXml( QString filename )
 bool MainWindow::parseXml( QString fileName, QDomDocument & resultDocument )
 {
     //    qDebug() << FCFL << fileName;
+    QString errorText;
+    bool result = TDriverReplyParser::parseXmlFile( fileName, resultDocument, errorText );
 
-    // temporary xml dom document
-    QDomDocument tempDomDocument;
-    bool result = false;
-
-    // read xml file
-    QFile xmlFile( fileName );
-
-    if ( !xmlFile.exists() ) {
-        qDebug() << FCFL << fileName << "not found";
-        QMessageBox::critical(
-                this,
-                tr( "XML Error" ),
-                tr( "File not found:\n\n  %1\n" ).arg( fileName )
-                );
-    } else {
-
-        if ( !xmlFile.open( QIODevice::ReadOnly ) ) {
-            qDebug() << fileName << "open error";
-            QMessageBox::critical(
-                    this,
-                    tr( "XML Error" ),
-                    tr( "Cannot open XML file %1" ).arg( fileName )
-                    );
-
-        } else {
-
-            QString errorMsg;
-            int errorLine = 0, errorColumn = 0;
-            result = tempDomDocument.setContent(&xmlFile, &errorMsg, &errorLine, &errorColumn );
-
-            if ( !result )  {
-
-                qDebug() << FCFL << fileName << 'l' << errorLine << 'c' << errorColumn << ':' << errorMsg;
-                QMessageBox::critical(
-                        this,
-                        tr( "XML Error" ),
-                        tr( "XML parse error in file %1 line %2 column %3:\n\n%4" )
-                            .arg(fileName)
-                            .arg(errorLine)
-                            .arg(errorColumn)
-                            .arg(errorMsg)
-                        );
-
-            } else {
-                qDebug() << FCFL << fileName << "success";
-                // return parsed xml dom as result
-                resultDocument = tempDomDocument;
+    if ( !result ) {
+        QMessageBox::critical( this, tr( "XML Error" ), errorText );
+    }
 
-            }
+    return result;
+}
 
-            xmlFile.close();
 
-        }
+bool MainWindow::parseUiDumpXml( QString fileName, TDriverUiDumpParser &parser )
+{
+    QString errorText;
+    bool result = TDriverReplyParser::parseUiDumpFile( fileName, parser, errorText );
 
+    if ( !result ) {
+        QMessageBox::critical( this, tr( "XML Error" ), errorText );
     }
 
     return result;
@@ -52,6 +52,16 @@ HEADERS += ../inc/tdriver_behaviour.h
 HEADERS += ../inc/tdriver_image_view.h
 HEADERS += ../inc/tdriver_main_window.h
 HEADERS += ../inc/tdriver_recorder.h
+HEADERS += ../inc/tdriver_uidump_parser.h
+HEADERS += ../inc/tdriver_testobject_store.h
+HEADERS += ../inc/tdriver_screenshot_index.h
+HEADERS += ../inc/tdriver_object_search_index.h
+HEADERS += ../inc/tdriver_object_selector.h
+HEADERS += ../inc/tdriver_testobject_diff.h
+HEADERS += ../inc/tdriver_object_tree_model.h
+HEADERS += ../inc/tdriver_reply_parser.h
+HEADERS += ../inc/tdriver_history_prefetcher.h
+HEADERS += ../inc/tdriver_state_history_store.h
 
 SOURCES += ../src/tdriver_libeditor_ui.cpp \
     ../src/tdriver_libfeatureditor_ui.cpp \
@@ -69,6 +79,16 @@ SOURCES += ../src/tdriver_properties_table.cpp
 SOURCES += ../src/tdriver_show_xml.cpp
 SOURCES += ../src/tdriver_ui.cpp
 SOURCES += ../src/tdriver_xml.cpp
+SOURCES += ../src/tdriver_uidump_parser.cpp
+SOURCES += ../src/tdriver_testobject_store.cpp
+SOURCES += ../src/tdriver_screenshot_index.cpp
+SOURCES += ../src/tdriver_object_search_index.cpp
+SOURCES += ../src/tdriver_object_selector.cpp
+SOURCES += ../src/tdriver_testobject_diff.cpp
+SOURCES += ../src/tdriver_object_tree_model.cpp
+SOURCES += ../src/tdriver_reply_parser.cpp
+SOURCES += ../src/tdriver_history_prefetcher.cpp
+SOURCES += ../src/tdriver_state_history_store.cpp
 SOURCES += ../src/tdriver_find_dialog.cpp
 SOURCES += ../src/tdriver_startapp_dialog.cpp
 SOURCES += ../src/tdriver_savedlayouts.cpp
@@ -1,16 +1,14 @@
 #include "tdriver_statehistorymenu.h"
+#include "tdriver_state_history_store.h"
 
 #include "tdriver_debug_macros.h"
 
 #include <QtGui>
 
-TDriverStateHistoryMenu::TDriverStateHistoryMenu(const QString &filePathPrefix, QWidget *parent) :
-    QMenu(parent)
+TDriverStateHistoryMenu::TDriverStateHistoryMenu(const TDriverStateHistoryStore *store, QWidget *parent) :
+    QMenu(parent),
+    store(store)
 {
-    int slashPos = filePathPrefix.lastIndexOf('/');
-    parentPath = filePathPrefix.left(slashPos+1);
-    QString namePrefix = filePathPrefix.mid(slashPos+1);
-    dirNameFilters << namePrefix+"*";
     addAction(tr("N/A"))->setDisabled(true);
     connect(this, SIGNAL(triggered(QAction*)), SLOT(emitActivated(QAction*)));
 }
@@ -25,39 +23,19 @@ void TDriverStateHistoryMenu::emitActivated(QAction *action)
 }
 
 
-static inline QString getDateOfFirstXmlFile(const QString &dirPath)
-{
-    static const QStringList filterList(QStringList() << "*.xml");
-    QString ret;
-    QDirIterator it(dirPath, filterList, QDir::Files);
-    if (it.hasNext()) {
-        it.next();
-        return it.fileInfo().created().toString("yyyy-MM-dd hh:mm:ss");
-    }
-    else {
-        ret = "N/A";
-    }
-    return ret;
-}
-
 void TDriverStateHistoryMenu::showEvent(QShowEvent *ev)
 {
-    QDirIterator it(parentPath, dirNameFilters, QDir::Dirs|QDir::NoDotAndDotDot);
-
     clear();
 
-    QFileInfoList entryInfos(
-                QDir(parentPath).entryInfoList(dirNameFilters,
-                                               QDir::Dirs|QDir::NoDotAndDotDot,
-                                               QDir::Name));
+    const QList<TDriverStateHistoryEntry> entries(store->entries());
 
-    foreach(const QFileInfo &info, entryInfos) {
-        QString menuPrefix = '&' + info.fileName().right(1) + tr(" created: ");
-        //qDebug() << FCFL << menuPrefix << info.absoluteFilePath();
-        QString dirPath = info.canonicalFilePath();
-        QAction *tmpAct = addAction(menuPrefix + getDateOfFirstXmlFile(dirPath));
-        tmpAct->setData(dirPath);
-        tmpAct->setStatusTip(tr("Load from directory: ") + info.canonicalFilePath());
+    for (int ind = 0; ind < entries.size(); ++ind) {
+        const TDriverStateHistoryEntry &entry = entries.at(ind);
+        QString menuPrefix = '&' + QString::number(ind).right(1) + tr(" created: ");
+        //qDebug() << FCFL << menuPrefix << entry.id;
+        QAction *tmpAct = addAction(menuPrefix + entry.created.toString("yyyy-MM-dd hh:mm:ss"));
+        tmpAct->setData(entry.id);
+        tmpAct->setStatusTip(tr("Load state: ") + entry.uiDumpName);
     }
 
     if (isEmpty()) {
@@ -66,4 +44,3 @@ void TDriverStateHistoryMenu::showEvent(QShowEvent *ev)
 
     QMenu::showEvent(ev);
 }
-
@@ -4,15 +4,16 @@
 #include <QMenu>
 
 class QShowEvent;
+class TDriverStateHistoryStore;
 
 class TDriverStateHistoryMenu : public QMenu
 {
     Q_OBJECT
 public:
-    explicit TDriverStateHistoryMenu(const QString &filePathPrefix, QWidget *parent = 0);
+    explicit TDriverStateHistoryMenu(const TDriverStateHistoryStore *store, QWidget *parent = 0);
 
 signals:
-    void activated(const QString &filePath);
+    void activated(const QString &entryId);
 
 public slots:
 
@@ -23,8 +24,7 @@ protected:
     virtual void showEvent(QShowEvent *);
 
 private:
-    QString parentPath;
-    QStringList dirNameFilters;
+    const TDriverStateHistoryStore *store;
 };
 
 #endif // TDRIVER_STATEHISTORYMENU_H
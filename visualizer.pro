@@ -41,4 +41,10 @@ SUBDIRS += tdriver_editor
 # Testability Driver fixture for tdriver_editor, for running feature tests
 SUBDIRS += fixtures
 
+# QTestLib benchmarks of visualizer internals, not needed for using the visualizer,
+# built when qmake is run with CONFIG+=benchmarks
+CONFIG(benchmarks) {
+    SUBDIRS += benchmarks
+}
+
 CONFIG += ordered